@@ -17,7 +17,7 @@ extern "C" {
 
 #include "echo_control_mobile.h"
 #include "delay_estimator_wrapper.h"
-
+#include "cpu_features_wrapper.h"
 
 #ifdef AEC_DEBUG
 FILE* dfile;
@@ -113,6 +113,44 @@ const int16_t WebRtcAecm_kSinTable[] = {
         -2667, -2531, -2395, -2258, -2120, -1981, -1842, -1703, -1563, -1422, -1281,
         -1140, -998, -856, -713, -571, -428, -285, -142};
 
+// Square root of Hanning window in Q14.
+const ALIGN8_BEG int16_t WebRtcAecm_kSqrtHanning[] ALIGN8_END = {
+        0, 399, 798, 1196, 1594, 1990, 2386, 2780, 3172, 3562, 3951,
+        4337, 4720, 5101, 5478, 5853, 6224, 6591, 6954, 7313, 7668, 8019,
+        8364, 8705, 9040, 9370, 9695, 10013, 10326, 10633, 10933, 11227, 11514,
+        11795, 12068, 12335, 12594, 12845, 13089, 13325, 13553, 13773, 13985, 14189,
+        14384, 14571, 14749, 14918, 15079, 15231, 15373, 15506, 15631, 15746, 15851,
+        15947, 16034, 16111, 16179, 16237, 16286, 16325, 16354, 16373, 16384};
+
+
+#ifdef AECM_WITH_ABS_APPROX
+// Q15 alpha = 0.99439986968132  const Factor for magnitude approximation
+static const uint16_t kAlpha1 = 32584;
+// Q15 beta = 0.12967166976970   const Factor for magnitude approximation
+static const uint16_t kBeta1 = 4249;
+// Q15 alpha = 0.94234827210087  const Factor for magnitude approximation
+static const uint16_t kAlpha2 = 30879;
+// Q15 beta = 0.33787806009150   const Factor for magnitude approximation
+static const uint16_t kBeta2 = 11072;
+// Q15 alpha = 0.82247698684306  const Factor for magnitude approximation
+static const uint16_t kAlpha3 = 26951;
+// Q15 beta = 0.57762063060713   const Factor for magnitude approximation
+static const uint16_t kBeta3 = 18927;
+#endif
+
+// Returns the far end history entry the next WebRtcAecm_UpdateFarHistory()
+// inserts into.
+//
+// Inputs:
+//      - self          : Pointer to the AECM instance
+//
+uint16_t *WebRtcAecm_NextFarHistorySlot(AecmCore *self) {
+    int buffer_position = self->far_history_pos + 1;
+    if (buffer_position >= MAX_DELAY) {
+        buffer_position = 0;
+    }
+    return &(self->far_history[buffer_position * FAR_HISTORY_STRIDE]);
+}
 
 // Moves the pointer to the next entry and inserts |far_spectrum| and
 // corresponding Q-domain in its buffer.
@@ -123,8 +161,9 @@ const int16_t WebRtcAecm_kSinTable[] = {
 //      - far_q         : Q-domain of far end spectrum
 //
 void WebRtcAecm_UpdateFarHistory(AecmCore *self,
-                                 uint16_t *far_spectrum,
+                                 const uint16_t *far_spectrum,
                                  int far_q) {
+    uint16_t *slot = WebRtcAecm_NextFarHistorySlot(self);
     // Get new buffer position
     self->far_history_pos++;
     if (self->far_history_pos >= MAX_DELAY) {
@@ -132,9 +171,10 @@ void WebRtcAecm_UpdateFarHistory(AecmCore *self,
     }
     // Update Q-domain buffer
     self->far_q_domains[self->far_history_pos] = far_q;
-    // Update far end spectrum buffer
-    memcpy(&(self->far_history[self->far_history_pos * PART_LEN1]), far_spectrum,
-           sizeof(uint16_t) * PART_LEN1);
+    // Update far end spectrum buffer, unless written in place
+    if (far_spectrum != slot) {
+        memcpy(slot, far_spectrum, sizeof(uint16_t) * PART_LEN1);
+    }
 }
 
 // Returns a pointer to the far end spectrum aligned to current near end
@@ -168,81 +208,153 @@ const uint16_t *WebRtcAecm_AlignedFarend(AecmCore *self,
     // Get Q-domain
     *far_q = self->far_q_domains[buffer_position];
     // Return far end spectrum
-    return &(self->far_history[buffer_position * PART_LEN1]);
+    return &(self->far_history[buffer_position * FAR_HISTORY_STRIDE]);
 }
 
 // Declare function pointers.
 CalcLinearEnergies WebRtcAecm_CalcLinearEnergies;
 StoreAdaptiveChannel WebRtcAecm_StoreAdaptiveChannel;
 ResetAdaptiveChannel WebRtcAecm_ResetAdaptiveChannel;
+UpdateAdaptiveChannel WebRtcAecm_UpdateAdaptiveChannel;
+ApplyWienerFilter WebRtcAecm_ApplyWienerFilter;
+CalcMagnitudes WebRtcAecm_CalcMagnitudes;
+WindowAndFFTFunction WebRtcAecm_WindowAndFFT;
+WindowAndFFTPairFunction WebRtcAecm_WindowAndFFTPair;
+InverseFFTAndWindowFunction WebRtcAecm_InverseFFTAndWindow;
+
+static bool InitFunctionPointers(void);
+
+// The parts of an AECM instance that follow the AecmCore struct in its
+// memory block, each starting on a cache line.
+enum {
+    kFarFrameBufPart = 0,
+    kNearNoisyFrameBufPart,
+    kNearCleanFrameBufPart,
+    kOutFrameBufPart,
+    kDelayEstimatorFarendPart,
+    kDelayEstimatorPart,
+    kRealFFTPart,
+    kNumCoreParts
+};
+
+static size_t CacheLineBytes(size_t bytes) {
+    return (bytes + 63) & ~(size_t) 63;
+}
 
-AecmCore *WebRtcAecm_CreateCore() {
-    // Allocate zero-filled memory.
-    AecmCore *aecm = static_cast<AecmCore *>(calloc(1, sizeof(AecmCore)));
+typedef struct {
+    size_t offsets[kNumCoreParts];
+    size_t size;
+} CoreBlockLayout;
 
-    aecm->farFrameBuf =
-            WebRtc_CreateBuffer(FRAME_LEN + PART_LEN, sizeof(int16_t));
-    if (!aecm->farFrameBuf) {
-        WebRtcAecm_FreeCore(aecm);
-        return NULL;
-    }
+static CoreBlockLayout ComputeCoreLayout() {
+    const size_t frame_buf_bytes =
+            WebRtc_BufferRequiredMemory(FRAME_LEN + PART_LEN, sizeof(int16_t));
+    size_t part_bytes[kNumCoreParts];
+    CoreBlockLayout layout;
+    int i = 0;
 
-    aecm->nearNoisyFrameBuf =
-            WebRtc_CreateBuffer(FRAME_LEN + PART_LEN, sizeof(int16_t));
-    if (!aecm->nearNoisyFrameBuf) {
-        WebRtcAecm_FreeCore(aecm);
-        return NULL;
+    part_bytes[kFarFrameBufPart] = frame_buf_bytes;
+    part_bytes[kNearNoisyFrameBufPart] = frame_buf_bytes;
+    part_bytes[kNearCleanFrameBufPart] = frame_buf_bytes;
+    part_bytes[kOutFrameBufPart] = frame_buf_bytes;
+    part_bytes[kDelayEstimatorFarendPart] =
+            WebRtc_DelayEstimatorFarendRequiredMemory(PART_LEN1, MAX_DELAY);
+    part_bytes[kDelayEstimatorPart] =
+            WebRtc_DelayEstimatorRequiredMemory(PART_LEN1, MAX_DELAY, 0);
+    part_bytes[kRealFFTPart] = WebRtcSpl_RealFFTRequiredMemory(PART_LEN_SHIFT);
+    layout.size = CacheLineBytes(sizeof(AecmCore));
+    for (i = 0; i < kNumCoreParts; i++) {
+        layout.offsets[i] = layout.size;
+        layout.size += CacheLineBytes(part_bytes[i]);
     }
+    return layout;
+}
 
-    aecm->nearCleanFrameBuf =
-            WebRtc_CreateBuffer(FRAME_LEN + PART_LEN, sizeof(int16_t));
-    if (!aecm->nearCleanFrameBuf) {
-        WebRtcAecm_FreeCore(aecm);
+// Writes the offset of each part to |offsets| and returns the size of the
+// block. The layout only depends on constants, so it is computed once.
+static size_t CoreLayout(size_t offsets[kNumCoreParts]) {
+    static const CoreBlockLayout layout = ComputeCoreLayout();
+    memcpy(offsets, layout.offsets, sizeof(layout.offsets));
+    return layout.size;
+}
+
+size_t WebRtcAecm_CoreRequiredMemory() {
+    size_t offsets[kNumCoreParts];
+    return CoreLayout(offsets);
+}
+
+AecmCore *WebRtcAecm_CreateCore() {
+    const size_t size = WebRtcAecm_CoreRequiredMemory();
+    // One block for the instance, with slack to align it to a cache line.
+    void *memory = malloc(size + 63);
+    AecmCore *aecm = NULL;
+
+    if (memory == NULL) {
         return NULL;
     }
-
-    aecm->outFrameBuf =
-            WebRtc_CreateBuffer(FRAME_LEN + PART_LEN, sizeof(int16_t));
-    if (!aecm->outFrameBuf) {
-        WebRtcAecm_FreeCore(aecm);
+    aecm = WebRtcAecm_CreateCoreInPlace(
+            (void *) (((uintptr_t) memory + 63) & ~(uintptr_t) 63));
+    if (aecm == NULL) {
+        free(memory);
         return NULL;
     }
+    aecm->own_memory = memory;
+    return aecm;
+}
+
+AecmCore *WebRtcAecm_CreateCoreInPlace(void *memory) {
+    size_t offsets[kNumCoreParts];
+    const size_t size = CoreLayout(offsets);
+    char *block = static_cast<char *>(memory);
+    AecmCore *aecm = static_cast<AecmCore *>(memory);
 
-    aecm->delay_estimator_farend =
-            WebRtc_CreateDelayEstimatorFarend(PART_LEN1, MAX_DELAY);
-    if (aecm->delay_estimator_farend == NULL) {
-        WebRtcAecm_FreeCore(aecm);
+    // Initialize function pointers. The kernels are selected once per process
+    // and the initialization of the local statics is thread-safe.
+    WebRtcSpl_Init();
+    static const bool kernels_initialized = InitFunctionPointers();
+    (void) kernels_initialized;
+
+    if (memory == NULL || ((uintptr_t) memory & 63) != 0) {
         return NULL;
     }
-    aecm->delay_estimator =
-            WebRtc_CreateDelayEstimator(aecm->delay_estimator_farend, 0);
+    // Zero-fill the whole block.
+    memset(memory, 0, size);
+
+    aecm->farFrameBuf = WebRtc_CreateBufferInPlace(
+            block + offsets[kFarFrameBufPart], FRAME_LEN + PART_LEN,
+            sizeof(int16_t));
+    aecm->nearNoisyFrameBuf = WebRtc_CreateBufferInPlace(
+            block + offsets[kNearNoisyFrameBufPart], FRAME_LEN + PART_LEN,
+            sizeof(int16_t));
+    aecm->nearCleanFrameBuf = WebRtc_CreateBufferInPlace(
+            block + offsets[kNearCleanFrameBufPart], FRAME_LEN + PART_LEN,
+            sizeof(int16_t));
+    aecm->outFrameBuf = WebRtc_CreateBufferInPlace(
+            block + offsets[kOutFrameBufPart], FRAME_LEN + PART_LEN,
+            sizeof(int16_t));
+
+    aecm->delay_estimator_farend = WebRtc_CreateDelayEstimatorFarendInPlace(
+            block + offsets[kDelayEstimatorFarendPart], PART_LEN1, MAX_DELAY);
+    aecm->delay_estimator = WebRtc_CreateDelayEstimatorInPlace(
+            block + offsets[kDelayEstimatorPart], aecm->delay_estimator_farend,
+            0);
     if (aecm->delay_estimator == NULL) {
-        WebRtcAecm_FreeCore(aecm);
         return NULL;
     }
-    // TODO(bjornv): Explicitly disable robust delay validation until no
-    // performance regression has been established.  Then remove the line.
-    WebRtc_enable_robust_validation(aecm->delay_estimator, 0);
+    WebRtc_enable_robust_validation(aecm->delay_estimator, 1);
+    // Long delay histories, e.g. for Bluetooth devices, are searched coarse to
+    // fine to keep the cost per block down.
+    if (MAX_DELAY >= COARSE_DELAY_SEARCH_MIN &&
+        WebRtc_enable_coarse_search(aecm->delay_estimator, 1) != 0) {
+        return NULL;
+    }
 
-    aecm->real_fft = WebRtcSpl_CreateRealFFT(PART_LEN_SHIFT);
+    aecm->real_fft = WebRtcSpl_CreateRealFFTInPlace(
+            block + offsets[kRealFFTPart], PART_LEN_SHIFT);
     if (aecm->real_fft == NULL) {
-        WebRtcAecm_FreeCore(aecm);
         return NULL;
     }
 
-    // Init some aecm pointers. 16 and 32 byte alignment is only necessary
-    // for Neon code currently.
-    aecm->xBuf = (int16_t *) (((uintptr_t) aecm->xBuf_buf + 31) & ~31);
-    aecm->dBufClean = (int16_t *) (((uintptr_t) aecm->dBufClean_buf + 31) & ~31);
-    aecm->dBufNoisy = (int16_t *) (((uintptr_t) aecm->dBufNoisy_buf + 31) & ~31);
-    aecm->outBuf = (int16_t *) (((uintptr_t) aecm->outBuf_buf + 15) & ~15);
-    aecm->channelStored =
-            (int16_t *) (((uintptr_t) aecm->channelStored_buf + 15) & ~15);
-    aecm->channelAdapt16 =
-            (int16_t *) (((uintptr_t) aecm->channelAdapt16_buf + 15) & ~15);
-    aecm->channelAdapt32 =
-            (int32_t *) (((uintptr_t) aecm->channelAdapt32_buf + 31) & ~31);
-
     return aecm;
 }
 
@@ -322,6 +434,547 @@ static void ResetAdaptiveChannelC(AecmCore *aecm) {
     aecm->channelAdapt32[i] = (int32_t) aecm->channelStored[i] << 16;
 }
 
+// NLMS update of bin |i| of the adaptive channel with step size |mu|,
+// normalized per frequency bin.
+static AECM_ALWAYS_INLINE void UpdateAdaptiveChannelBin(
+        AecmCore *aecm,
+        const uint16_t *far_spectrum,
+        const int16_t far_q,
+        const uint16_t *const dfa,
+        const int16_t mu,
+        int i) {
+    uint32_t tmpU32no1, tmpU32no2;
+    int32_t tmp32no1, tmp32no2;
+
+    int16_t zerosFar, zerosNum, zerosCh, zerosDfa;
+    int16_t shiftChFar, shiftNum, shift2ResChan;
+    int16_t tmp16no1;
+    int16_t xfaQ, dfaQ;
+
+    // Determine norm of channel and farend to make sure we don't get overflow
+    // in multiplication
+    zerosCh = WebRtcSpl_NormU32(aecm->channelAdapt32[i]);
+    zerosFar = WebRtcSpl_NormU32((uint32_t) far_spectrum[i]);
+    if (zerosCh + zerosFar > 31) {
+        // Multiplication is safe
+        tmpU32no1 =
+                WEBRTC_SPL_UMUL_32_16(aecm->channelAdapt32[i], far_spectrum[i]);
+        shiftChFar = 0;
+    } else {
+        // We need to shift down before multiplication
+        shiftChFar = 32 - zerosCh - zerosFar;
+        // If zerosCh == zerosFar == 0, shiftChFar is 32. A
+        // right shift of 32 is undefined. To avoid that, we
+        // do this check.
+        tmpU32no1 = (uint32_t) (
+                shiftChFar >= 32 ? 0 : aecm->channelAdapt32[i] >> shiftChFar) *
+                    far_spectrum[i];
+    }
+    // Determine Q-domain of numerator
+    zerosNum = WebRtcSpl_NormU32(tmpU32no1);
+    if (dfa[i]) {
+        zerosDfa = WebRtcSpl_NormU32((uint32_t) dfa[i]);
+    } else {
+        zerosDfa = 32;
+    }
+    tmp16no1 = zerosDfa - 2 + aecm->dfaNoisyQDomain - RESOLUTION_CHANNEL32 -
+               far_q + shiftChFar;
+    if (zerosNum > tmp16no1 + 1) {
+        xfaQ = tmp16no1;
+        dfaQ = zerosDfa - 2;
+    } else {
+        xfaQ = zerosNum - 2;
+        dfaQ = RESOLUTION_CHANNEL32 + far_q - aecm->dfaNoisyQDomain -
+               shiftChFar + xfaQ;
+    }
+    // Add in the same Q-domain
+    tmpU32no1 = WEBRTC_SPL_SHIFT_W32(tmpU32no1, xfaQ);
+    tmpU32no2 = WEBRTC_SPL_SHIFT_W32((uint32_t) dfa[i], dfaQ);
+    tmp32no1 = (int32_t) tmpU32no2 - (int32_t) tmpU32no1;
+    zerosNum = WebRtcSpl_NormW32(tmp32no1);
+    if ((tmp32no1) && (far_spectrum[i] > (CHANNEL_VAD << far_q))) {
+        //
+        // Update is needed
+        //
+        // This is what we would like to compute
+        //
+        // tmp32no1 = dfa[i] - (aecm->channelAdapt[i] * far_spectrum[i])
+        // tmp32norm = (i + 1)
+        // aecm->channelAdapt[i] += (2^mu) * tmp32no1
+        //                        / (tmp32norm * far_spectrum[i])
+        //
+
+        // Make sure we don't get overflow in multiplication.
+        if (zerosNum + zerosFar > 31) {
+            if (tmp32no1 > 0) {
+                tmp32no2 =
+                        (int32_t) WEBRTC_SPL_UMUL_32_16(tmp32no1, far_spectrum[i]);
+            } else {
+                tmp32no2 =
+                        -(int32_t) WEBRTC_SPL_UMUL_32_16(-tmp32no1, far_spectrum[i]);
+            }
+            shiftNum = 0;
+        } else {
+            shiftNum = 32 - (zerosNum + zerosFar);
+            if (tmp32no1 > 0) {
+                tmp32no2 = (tmp32no1 >> shiftNum) * far_spectrum[i];
+            } else {
+                tmp32no2 = -((-tmp32no1 >> shiftNum) * far_spectrum[i]);
+            }
+        }
+        // Normalize with respect to frequency bin
+        tmp32no2 = WebRtcSpl_DivW32W16(tmp32no2, i + 1);
+        // Make sure we are in the right Q-domain
+        shift2ResChan =
+                shiftNum + shiftChFar - xfaQ - mu - ((30 - zerosFar) << 1);
+        if (WebRtcSpl_NormW32(tmp32no2) < shift2ResChan) {
+            tmp32no2 = WEBRTC_SPL_WORD32_MAX;
+        } else {
+            tmp32no2 = WEBRTC_SPL_SHIFT_W32(tmp32no2, shift2ResChan);
+        }
+        aecm->channelAdapt32[i] =
+                WebRtcSpl_AddSatW32(aecm->channelAdapt32[i], tmp32no2);
+        if (aecm->channelAdapt32[i] < 0) {
+            // We can never have negative channel gain
+            aecm->channelAdapt32[i] = 0;
+        }
+        aecm->channelAdapt16[i] = (int16_t) (aecm->channelAdapt32[i] >> 16);
+    }
+}
+
+// NLMS update of the adaptive channel with step size |mu|, normalized per
+// frequency bin. Called from WebRtcAecm_UpdateChannel() when |mu| is nonzero.
+static void UpdateAdaptiveChannelC(AecmCore *aecm,
+                                   const uint16_t *far_spectrum,
+                                   const int16_t far_q,
+                                   const uint16_t *const dfa,
+                                   const int16_t mu) {
+    int i;
+
+    for (i = 0; i < PART_LEN1; i++) {
+        UpdateAdaptiveChannelBin(aecm, far_spectrum, far_q, dfa, mu, i);
+    }
+}
+
+// Windows the two blocks of |time_signal| with the square root Hanning window
+// into |fft|.
+static void WindowC(int16_t *fft,
+                    const int16_t *time_signal,
+                    int time_signal_scaling) {
+    int i = 0;
+
+    for (i = 0; i < PART_LEN; i++) {
+        // Window time domain signal and insert into real part of
+        // transformation array |fft|
+        int16_t scaled_time_signal = time_signal[i] * (1 << time_signal_scaling);
+        fft[i] = (int16_t) ((scaled_time_signal * WebRtcAecm_kSqrtHanning[i]) >> 14);
+        scaled_time_signal = time_signal[i + PART_LEN] * (1 << time_signal_scaling);
+        fft[PART_LEN + i] = (int16_t) (
+                (scaled_time_signal * WebRtcAecm_kSqrtHanning[PART_LEN - i]) >> 14);
+    }
+}
+
+// Windows the two blocks of |time_signal| with the square root Hanning window
+// and transforms them into the |freq_signal| of PART_LEN1 bins.
+static void WindowAndFFTC(AecmCore *aecm,
+                          int16_t *fft,
+                          const int16_t *time_signal,
+                          ComplexInt16 *freq_signal,
+                          int time_signal_scaling) {
+    int i = 0;
+
+    // FFT of signal
+    WindowC(fft, time_signal, time_signal_scaling);
+
+    // Do forward FFT, then take only the first PART_LEN complex samples,
+    // and change signs of the imaginary parts.
+    WebRtcSpl_RealForwardFFT(aecm->real_fft, fft, (int16_t *)
+            freq_signal);
+    for (i = 0; i < PART_LEN; i++) {
+        freq_signal[i].imag = -freq_signal[i].imag;
+    }
+}
+
+// WindowAndFFTC() of two signals, with one complex FFT.
+static void WindowAndFFTPairC(AecmCore *aecm,
+                              int16_t *fft,
+                              const int16_t *time_signal_a,
+                              const int16_t *time_signal_b,
+                              ComplexInt16 *freq_signal_a,
+                              ComplexInt16 *freq_signal_b,
+                              int time_signal_scaling_a,
+                              int time_signal_scaling_b) {
+    int i = 0;
+
+    WindowC(fft, time_signal_a, time_signal_scaling_a);
+    WindowC(fft + PART_LEN2, time_signal_b, time_signal_scaling_b);
+
+    WebRtcSpl_RealForwardFFTPair(aecm->real_fft, fft, fft + PART_LEN2,
+                                 (int16_t *) freq_signal_a,
+                                 (int16_t *) freq_signal_b);
+    for (i = 0; i < PART_LEN; i++) {
+        freq_signal_a[i].imag = -freq_signal_a[i].imag;
+        freq_signal_b[i].imag = -freq_signal_b[i].imag;
+    }
+}
+
+// Transforms |efw| back to the time domain, windows the result and overlap-adds
+// it with the previous block into |output|. Also shifts the input buffers.
+static void InverseFFTAndWindowC(AecmCore *aecm,
+                                 int16_t *fft,
+                                 ComplexInt16 *efw,
+                                 int16_t *output,
+                                 const int16_t *nearendClean) {
+    int i, j, outCFFT;
+    int32_t tmp32no1;
+    // Reuse |efw| for the inverse FFT output after transferring
+    // the contents to |fft|.
+    int16_t *ifft_out = (int16_t *)
+            efw;
+
+    // Synthesis
+    for (i = 1, j = 2; i < PART_LEN; i += 1, j += 2) {
+        fft[j] = efw[i].real;
+        fft[j + 1] = -efw[i].imag;
+    }
+    fft[0] = efw[0].real;
+    fft[1] = -efw[0].imag;
+
+    fft[PART_LEN2] = efw[PART_LEN].real;
+    fft[PART_LEN2 + 1] = -efw[PART_LEN].imag;
+
+    // Inverse FFT. Keep outCFFT to scale the samples in the next block.
+    outCFFT = WebRtcSpl_RealInverseFFT(aecm->real_fft, fft, ifft_out);
+    for (i = 0; i < PART_LEN; i++) {
+        ifft_out[i] = (int16_t)
+                WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(
+                        ifft_out[i], WebRtcAecm_kSqrtHanning[i], 14);
+        tmp32no1 = WEBRTC_SPL_SHIFT_W32((int32_t) ifft_out[i],
+                                        outCFFT - aecm->dfaCleanQDomain);
+        output[i] = (int16_t)
+                WEBRTC_SPL_SAT(WEBRTC_SPL_WORD16_MAX,
+                               tmp32no1 + aecm->outBuf[i],
+                               WEBRTC_SPL_WORD16_MIN);
+
+        tmp32no1 =
+                (ifft_out[PART_LEN + i] * WebRtcAecm_kSqrtHanning[PART_LEN - i]) >> 14;
+        tmp32no1 = WEBRTC_SPL_SHIFT_W32(tmp32no1, outCFFT - aecm->dfaCleanQDomain);
+        aecm->outBuf[i] = (int16_t)
+                WEBRTC_SPL_SAT(WEBRTC_SPL_WORD16_MAX, tmp32no1,
+                               WEBRTC_SPL_WORD16_MIN);
+    }
+
+    // Copy the current block to the old position
+    // (aecm->outBuf is shifted elsewhere)
+    memcpy(aecm->xBuf, aecm->xBuf + PART_LEN, sizeof(int16_t) * PART_LEN);
+    memcpy(aecm->dBufNoisy, aecm->dBufNoisy + PART_LEN,
+           sizeof(int16_t) * PART_LEN);
+    if (nearendClean != NULL) {
+        memcpy(aecm->dBufClean, aecm->dBufClean + PART_LEN,
+               sizeof(int16_t) * PART_LEN);
+    }
+}
+
+// Calculates the magnitude of each frequency bin of |freq_signal| and the sum
+// of the magnitudes. The imaginary parts of the first and last bins are zero.
+static void CalcMagnitudesC(const ComplexInt16 *freq_signal,
+                            uint16_t *freq_signal_abs,
+                            uint32_t *freq_signal_sum_abs) {
+    int i;
+
+    int32_t tmp32no1 = 0;
+    int32_t tmp32no2 = 0;
+
+    int16_t tmp16no1;
+#ifndef WEBRTC_ARCH_ARM_V7
+    int16_t tmp16no2;
+#endif
+#ifdef AECM_WITH_ABS_APPROX
+    int16_t max_value = 0;
+    int16_t min_value = 0;
+    uint16_t alpha = 0;
+    uint16_t beta = 0;
+#endif
+
+    freq_signal_abs[0] = (uint16_t) WEBRTC_SPL_ABS_W16(freq_signal[0].real);
+    freq_signal_abs[PART_LEN] =
+            (uint16_t) WEBRTC_SPL_ABS_W16(freq_signal[PART_LEN].real);
+    (*freq_signal_sum_abs) =
+            (uint32_t) (freq_signal_abs[0]) + (uint32_t) (freq_signal_abs[PART_LEN]);
+
+    for (i = 1; i < PART_LEN; i++) {
+        if (freq_signal[i].real == 0) {
+            freq_signal_abs[i] = (uint16_t) WEBRTC_SPL_ABS_W16(freq_signal[i].imag);
+        } else if (freq_signal[i].imag == 0) {
+            freq_signal_abs[i] = (uint16_t) WEBRTC_SPL_ABS_W16(freq_signal[i].real);
+        } else {
+            // Approximation for magnitude of complex fft output
+            // magn = sqrt(real^2 + imag^2)
+            // magn ~= alpha * max(|imag|,|real|) + beta * min(|imag|,|real|)
+            //
+            // The parameters alpha and beta are stored in Q15
+
+#ifdef AECM_WITH_ABS_APPROX
+            tmp16no1 = WEBRTC_SPL_ABS_W16(freq_signal[i].real);
+            tmp16no2 = WEBRTC_SPL_ABS_W16(freq_signal[i].imag);
+
+            if (tmp16no1 > tmp16no2) {
+              max_value = tmp16no1;
+              min_value = tmp16no2;
+            } else {
+              max_value = tmp16no2;
+              min_value = tmp16no1;
+            }
+
+            // Magnitude in Q(-6)
+            if ((max_value >> 2) > min_value) {
+              alpha = kAlpha1;
+              beta = kBeta1;
+            } else if ((max_value >> 1) > min_value) {
+              alpha = kAlpha2;
+              beta = kBeta2;
+            } else {
+              alpha = kAlpha3;
+              beta = kBeta3;
+            }
+            tmp16no1 = (int16_t)((max_value * alpha) >> 15);
+            tmp16no2 = (int16_t)((min_value * beta) >> 15);
+            freq_signal_abs[i] = (uint16_t)tmp16no1 + (uint16_t)tmp16no2;
+#else
+#ifdef WEBRTC_ARCH_ARM_V7
+            __asm __volatile(
+                "smulbb %[tmp32no1], %[real], %[real]\n\t"
+                "smlabb %[tmp32no2], %[imag], %[imag], %[tmp32no1]\n\t"
+                : [tmp32no1] "+&r"(tmp32no1), [tmp32no2] "=r"(tmp32no2)
+                : [real] "r"(freq_signal[i].real), [imag] "r"(freq_signal[i].imag));
+#else
+            tmp16no1 = WEBRTC_SPL_ABS_W16(freq_signal[i].real);
+            tmp16no2 = WEBRTC_SPL_ABS_W16(freq_signal[i].imag);
+            tmp32no1 = tmp16no1 * tmp16no1;
+            tmp32no2 = tmp16no2 * tmp16no2;
+            tmp32no2 = WebRtcSpl_AddSatW32(tmp32no1, tmp32no2);
+#endif  // WEBRTC_ARCH_ARM_V7
+            tmp32no1 = WebRtcSpl_SqrtFloor(tmp32no2);
+
+            freq_signal_abs[i] = (uint16_t) tmp32no1;
+#endif  // AECM_WITH_ABS_APPROX
+        }
+        (*freq_signal_sum_abs) += (uint32_t) freq_signal_abs[i];
+    }
+}
+
+// Calculates the Wiener filter gain in Q14 of bin |i| from the echo estimate
+// and the clean near end spectrum of the bin, and updates the filtered echo
+// estimate and near end spectrum of |aecm| on the way. |zeros_gain| is
+// WebRtcSpl_NormW16(|sup_gain|) + 1.
+static AECM_ALWAYS_INLINE int16_t WienerGainBin(AecmCore *aecm,
+                                                int32_t echo_est,
+                                                uint16_t dfa_clean,
+                                                const int16_t far_q,
+                                                const int16_t sup_gain,
+                                                const int16_t zeros_gain,
+                                                int i) {
+    uint32_t echoEst32Gained;
+    uint32_t tmpU32;
+
+    int32_t tmp32no1;
+
+    int16_t hnl;
+    int16_t tmp16no1;
+    int16_t tmp16no2;
+    int16_t zeros32, zeros16;
+    int16_t resolutionDiff, qDomainDiff, dfa_clean_q_domain_diff;
+
+    // Far end signal through channel estimate in Q8
+    // How much can we shift right to preserve resolution
+    tmp32no1 = echo_est - aecm->echoFilt[i];
+    aecm->echoFilt[i] += (int32_t) ((int64_t{tmp32no1} * 50) >> 8);
+
+    zeros32 = WebRtcSpl_NormW32(aecm->echoFilt[i]) + 1;
+    if (zeros32 + zeros_gain > 16) {
+        // Multiplication is safe
+        // Result in
+        // Q(RESOLUTION_CHANNEL+RESOLUTION_SUPGAIN+
+        //   aecm->xfaQDomainBuf[diff])
+        echoEst32Gained =
+                WEBRTC_SPL_UMUL_32_16((uint32_t) aecm->echoFilt[i], (uint16_t) sup_gain);
+        resolutionDiff = 14 - RESOLUTION_CHANNEL16 - RESOLUTION_SUPGAIN;
+        resolutionDiff += (aecm->dfaCleanQDomain - far_q);
+    } else {
+        tmp16no1 = 17 - zeros32 - zeros_gain;
+        resolutionDiff =
+                14 + tmp16no1 - RESOLUTION_CHANNEL16 - RESOLUTION_SUPGAIN;
+        resolutionDiff += (aecm->dfaCleanQDomain - far_q);
+        if (zeros32 > tmp16no1) {
+            echoEst32Gained = WEBRTC_SPL_UMUL_32_16((uint32_t) aecm->echoFilt[i],
+                                                    sup_gain >> tmp16no1);
+        } else {
+            // Result in Q-(RESOLUTION_CHANNEL+RESOLUTION_SUPGAIN-16)
+            echoEst32Gained = (aecm->echoFilt[i] >> tmp16no1) * sup_gain;
+        }
+    }
+
+    zeros16 = WebRtcSpl_NormW16(aecm->nearFilt[i]);
+    RTC_DCHECK_GE(zeros16, 0);  // |zeros16| is a norm, hence non-negative.
+    dfa_clean_q_domain_diff = aecm->dfaCleanQDomain - aecm->dfaCleanQDomainOld;
+    if (zeros16 < dfa_clean_q_domain_diff && aecm->nearFilt[i]) {
+        tmp16no1 = aecm->nearFilt[i] * (1 << zeros16);
+        qDomainDiff = zeros16 - dfa_clean_q_domain_diff;
+        tmp16no2 = dfa_clean >> -qDomainDiff;
+    } else {
+        tmp16no1 = dfa_clean_q_domain_diff < 0
+                   ? aecm->nearFilt[i] >> -dfa_clean_q_domain_diff
+                   : aecm->nearFilt[i] * (1 << dfa_clean_q_domain_diff);
+        qDomainDiff = 0;
+        tmp16no2 = dfa_clean;
+    }
+    tmp32no1 = (int32_t) (tmp16no2 - tmp16no1);
+    tmp16no2 = (int16_t) (tmp32no1 >> 4);
+    tmp16no2 += tmp16no1;
+    zeros16 = WebRtcSpl_NormW16(tmp16no2);
+    if ((tmp16no2) & (-qDomainDiff > zeros16)) {
+        aecm->nearFilt[i] = WEBRTC_SPL_WORD16_MAX;
+    } else {
+        aecm->nearFilt[i] = qDomainDiff < 0 ? tmp16no2 * (1 << -qDomainDiff)
+                                            : tmp16no2 >> qDomainDiff;
+    }
+
+    // Wiener filter coefficients, resulting hnl in Q14
+    if (echoEst32Gained == 0) {
+        hnl = ONE_Q14;
+    } else if (aecm->nearFilt[i] == 0) {
+        hnl = 0;
+    } else {
+        // Multiply the suppression gain
+        // Rounding
+        echoEst32Gained += (uint32_t) (aecm->nearFilt[i] >> 1);
+        tmpU32 =
+                WebRtcSpl_DivU32U16(echoEst32Gained, (uint16_t) aecm->nearFilt[i]);
+
+        // Current resolution is
+        // Q-(RESOLUTION_CHANNEL+RESOLUTION_SUPGAIN- max(0,17-zeros16- zeros32))
+        // Make sure we are in Q14
+        tmp32no1 = (int32_t) WEBRTC_SPL_SHIFT_W32(tmpU32, resolutionDiff);
+        if (tmp32no1 > ONE_Q14) {
+            hnl = 0;
+        } else if (tmp32no1 < 0) {
+            hnl = ONE_Q14;
+        } else {
+            // 1-echoEst/dfa
+            hnl = ONE_Q14 - (int16_t) tmp32no1;
+            if (hnl < 0) {
+                hnl = 0;
+            }
+        }
+    }
+    return hnl;
+}
+
+// Limits the upper band gains in wideband, applies the NLP to the Wiener
+// filter hnl[] and multiplies the near end spectrum |dfw| into |efw|.
+// |numPosCoef| is the number of nonzero gains in hnl[].
+static void ApplyNlpAndFilter(AecmCore *aecm,
+                              int16_t numPosCoef,
+                              const ComplexInt16 *dfw,
+                              ComplexInt16 *efw,
+                              int16_t *hnl) {
+    int i;
+
+    int16_t nlpGain = ONE_Q14;
+
+    const int kMinPrefBand = 4;
+    const int kMaxPrefBand = 24;
+    int32_t avgHnl32 = 0;
+
+    // Only in wideband. Prevent the gain in upper band from being larger than
+    // in lower band.
+    if (aecm->mult == 2) {
+        // TODO(bjornv): Investigate if the scaling of hnl[i] below can cause
+        //               speech distortion in double-talk.
+        for (i = 0; i < PART_LEN1; i++) {
+            hnl[i] = (int16_t) ((hnl[i] * hnl[i]) >> 14);
+        }
+
+        for (i = kMinPrefBand; i <= kMaxPrefBand; i++) {
+            avgHnl32 += (int32_t) hnl[i];
+        }
+        RTC_DCHECK_GT(kMaxPrefBand - kMinPrefBand + 1, 0);
+        avgHnl32 /= (kMaxPrefBand - kMinPrefBand + 1);
+
+        for (i = kMaxPrefBand; i < PART_LEN1; i++) {
+            if (hnl[i] > (int16_t) avgHnl32) {
+                hnl[i] = (int16_t) avgHnl32;
+            }
+        }
+    }
+
+    // Calculate NLP gain, result is in Q14
+    if (aecm->nlpFlag) {
+        for (i = 0; i < PART_LEN1; i++) {
+            // Truncate values close to zero and one.
+            if (hnl[i] > NLP_COMP_HIGH) {
+                hnl[i] = ONE_Q14;
+            } else if (hnl[i] < NLP_COMP_LOW) {
+                hnl[i] = 0;
+            }
+
+            // Remove outliers
+            if (numPosCoef < 3) {
+                nlpGain = 0;
+            } else {
+                nlpGain = ONE_Q14;
+            }
+
+            // NLP
+            if ((hnl[i] == ONE_Q14) && (nlpGain == ONE_Q14)) {
+                hnl[i] = ONE_Q14;
+            } else {
+                hnl[i] = (int16_t) ((hnl[i] * nlpGain) >> 14);
+            }
+
+            // multiply with Wiener coefficients
+            efw[i].real = (int16_t) (
+                    WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(dfw[i].real, hnl[i], 14));
+            efw[i].imag = (int16_t) (
+                    WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(dfw[i].imag, hnl[i], 14));
+        }
+    } else {
+        // multiply with Wiener coefficients
+        for (i = 0; i < PART_LEN1; i++) {
+            efw[i].real = (int16_t) (
+                    WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(dfw[i].real, hnl[i], 14));
+            efw[i].imag = (int16_t) (
+                    WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(dfw[i].imag, hnl[i], 14));
+        }
+    }
+}
+
+// Calculates the Wiener filter hnl[] in Q14 from the echo estimate and the
+// clean near end spectrum, limits the upper band in wideband, applies the NLP
+// and multiplies the near end spectrum |dfw| into |efw|. The filtered echo
+// estimate and near end spectrum of |aecm| are updated on the way.
+static void ApplyWienerFilterC(AecmCore *aecm,
+                               const int32_t *echo_est,
+                               const uint16_t *dfa_clean,
+                               const int16_t far_q,
+                               const int16_t sup_gain,
+                               const ComplexInt16 *dfw,
+                               ComplexInt16 *efw,
+                               int16_t *hnl) {
+    const int16_t zeros_gain = WebRtcSpl_NormW16(sup_gain) + 1;
+    int16_t numPosCoef = 0;
+    int i;
+
+    for (i = 0; i < PART_LEN1; i++) {
+        hnl[i] = WienerGainBin(aecm, echo_est[i], dfa_clean[i], far_q, sup_gain,
+                               zeros_gain, i);
+        if (hnl[i]) {
+            numPosCoef++;
+        }
+    }
+    ApplyNlpAndFilter(aecm, numPosCoef, dfw, efw, hnl);
+}
+
 // Initialize function pointers for ARM Neon platform.
 #if defined(WEBRTC_HAS_NEON)
 static void WebRtcAecm_InitNeon(void) {
@@ -331,6 +984,37 @@ static void WebRtcAecm_InitNeon(void) {
 }
 #endif
 
+// Initialize function pointers for x86 platforms, depending on the
+// instruction set level of the process.
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+static void WebRtcAecm_InitX86(IsaLevel level) {
+  if (level >= kIsaLevelSSE2) {
+    WebRtcAecm_StoreAdaptiveChannel = WebRtcAecm_StoreAdaptiveChannelSse2;
+    WebRtcAecm_ResetAdaptiveChannel = WebRtcAecm_ResetAdaptiveChannelSse2;
+    WebRtcAecm_CalcLinearEnergies = WebRtcAecm_CalcLinearEnergiesSse2;
+#if !defined(AECM_WITH_ABS_APPROX)
+    WebRtcAecm_CalcMagnitudes = WebRtcAecm_CalcMagnitudesSse2;
+#endif
+    WebRtcAecm_WindowAndFFT = WebRtcAecm_WindowAndFFTSse2;
+    WebRtcAecm_WindowAndFFTPair = WebRtcAecm_WindowAndFFTPairSse2;
+    WebRtcAecm_InverseFFTAndWindow = WebRtcAecm_InverseFFTAndWindowSse2;
+  }
+  if (level >= kIsaLevelAVX2) {
+    WebRtcAecm_StoreAdaptiveChannel = WebRtcAecm_StoreAdaptiveChannelAvx2;
+    WebRtcAecm_ResetAdaptiveChannel = WebRtcAecm_ResetAdaptiveChannelAvx2;
+    WebRtcAecm_CalcLinearEnergies = WebRtcAecm_CalcLinearEnergiesAvx2;
+    WebRtcAecm_UpdateAdaptiveChannel = WebRtcAecm_UpdateAdaptiveChannelAvx2;
+    WebRtcAecm_ApplyWienerFilter = WebRtcAecm_ApplyWienerFilterAvx2;
+#if !defined(AECM_WITH_ABS_APPROX)
+    WebRtcAecm_CalcMagnitudes = WebRtcAecm_CalcMagnitudesAvx2;
+#endif
+    WebRtcAecm_WindowAndFFT = WebRtcAecm_WindowAndFFTAvx2;
+    WebRtcAecm_WindowAndFFTPair = WebRtcAecm_WindowAndFFTPairAvx2;
+    WebRtcAecm_InverseFFTAndWindow = WebRtcAecm_InverseFFTAndWindowAvx2;
+  }
+}
+#endif
+
 // Initialize function pointers for MIPS platform.
 #if defined(MIPS32_LE)
 static void WebRtcAecm_InitMips(void) {
@@ -342,6 +1026,39 @@ static void WebRtcAecm_InitMips(void) {
 }
 #endif
 
+// Binds the function pointers to the kernels of the instruction set level
+// returned by WebRtc_GetIsaLevel(). Called once per process from
+// WebRtcAecm_CreateCore().
+static bool InitFunctionPointers(void) {
+    const IsaLevel level = WebRtc_GetIsaLevel();
+
+    WebRtcAecm_CalcLinearEnergies = CalcLinearEnergiesC;
+    WebRtcAecm_StoreAdaptiveChannel = StoreAdaptiveChannelC;
+    WebRtcAecm_ResetAdaptiveChannel = ResetAdaptiveChannelC;
+    WebRtcAecm_UpdateAdaptiveChannel = UpdateAdaptiveChannelC;
+    WebRtcAecm_ApplyWienerFilter = ApplyWienerFilterC;
+    WebRtcAecm_CalcMagnitudes = CalcMagnitudesC;
+    WebRtcAecm_WindowAndFFT = WindowAndFFTC;
+    WebRtcAecm_WindowAndFFTPair = WindowAndFFTPairC;
+    WebRtcAecm_InverseFFTAndWindow = InverseFFTAndWindowC;
+    if (level == kIsaLevelGeneric) {
+        return true;
+    }
+
+#if defined(WEBRTC_HAS_NEON)
+    WebRtcAecm_InitNeon();
+#endif
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+    WebRtcAecm_InitX86(level);
+#endif
+
+#if defined(MIPS32_LE)
+    WebRtcAecm_InitMips();
+#endif
+    return true;
+}
+
 // WebRtcAecm_InitCore(...)
 //
 // This function initializes the AECM instant created with
@@ -377,10 +1094,10 @@ int WebRtcAecm_InitCore(AecmCore *const aecm, int samplingFreq) {
     WebRtc_InitBuffer(aecm->nearCleanFrameBuf);
     WebRtc_InitBuffer(aecm->outFrameBuf);
 
-    memset(aecm->xBuf_buf, 0, sizeof(aecm->xBuf_buf));
-    memset(aecm->dBufClean_buf, 0, sizeof(aecm->dBufClean_buf));
-    memset(aecm->dBufNoisy_buf, 0, sizeof(aecm->dBufNoisy_buf));
-    memset(aecm->outBuf_buf, 0, sizeof(aecm->outBuf_buf));
+    memset(aecm->xBuf, 0, sizeof(aecm->xBuf));
+    memset(aecm->dBufClean, 0, sizeof(aecm->dBufClean));
+    memset(aecm->dBufNoisy, 0, sizeof(aecm->dBufNoisy));
+    memset(aecm->outBuf, 0, sizeof(aecm->outBuf));
 
     aecm->seed = 666;
     aecm->totCount = 0;
@@ -392,7 +1109,7 @@ int WebRtcAecm_InitCore(AecmCore *const aecm, int samplingFreq) {
         return -1;
     }
     // Set far end histories to zero
-    memset(aecm->far_history, 0, sizeof(uint16_t) * PART_LEN1 * MAX_DELAY);
+    memset(aecm->far_history, 0, sizeof(aecm->far_history));
     memset(aecm->far_q_domains, 0, sizeof(int) * MAX_DELAY);
     aecm->far_history_pos = MAX_DELAY;
 
@@ -408,6 +1125,9 @@ int WebRtcAecm_InitCore(AecmCore *const aecm, int samplingFreq) {
     aecm->farLogEnergy = 0;
     memset(aecm->echoAdaptLogEnergy, 0, sizeof(aecm->echoAdaptLogEnergy));
     memset(aecm->echoStoredLogEnergy, 0, sizeof(aecm->echoStoredLogEnergy));
+    aecm->logEnergyPos = 0;
+    aecm->mseAdaptSum = 0;
+    aecm->mseStoredSum = 0;
 
     // Initialize the echo channels with a stored shape.
     if (samplingFreq == 8000) {
@@ -457,18 +1177,6 @@ int WebRtcAecm_InitCore(AecmCore *const aecm, int samplingFreq) {
     // used in assembly code, so check the assembly files before any change.
     static_assert(PART_LEN % 16 == 0, "PART_LEN is not a multiple of 16");
 
-    // Initialize function pointers.
-    WebRtcAecm_CalcLinearEnergies = CalcLinearEnergiesC;
-    WebRtcAecm_StoreAdaptiveChannel = StoreAdaptiveChannelC;
-    WebRtcAecm_ResetAdaptiveChannel = ResetAdaptiveChannelC;
-
-#if defined(WEBRTC_HAS_NEON)
-    WebRtcAecm_InitNeon();
-#endif
-
-#if defined(MIPS32_LE)
-    WebRtcAecm_InitMips();
-#endif
     return 0;
 }
 
@@ -486,16 +1194,102 @@ void WebRtcAecm_FreeCore(AecmCore *aecm) {
         return;
     }
 
-    WebRtc_FreeBuffer(aecm->farFrameBuf);
-    WebRtc_FreeBuffer(aecm->nearNoisyFrameBuf);
-    WebRtc_FreeBuffer(aecm->nearCleanFrameBuf);
-    WebRtc_FreeBuffer(aecm->outFrameBuf);
+    // The buffers, the delay estimator and the FFT plan are all in the block.
+    free(aecm->own_memory);
+}
 
-    WebRtc_FreeDelayEstimator(aecm->delay_estimator);
-    WebRtc_FreeDelayEstimatorFarend(aecm->delay_estimator_farend);
-    WebRtcSpl_FreeRealFFT(aecm->real_fft);
+int WebRtcAecm_CopyCore(AecmCore *aecm, const AecmCore *src) {
+    RingBuffer *farFrameBuf = aecm->farFrameBuf;
+    RingBuffer *nearNoisyFrameBuf = aecm->nearNoisyFrameBuf;
+    RingBuffer *nearCleanFrameBuf = aecm->nearCleanFrameBuf;
+    RingBuffer *outFrameBuf = aecm->outFrameBuf;
+    void *delay_estimator_farend = aecm->delay_estimator_farend;
+    void *delay_estimator = aecm->delay_estimator;
+    struct RealFFT *real_fft = aecm->real_fft;
+    void *own_memory = aecm->own_memory;
+#ifdef AEC_DEBUG
+    FILE *farFile = aecm->farFile;
+    FILE *nearFile = aecm->nearFile;
+    FILE *outFile = aecm->outFile;
+#endif
+
+    if (aecm == src) {
+        return 0;
+    }
+    memcpy(aecm, src, sizeof(AecmCore));
+
+    // The parts outside the struct stay those of |aecm|. The FFT plan holds
+    // no state between blocks, so it is not copied.
+    aecm->farFrameBuf = farFrameBuf;
+    aecm->nearNoisyFrameBuf = nearNoisyFrameBuf;
+    aecm->nearCleanFrameBuf = nearCleanFrameBuf;
+    aecm->outFrameBuf = outFrameBuf;
+    aecm->delay_estimator_farend = delay_estimator_farend;
+    aecm->delay_estimator = delay_estimator;
+    aecm->real_fft = real_fft;
+    aecm->own_memory = own_memory;
+#ifdef AEC_DEBUG
+    aecm->farFile = farFile;
+    aecm->nearFile = nearFile;
+    aecm->outFile = outFile;
+#endif
 
-    free(aecm);
+    if (WebRtc_CopyBuffer(aecm->farFrameBuf, src->farFrameBuf) != 0 ||
+        WebRtc_CopyBuffer(aecm->nearNoisyFrameBuf, src->nearNoisyFrameBuf) != 0 ||
+        WebRtc_CopyBuffer(aecm->nearCleanFrameBuf, src->nearCleanFrameBuf) != 0 ||
+        WebRtc_CopyBuffer(aecm->outFrameBuf, src->outFrameBuf) != 0) {
+        return -1;
+    }
+    if (WebRtc_CopyDelayEstimatorFarend(aecm->delay_estimator_farend,
+                                        src->delay_estimator_farend) != 0 ||
+        WebRtc_CopyDelayEstimator(aecm->delay_estimator,
+                                  src->delay_estimator) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+AecmCore *WebRtcAecm_CloneCoreInPlace(void *memory, const AecmCore *src) {
+    size_t offsets[kNumCoreParts];
+    char *block = static_cast<char *>(memory);
+    AecmCore *aecm = static_cast<AecmCore *>(memory);
+
+    if (memory == NULL || ((uintptr_t) memory & 63) != 0 || src == NULL) {
+        return NULL;
+    }
+    CoreLayout(offsets);
+
+    memcpy(aecm, src, sizeof(AecmCore));
+    aecm->farFrameBuf = WebRtc_CloneBufferInPlace(
+            block + offsets[kFarFrameBufPart], src->farFrameBuf);
+    aecm->nearNoisyFrameBuf = WebRtc_CloneBufferInPlace(
+            block + offsets[kNearNoisyFrameBufPart], src->nearNoisyFrameBuf);
+    aecm->nearCleanFrameBuf = WebRtc_CloneBufferInPlace(
+            block + offsets[kNearCleanFrameBufPart], src->nearCleanFrameBuf);
+    aecm->outFrameBuf = WebRtc_CloneBufferInPlace(
+            block + offsets[kOutFrameBufPart], src->outFrameBuf);
+    aecm->delay_estimator_farend = WebRtc_CloneDelayEstimatorFarendInPlace(
+            block + offsets[kDelayEstimatorFarendPart],
+            src->delay_estimator_farend);
+    aecm->delay_estimator = WebRtc_CloneDelayEstimatorInPlace(
+            block + offsets[kDelayEstimatorPart], aecm->delay_estimator_farend,
+            src->delay_estimator);
+    // The tables are copied from the plan of |src|, which holds them even
+    // when it reads those of another instance, so the copy has its own.
+    aecm->real_fft = WebRtcSpl_CloneRealFFTInPlace(
+            block + offsets[kRealFFTPart], src->real_fft);
+    aecm->own_memory = NULL;
+    if (aecm->delay_estimator == NULL || aecm->real_fft == NULL) {
+        return NULL;
+    }
+    return aecm;
+}
+
+void WebRtcAecm_ShareRealFFT(AecmCore *aecm, AecmCore *owner) {
+    if (aecm == owner) {
+        return;
+    }
+    WebRtcSpl_ShareRealFFTTables(aecm->real_fft, owner->real_fft);
 }
 
 int WebRtcAecm_ProcessFrame(AecmCore *aecm,
@@ -652,6 +1446,8 @@ void WebRtcAecm_CalcEnergies(AecmCore *aecm,
     uint32_t tmpFar = 0;
 
     int i;
+    int pos;
+    int oldest_pos;
 
     int16_t tmp16;
     int16_t increase_max_shifts = 4;
@@ -661,31 +1457,28 @@ void WebRtcAecm_CalcEnergies(AecmCore *aecm,
 
     // Get log of near end energy and store in buffer
 
-    // Shift buffer
-    memmove(aecm->nearLogEnergy + 1, aecm->nearLogEnergy,
-            sizeof(int16_t) * (MAX_BUF_LEN - 1));
+    // Advance the buffer position
+    aecm->logEnergyPos++;
+    if (aecm->logEnergyPos >= MAX_BUF_LEN) {
+        aecm->logEnergyPos = 0;
+    }
+    pos = aecm->logEnergyPos;
 
     // Logarithm of integrated magnitude spectrum (nearEner)
-    aecm->nearLogEnergy[0] = LogOfEnergyInQ8(nearEner, aecm->dfaNoisyQDomain);
+    aecm->nearLogEnergy[pos] = LogOfEnergyInQ8(nearEner, aecm->dfaNoisyQDomain);
 
     WebRtcAecm_CalcLinearEnergies(aecm, far_spectrum, echoEst, &tmpFar, &tmpAdapt,
                                   &tmpStored);
 
-    // Shift buffers
-    memmove(aecm->echoAdaptLogEnergy + 1, aecm->echoAdaptLogEnergy,
-            sizeof(int16_t) * (MAX_BUF_LEN - 1));
-    memmove(aecm->echoStoredLogEnergy + 1, aecm->echoStoredLogEnergy,
-            sizeof(int16_t) * (MAX_BUF_LEN - 1));
-
     // Logarithm of delayed far end energy
     aecm->farLogEnergy = LogOfEnergyInQ8(tmpFar, far_q);
 
     // Logarithm of estimated echo energy through adapted channel
-    aecm->echoAdaptLogEnergy[0] =
+    aecm->echoAdaptLogEnergy[pos] =
             LogOfEnergyInQ8(tmpAdapt, RESOLUTION_CHANNEL16 + far_q);
 
     // Logarithm of estimated echo energy through stored channel
-    aecm->echoStoredLogEnergy[0] =
+    aecm->echoStoredLogEnergy[pos] =
             LogOfEnergyInQ8(tmpStored, RESOLUTION_CHANNEL16 + far_q);
 
     // Update farend energy levels (min, max, vad, mse)
@@ -740,7 +1533,7 @@ void WebRtcAecm_CalcEnergies(AecmCore *aecm,
     }
     if ((aecm->currentVADValue) && (aecm->firstVAD)) {
         aecm->firstVAD = 0;
-        if (aecm->echoAdaptLogEnergy[0] > aecm->nearLogEnergy[0]) {
+        if (aecm->echoAdaptLogEnergy[pos] > aecm->nearLogEnergy[pos]) {
             // The estimated echo has higher energy than the near end signal.
             // This means that the initialization was too aggressive. Scale
             // down by a factor 8
@@ -748,10 +1541,27 @@ void WebRtcAecm_CalcEnergies(AecmCore *aecm,
                 aecm->channelAdapt16[i] >>= 3;
             }
             // Compensate the adapted echo energy level accordingly.
-            aecm->echoAdaptLogEnergy[0] -= (3 << 8);
+            aecm->echoAdaptLogEnergy[pos] -= (3 << 8);
             aecm->firstVAD = 1;
         }
     }
+
+    // Slide the MSE window: add the errors of the latest block and remove the
+    // ones of the block that is MIN_MSE_COUNT blocks old.
+    oldest_pos = pos - MIN_MSE_COUNT;
+    if (oldest_pos < 0) {
+        oldest_pos += MAX_BUF_LEN;
+    }
+    aecm->mseStoredSum +=
+            WEBRTC_SPL_ABS_W32((int32_t) aecm->echoStoredLogEnergy[pos] -
+                               (int32_t) aecm->nearLogEnergy[pos]) -
+            WEBRTC_SPL_ABS_W32((int32_t) aecm->echoStoredLogEnergy[oldest_pos] -
+                               (int32_t) aecm->nearLogEnergy[oldest_pos]);
+    aecm->mseAdaptSum +=
+            WEBRTC_SPL_ABS_W32((int32_t) aecm->echoAdaptLogEnergy[pos] -
+                               (int32_t) aecm->nearLogEnergy[pos]) -
+            WEBRTC_SPL_ABS_W32((int32_t) aecm->echoAdaptLogEnergy[oldest_pos] -
+                               (int32_t) aecm->nearLogEnergy[oldest_pos]);
 }
 
 // WebRtcAecm_CalcStepSize(...)
@@ -813,120 +1623,45 @@ void WebRtcAecm_UpdateChannel(AecmCore *aecm,
                               const uint16_t *const dfa,
                               const int16_t mu,
                               int32_t *echoEst) {
-    uint32_t tmpU32no1, tmpU32no2;
-    int32_t tmp32no1, tmp32no2;
-    int32_t mseStored;
-    int32_t mseAdapt;
-
-    int i;
-
-    int16_t zerosFar, zerosNum, zerosCh, zerosDfa;
-    int16_t shiftChFar, shiftNum, shift2ResChan;
-    int16_t tmp16no1;
-    int16_t xfaQ, dfaQ;
+    int channel_update;
 
     // This is the channel estimation algorithm. It is base on NLMS but has a
     // variable step length, which was calculated above.
     if (mu) {
-        for (i = 0; i < PART_LEN1; i++) {
-            // Determine norm of channel and farend to make sure we don't get overflow
-            // in multiplication
-            zerosCh = WebRtcSpl_NormU32(aecm->channelAdapt32[i]);
-            zerosFar = WebRtcSpl_NormU32((uint32_t) far_spectrum[i]);
-            if (zerosCh + zerosFar > 31) {
-                // Multiplication is safe
-                tmpU32no1 =
-                        WEBRTC_SPL_UMUL_32_16(aecm->channelAdapt32[i], far_spectrum[i]);
-                shiftChFar = 0;
-            } else {
-                // We need to shift down before multiplication
-                shiftChFar = 32 - zerosCh - zerosFar;
-                // If zerosCh == zerosFar == 0, shiftChFar is 32. A
-                // right shift of 32 is undefined. To avoid that, we
-                // do this check.
-                tmpU32no1 = (uint32_t) (
-                        shiftChFar >= 32 ? 0 : aecm->channelAdapt32[i] >> shiftChFar) *
-                            far_spectrum[i];
-            }
-            // Determine Q-domain of numerator
-            zerosNum = WebRtcSpl_NormU32(tmpU32no1);
-            if (dfa[i]) {
-                zerosDfa = WebRtcSpl_NormU32((uint32_t) dfa[i]);
-            } else {
-                zerosDfa = 32;
-            }
-            tmp16no1 = zerosDfa - 2 + aecm->dfaNoisyQDomain - RESOLUTION_CHANNEL32 -
-                       far_q + shiftChFar;
-            if (zerosNum > tmp16no1 + 1) {
-                xfaQ = tmp16no1;
-                dfaQ = zerosDfa - 2;
-            } else {
-                xfaQ = zerosNum - 2;
-                dfaQ = RESOLUTION_CHANNEL32 + far_q - aecm->dfaNoisyQDomain -
-                       shiftChFar + xfaQ;
-            }
-            // Add in the same Q-domain
-            tmpU32no1 = WEBRTC_SPL_SHIFT_W32(tmpU32no1, xfaQ);
-            tmpU32no2 = WEBRTC_SPL_SHIFT_W32((uint32_t) dfa[i], dfaQ);
-            tmp32no1 = (int32_t) tmpU32no2 - (int32_t) tmpU32no1;
-            zerosNum = WebRtcSpl_NormW32(tmp32no1);
-            if ((tmp32no1) && (far_spectrum[i] > (CHANNEL_VAD << far_q))) {
-                //
-                // Update is needed
-                //
-                // This is what we would like to compute
-                //
-                // tmp32no1 = dfa[i] - (aecm->channelAdapt[i] * far_spectrum[i])
-                // tmp32norm = (i + 1)
-                // aecm->channelAdapt[i] += (2^mu) * tmp32no1
-                //                        / (tmp32norm * far_spectrum[i])
-                //
-
-                // Make sure we don't get overflow in multiplication.
-                if (zerosNum + zerosFar > 31) {
-                    if (tmp32no1 > 0) {
-                        tmp32no2 =
-                                (int32_t) WEBRTC_SPL_UMUL_32_16(tmp32no1, far_spectrum[i]);
-                    } else {
-                        tmp32no2 =
-                                -(int32_t) WEBRTC_SPL_UMUL_32_16(-tmp32no1, far_spectrum[i]);
-                    }
-                    shiftNum = 0;
-                } else {
-                    shiftNum = 32 - (zerosNum + zerosFar);
-                    if (tmp32no1 > 0) {
-                        tmp32no2 = (tmp32no1 >> shiftNum) * far_spectrum[i];
-                    } else {
-                        tmp32no2 = -((-tmp32no1 >> shiftNum) * far_spectrum[i]);
-                    }
-                }
-                // Normalize with respect to frequency bin
-                tmp32no2 = WebRtcSpl_DivW32W16(tmp32no2, i + 1);
-                // Make sure we are in the right Q-domain
-                shift2ResChan =
-                        shiftNum + shiftChFar - xfaQ - mu - ((30 - zerosFar) << 1);
-                if (WebRtcSpl_NormW32(tmp32no2) < shift2ResChan) {
-                    tmp32no2 = WEBRTC_SPL_WORD32_MAX;
-                } else {
-                    tmp32no2 = WEBRTC_SPL_SHIFT_W32(tmp32no2, shift2ResChan);
-                }
-                aecm->channelAdapt32[i] =
-                        WebRtcSpl_AddSatW32(aecm->channelAdapt32[i], tmp32no2);
-                if (aecm->channelAdapt32[i] < 0) {
-                    // We can never have negative channel gain
-                    aecm->channelAdapt32[i] = 0;
-                }
-                aecm->channelAdapt16[i] = (int16_t) (aecm->channelAdapt32[i] >> 16);
-            }
-        }
+        WebRtcAecm_UpdateAdaptiveChannel(aecm, far_spectrum, far_q, dfa, mu);
     }
     // END: Adaptive channel update
 
     // Determine if we should store or restore the channel
-    if ((aecm->startupState == 0) & (aecm->currentVADValue)) {
-        // During startup we store the channel every block,
-        // and we recalculate echo estimate
+    channel_update = WebRtcAecm_SelectChannelUpdate(aecm);
+    if (channel_update == kAecmStoreChannel) {
+        // Store the channel, and we recalculate echo estimate
         WebRtcAecm_StoreAdaptiveChannel(aecm, far_spectrum, echoEst);
+    } else if (channel_update == kAecmResetChannel) {
+        WebRtcAecm_ResetAdaptiveChannel(aecm);
+    }
+    // END: Determine if we should store or reset channel estimate.
+}
+
+// WebRtcAecm_SelectChannelUpdate(...)
+//
+// Decides whether the adaptive channel is stored or reset to the stored one
+// this block, and updates the MSE statistics of the decision. Only depends on
+// the energies of WebRtcAecm_CalcEnergies(), so it can be called before the
+// adaptive channel is updated.
+//
+// @param  aecm     [i/o]   Handle of the AECM instance.
+// @return                  kAecmKeepChannel, kAecmStoreChannel or
+//                          kAecmResetChannel.
+//
+int WebRtcAecm_SelectChannelUpdate(AecmCore *aecm) {
+    int32_t mseStored;
+    int32_t mseAdapt;
+    int channel_update = kAecmKeepChannel;
+
+    if ((aecm->startupState == 0) & (aecm->currentVADValue)) {
+        // During startup we store the channel every block.
+        channel_update = kAecmStoreChannel;
     } else {
         if (aecm->farLogEnergy < aecm->farEnergyMSE) {
             aecm->mseChannelCount = 0;
@@ -936,34 +1671,24 @@ void WebRtcAecm_UpdateChannel(AecmCore *aecm,
         // Enough data for validation. Store channel if we can.
         if (aecm->mseChannelCount >= (MIN_MSE_COUNT + 10)) {
             // We have enough data.
-            // Calculate MSE of "Adapt" and "Stored" versions.
+            // MSE of "Adapt" and "Stored" versions, kept up to date by
+            // WebRtcAecm_CalcEnergies().
             // It is actually not MSE, but average absolute error.
-            mseStored = 0;
-            mseAdapt = 0;
-            for (i = 0; i < MIN_MSE_COUNT; i++) {
-                tmp32no1 = ((int32_t) aecm->echoStoredLogEnergy[i] -
-                            (int32_t) aecm->nearLogEnergy[i]);
-                tmp32no2 = WEBRTC_SPL_ABS_W32(tmp32no1);
-                mseStored += tmp32no2;
-
-                tmp32no1 = ((int32_t) aecm->echoAdaptLogEnergy[i] -
-                            (int32_t) aecm->nearLogEnergy[i]);
-                tmp32no2 = WEBRTC_SPL_ABS_W32(tmp32no1);
-                mseAdapt += tmp32no2;
-            }
+            mseStored = aecm->mseStoredSum;
+            mseAdapt = aecm->mseAdaptSum;
             if (((mseStored << MSE_RESOLUTION) < (MIN_MSE_DIFF * mseAdapt)) &
                 ((aecm->mseStoredOld << MSE_RESOLUTION) <
                  (MIN_MSE_DIFF * aecm->mseAdaptOld))) {
                 // The stored channel has a significantly lower MSE than the adaptive
                 // one for two consecutive calculations. Reset the adaptive channel.
-                WebRtcAecm_ResetAdaptiveChannel(aecm);
+                channel_update = kAecmResetChannel;
             } else if (((MIN_MSE_DIFF * mseStored) > (mseAdapt << MSE_RESOLUTION)) &
                        (mseAdapt < aecm->mseThreshold) &
                        (aecm->mseAdaptOld < aecm->mseThreshold)) {
                 // The adaptive channel has a significantly lower MSE than the stored
                 // one. The MSE for the adaptive channel has also been low for two
                 // consecutive calculations. Store the adaptive channel.
-                WebRtcAecm_StoreAdaptiveChannel(aecm, far_spectrum, echoEst);
+                channel_update = kAecmStoreChannel;
 
                 // Update threshold
                 if (aecm->mseThreshold == WEBRTC_SPL_WORD32_MAX) {
@@ -982,7 +1707,7 @@ void WebRtcAecm_UpdateChannel(AecmCore *aecm,
             aecm->mseAdaptOld = mseAdapt;
         }
     }
-    // END: Determine if we should store or reset channel estimate.
+    return channel_update;
 }
 
 // CalcSuppressionGain(...)
@@ -1013,7 +1738,8 @@ int16_t WebRtcAecm_CalcSuppressionGain(AecmCore *const aecm) {
     } else {
         // Adjust for possible double talk. If we have large variations in
         // estimation error we likely have double talk (or poor channel).
-        tmp16no1 = (aecm->nearLogEnergy[0] - aecm->echoStoredLogEnergy[0] -
+        tmp16no1 = (aecm->nearLogEnergy[aecm->logEnergyPos] -
+                    aecm->echoStoredLogEnergy[aecm->logEnergyPos] -
                     ENERGY_DEV_OFFSET);
         dE = WEBRTC_SPL_ABS_W16(tmp16no1);
 
@@ -39,100 +39,103 @@ typedef struct {
 } ComplexInt16;
 
 typedef struct {
-    int farBufWritePos;
-    int farBufReadPos;
-    int knownDelay;
-    int lastKnownDelay;
-    int firstVAD;  // Parameter to control poorly initialized channels
-
-    RingBuffer *farFrameBuf;
-    RingBuffer *nearNoisyFrameBuf;
-    RingBuffer *nearCleanFrameBuf;
-    RingBuffer *outFrameBuf;
-
-    int16_t farBuf[FAR_BUF_LEN];
-
+    // Hot state, read or written on every block. It comes first and is kept
+    // compact, so that a block touches few cache lines of an instance when
+    // many instances take turns on a core.
     int16_t mult;
-    uint32_t seed;
-
-    // Delay estimation variables
-    void *delay_estimator_farend;
-    void *delay_estimator;
-    uint16_t currentDelay;
-    // Far end history variables
-    // TODO(bjornv): Replace |far_history| with ring_buffer.
-    uint16_t far_history[PART_LEN1 * MAX_DELAY];
-    int far_history_pos;
-    int far_q_domains[MAX_DELAY];
-
     int16_t nlpFlag;
     int16_t fixedDelay;
-
-    uint32_t totCount;
+    uint16_t currentDelay;
 
     int16_t dfaCleanQDomain;
     int16_t dfaCleanQDomainOld;
     int16_t dfaNoisyQDomain;
     int16_t dfaNoisyQDomainOld;
 
-    int16_t nearLogEnergy[MAX_BUF_LEN];
     int16_t farLogEnergy;
-    int16_t echoAdaptLogEnergy[MAX_BUF_LEN];
-    int16_t echoStoredLogEnergy[MAX_BUF_LEN];
-
-    // The extra 16 or 32 bytes in the following buffers are for alignment based
-    // Neon code.
-    // It's designed this way since the current GCC compiler can't align a
-    // buffer in 16 or 32 byte boundaries properly.
-    int16_t channelStored_buf[PART_LEN1 + 8];
-    int16_t channelAdapt16_buf[PART_LEN1 + 8];
-    int32_t channelAdapt32_buf[PART_LEN1 + 8];
-    int16_t xBuf_buf[PART_LEN2 + 16];       // farend
-    int16_t dBufClean_buf[PART_LEN2 + 16];  // nearend
-    int16_t dBufNoisy_buf[PART_LEN2 + 16];  // nearend
-    int16_t outBuf_buf[PART_LEN + 8];
-
-    // Pointers to the above buffers
-    int16_t *channelStored;
-    int16_t *channelAdapt16;
-    int32_t *channelAdapt32;
-    int16_t *xBuf;
-    int16_t *dBufClean;
-    int16_t *dBufNoisy;
-    int16_t *outBuf;
-
-    int32_t echoFilt[PART_LEN1];
-    int16_t nearFilt[PART_LEN1];
-    int32_t noiseEst[PART_LEN1];
-    int noiseEstTooLowCtr[PART_LEN1];
-    int noiseEstTooHighCtr[PART_LEN1];
-    int16_t noiseEstCtr;
-    int16_t cngMode;
-
-    int32_t mseAdaptOld;
-    int32_t mseStoredOld;
-    int32_t mseThreshold;
-
     int16_t farEnergyMin;
     int16_t farEnergyMax;
     int16_t farEnergyMaxMin;
     int16_t farEnergyVAD;
     int16_t farEnergyMSE;
-    int currentVADValue;
     int16_t vadUpdateCount;
-
     int16_t startupState;
     int16_t mseChannelCount;
     int16_t supGain;
     int16_t supGainOld;
-
     int16_t supGainErrParamA;
     int16_t supGainErrParamD;
     int16_t supGainErrParamDiffAB;
     int16_t supGainErrParamDiffBD;
+    int16_t noiseEstCtr;
+    int16_t cngMode;
+
+    int currentVADValue;
+    int firstVAD;  // Parameter to control poorly initialized channels
+    int far_history_pos;
+    int logEnergyPos;
+    uint32_t totCount;
+    uint32_t seed;
 
+    // Absolute errors between the echo and near end log energies, summed over
+    // the latest MIN_MSE_COUNT blocks.
+    int32_t mseAdaptSum;
+    int32_t mseStoredSum;
+    int32_t mseAdaptOld;
+    int32_t mseStoredOld;
+    int32_t mseThreshold;
+
+    RingBuffer *farFrameBuf;
+    RingBuffer *nearNoisyFrameBuf;
+    RingBuffer *nearCleanFrameBuf;
+    RingBuffer *outFrameBuf;
+
+    // Delay estimation variables
+    void *delay_estimator_farend;
+    void *delay_estimator;
+
+    // The FFT plan in the block. It reads the tables of the plan of another
+    // instance after WebRtcAecm_ShareRealFFT().
     struct RealFFT *real_fft;
 
+    // 16 and 32 byte alignment is for the SIMD code.
+    alignas(32) int16_t xBuf[PART_LEN2];       // farend
+    alignas(32) int16_t dBufClean[PART_LEN2];  // nearend
+    alignas(32) int16_t dBufNoisy[PART_LEN2];  // nearend
+    alignas(32) int32_t channelAdapt32[PART_LEN1];
+    alignas(16) int16_t channelStored[PART_LEN1];
+    alignas(16) int16_t channelAdapt16[PART_LEN1];
+    alignas(16) int16_t outBuf[PART_LEN];
+
+    int32_t echoFilt[PART_LEN1];
+    int32_t noiseEst[PART_LEN1];
+    int16_t nearFilt[PART_LEN1];
+    // The counters stay below kNoiseEstIncCount.
+    int16_t noiseEstTooLowCtr[PART_LEN1];
+    int16_t noiseEstTooHighCtr[PART_LEN1];
+
+    // Cold state, touched once per frame, at a few entries per block or only
+    // at setup. It starts on a cache line of its own.
+    alignas(64) int farBufWritePos;
+    int farBufReadPos;
+    int knownDelay;
+    int lastKnownDelay;
+
+    int16_t farBuf[FAR_BUF_LEN];
+
+    // Log energy histories, circular with the latest block at |logEnergyPos|.
+    int16_t nearLogEnergy[MAX_BUF_LEN];
+    int16_t echoAdaptLogEnergy[MAX_BUF_LEN];
+    int16_t echoStoredLogEnergy[MAX_BUF_LEN];
+
+    // Far end history, rows of FAR_HISTORY_STRIDE elements on cache lines.
+    int far_q_domains[MAX_DELAY];
+    alignas(64) uint16_t far_history[FAR_HISTORY_STRIDE * MAX_DELAY];
+
+    // The block allocated by WebRtcAecm_CreateCore(), NULL if the instance is
+    // in caller memory.
+    void *own_memory;
+
 #ifdef AEC_DEBUG
     FILE* farFile;
     FILE* nearFile;
@@ -148,6 +151,27 @@ typedef struct {
 // Returns a pointer to the instance and a nullptr at failure.
 AecmCore *WebRtcAecm_CreateCore();
 
+////////////////////////////////////////////////////////////////////////////////
+// WebRtcAecm_CoreRequiredMemory()
+//
+// Returns the size of the block WebRtcAecm_CreateCoreInPlace() needs. The
+// instance, its frame buffers, delay estimator and FFT plan are all in it.
+size_t WebRtcAecm_CoreRequiredMemory();
+
+////////////////////////////////////////////////////////////////////////////////
+// WebRtcAecm_CreateCoreInPlace(...)
+//
+// As WebRtcAecm_CreateCore(), but places the instance in |memory|, which is
+// owned by the caller. Nothing is allocated. The instance must not be passed
+// to WebRtcAecm_FreeCore(), it ends with the memory.
+// Input:
+//      - memory        : WebRtcAecm_CoreRequiredMemory() bytes, aligned to
+//                        64 bytes
+//
+// Return value         : Pointer to the instance, a nullptr if |memory| is
+//                        NULL or misaligned
+AecmCore *WebRtcAecm_CreateCoreInPlace(void *memory);
+
 ////////////////////////////////////////////////////////////////////////////////
 // WebRtcAecm_InitCore(...)
 //
@@ -174,6 +198,47 @@ int WebRtcAecm_InitCore(AecmCore *const aecm, int samplingFreq);
 //
 void WebRtcAecm_FreeCore(AecmCore *aecm);
 
+////////////////////////////////////////////////////////////////////////////////
+// WebRtcAecm_CopyCore(...)
+//
+// Copies the state of |src| to |aecm|, including the contents of its frame
+// buffers and delay estimator. Both instances keep their own memory and FFT
+// plans, and must have been created with the same MAX_DELAY.
+// Input:
+//      - aecm          : Pointer to the AECM instance to copy to
+//      - src           : Pointer to the AECM instance to copy
+//
+// Return value         :  0 - Ok
+//                        -1 - Error
+//
+int WebRtcAecm_CopyCore(AecmCore *aecm, const AecmCore *src);
+
+////////////////////////////////////////////////////////////////////////////////
+// WebRtcAecm_CloneCoreInPlace(...)
+//
+// Creates a copy of |src| in |memory|, as WebRtcAecm_CreateCoreInPlace(), but
+// with all parts copied from |src| instead of set up anew.
+// Input:
+//      - memory        : WebRtcAecm_CoreRequiredMemory() bytes, aligned to
+//                        64 bytes
+//      - src           : Pointer to the AECM instance to copy
+//
+// Return value         : Pointer to the copy, a nullptr at failure
+AecmCore *WebRtcAecm_CloneCoreInPlace(void *memory, const AecmCore *src);
+
+////////////////////////////////////////////////////////////////////////////////
+// WebRtcAecm_ShareRealFFT(...)
+//
+// Makes the FFT plan of |aecm| read the tables of the plan of |owner|, so
+// that one copy of them stays in the cache for both. Each plan keeps its own
+// scratch areas, so the two instances may process at the same time, but
+// |owner| must be freed last.
+// Input:
+//      - aecm          : Pointer to the AECM instance
+//      - owner         : Pointer to the AECM instance that owns the plan
+//
+void WebRtcAecm_ShareRealFFT(AecmCore *aecm, AecmCore *owner);
+
 int WebRtcAecm_Control(AecmCore *aecm, int delay, int nlpFlag);
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -270,11 +335,24 @@ void WebRtcAecm_FetchFarFrame(AecmCore *const aecm,
 
 // All the functions below are intended to be private
 
+////////////////////////////////////////////////////////////////////////////////
+// WebRtcAecm_NextFarHistorySlot()
+//
+// Returns the far end history entry the next WebRtcAecm_UpdateFarHistory()
+// inserts into, 64 byte aligned with room for FAR_HISTORY_STRIDE elements.
+// Writing the far end spectrum there in place saves the copy.
+//
+// Inputs:
+//      - self          : Pointer to the AECM instance
+//
+uint16_t *WebRtcAecm_NextFarHistorySlot(AecmCore *self);
+
 ////////////////////////////////////////////////////////////////////////////////
 // WebRtcAecm_UpdateFarHistory()
 //
 // Moves the pointer to the next entry and inserts |far_spectrum| and
-// corresponding Q-domain in its buffer.
+// corresponding Q-domain in its buffer. The spectrum is not copied if it was
+// written in place to WebRtcAecm_NextFarHistorySlot().
 //
 // Inputs:
 //      - self          : Pointer to the delay estimation instance
@@ -282,7 +360,7 @@ void WebRtcAecm_FetchFarFrame(AecmCore *const aecm,
 //      - far_q         : Q-domain of far end spectrum
 //
 void WebRtcAecm_UpdateFarHistory(AecmCore *self,
-                                 uint16_t *far_spectrum,
+                                 const uint16_t *far_spectrum,
                                  int far_q);
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -381,8 +459,33 @@ void WebRtcAecm_UpdateChannel(AecmCore *aecm,
                               const int16_t mu,
                               int32_t *echoEst);
 
+// Channel updates decided by WebRtcAecm_SelectChannelUpdate().
+enum {
+    kAecmKeepChannel = 0,
+    kAecmStoreChannel,  // Store the adaptive channel, recalculate echoEst.
+    kAecmResetChannel   // Reset the adaptive channel to the stored one.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// WebRtcAecm_SelectChannelUpdate(...)
+//
+// The decision on channel storage of WebRtcAecm_UpdateChannel(), without
+// applying it. Only depends on the energies of WebRtcAecm_CalcEnergies(), so
+// it can be made before the adaptive channel is updated.
+//
+// Inputs:
+//      - aecm              : Pointer to the AECM instance.
+//
+// Return value:
+//      - channel_update    : kAecmKeepChannel, kAecmStoreChannel or
+//                            kAecmResetChannel.
+//
+int WebRtcAecm_SelectChannelUpdate(AecmCore *aecm);
+
 extern const int16_t WebRtcAecm_kCosTable[];
 extern const int16_t WebRtcAecm_kSinTable[];
+// Square root of Hanning window in Q14.
+extern const ALIGN8_BEG int16_t WebRtcAecm_kSqrtHanning[] ALIGN8_END;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Some function pointers, for internal functions shared by ARM NEON and
@@ -407,9 +510,64 @@ typedef void (*ResetAdaptiveChannel)(AecmCore *aecm);
 
 extern ResetAdaptiveChannel WebRtcAecm_ResetAdaptiveChannel;
 
+typedef void (*UpdateAdaptiveChannel)(AecmCore *aecm,
+                                      const uint16_t *far_spectrum,
+                                      int16_t far_q,
+                                      const uint16_t *dfa,
+                                      int16_t mu);
+
+extern UpdateAdaptiveChannel WebRtcAecm_UpdateAdaptiveChannel;
+
+typedef void (*ApplyWienerFilter)(AecmCore *aecm,
+                                  const int32_t *echo_est,
+                                  const uint16_t *dfa_clean,
+                                  int16_t far_q,
+                                  int16_t sup_gain,
+                                  const ComplexInt16 *dfw,
+                                  ComplexInt16 *efw,
+                                  int16_t *hnl);
+
+extern ApplyWienerFilter WebRtcAecm_ApplyWienerFilter;
+
+typedef void (*CalcMagnitudes)(const ComplexInt16 *freq_signal,
+                               uint16_t *freq_signal_abs,
+                               uint32_t *freq_signal_sum_abs);
+
+extern CalcMagnitudes WebRtcAecm_CalcMagnitudes;
+
+typedef void (*WindowAndFFTFunction)(AecmCore *aecm,
+                                     int16_t *fft,
+                                     const int16_t *time_signal,
+                                     ComplexInt16 *freq_signal,
+                                     int time_signal_scaling);
+
+extern WindowAndFFTFunction WebRtcAecm_WindowAndFFT;
+
+// WebRtcAecm_WindowAndFFT() of two signals, each with its own scaling, in one
+// complex FFT. |fft| holds 2 * PART_LEN2 values.
+typedef void (*WindowAndFFTPairFunction)(AecmCore *aecm,
+                                         int16_t *fft,
+                                         const int16_t *time_signal_a,
+                                         const int16_t *time_signal_b,
+                                         ComplexInt16 *freq_signal_a,
+                                         ComplexInt16 *freq_signal_b,
+                                         int time_signal_scaling_a,
+                                         int time_signal_scaling_b);
+
+extern WindowAndFFTPairFunction WebRtcAecm_WindowAndFFTPair;
+
+typedef void (*InverseFFTAndWindowFunction)(AecmCore *aecm,
+                                            int16_t *fft,
+                                            ComplexInt16 *efw,
+                                            int16_t *output,
+                                            const int16_t *nearendClean);
+
+extern InverseFFTAndWindowFunction WebRtcAecm_InverseFFTAndWindow;
+
 // For the above function pointers, functions for generic platforms are declared
 // and defined as static in file aecm_core.c, while those for ARM Neon platforms
-// are declared below and defined in file aecm_core_neon.c.
+// are declared below and defined in file aecm_core_neon.c. The x86 versions are
+// defined in aecm_core_sse2.cc and aecm_core_avx2.cc and selected at run-time.
 #if defined(WEBRTC_HAS_NEON)
 void WebRtcAecm_CalcLinearEnergiesNeon(AecmCore* aecm,
                                        const uint16_t* far_spectrum,
@@ -425,6 +583,99 @@ void WebRtcAecm_StoreAdaptiveChannelNeon(AecmCore* aecm,
 void WebRtcAecm_ResetAdaptiveChannelNeon(AecmCore* aecm);
 #endif
 
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+void WebRtcAecm_CalcLinearEnergiesSse2(AecmCore* aecm,
+                                       const uint16_t* far_spectrum,
+                                       int32_t* echo_est,
+                                       uint32_t* far_energy,
+                                       uint32_t* echo_energy_adapt,
+                                       uint32_t* echo_energy_stored);
+
+void WebRtcAecm_StoreAdaptiveChannelSse2(AecmCore* aecm,
+                                         const uint16_t* far_spectrum,
+                                         int32_t* echo_est);
+
+void WebRtcAecm_ResetAdaptiveChannelSse2(AecmCore* aecm);
+
+void WebRtcAecm_CalcMagnitudesSse2(const ComplexInt16* freq_signal,
+                                   uint16_t* freq_signal_abs,
+                                   uint32_t* freq_signal_sum_abs);
+
+void WebRtcAecm_WindowAndFFTSse2(AecmCore* aecm,
+                                 int16_t* fft,
+                                 const int16_t* time_signal,
+                                 ComplexInt16* freq_signal,
+                                 int time_signal_scaling);
+
+void WebRtcAecm_WindowAndFFTPairSse2(AecmCore* aecm,
+                                     int16_t* fft,
+                                     const int16_t* time_signal_a,
+                                     const int16_t* time_signal_b,
+                                     ComplexInt16* freq_signal_a,
+                                     ComplexInt16* freq_signal_b,
+                                     int time_signal_scaling_a,
+                                     int time_signal_scaling_b);
+
+void WebRtcAecm_InverseFFTAndWindowSse2(AecmCore* aecm,
+                                        int16_t* fft,
+                                        ComplexInt16* efw,
+                                        int16_t* output,
+                                        const int16_t* nearendClean);
+
+void WebRtcAecm_CalcLinearEnergiesAvx2(AecmCore* aecm,
+                                       const uint16_t* far_spectrum,
+                                       int32_t* echo_est,
+                                       uint32_t* far_energy,
+                                       uint32_t* echo_energy_adapt,
+                                       uint32_t* echo_energy_stored);
+
+void WebRtcAecm_StoreAdaptiveChannelAvx2(AecmCore* aecm,
+                                         const uint16_t* far_spectrum,
+                                         int32_t* echo_est);
+
+void WebRtcAecm_ResetAdaptiveChannelAvx2(AecmCore* aecm);
+
+void WebRtcAecm_UpdateAdaptiveChannelAvx2(AecmCore* aecm,
+                                          const uint16_t* far_spectrum,
+                                          int16_t far_q,
+                                          const uint16_t* dfa,
+                                          int16_t mu);
+
+void WebRtcAecm_ApplyWienerFilterAvx2(AecmCore* aecm,
+                                      const int32_t* echo_est,
+                                      const uint16_t* dfa_clean,
+                                      int16_t far_q,
+                                      int16_t sup_gain,
+                                      const ComplexInt16* dfw,
+                                      ComplexInt16* efw,
+                                      int16_t* hnl);
+
+void WebRtcAecm_CalcMagnitudesAvx2(const ComplexInt16* freq_signal,
+                                   uint16_t* freq_signal_abs,
+                                   uint32_t* freq_signal_sum_abs);
+
+void WebRtcAecm_WindowAndFFTAvx2(AecmCore* aecm,
+                                 int16_t* fft,
+                                 const int16_t* time_signal,
+                                 ComplexInt16* freq_signal,
+                                 int time_signal_scaling);
+
+void WebRtcAecm_WindowAndFFTPairAvx2(AecmCore* aecm,
+                                     int16_t* fft,
+                                     const int16_t* time_signal_a,
+                                     const int16_t* time_signal_b,
+                                     ComplexInt16* freq_signal_a,
+                                     ComplexInt16* freq_signal_b,
+                                     int time_signal_scaling_a,
+                                     int time_signal_scaling_b);
+
+void WebRtcAecm_InverseFFTAndWindowAvx2(AecmCore* aecm,
+                                        int16_t* fft,
+                                        ComplexInt16* efw,
+                                        int16_t* output,
+                                        const int16_t* nearendClean);
+#endif
+
 #if defined(MIPS32_LE)
 void WebRtcAecm_CalcLinearEnergies_mips(AecmCore* aecm,
                                         const uint16_t* far_spectrum,
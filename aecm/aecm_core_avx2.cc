@@ -0,0 +1,880 @@
+/*
+ *  Copyright (c) 2012 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <immintrin.h>
+#include <string.h>
+
+#include "aecm_core.h"
+#include "real_fft.h"
+#include "signal_processing_library.h"
+
+// Multiplies signed 16-bit |a| with unsigned 16-bit |b| into two vectors of
+// 32-bit products in natural order, i.e., WEBRTC_SPL_MUL_16_U16() for sixteen
+// lanes. See MulS16U16() in aecm_core_sse2.cc.
+static inline void MulS16U16(__m256i a,
+                             __m256i b,
+                             __m256i *prod_low,
+                             __m256i *prod_high) {
+    const __m256i lo = _mm256_mullo_epi16(a, b);
+    const __m256i hi =
+            _mm256_sub_epi16(_mm256_mulhi_epu16(a, b),
+                             _mm256_and_si256(_mm256_srai_epi16(a, 15), b));
+    // The unpack instructions work within 128-bit lanes.
+    const __m256i unpacked_low = _mm256_unpacklo_epi16(lo, hi);
+    const __m256i unpacked_high = _mm256_unpackhi_epi16(lo, hi);
+    *prod_low = _mm256_permute2x128_si256(unpacked_low, unpacked_high, 0x20);
+    *prod_high = _mm256_permute2x128_si256(unpacked_low, unpacked_high, 0x31);
+}
+
+static inline uint32_t AddLanes(__m256i v) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v),
+                                _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t) _mm_cvtsi128_si32(sum);
+}
+
+void WebRtcAecm_CalcLinearEnergiesAvx2(AecmCore *aecm,
+                                       const uint16_t *far_spectrum,
+                                       int32_t *echo_est,
+                                       uint32_t *far_energy,
+                                       uint32_t *echo_energy_adapt,
+                                       uint32_t *echo_energy_stored) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i far_energy_v = zero;
+    __m256i echo_adapt_v = zero;
+    __m256i echo_stored_v = zero;
+    int i;
+
+    // See WebRtcAecm_CalcLinearEnergiesSse2() for the C code.
+    for (i = 0; i < PART_LEN; i += 16) {
+        const __m256i spectrum_v =
+                _mm256_loadu_si256((const __m256i *) &far_spectrum[i]);
+        const __m256i stored_v =
+                _mm256_loadu_si256((const __m256i *) &aecm->channelStored[i]);
+        const __m256i adapt_v =
+                _mm256_loadu_si256((const __m256i *) &aecm->channelAdapt16[i]);
+        __m256i est_low, est_high, adapt_low, adapt_high;
+
+        // The lane order does not matter for the sums.
+        far_energy_v = _mm256_add_epi32(far_energy_v,
+                                        _mm256_unpacklo_epi16(spectrum_v, zero));
+        far_energy_v = _mm256_add_epi32(far_energy_v,
+                                        _mm256_unpackhi_epi16(spectrum_v, zero));
+
+        MulS16U16(stored_v, spectrum_v, &est_low, &est_high);
+        _mm256_storeu_si256((__m256i *) &echo_est[i], est_low);
+        _mm256_storeu_si256((__m256i *) &echo_est[i + 8], est_high);
+        echo_stored_v = _mm256_add_epi32(echo_stored_v, est_low);
+        echo_stored_v = _mm256_add_epi32(echo_stored_v, est_high);
+
+        MulS16U16(adapt_v, spectrum_v, &adapt_low, &adapt_high);
+        echo_adapt_v = _mm256_add_epi32(echo_adapt_v, adapt_low);
+        echo_adapt_v = _mm256_add_epi32(echo_adapt_v, adapt_high);
+    }
+
+    *far_energy += AddLanes(far_energy_v);
+    *echo_energy_stored += AddLanes(echo_stored_v);
+    *echo_energy_adapt += AddLanes(echo_adapt_v);
+
+    echo_est[PART_LEN] = WEBRTC_SPL_MUL_16_U16(aecm->channelStored[PART_LEN],
+                                               far_spectrum[PART_LEN]);
+    *echo_energy_stored += (uint32_t) echo_est[PART_LEN];
+    *far_energy += (uint32_t) far_spectrum[PART_LEN];
+    *echo_energy_adapt += aecm->channelAdapt16[PART_LEN] * far_spectrum[PART_LEN];
+}
+
+void WebRtcAecm_StoreAdaptiveChannelAvx2(AecmCore *aecm,
+                                         const uint16_t *far_spectrum,
+                                         int32_t *echo_est) {
+    int i;
+
+    // See WebRtcAecm_StoreAdaptiveChannelSse2() for the C code.
+    for (i = 0; i < PART_LEN; i += 16) {
+        const __m256i spectrum_v =
+                _mm256_loadu_si256((const __m256i *) &far_spectrum[i]);
+        const __m256i adapt_v =
+                _mm256_loadu_si256((const __m256i *) &aecm->channelAdapt16[i]);
+        __m256i est_low, est_high;
+
+        _mm256_storeu_si256((__m256i *) &aecm->channelStored[i], adapt_v);
+
+        MulS16U16(adapt_v, spectrum_v, &est_low, &est_high);
+        _mm256_storeu_si256((__m256i *) &echo_est[i], est_low);
+        _mm256_storeu_si256((__m256i *) &echo_est[i + 8], est_high);
+    }
+    aecm->channelStored[PART_LEN] = aecm->channelAdapt16[PART_LEN];
+    echo_est[PART_LEN] = WEBRTC_SPL_MUL_16_U16(aecm->channelStored[PART_LEN],
+                                               far_spectrum[PART_LEN]);
+}
+
+void WebRtcAecm_ResetAdaptiveChannelAvx2(AecmCore *aecm) {
+    int i;
+
+    // See WebRtcAecm_ResetAdaptiveChannelSse2() for the C code.
+    for (i = 0; i < PART_LEN; i += 16) {
+        const __m256i stored_v =
+                _mm256_loadu_si256((const __m256i *) &aecm->channelStored[i]);
+
+        _mm256_storeu_si256((__m256i *) &aecm->channelAdapt16[i], stored_v);
+
+        // Sign extend to 32 bits and shift up by 16.
+        _mm256_storeu_si256(
+                (__m256i *) &aecm->channelAdapt32[i],
+                _mm256_slli_epi32(
+                        _mm256_cvtepi16_epi32(_mm256_castsi256_si128(stored_v)),
+                        16));
+        _mm256_storeu_si256(
+                (__m256i *) &aecm->channelAdapt32[i + 8],
+                _mm256_slli_epi32(
+                        _mm256_cvtepi16_epi32(
+                                _mm256_extracti128_si256(stored_v, 1)),
+                        16));
+    }
+    aecm->channelAdapt16[PART_LEN] = aecm->channelStored[PART_LEN];
+    aecm->channelAdapt32[PART_LEN] = (int32_t) aecm->channelStored[PART_LEN] << 16;
+}
+
+// floor((2^32 - 1) / d) for d = 1, ..., PART_LEN1 and the padding lanes of the
+// last block. Multiplying by these and correcting the quotient by at most one
+// gives an exact unsigned division by the bin normalization i + 1.
+static const uint32_t kReciprocalQ32[72] = {
+        0xffffffff, 0x7fffffff, 0x55555555, 0x3fffffff,
+        0x33333333, 0x2aaaaaaa, 0x24924924, 0x1fffffff,
+        0x1c71c71c, 0x19999999, 0x1745d174, 0x15555555,
+        0x13b13b13, 0x12492492, 0x11111111, 0x0fffffff,
+        0x0f0f0f0f, 0x0e38e38e, 0x0d79435e, 0x0ccccccc,
+        0x0c30c30c, 0x0ba2e8ba, 0x0b21642c, 0x0aaaaaaa,
+        0x0a3d70a3, 0x09d89d89, 0x097b425e, 0x09249249,
+        0x08d3dcb0, 0x08888888, 0x08421084, 0x07ffffff,
+        0x07c1f07c, 0x07878787, 0x07507507, 0x071c71c7,
+        0x06eb3e45, 0x06bca1af, 0x06906906, 0x06666666,
+        0x063e7063, 0x06186186, 0x05f417d0, 0x05d1745d,
+        0x05b05b05, 0x0590b216, 0x0572620a, 0x05555555,
+        0x05397829, 0x051eb851, 0x05050505, 0x04ec4ec4,
+        0x04d4873e, 0x04bda12f, 0x04a7904a, 0x04924924,
+        0x047dc11f, 0x0469ee58, 0x0456c797, 0x04444444,
+        0x04325c53, 0x04210842, 0x04104104, 0x03ffffff,
+        0x03f03f03, 0x03e0f83e, 0x03d22635, 0x03c3c3c3,
+        0x03b5cc0e, 0x03a83a83, 0x039b0ad1, 0x038e38e3,
+};
+
+// Counts the leading zeros of each lane, which must be in [0, 2^31). Returns
+// 32 for zero lanes. Clearing the bit below every set bit keeps the leading one
+// and prevents the conversion to float from rounding up to the next power of
+// two, so the exponent of the float is the position of the leading one.
+static inline __m256i LeadingZeros31(__m256i x) {
+    const __m256i y = _mm256_andnot_si256(_mm256_srli_epi32(x, 1), x);
+    const __m256i exponent =
+            _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(y)), 23);
+    return _mm256_min_epi32(_mm256_sub_epi32(_mm256_set1_epi32(158), exponent),
+                            _mm256_set1_epi32(32));
+}
+
+// WebRtcSpl_NormU32() for each lane, treating lanes >= 2^31 as unsigned.
+static inline __m256i NormU32(__m256i a) {
+    return _mm256_and_si256(
+            _mm256_cmpgt_epi32(a, _mm256_setzero_si256()), LeadingZeros31(a));
+}
+
+// WebRtcSpl_NormW32() for each lane.
+static inline __m256i NormW32(__m256i a) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i norm = _mm256_sub_epi32(
+            LeadingZeros31(_mm256_xor_si256(a, _mm256_srai_epi32(a, 31))),
+            _mm256_set1_epi32(1));
+    return _mm256_andnot_si256(_mm256_cmpeq_epi32(a, zero), norm);
+}
+
+// WEBRTC_SPL_SHIFT_W32() of unsigned lanes by per-lane shifts |c|.
+static inline __m256i ShiftU32(__m256i x, __m256i c) {
+    const __m256i zero = _mm256_setzero_si256();
+    return _mm256_sllv_epi32(
+            _mm256_srlv_epi32(x, _mm256_max_epi32(_mm256_sub_epi32(zero, c), zero)),
+            _mm256_max_epi32(c, zero));
+}
+
+// The high 32 bits of the unsigned 64-bit products of |a| and |b|.
+static inline __m256i MulHighU32(__m256i a, __m256i b) {
+    const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(a, b), 32);
+    const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32),
+                                         _mm256_srli_epi64(b, 32));
+    return _mm256_blend_epi32(even, odd, 0xAA);
+}
+
+// Updates the eight bins starting at |bin|. The channel, spectra and
+// reciprocals are given for these bins. See UpdateAdaptiveChannelC() in
+// aecm_core.cc for the scalar code, which this follows operation by operation
+// with the branches turned into per-lane selects.
+static AECM_ALWAYS_INLINE void UpdateAdaptiveChannelLanes(int32_t *channel32,
+                                                          int16_t *channel16,
+                                                          const uint16_t *far_spectrum,
+                                                          const uint16_t *dfa,
+                                                          const uint32_t *reciprocal,
+                                                          int bin,
+                                                          int16_t far_q,
+                                                          int16_t dfa_q_domain,
+                                                          int16_t mu) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i v32 = _mm256_set1_epi32(32);
+    const __m256i ch = _mm256_loadu_si256((const __m256i *) channel32);
+    const __m256i far = _mm256_cvtepu16_epi32(
+            _mm_loadu_si128((const __m128i *) far_spectrum));
+    const __m256i near = _mm256_cvtepu16_epi32(
+            _mm_loadu_si128((const __m128i *) dfa));
+    __m256i zeros_ch, zeros_far, zeros_num, zeros_dfa, shift_ch_far, num;
+    __m256i tmp16, use_dfa, xfa_q, dfa_q, err, update, shift_num, prod;
+    __m256i divisor, quot, rem, shift2, shifted, step, sum, overflow, ch16;
+
+    // Determine norm of channel and farend to make sure we don't get overflow
+    // in multiplication. A shift of 32 gives zero, as in the C code.
+    zeros_ch = NormU32(ch);
+    zeros_far = NormU32(far);
+    shift_ch_far = _mm256_max_epi32(
+            _mm256_sub_epi32(v32, _mm256_add_epi32(zeros_ch, zeros_far)), zero);
+    num = _mm256_mullo_epi32(_mm256_srlv_epi32(ch, shift_ch_far), far);
+
+    // Determine Q-domain of numerator.
+    zeros_num = NormU32(num);
+    zeros_dfa = LeadingZeros31(near);
+    tmp16 = _mm256_add_epi32(
+            _mm256_add_epi32(zeros_dfa, shift_ch_far),
+            _mm256_set1_epi32(dfa_q_domain - 2 - RESOLUTION_CHANNEL32 - far_q));
+    use_dfa = _mm256_cmpgt_epi32(zeros_num,
+                                 _mm256_add_epi32(tmp16, _mm256_set1_epi32(1)));
+    xfa_q = _mm256_blendv_epi8(_mm256_sub_epi32(zeros_num, two), tmp16, use_dfa);
+    dfa_q = _mm256_blendv_epi8(
+            _mm256_add_epi32(
+                    _mm256_sub_epi32(
+                            _mm256_set1_epi32(RESOLUTION_CHANNEL32 + far_q -
+                                              dfa_q_domain),
+                            shift_ch_far),
+                    xfa_q),
+            _mm256_sub_epi32(zeros_dfa, two),
+            use_dfa);
+
+    // Add in the same Q-domain.
+    err = _mm256_sub_epi32(ShiftU32(near, dfa_q), ShiftU32(num, xfa_q));
+    update = _mm256_andnot_si256(
+            _mm256_cmpeq_epi32(err, zero),
+            _mm256_cmpgt_epi32(far, _mm256_set1_epi32(CHANNEL_VAD << far_q)));
+    if (_mm256_movemask_epi8(update) == 0) {
+        return;
+    }
+
+    // Make sure we don't get overflow in multiplication.
+    zeros_num = NormW32(err);
+    shift_num = _mm256_max_epi32(
+            _mm256_sub_epi32(v32, _mm256_add_epi32(zeros_num, zeros_far)), zero);
+    prod = _mm256_mullo_epi32(_mm256_srlv_epi32(_mm256_abs_epi32(err), shift_num),
+                              far);
+
+    // Normalize with respect to frequency bin. The truncated reciprocal gives
+    // a quotient that is at most one too small.
+    divisor = _mm256_add_epi32(_mm256_set1_epi32(bin + 1),
+                               _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    quot = MulHighU32(prod,
+                      _mm256_loadu_si256((const __m256i *) reciprocal));
+    rem = _mm256_sub_epi32(prod, _mm256_mullo_epi32(quot, divisor));
+    quot = _mm256_sub_epi32(quot, _mm256_cmpgt_epi32(rem, _mm256_sub_epi32(
+            divisor, _mm256_set1_epi32(1))));
+    quot = _mm256_sign_epi32(quot, err);
+
+    // Make sure we are in the right Q-domain. Right shifts are limited to 31,
+    // which is what an arithmetic shift saturates to anyway.
+    shift2 = _mm256_sub_epi32(
+            _mm256_sub_epi32(_mm256_add_epi32(shift_num, shift_ch_far), xfa_q),
+            _mm256_add_epi32(
+                    _mm256_set1_epi32(mu),
+                    _mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(30),
+                                                       zeros_far),
+                                      1)));
+    shifted = _mm256_sllv_epi32(
+            _mm256_srav_epi32(
+                    quot,
+                    _mm256_min_epi32(
+                            _mm256_max_epi32(_mm256_sub_epi32(zero, shift2), zero),
+                            _mm256_set1_epi32(31))),
+            _mm256_max_epi32(shift2, zero));
+    step = _mm256_blendv_epi8(shifted,
+                              _mm256_set1_epi32(WEBRTC_SPL_WORD32_MAX),
+                              _mm256_cmpgt_epi32(shift2, NormW32(quot)));
+
+    // WebRtcSpl_AddSatW32(), and we can never have negative channel gain.
+    sum = _mm256_add_epi32(ch, step);
+    overflow = _mm256_srai_epi32(
+            _mm256_andnot_si256(_mm256_xor_si256(ch, step),
+                                _mm256_xor_si256(ch, sum)),
+            31);
+    sum = _mm256_blendv_epi8(
+            sum,
+            _mm256_xor_si256(_mm256_srai_epi32(ch, 31),
+                             _mm256_set1_epi32(WEBRTC_SPL_WORD32_MAX)),
+            overflow);
+    sum = _mm256_blendv_epi8(ch, _mm256_max_epi32(sum, zero), update);
+    _mm256_storeu_si256((__m256i *) channel32, sum);
+
+    // The 16-bit channel is only rewritten in the updated bins, since it is
+    // not always the upper half of the 32-bit channel.
+    ch16 = _mm256_blendv_epi8(
+            _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) channel16)),
+            _mm256_srai_epi32(sum, 16),
+            update);
+    ch16 = _mm256_permute4x64_epi64(_mm256_packs_epi32(ch16, ch16), 0xD8);
+    _mm_storeu_si128((__m128i *) channel16, _mm256_castsi256_si128(ch16));
+}
+
+void WebRtcAecm_UpdateAdaptiveChannelAvx2(AecmCore *aecm,
+                                          const uint16_t *far_spectrum,
+                                          int16_t far_q,
+                                          const uint16_t *dfa,
+                                          int16_t mu) {
+    int32_t channel32[8] = {0};
+    int16_t channel16[8] = {0};
+    uint16_t far_tail[8] = {0};
+    uint16_t dfa_tail[8] = {0};
+    int i;
+
+    for (i = 0; i < PART_LEN; i += 8) {
+        UpdateAdaptiveChannelLanes(&aecm->channelAdapt32[i],
+                                   &aecm->channelAdapt16[i],
+                                   &far_spectrum[i], &dfa[i],
+                                   &kReciprocalQ32[i], i, far_q,
+                                   aecm->dfaNoisyQDomain, mu);
+    }
+
+    // The last bin goes through the same code in a padded block. The padding
+    // lanes have a zero far end spectrum and are never updated.
+    channel32[0] = aecm->channelAdapt32[PART_LEN];
+    channel16[0] = aecm->channelAdapt16[PART_LEN];
+    far_tail[0] = far_spectrum[PART_LEN];
+    dfa_tail[0] = dfa[PART_LEN];
+    UpdateAdaptiveChannelLanes(channel32, channel16, far_tail, dfa_tail,
+                               &kReciprocalQ32[PART_LEN], PART_LEN, far_q,
+                               aecm->dfaNoisyQDomain, mu);
+    aecm->channelAdapt32[PART_LEN] = channel32[0];
+    aecm->channelAdapt16[PART_LEN] = channel16[0];
+}
+
+// Sign extends the lower 16 bits of each lane, i.e., a cast to int16_t.
+static inline __m256i Wrap16(__m256i x) {
+    return _mm256_srai_epi32(_mm256_slli_epi32(x, 16), 16);
+}
+
+// Packs eight 32-bit lanes, which must be in the int16_t range, into |dst|.
+static inline void StoreW16(int16_t *dst, __m256i x) {
+    x = _mm256_permute4x64_epi64(_mm256_packs_epi32(x, x), 0xD8);
+    _mm_storeu_si128((__m128i *) dst, _mm256_castsi256_si128(x));
+}
+
+// Unsigned 32-bit division of |num| by |den|, which must be nonzero and fit in
+// 16 bits, i.e., WebRtcSpl_DivU32U16(). The quotient of two such integers
+// cannot come closer than 2^-48 relative to the next integer, so truncating
+// the correctly rounded double quotient is exact.
+static inline __m128i DivU32U16(__m128i num, __m128i den) {
+    const __m128i bias = _mm_set1_epi32((int32_t) 0x80000000);
+    const __m256d bias_pd = _mm256_set1_pd(2147483648.0);
+    const __m256d num_pd = _mm256_add_pd(
+            _mm256_cvtepi32_pd(_mm_xor_si128(num, bias)), bias_pd);
+    const __m256d quot_pd = _mm256_floor_pd(
+            _mm256_div_pd(num_pd, _mm256_cvtepi32_pd(den)));
+    return _mm_xor_si128(_mm256_cvtpd_epi32(_mm256_sub_pd(quot_pd, bias_pd)),
+                         bias);
+}
+
+// Calculates hnl[] for the eight bins starting at |echo_filt| and updates the
+// filtered echo estimate and near end spectrum. Returns one in each lane with a
+// nonzero hnl. See ApplyWienerFilterC() in aecm_core.cc for the scalar code.
+static AECM_ALWAYS_INLINE __m256i WienerGainLanes(const int32_t *echo_est,
+                                                  int32_t *echo_filt,
+                                                  int16_t *near_filt,
+                                                  const uint16_t *dfa_clean,
+                                                  int16_t *hnl,
+                                                  int16_t sup_gain,
+                                                  int16_t zeros_gain,
+                                                  int16_t resolution_diff,
+                                                  int16_t q_domain_diff) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i one_q14 = _mm256_set1_epi32(ONE_Q14);
+    const __m256i gain = _mm256_set1_epi32(sup_gain);
+    const __m256i q_diff = _mm256_set1_epi32(q_domain_diff);
+    __m256i filt, tmp, zeros32, shift, use_shifted_gain, gained;
+    __m256i near, dfa, zeros16, shift_dfa, tmp16no1, tmp16no2, q_domain_diff_v;
+    __m256i saturate, den, quot, out;
+    __m128i quot_low, quot_high;
+
+    // Far end signal through channel estimate. The 64-bit product of the C
+    // code is split into the upper and lower seven bits of the difference.
+    filt = _mm256_loadu_si256((const __m256i *) echo_filt);
+    tmp = _mm256_sub_epi32(
+            _mm256_loadu_si256((const __m256i *) echo_est), filt);
+    filt = _mm256_add_epi32(
+            filt,
+            _mm256_add_epi32(
+                    _mm256_mullo_epi32(_mm256_srai_epi32(tmp, 7),
+                                       _mm256_set1_epi32(25)),
+                    _mm256_srli_epi32(
+                            _mm256_mullo_epi32(
+                                    _mm256_and_si256(tmp, _mm256_set1_epi32(127)),
+                                    _mm256_set1_epi32(25)),
+                            7)));
+    _mm256_storeu_si256((__m256i *) echo_filt, filt);
+
+    // Multiply by the suppression gain, shifting down either the gain or the
+    // echo estimate if the product would overflow.
+    zeros32 = _mm256_add_epi32(NormW32(filt), one);
+    shift = _mm256_max_epi32(
+            _mm256_sub_epi32(_mm256_set1_epi32(17 - zeros_gain), zeros32), zero);
+    use_shifted_gain = _mm256_cmpgt_epi32(zeros32, shift);
+    gained = _mm256_blendv_epi8(
+            _mm256_mullo_epi32(_mm256_srav_epi32(filt, shift), gain),
+            _mm256_mullo_epi32(
+                    filt,
+                    _mm256_and_si256(_mm256_srav_epi32(gain, shift),
+                                     _mm256_set1_epi32(0xFFFF))),
+            use_shifted_gain);
+
+    // Update the filtered near end in the new Q-domain. All 16-bit
+    // intermediates of the C code wrap as they do there.
+    near = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) near_filt));
+    dfa = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) dfa_clean));
+    zeros16 = _mm256_max_epi32(_mm256_sub_epi32(NormW32(near),
+                                                _mm256_set1_epi32(16)),
+                               zero);
+    shift_dfa = _mm256_andnot_si256(_mm256_cmpeq_epi32(near, zero),
+                                    _mm256_cmpgt_epi32(q_diff, zeros16));
+    if (q_domain_diff < 0) {
+        tmp16no1 = _mm256_sra_epi32(near, _mm_cvtsi32_si128(-q_domain_diff));
+    } else {
+        tmp16no1 = _mm256_sll_epi32(near, _mm_cvtsi32_si128(q_domain_diff));
+    }
+    q_domain_diff_v = _mm256_and_si256(shift_dfa,
+                                       _mm256_sub_epi32(zeros16, q_diff));
+    tmp16no1 = Wrap16(_mm256_blendv_epi8(tmp16no1,
+                                         _mm256_sllv_epi32(near, zeros16),
+                                         shift_dfa));
+    tmp16no2 = Wrap16(_mm256_srlv_epi32(
+            dfa, _mm256_sub_epi32(zero, q_domain_diff_v)));
+    tmp16no2 = Wrap16(_mm256_add_epi32(
+            _mm256_srai_epi32(_mm256_sub_epi32(tmp16no2, tmp16no1), 4),
+            tmp16no1));
+    // The C code tests the lowest bit of |tmp16no2| for saturation.
+    saturate = _mm256_and_si256(
+            _mm256_cmpeq_epi32(_mm256_and_si256(tmp16no2, one), one),
+            _mm256_cmpgt_epi32(
+                    _mm256_sub_epi32(zero, q_domain_diff_v),
+                    _mm256_max_epi32(_mm256_sub_epi32(NormW32(tmp16no2),
+                                                      _mm256_set1_epi32(16)),
+                                     zero)));
+    near = _mm256_blendv_epi8(
+            Wrap16(_mm256_sllv_epi32(tmp16no2,
+                                     _mm256_sub_epi32(zero, q_domain_diff_v))),
+            _mm256_set1_epi32(WEBRTC_SPL_WORD16_MAX),
+            saturate);
+    StoreW16(near_filt, near);
+
+    // Wiener filter coefficients, resulting hnl in Q14.
+    den = _mm256_max_epi32(_mm256_and_si256(near, _mm256_set1_epi32(0xFFFF)),
+                           one);
+    tmp = _mm256_add_epi32(gained, _mm256_srai_epi32(near, 1));
+    quot_low = DivU32U16(_mm256_castsi256_si128(tmp),
+                         _mm256_castsi256_si128(den));
+    quot_high = DivU32U16(_mm256_extracti128_si256(tmp, 1),
+                          _mm256_extracti128_si256(den, 1));
+    quot = _mm256_inserti128_si256(_mm256_castsi128_si256(quot_low),
+                                   quot_high, 1);
+    tmp = ShiftU32(quot, _mm256_add_epi32(_mm256_set1_epi32(resolution_diff),
+                                          shift));
+    out = _mm256_max_epi32(
+            _mm256_blendv_epi8(_mm256_sub_epi32(one_q14, tmp), one_q14,
+                               _mm256_cmpgt_epi32(zero, tmp)),
+            zero);
+    out = _mm256_andnot_si256(_mm256_cmpeq_epi32(near, zero), out);
+    out = _mm256_blendv_epi8(out, one_q14, _mm256_cmpeq_epi32(gained, zero));
+    StoreW16(hnl, out);
+
+    return _mm256_andnot_si256(_mm256_cmpeq_epi32(out, zero), one);
+}
+
+// WienerGainLanes() of the last bin, in a padded block of which only the
+// first lane is kept.
+static AECM_ALWAYS_INLINE __m256i WienerGainLastBin(AecmCore *aecm,
+                                                    const int32_t *echo_est,
+                                                    const uint16_t *dfa_clean,
+                                                    int16_t *hnl,
+                                                    int16_t sup_gain,
+                                                    int16_t zeros_gain,
+                                                    int16_t resolution_diff,
+                                                    int16_t q_domain_diff) {
+    int32_t echo_est_tail[8] = {0};
+    int32_t echo_filt_tail[8] = {0};
+    int16_t near_filt_tail[8] = {0};
+    uint16_t dfa_tail[8] = {0};
+    int16_t hnl_tail[8];
+    __m256i num_pos;
+
+    echo_est_tail[0] = echo_est[PART_LEN];
+    echo_filt_tail[0] = aecm->echoFilt[PART_LEN];
+    near_filt_tail[0] = aecm->nearFilt[PART_LEN];
+    dfa_tail[0] = dfa_clean[PART_LEN];
+    num_pos = _mm256_and_si256(
+            WienerGainLanes(echo_est_tail, echo_filt_tail, near_filt_tail,
+                            dfa_tail, hnl_tail, sup_gain, zeros_gain,
+                            resolution_diff, q_domain_diff),
+            _mm256_setr_epi32(-1, 0, 0, 0, 0, 0, 0, 0));
+    aecm->echoFilt[PART_LEN] = echo_filt_tail[0];
+    aecm->nearFilt[PART_LEN] = near_filt_tail[0];
+    hnl[PART_LEN] = hnl_tail[0];
+    return num_pos;
+}
+
+// Limits the upper band gains in wideband, applies the NLP to hnl[] and
+// multiplies the near end spectrum |dfw| into |efw|. See ApplyNlpAndFilter()
+// in aecm_core.cc for the scalar code.
+static void ApplyNlpAndFilter(AecmCore *aecm,
+                              int num_pos_coef,
+                              const ComplexInt16 *dfw,
+                              ComplexInt16 *efw,
+                              int16_t *hnl) {
+    const int kMinPrefBand = 4;
+    const int kMaxPrefBand = 24;
+    int32_t avg_hnl32 = 0;
+    int i;
+
+    // Only in wideband. Prevent the gain in upper band from being larger than
+    // in lower band. The squares fit in 28 bits since hnl[] is at most ONE_Q14.
+    if (aecm->mult == 2) {
+        for (i = 0; i < PART_LEN; i += 16) {
+            const __m256i h = _mm256_loadu_si256((const __m256i *) &hnl[i]);
+            _mm256_storeu_si256(
+                    (__m256i *) &hnl[i],
+                    _mm256_or_si256(
+                            _mm256_slli_epi16(_mm256_mulhi_epu16(h, h), 2),
+                            _mm256_srli_epi16(_mm256_mullo_epi16(h, h), 14)));
+        }
+        hnl[PART_LEN] = (int16_t) ((hnl[PART_LEN] * hnl[PART_LEN]) >> 14);
+
+        for (i = kMinPrefBand; i <= kMaxPrefBand; i++) {
+            avg_hnl32 += (int32_t) hnl[i];
+        }
+        avg_hnl32 /= (kMaxPrefBand - kMinPrefBand + 1);
+
+        // Limiting is idempotent, so the last block may overlap the previous.
+        const __m256i avg = _mm256_set1_epi16((int16_t) avg_hnl32);
+        for (i = kMaxPrefBand; i < PART_LEN1; i += 16) {
+            if (i > PART_LEN1 - 16) {
+                i = PART_LEN1 - 16;
+            }
+            _mm256_storeu_si256(
+                    (__m256i *) &hnl[i],
+                    _mm256_min_epi16(
+                            _mm256_loadu_si256((const __m256i *) &hnl[i]), avg));
+        }
+    }
+
+    // Calculate NLP gain. With less than three nonzero coefficients the NLP
+    // gain is zero and removes everything, otherwise it only truncates values
+    // close to zero and one.
+    if (aecm->nlpFlag) {
+        if (num_pos_coef < 3) {
+            memset(hnl, 0, sizeof(int16_t) * PART_LEN1);
+        } else {
+            const __m256i low = _mm256_set1_epi16(NLP_COMP_LOW);
+            const __m256i high = _mm256_set1_epi16(NLP_COMP_HIGH);
+            for (i = 0; i < PART_LEN1; i += 16) {
+                __m256i h;
+                if (i > PART_LEN1 - 16) {
+                    i = PART_LEN1 - 16;
+                }
+                h = _mm256_loadu_si256((const __m256i *) &hnl[i]);
+                h = _mm256_andnot_si256(_mm256_cmpgt_epi16(low, h),
+                                        _mm256_min_epi16(h, high));
+                _mm256_storeu_si256((__m256i *) &hnl[i], h);
+            }
+        }
+    }
+
+    // Multiply with Wiener coefficients, rounding as
+    // WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(dfw[i].real, hnl[i], 14).
+    for (i = 0; i < PART_LEN; i += 8) {
+        const __m256i h = _mm256_cvtepu16_epi32(
+                _mm_loadu_si128((const __m128i *) &hnl[i]));
+        const __m256i gains = _mm256_or_si256(h, _mm256_slli_epi32(h, 16));
+        const __m256i spectrum = _mm256_loadu_si256((const __m256i *) &dfw[i]);
+        const __m256i lo = _mm256_mullo_epi16(spectrum, gains);
+        const __m256i hi = _mm256_mulhi_epi16(spectrum, gains);
+        const __m256i round = _mm256_set1_epi32(1 << 13);
+        const __m256i prod_low = _mm256_srai_epi32(
+                _mm256_add_epi32(_mm256_unpacklo_epi16(lo, hi), round), 14);
+        const __m256i prod_high = _mm256_srai_epi32(
+                _mm256_add_epi32(_mm256_unpackhi_epi16(lo, hi), round), 14);
+        _mm256_storeu_si256((__m256i *) &efw[i],
+                            _mm256_packs_epi32(prod_low, prod_high));
+    }
+    efw[PART_LEN].real = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(
+            dfw[PART_LEN].real, hnl[PART_LEN], 14);
+    efw[PART_LEN].imag = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(
+            dfw[PART_LEN].imag, hnl[PART_LEN], 14);
+}
+
+void WebRtcAecm_ApplyWienerFilterAvx2(AecmCore *aecm,
+                                      const int32_t *echo_est,
+                                      const uint16_t *dfa_clean,
+                                      int16_t far_q,
+                                      int16_t sup_gain,
+                                      const ComplexInt16 *dfw,
+                                      ComplexInt16 *efw,
+                                      int16_t *hnl) {
+    const int16_t zeros_gain = WebRtcSpl_NormW16(sup_gain) + 1;
+    const int16_t resolution_diff = 14 - RESOLUTION_CHANNEL16 -
+                                    RESOLUTION_SUPGAIN + aecm->dfaCleanQDomain -
+                                    far_q;
+    const int16_t q_domain_diff =
+            aecm->dfaCleanQDomain - aecm->dfaCleanQDomainOld;
+    __m256i num_pos = _mm256_setzero_si256();
+    int i;
+
+    for (i = 0; i < PART_LEN; i += 8) {
+        num_pos = _mm256_add_epi32(
+                num_pos,
+                WienerGainLanes(&echo_est[i], &aecm->echoFilt[i],
+                                &aecm->nearFilt[i], &dfa_clean[i], &hnl[i],
+                                sup_gain, zeros_gain, resolution_diff,
+                                q_domain_diff));
+    }
+    num_pos = _mm256_add_epi32(
+            num_pos,
+            WienerGainLastBin(aecm, echo_est, dfa_clean, hnl, sup_gain,
+                              zeros_gain, resolution_diff, q_domain_diff));
+    ApplyNlpAndFilter(aecm, (int) AddLanes(num_pos), dfw, efw, hnl);
+}
+
+// WebRtcSpl_SqrtFloor() of eight lanes in [0, 2^31). See SqrtFloor() in
+// aecm_core_sse2.cc.
+static inline __m256i SqrtFloor(__m256i value) {
+    __m256i root =
+            _mm256_cvttps_epi32(_mm256_sqrt_ps(_mm256_cvtepi32_ps(value)));
+
+    root = _mm256_add_epi32(
+            root, _mm256_cmpgt_epi32(_mm256_mullo_epi32(root, root), value));
+    return _mm256_sub_epi32(
+            root,
+            _mm256_cmpgt_epi32(
+                    _mm256_sub_epi32(value, _mm256_mullo_epi32(root, root)),
+                    _mm256_add_epi32(root, root)));
+}
+
+// real^2 + imag^2 of eight bins, saturated as WebRtcSpl_AddSatW32() does.
+static inline __m256i SquaredMagnitude(__m256i spectrum) {
+    const __m256i sum = _mm256_madd_epi16(spectrum, spectrum);
+    return _mm256_add_epi32(
+            sum,
+            _mm256_cmpeq_epi32(sum, _mm256_set1_epi32((int32_t) 0x80000000)));
+}
+
+void WebRtcAecm_CalcMagnitudesAvx2(const ComplexInt16 *freq_signal,
+                                   uint16_t *freq_signal_abs,
+                                   uint32_t *freq_signal_sum_abs) {
+    __m256i sum_v = _mm256_setzero_si256();
+    int i;
+
+    // See WebRtcAecm_CalcMagnitudesSse2().
+    for (i = 0; i < PART_LEN; i += 16) {
+        const __m256i abs_low = SqrtFloor(SquaredMagnitude(
+                _mm256_loadu_si256((const __m256i *) &freq_signal[i])));
+        const __m256i abs_high = SqrtFloor(SquaredMagnitude(
+                _mm256_loadu_si256((const __m256i *) &freq_signal[i + 8])));
+
+        sum_v = _mm256_add_epi32(sum_v, _mm256_add_epi32(abs_low, abs_high));
+        _mm256_storeu_si256(
+                (__m256i *) &freq_signal_abs[i],
+                _mm256_permute4x64_epi64(_mm256_packus_epi32(abs_low, abs_high),
+                                         0xD8));
+    }
+    freq_signal_abs[PART_LEN] =
+            (uint16_t) WEBRTC_SPL_ABS_W16(freq_signal[PART_LEN].real);
+    *freq_signal_sum_abs = AddLanes(sum_v) + freq_signal_abs[PART_LEN];
+}
+
+// Reverses the order of the sixteen 16-bit lanes.
+static inline __m256i Reverse16(__m256i v) {
+    const __m256i reverse_in_lane = _mm256_setr_epi8(
+            14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+            14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+    return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, reverse_in_lane),
+                                    _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+// (int16_t) ((a * b) >> 14) for sixteen lanes. See MulQ14() in
+// aecm_core_sse2.cc.
+static inline __m256i MulQ14(__m256i a, __m256i b) {
+    return _mm256_or_si256(_mm256_srli_epi16(_mm256_mullo_epi16(a, b), 14),
+                           _mm256_slli_epi16(_mm256_mulhi_epi16(a, b), 2));
+}
+
+// Negates the imaginary parts of interleaved complex values.
+static inline __m256i Conjugate(__m256i v) {
+    const __m256i imag_mask = _mm256_set1_epi32((int32_t) 0xFFFF0000);
+    return _mm256_sub_epi16(_mm256_xor_si256(v, imag_mask), imag_mask);
+}
+
+// The 32-bit products of sixteen signed 16-bit lanes, in the order of the
+// in-lane unpack instructions.
+static inline void MulS16(__m256i a,
+                          __m256i b,
+                          __m256i *prod_low,
+                          __m256i *prod_high) {
+    const __m256i lo = _mm256_mullo_epi16(a, b);
+    const __m256i hi = _mm256_mulhi_epi16(a, b);
+    *prod_low = _mm256_unpacklo_epi16(lo, hi);
+    *prod_high = _mm256_unpackhi_epi16(lo, hi);
+}
+
+// WEBRTC_SPL_SHIFT_W32() of eight lanes by the same amount.
+static inline __m256i ShiftW32(__m256i v, int shift) {
+    if (shift >= 0) {
+        return _mm256_sll_epi32(v, _mm_cvtsi32_si128(shift));
+    }
+    return _mm256_sra_epi32(v, _mm_cvtsi32_si128(-shift));
+}
+
+// See Window() in aecm_core_sse2.cc.
+static void Window(int16_t *fft, const int16_t *time_signal,
+                   int time_signal_scaling) {
+    const __m128i scaling = _mm_cvtsi32_si128(time_signal_scaling);
+    int i;
+
+    for (i = 0; i < PART_LEN; i += 16) {
+        const __m256i first = _mm256_sll_epi16(
+                _mm256_loadu_si256((const __m256i *) &time_signal[i]), scaling);
+        const __m256i second = _mm256_sll_epi16(
+                _mm256_loadu_si256(
+                        (const __m256i *) &time_signal[PART_LEN + i]),
+                scaling);
+        const __m256i window = _mm256_loadu_si256(
+                (const __m256i *) &WebRtcAecm_kSqrtHanning[i]);
+        const __m256i window_reversed = Reverse16(_mm256_loadu_si256(
+                (const __m256i *) &WebRtcAecm_kSqrtHanning[PART_LEN - 15 - i]));
+
+        _mm256_storeu_si256((__m256i *) &fft[i], MulQ14(first, window));
+        _mm256_storeu_si256((__m256i *) &fft[PART_LEN + i],
+                            MulQ14(second, window_reversed));
+    }
+}
+
+static void ConjugateSpectrum(int16_t *freq) {
+    int i;
+
+    for (i = 0; i < PART_LEN2; i += 16) {
+        _mm256_storeu_si256(
+                (__m256i *) &freq[i],
+                Conjugate(_mm256_loadu_si256((const __m256i *) &freq[i])));
+    }
+}
+
+void WebRtcAecm_WindowAndFFTAvx2(AecmCore *aecm,
+                                 int16_t *fft,
+                                 const int16_t *time_signal,
+                                 ComplexInt16 *freq_signal,
+                                 int time_signal_scaling) {
+    int16_t *freq = (int16_t *) freq_signal;
+
+    // See WebRtcAecm_WindowAndFFTSse2().
+    Window(fft, time_signal, time_signal_scaling);
+    WebRtcSpl_RealForwardFFT(aecm->real_fft, fft, freq);
+    ConjugateSpectrum(freq);
+}
+
+void WebRtcAecm_WindowAndFFTPairAvx2(AecmCore *aecm,
+                                     int16_t *fft,
+                                     const int16_t *time_signal_a,
+                                     const int16_t *time_signal_b,
+                                     ComplexInt16 *freq_signal_a,
+                                     ComplexInt16 *freq_signal_b,
+                                     int time_signal_scaling_a,
+                                     int time_signal_scaling_b) {
+    int16_t *freq_a = (int16_t *) freq_signal_a;
+    int16_t *freq_b = (int16_t *) freq_signal_b;
+
+    Window(fft, time_signal_a, time_signal_scaling_a);
+    Window(fft + PART_LEN2, time_signal_b, time_signal_scaling_b);
+
+    WebRtcSpl_RealForwardFFTPair(aecm->real_fft, fft, fft + PART_LEN2, freq_a,
+                                 freq_b);
+    ConjugateSpectrum(freq_a);
+    ConjugateSpectrum(freq_b);
+}
+
+void WebRtcAecm_InverseFFTAndWindowAvx2(AecmCore *aecm,
+                                        int16_t *fft,
+                                        ComplexInt16 *efw,
+                                        int16_t *output,
+                                        const int16_t *nearendClean) {
+    const __m256i round = _mm256_set1_epi32(1 << 13);
+    const int16_t *efw16 = (const int16_t *) efw;
+    int16_t *ifft_out = (int16_t *) efw;
+    int i, out_cfft, shift;
+
+    // See WebRtcAecm_InverseFFTAndWindowSse2().
+    for (i = 0; i < PART_LEN2; i += 16) {
+        _mm256_storeu_si256(
+                (__m256i *) &fft[i],
+                Conjugate(_mm256_loadu_si256((const __m256i *) &efw16[i])));
+    }
+    fft[PART_LEN2] = efw[PART_LEN].real;
+    fft[PART_LEN2 + 1] = -efw[PART_LEN].imag;
+
+    out_cfft = WebRtcSpl_RealInverseFFT(aecm->real_fft, fft, ifft_out);
+    shift = out_cfft - aecm->dfaCleanQDomain;
+    for (i = 0; i < PART_LEN; i += 16) {
+        const __m256i window = _mm256_loadu_si256(
+                (const __m256i *) &WebRtcAecm_kSqrtHanning[i]);
+        const __m256i window_reversed = Reverse16(_mm256_loadu_si256(
+                (const __m256i *) &WebRtcAecm_kSqrtHanning[PART_LEN - 15 - i]));
+        const __m256i out_buf =
+                _mm256_loadu_si256((const __m256i *) &aecm->outBuf[i]);
+        __m256i low, high;
+
+        MulS16(_mm256_loadu_si256((const __m256i *) &ifft_out[i]), window,
+               &low, &high);
+        low = _mm256_srai_epi32(_mm256_add_epi32(low, round), 14);
+        high = _mm256_srai_epi32(_mm256_add_epi32(high, round), 14);
+        low = _mm256_srai_epi32(_mm256_slli_epi32(low, 16), 16);
+        high = _mm256_srai_epi32(_mm256_slli_epi32(high, 16), 16);
+        low = _mm256_add_epi32(
+                ShiftW32(low, shift),
+                _mm256_srai_epi32(_mm256_unpacklo_epi16(out_buf, out_buf), 16));
+        high = _mm256_add_epi32(
+                ShiftW32(high, shift),
+                _mm256_srai_epi32(_mm256_unpackhi_epi16(out_buf, out_buf), 16));
+        // The in-lane unpacks above and the pack restore the sample order.
+        _mm256_storeu_si256((__m256i *) &output[i],
+                            _mm256_packs_epi32(low, high));
+
+        MulS16(_mm256_loadu_si256((const __m256i *) &ifft_out[PART_LEN + i]),
+               window_reversed, &low, &high);
+        low = ShiftW32(_mm256_srai_epi32(low, 14), shift);
+        high = ShiftW32(_mm256_srai_epi32(high, 14), shift);
+        _mm256_storeu_si256((__m256i *) &aecm->outBuf[i],
+                            _mm256_packs_epi32(low, high));
+    }
+
+    // Copy the current block to the old position
+    // (aecm->outBuf is shifted elsewhere)
+    memcpy(aecm->xBuf, aecm->xBuf + PART_LEN, sizeof(int16_t) * PART_LEN);
+    memcpy(aecm->dBufNoisy, aecm->dBufNoisy + PART_LEN,
+           sizeof(int16_t) * PART_LEN);
+    if (nearendClean != NULL) {
+        memcpy(aecm->dBufClean, aecm->dBufClean + PART_LEN,
+               sizeof(int16_t) * PART_LEN);
+    }
+}
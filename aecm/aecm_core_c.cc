@@ -20,32 +20,6 @@ extern "C" {
 #include "delay_estimator_wrapper.h"
 
 
-// Square root of Hanning window in Q14.
-static const ALIGN8_BEG int16_t
-        WebRtcAecm_kSqrtHanning[]
-        ALIGN8_END = {
-        0, 399, 798, 1196, 1594, 1990, 2386, 2780, 3172, 3562, 3951,
-        4337, 4720, 5101, 5478, 5853, 6224, 6591, 6954, 7313, 7668, 8019,
-        8364, 8705, 9040, 9370, 9695, 10013, 10326, 10633, 10933, 11227, 11514,
-        11795, 12068, 12335, 12594, 12845, 13089, 13325, 13553, 13773, 13985, 14189,
-        14384, 14571, 14749, 14918, 15079, 15231, 15373, 15506, 15631, 15746, 15851,
-        15947, 16034, 16111, 16179, 16237, 16286, 16325, 16354, 16373, 16384};
-
-#ifdef AECM_WITH_ABS_APPROX
-// Q15 alpha = 0.99439986968132  const Factor for magnitude approximation
-static const uint16_t kAlpha1 = 32584;
-// Q15 beta = 0.12967166976970   const Factor for magnitude approximation
-static const uint16_t kBeta1 = 4249;
-// Q15 alpha = 0.94234827210087  const Factor for magnitude approximation
-static const uint16_t kAlpha2 = 30879;
-// Q15 beta = 0.33787806009150   const Factor for magnitude approximation
-static const uint16_t kBeta2 = 11072;
-// Q15 alpha = 0.82247698684306  const Factor for magnitude approximation
-static const uint16_t kAlpha3 = 26951;
-// Q15 beta = 0.57762063060713   const Factor for magnitude approximation
-static const uint16_t kBeta3 = 18927;
-#endif
-
 static const int16_t kNoiseEstQDomain = 15;
 static const int16_t kNoiseEstIncCount = 5;
 
@@ -163,88 +137,6 @@ static void ComfortNoise(AecmCore *aecm,
     }
 }
 
-static void WindowAndFFT(AecmCore *aecm,
-                         int16_t *fft,
-                         const int16_t *time_signal,
-                         ComplexInt16 *freq_signal,
-                         int time_signal_scaling) {
-    int i = 0;
-
-    // FFT of signal
-    for (i = 0; i < PART_LEN; i++) {
-        // Window time domain signal and insert into real part of
-        // transformation array |fft|
-        int16_t scaled_time_signal = time_signal[i] * (1 << time_signal_scaling);
-        fft[i] = (int16_t) ((scaled_time_signal * WebRtcAecm_kSqrtHanning[i]) >> 14);
-        scaled_time_signal = time_signal[i + PART_LEN] * (1 << time_signal_scaling);
-        fft[PART_LEN + i] = (int16_t) (
-                (scaled_time_signal * WebRtcAecm_kSqrtHanning[PART_LEN - i]) >> 14);
-    }
-
-    // Do forward FFT, then take only the first PART_LEN complex samples,
-    // and change signs of the imaginary parts.
-    WebRtcSpl_RealForwardFFT(aecm->real_fft, fft, (int16_t *)
-            freq_signal);
-    for (i = 0; i < PART_LEN; i++) {
-        freq_signal[i].imag = -freq_signal[i].imag;
-    }
-}
-
-static void InverseFFTAndWindow(AecmCore *aecm,
-                                int16_t *fft,
-                                ComplexInt16 *efw,
-                                int16_t *output,
-                                const int16_t *nearendClean) {
-    int i, j, outCFFT;
-    int32_t tmp32no1;
-    // Reuse |efw| for the inverse FFT output after transferring
-    // the contents to |fft|.
-    int16_t *ifft_out = (int16_t *)
-            efw;
-
-    // Synthesis
-    for (i = 1, j = 2; i < PART_LEN; i += 1, j += 2) {
-        fft[j] = efw[i].real;
-        fft[j + 1] = -efw[i].imag;
-    }
-    fft[0] = efw[0].real;
-    fft[1] = -efw[0].imag;
-
-    fft[PART_LEN2] = efw[PART_LEN].real;
-    fft[PART_LEN2 + 1] = -efw[PART_LEN].imag;
-
-    // Inverse FFT. Keep outCFFT to scale the samples in the next block.
-    outCFFT = WebRtcSpl_RealInverseFFT(aecm->real_fft, fft, ifft_out);
-    for (i = 0; i < PART_LEN; i++) {
-        ifft_out[i] = (int16_t)
-                WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(
-                        ifft_out[i], WebRtcAecm_kSqrtHanning[i], 14);
-        tmp32no1 = WEBRTC_SPL_SHIFT_W32((int32_t) ifft_out[i],
-                                        outCFFT - aecm->dfaCleanQDomain);
-        output[i] = (int16_t)
-                WEBRTC_SPL_SAT(WEBRTC_SPL_WORD16_MAX,
-                               tmp32no1 + aecm->outBuf[i],
-                               WEBRTC_SPL_WORD16_MIN);
-
-        tmp32no1 =
-                (ifft_out[PART_LEN + i] * WebRtcAecm_kSqrtHanning[PART_LEN - i]) >> 14;
-        tmp32no1 = WEBRTC_SPL_SHIFT_W32(tmp32no1, outCFFT - aecm->dfaCleanQDomain);
-        aecm->outBuf[i] = (int16_t)
-                WEBRTC_SPL_SAT(WEBRTC_SPL_WORD16_MAX, tmp32no1,
-                               WEBRTC_SPL_WORD16_MIN);
-    }
-
-    // Copy the current block to the old position
-    // (aecm->outBuf is shifted elsewhere)
-    memcpy(aecm->xBuf, aecm->xBuf + PART_LEN, sizeof(int16_t) * PART_LEN);
-    memcpy(aecm->dBufNoisy, aecm->dBufNoisy + PART_LEN,
-           sizeof(int16_t) * PART_LEN);
-    if (nearendClean != NULL) {
-        memcpy(aecm->dBufClean, aecm->dBufClean + PART_LEN,
-               sizeof(int16_t) * PART_LEN);
-    }
-}
-
 // Transforms a time domain signal into the frequency domain, outputting the
 // complex valued signal, absolute value and sum of absolute values.
 //
@@ -263,121 +155,79 @@ static int TimeToFrequencyDomain(AecmCore *aecm,
                                  ComplexInt16 *freq_signal,
                                  uint16_t *freq_signal_abs,
                                  uint32_t *freq_signal_sum_abs) {
-    int i = 0;
     int time_signal_scaling = 0;
 
-    int32_t tmp32no1 = 0;
-    int32_t tmp32no2 = 0;
-
     // In fft_buf, +16 for 32-byte alignment.
     int16_t fft_buf[PART_LEN4 + 16];
     int16_t *fft = (int16_t *) (((uintptr_t) fft_buf + 31) & ~31);
 
+#ifdef AECM_DYNAMIC_Q
     int16_t tmp16no1;
-#ifndef WEBRTC_ARCH_ARM_V7
-    int16_t tmp16no2;
-#endif
-#ifdef AECM_WITH_ABS_APPROX
-    int16_t max_value = 0;
-    int16_t min_value = 0;
-    uint16_t alpha = 0;
-    uint16_t beta = 0;
-#endif
 
-#ifdef AECM_DYNAMIC_Q
     tmp16no1 = WebRtcSpl_MaxAbsValueW16(time_signal, PART_LEN2);
     time_signal_scaling = WebRtcSpl_NormW16(tmp16no1);
 #endif
 
-    WindowAndFFT(aecm, fft, time_signal, freq_signal, time_signal_scaling);
+    WebRtcAecm_WindowAndFFT(aecm, fft, time_signal, freq_signal,
+                            time_signal_scaling);
 
     // Extract imaginary and real part, calculate the magnitude for
     // all frequency bins
     freq_signal[0].imag = 0;
     freq_signal[PART_LEN].imag = 0;
-    freq_signal_abs[0] = (uint16_t) WEBRTC_SPL_ABS_W16(freq_signal[0].real);
-    freq_signal_abs[PART_LEN] =
-            (uint16_t) WEBRTC_SPL_ABS_W16(freq_signal[PART_LEN].real);
-    (*freq_signal_sum_abs) =
-            (uint32_t) (freq_signal_abs[0]) + (uint32_t) (freq_signal_abs[PART_LEN]);
-
-    for (i = 1; i < PART_LEN; i++) {
-        if (freq_signal[i].real == 0) {
-            freq_signal_abs[i] = (uint16_t) WEBRTC_SPL_ABS_W16(freq_signal[i].imag);
-        } else if (freq_signal[i].imag == 0) {
-            freq_signal_abs[i] = (uint16_t) WEBRTC_SPL_ABS_W16(freq_signal[i].real);
-        } else {
-            // Approximation for magnitude of complex fft output
-            // magn = sqrt(real^2 + imag^2)
-            // magn ~= alpha * max(|imag|,|real|) + beta * min(|imag|,|real|)
-            //
-            // The parameters alpha and beta are stored in Q15
-
-#ifdef AECM_WITH_ABS_APPROX
-            tmp16no1 = WEBRTC_SPL_ABS_W16(freq_signal[i].real);
-            tmp16no2 = WEBRTC_SPL_ABS_W16(freq_signal[i].imag);
-
-            if (tmp16no1 > tmp16no2) {
-              max_value = tmp16no1;
-              min_value = tmp16no2;
-            } else {
-              max_value = tmp16no2;
-              min_value = tmp16no1;
-            }
-
-            // Magnitude in Q(-6)
-            if ((max_value >> 2) > min_value) {
-              alpha = kAlpha1;
-              beta = kBeta1;
-            } else if ((max_value >> 1) > min_value) {
-              alpha = kAlpha2;
-              beta = kBeta2;
-            } else {
-              alpha = kAlpha3;
-              beta = kBeta3;
-            }
-            tmp16no1 = (int16_t)((max_value * alpha) >> 15);
-            tmp16no2 = (int16_t)((min_value * beta) >> 15);
-            freq_signal_abs[i] = (uint16_t)tmp16no1 + (uint16_t)tmp16no2;
-#else
-#ifdef WEBRTC_ARCH_ARM_V7
-            __asm __volatile(
-                "smulbb %[tmp32no1], %[real], %[real]\n\t"
-                "smlabb %[tmp32no2], %[imag], %[imag], %[tmp32no1]\n\t"
-                : [tmp32no1] "+&r"(tmp32no1), [tmp32no2] "=r"(tmp32no2)
-                : [real] "r"(freq_signal[i].real), [imag] "r"(freq_signal[i].imag));
-#else
-            tmp16no1 = WEBRTC_SPL_ABS_W16(freq_signal[i].real);
-            tmp16no2 = WEBRTC_SPL_ABS_W16(freq_signal[i].imag);
-            tmp32no1 = tmp16no1 * tmp16no1;
-            tmp32no2 = tmp16no2 * tmp16no2;
-            tmp32no2 = WebRtcSpl_AddSatW32(tmp32no1, tmp32no2);
-#endif  // WEBRTC_ARCH_ARM_V7
-            tmp32no1 = WebRtcSpl_SqrtFloor(tmp32no2);
-
-            freq_signal_abs[i] = (uint16_t) tmp32no1;
-#endif  // AECM_WITH_ABS_APPROX
-        }
-        (*freq_signal_sum_abs) += (uint32_t) freq_signal_abs[i];
-    }
+    WebRtcAecm_CalcMagnitudes(freq_signal, freq_signal_abs, freq_signal_sum_abs);
 
     return time_signal_scaling;
 }
 
+// TimeToFrequencyDomain() of two signals, transformed together in one complex
+// FFT. Each signal keeps its own Q-domain, returned in |time_signal_scaling|.
+static void TimeToFrequencyDomainPair(AecmCore *aecm,
+                                      const int16_t *time_signal_a,
+                                      const int16_t *time_signal_b,
+                                      ComplexInt16 *freq_signal_a,
+                                      ComplexInt16 *freq_signal_b,
+                                      uint16_t *freq_signal_abs_a,
+                                      uint16_t *freq_signal_abs_b,
+                                      uint32_t *freq_signal_sum_abs_a,
+                                      uint32_t *freq_signal_sum_abs_b,
+                                      int time_signal_scaling[2]) {
+    // In fft_buf, +16 for 32-byte alignment.
+    int16_t fft_buf[PART_LEN4 + 16];
+    int16_t *fft = (int16_t *) (((uintptr_t) fft_buf + 31) & ~31);
+
+    time_signal_scaling[0] = 0;
+    time_signal_scaling[1] = 0;
+#ifdef AECM_DYNAMIC_Q
+    time_signal_scaling[0] = WebRtcSpl_NormW16(
+            WebRtcSpl_MaxAbsValueW16(time_signal_a, PART_LEN2));
+    time_signal_scaling[1] = WebRtcSpl_NormW16(
+            WebRtcSpl_MaxAbsValueW16(time_signal_b, PART_LEN2));
+#endif
+
+    WebRtcAecm_WindowAndFFTPair(aecm, fft, time_signal_a, time_signal_b,
+                                freq_signal_a, freq_signal_b,
+                                time_signal_scaling[0],
+                                time_signal_scaling[1]);
+
+    freq_signal_a[0].imag = 0;
+    freq_signal_a[PART_LEN].imag = 0;
+    freq_signal_b[0].imag = 0;
+    freq_signal_b[PART_LEN].imag = 0;
+    WebRtcAecm_CalcMagnitudes(freq_signal_a, freq_signal_abs_a,
+                              freq_signal_sum_abs_a);
+    WebRtcAecm_CalcMagnitudes(freq_signal_b, freq_signal_abs_b,
+                              freq_signal_sum_abs_b);
+}
+
 // bugs.webrtc.org/8200
 int WebRtcAecm_ProcessBlock(AecmCore *aecm, const int16_t *farend, const int16_t *nearendNoisy,
                             const int16_t *nearendClean, int16_t *output) {
-    int i;
-
     uint32_t xfaSum;
     uint32_t dfaNoisySum;
     uint32_t dfaCleanSum;
-    uint32_t echoEst32Gained;
-    uint32_t tmpU32;
-
-    int32_t tmp32no1;
-
-    uint16_t xfa[PART_LEN1];
+    // The far end spectrum is written in place to the far end history.
+    uint16_t *xfa = WebRtcAecm_NextFarHistorySlot(aecm);
     uint16_t dfaNoisy[PART_LEN1];
     uint16_t dfaClean[PART_LEN1];
     uint16_t *ptrDfaClean = dfaClean;
@@ -396,21 +246,12 @@ int WebRtcAecm_ProcessBlock(AecmCore *aecm, const int16_t *farend, const int16_t
     ComplexInt16 *efw = (ComplexInt16 *) (((uintptr_t) efw_buf + 31) & ~31);
 
     int16_t hnl[PART_LEN1];
-    int16_t numPosCoef = 0;
-    int16_t nlpGain = ONE_Q14;
     int delay;
-    int16_t tmp16no1;
-    int16_t tmp16no2;
     int16_t mu;
     int16_t supGain;
-    int16_t zeros32, zeros16;
     int16_t zerosDBufNoisy, zerosDBufClean, zerosXBuf;
+    int zeros[2];
     int far_q;
-    int16_t resolutionDiff, qDomainDiff, dfa_clean_q_domain_diff;
-
-    const int kMinPrefBand = 4;
-    const int kMaxPrefBand = 24;
-    int32_t avgHnl32 = 0;
 
     // Determine startup state. There are three states:
     // (0) the first CONV_LEN blocks
@@ -435,12 +276,22 @@ int WebRtcAecm_ProcessBlock(AecmCore *aecm, const int16_t *farend, const int16_t
                sizeof(int16_t) * PART_LEN);
     }
 
-// Transform far end signal from time domain to frequency domain.
-    far_q = TimeToFrequencyDomain(aecm, aecm->xBuf, dfw, xfa, &xfaSum);
-
-// Transform noisy near end signal from time domain to frequency domain.
-    zerosDBufNoisy =
-            TimeToFrequencyDomain(aecm, aecm->dBufNoisy, dfw, dfaNoisy, &dfaNoisySum);
+// Transform the far end and near end signals from time domain to frequency
+// domain, two at a time. Only the magnitudes of all but the last near end
+// spectrum are used, so |efw| holds them until the Wiener filter writes it.
+    if (nearendClean == NULL) {
+        TimeToFrequencyDomainPair(aecm, aecm->xBuf, aecm->dBufNoisy, efw, dfw,
+                                  xfa, dfaNoisy, &xfaSum, &dfaNoisySum, zeros);
+        far_q = zeros[0];
+        zerosDBufNoisy = (int16_t) zeros[1];
+    } else {
+        far_q = TimeToFrequencyDomain(aecm, aecm->xBuf, efw, xfa, &xfaSum);
+        TimeToFrequencyDomainPair(aecm, aecm->dBufNoisy, aecm->dBufClean, efw,
+                                  dfw, dfaNoisy, dfaClean, &dfaNoisySum,
+                                  &dfaCleanSum, zeros);
+        zerosDBufNoisy = (int16_t) zeros[0];
+        zerosDBufClean = (int16_t) zeros[1];
+    }
     aecm->
             dfaNoisyQDomainOld = aecm->dfaNoisyQDomain;
     aecm->
@@ -454,9 +305,6 @@ int WebRtcAecm_ProcessBlock(AecmCore *aecm, const int16_t *farend, const int16_t
                 dfaCleanQDomain = aecm->dfaNoisyQDomain;
         dfaCleanSum = dfaNoisySum;
     } else {
-// Transform clean near end signal from time domain to frequency domain.
-        zerosDBufClean = TimeToFrequencyDomain(aecm, aecm->dBufClean, dfw, dfaClean,
-                                               &dfaCleanSum);
         aecm->
                 dfaCleanQDomainOld = aecm->dfaCleanQDomain;
         aecm->
@@ -513,199 +361,16 @@ int WebRtcAecm_ProcessBlock(AecmCore *aecm, const int16_t *farend, const int16_t
     );
     supGain = WebRtcAecm_CalcSuppressionGain(aecm);
 
-// Calculate Wiener filter hnl[]
-    for (
-            i = 0;
-            i < PART_LEN1;
-            i++) {
-// Far end signal through channel estimate in Q8
-// How much can we shift right to preserve resolution
-        tmp32no1 = echoEst32[i] - aecm->echoFilt[i];
-        aecm->echoFilt[i] += (int32_t) ((int64_t{tmp32no1}
-                                         * 50) >> 8);
-
-        zeros32 = WebRtcSpl_NormW32(aecm->echoFilt[i]) + 1;
-        zeros16 = WebRtcSpl_NormW16(supGain) + 1;
-        if (zeros32 + zeros16 > 16) {
-// Multiplication is safe
-// Result in
-// Q(RESOLUTION_CHANNEL+RESOLUTION_SUPGAIN+
-//   aecm->xfaQDomainBuf[diff])
-            echoEst32Gained =
-                    WEBRTC_SPL_UMUL_32_16((uint32_t) aecm->echoFilt[i], (uint16_t) supGain);
-            resolutionDiff = 14 - RESOLUTION_CHANNEL16 - RESOLUTION_SUPGAIN;
-            resolutionDiff += (aecm->dfaCleanQDomain - zerosXBuf);
-        } else {
-            tmp16no1 = 17 - zeros32 - zeros16;
-            resolutionDiff =
-                    14 + tmp16no1 - RESOLUTION_CHANNEL16 - RESOLUTION_SUPGAIN;
-            resolutionDiff += (aecm->dfaCleanQDomain - zerosXBuf);
-            if (zeros32 > tmp16no1) {
-                echoEst32Gained = WEBRTC_SPL_UMUL_32_16((uint32_t) aecm->echoFilt[i],
-                                                        supGain >> tmp16no1);
-            } else {
-// Result in Q-(RESOLUTION_CHANNEL+RESOLUTION_SUPGAIN-16)
-                echoEst32Gained = (aecm->echoFilt[i] >> tmp16no1) * supGain;
-            }
-        }
-
-        zeros16 = WebRtcSpl_NormW16(aecm->nearFilt[i]);
-        RTC_DCHECK_GE(zeros16,
-                      0);  // |zeros16| is a norm, hence non-negative.
-        dfa_clean_q_domain_diff = aecm->dfaCleanQDomain - aecm->dfaCleanQDomainOld;
-        if (zeros16 < dfa_clean_q_domain_diff && aecm->nearFilt[i]) {
-            tmp16no1 = aecm->nearFilt[i] * (1 << zeros16);
-            qDomainDiff = zeros16 - dfa_clean_q_domain_diff;
-            tmp16no2 = ptrDfaClean[i] >> -qDomainDiff;
-        } else {
-            tmp16no1 = dfa_clean_q_domain_diff < 0
-                       ? aecm->nearFilt[i] >> -dfa_clean_q_domain_diff
-                       : aecm->nearFilt[i] * (1 << dfa_clean_q_domain_diff);
-            qDomainDiff = 0;
-            tmp16no2 = ptrDfaClean[i];
-        }
-        tmp32no1 = (int32_t) (tmp16no2 - tmp16no1);
-        tmp16no2 = (int16_t) (tmp32no1 >> 4);
-        tmp16no2 +=
-                tmp16no1;
-        zeros16 = WebRtcSpl_NormW16(tmp16no2);
-        if ((tmp16no2) & (-qDomainDiff > zeros16)) {
-            aecm->nearFilt[i] =
-                    WEBRTC_SPL_WORD16_MAX;
-        } else {
-            aecm->nearFilt[i] = qDomainDiff < 0 ? tmp16no2 * (1 << -qDomainDiff)
-                                                : tmp16no2 >>
-                                                           qDomainDiff;
-        }
-
-// Wiener filter coefficients, resulting hnl in Q14
-        if (echoEst32Gained == 0) {
-            hnl[i] =
-                    ONE_Q14;
-        } else if (aecm->nearFilt[i] == 0) {
-            hnl[i] = 0;
-        } else {
-// Multiply the suppression gain
-// Rounding
-            echoEst32Gained += (uint32_t) (aecm->nearFilt[i] >> 1);
-            tmpU32 =
-                    WebRtcSpl_DivU32U16(echoEst32Gained, (uint16_t) aecm->nearFilt[i]);
-
-// Current resolution is
-// Q-(RESOLUTION_CHANNEL+RESOLUTION_SUPGAIN- max(0,17-zeros16- zeros32))
-// Make sure we are in Q14
-            tmp32no1 = (int32_t) WEBRTC_SPL_SHIFT_W32(tmpU32, resolutionDiff);
-            if (tmp32no1 > ONE_Q14) {
-                hnl[i] = 0;
-            } else if (tmp32no1 < 0) {
-                hnl[i] =
-                        ONE_Q14;
-            } else {
-// 1-echoEst/dfa
-                hnl[i] = ONE_Q14 - (int16_t)
-                        tmp32no1;
-                if (hnl[i] < 0) {
-                    hnl[i] = 0;
-                }
-            }
-        }
-        if (hnl[i]) {
-            numPosCoef++;
-        }
-    }
-// Only in wideband. Prevent the gain in upper band from being larger than
-// in lower band.
-    if (aecm->mult == 2) {
-// TODO(bjornv): Investigate if the scaling of hnl[i] below can cause
-//               speech distortion in double-talk.
-        for (
-                i = 0;
-                i < PART_LEN1;
-                i++) {
-            hnl[i] = (int16_t) ((hnl[i] * hnl[i]) >> 14);
-        }
-
-        for (
-                i = kMinPrefBand;
-                i <=
-                kMaxPrefBand;
-                i++) {
-            avgHnl32 += (int32_t) hnl[i];
-        }
-        RTC_DCHECK_GT(kMaxPrefBand
-                              -kMinPrefBand + 1, 0);
-        avgHnl32 /= (kMaxPrefBand - kMinPrefBand + 1);
-
-        for (
-                i = kMaxPrefBand;
-                i < PART_LEN1;
-                i++) {
-            if (hnl[i] > (int16_t) avgHnl32) {
-                hnl[i] = (int16_t)
-                        avgHnl32;
-            }
-        }
-    }
-
-// Calculate NLP gain, result is in Q14
-    if (aecm->nlpFlag) {
-        for (
-                i = 0;
-                i < PART_LEN1;
-                i++) {
-// Truncate values close to zero and one.
-            if (hnl[i] > NLP_COMP_HIGH) {
-                hnl[i] =
-                        ONE_Q14;
-            } else if (hnl[i] < NLP_COMP_LOW) {
-                hnl[i] = 0;
-            }
-
-// Remove outliers
-            if (numPosCoef < 3) {
-                nlpGain = 0;
-            } else {
-                nlpGain = ONE_Q14;
-            }
-
-// NLP
-            if ((hnl[i] == ONE_Q14) && (nlpGain == ONE_Q14)) {
-                hnl[i] =
-                        ONE_Q14;
-            } else {
-                hnl[i] = (int16_t) ((hnl[i] * nlpGain) >> 14);
-            }
-
-// multiply with Wiener coefficients
-            efw[i].
-                    real = (int16_t) (
-                    WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(dfw[i].real, hnl[i], 14));
-            efw[i].
-                    imag = (int16_t) (
-                    WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(dfw[i].imag, hnl[i], 14));
-        }
-    } else {
-// multiply with Wiener coefficients
-        for (
-                i = 0;
-                i < PART_LEN1;
-                i++) {
-            efw[i].
-                    real = (int16_t) (
-                    WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(dfw[i].real, hnl[i], 14));
-            efw[i].
-                    imag = (int16_t) (
-                    WEBRTC_SPL_MUL_16_16_RSFT_WITH_ROUND(dfw[i].imag, hnl[i], 14));
-        }
-    }
+// Calculate Wiener filter hnl[], apply the NLP and filter the near end.
+    WebRtcAecm_ApplyWienerFilter(aecm, echoEst32, ptrDfaClean, zerosXBuf, supGain,
+                                 dfw, efw, hnl);
 
     if (aecm->cngMode == AecmTrue) {
         ComfortNoise(aecm, ptrDfaClean, efw, hnl
         );
     }
 
-    InverseFFTAndWindow(aecm, fft, efw, output, nearendClean
-    );
+    WebRtcAecm_InverseFFTAndWindow(aecm, fft, efw, output, nearendClean);
 
     return 0;
 }
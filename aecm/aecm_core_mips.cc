@@ -13,17 +13,6 @@
 #include "delay_estimator_wrapper.h"
 #include "signal_processing_library.h"
 
-
-static const ALIGN8_BEG int16_t
-        WebRtcAecm_kSqrtHanning[]
-        ALIGN8_END = {
-        0, 399, 798, 1196, 1594, 1990, 2386, 2780, 3172, 3562, 3951,
-        4337, 4720, 5101, 5478, 5853, 6224, 6591, 6954, 7313, 7668, 8019,
-        8364, 8705, 9040, 9370, 9695, 10013, 10326, 10633, 10933, 11227, 11514,
-        11795, 12068, 12335, 12594, 12845, 13089, 13325, 13553, 13773, 13985, 14189,
-        14384, 14571, 14749, 14918, 15079, 15231, 15373, 15506, 15631, 15746, 15851,
-        15947, 16034, 16111, 16179, 16237, 16286, 16325, 16354, 16373, 16384};
-
 static const int16_t kNoiseEstQDomain = 15;
 static const int16_t kNoiseEstIncCount = 5;
 
@@ -937,7 +926,8 @@ int WebRtcAecm_ProcessBlock(AecmCore *aecm,
     uint32_t tmpU32;
     int32_t tmp32no1;
 
-    uint16_t xfa[PART_LEN1];
+    // The far end spectrum is written in place to the far end history.
+    uint16_t *xfa = WebRtcAecm_NextFarHistorySlot(aecm);
     uint16_t dfaNoisy[PART_LEN1];
     uint16_t dfaClean[PART_LEN1];
     uint16_t *ptrDfaClean = dfaClean;
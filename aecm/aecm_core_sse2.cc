@@ -0,0 +1,394 @@
+/*
+ *  Copyright (c) 2012 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <emmintrin.h>
+
+#include <string.h>
+
+#include "aecm_core.h"
+#include "real_fft.h"
+#include "signal_processing_library.h"
+
+// Multiplies signed 16-bit |a| with unsigned 16-bit |b| into two vectors of
+// 32-bit products, i.e., WEBRTC_SPL_MUL_16_U16() for eight lanes. The low
+// halves of the products are equal for signed and unsigned operands, while the
+// unsigned high halves are off by |b| for negative |a|.
+static inline void MulS16U16(__m128i a,
+                             __m128i b,
+                             __m128i *prod_low,
+                             __m128i *prod_high) {
+    const __m128i lo = _mm_mullo_epi16(a, b);
+    const __m128i hi = _mm_sub_epi16(_mm_mulhi_epu16(a, b),
+                                     _mm_and_si128(_mm_srai_epi16(a, 15), b));
+    *prod_low = _mm_unpacklo_epi16(lo, hi);
+    *prod_high = _mm_unpackhi_epi16(lo, hi);
+}
+
+static inline uint32_t AddLanes(__m128i v) {
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t) _mm_cvtsi128_si32(v);
+}
+
+void WebRtcAecm_CalcLinearEnergiesSse2(AecmCore *aecm,
+                                       const uint16_t *far_spectrum,
+                                       int32_t *echo_est,
+                                       uint32_t *far_energy,
+                                       uint32_t *echo_energy_adapt,
+                                       uint32_t *echo_energy_stored) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i far_energy_v = zero;
+    __m128i echo_adapt_v = zero;
+    __m128i echo_stored_v = zero;
+    int i;
+
+    // Get energy for the delayed far end signal and estimated
+    // echo using both stored and adapted channels.
+    // The C code:
+    //  for (i = 0; i < PART_LEN1; i++) {
+    //      echo_est[i] = WEBRTC_SPL_MUL_16_U16(aecm->channelStored[i],
+    //                                         far_spectrum[i]);
+    //      (*far_energy) += (uint32_t)(far_spectrum[i]);
+    //      *echo_energy_adapt += aecm->channelAdapt16[i] * far_spectrum[i];
+    //      (*echo_energy_stored) += (uint32_t)echo_est[i];
+    //  }
+    for (i = 0; i < PART_LEN; i += 8) {
+        const __m128i spectrum_v =
+                _mm_loadu_si128((const __m128i *) &far_spectrum[i]);
+        const __m128i stored_v =
+                _mm_loadu_si128((const __m128i *) &aecm->channelStored[i]);
+        const __m128i adapt_v =
+                _mm_loadu_si128((const __m128i *) &aecm->channelAdapt16[i]);
+        __m128i est_low, est_high, adapt_low, adapt_high;
+
+        far_energy_v = _mm_add_epi32(far_energy_v,
+                                     _mm_unpacklo_epi16(spectrum_v, zero));
+        far_energy_v = _mm_add_epi32(far_energy_v,
+                                     _mm_unpackhi_epi16(spectrum_v, zero));
+
+        MulS16U16(stored_v, spectrum_v, &est_low, &est_high);
+        _mm_storeu_si128((__m128i *) &echo_est[i], est_low);
+        _mm_storeu_si128((__m128i *) &echo_est[i + 4], est_high);
+        echo_stored_v = _mm_add_epi32(echo_stored_v, est_low);
+        echo_stored_v = _mm_add_epi32(echo_stored_v, est_high);
+
+        MulS16U16(adapt_v, spectrum_v, &adapt_low, &adapt_high);
+        echo_adapt_v = _mm_add_epi32(echo_adapt_v, adapt_low);
+        echo_adapt_v = _mm_add_epi32(echo_adapt_v, adapt_high);
+    }
+
+    *far_energy += AddLanes(far_energy_v);
+    *echo_energy_stored += AddLanes(echo_stored_v);
+    *echo_energy_adapt += AddLanes(echo_adapt_v);
+
+    echo_est[PART_LEN] = WEBRTC_SPL_MUL_16_U16(aecm->channelStored[PART_LEN],
+                                               far_spectrum[PART_LEN]);
+    *echo_energy_stored += (uint32_t) echo_est[PART_LEN];
+    *far_energy += (uint32_t) far_spectrum[PART_LEN];
+    *echo_energy_adapt += aecm->channelAdapt16[PART_LEN] * far_spectrum[PART_LEN];
+}
+
+void WebRtcAecm_StoreAdaptiveChannelSse2(AecmCore *aecm,
+                                         const uint16_t *far_spectrum,
+                                         int32_t *echo_est) {
+    int i;
+
+    // The C code of following optimized code.
+    // During startup we store the channel every block.
+    //  memcpy(aecm->channelStored,
+    //         aecm->channelAdapt16,
+    //         sizeof(int16_t) * PART_LEN1);
+    // Recalculate echo estimate
+    //  for (i = 0; i < PART_LEN1; i++) {
+    //    echo_est[i] = WEBRTC_SPL_MUL_16_U16(aecm->channelStored[i],
+    //                                        far_spectrum[i]);
+    //  }
+    for (i = 0; i < PART_LEN; i += 8) {
+        const __m128i spectrum_v =
+                _mm_loadu_si128((const __m128i *) &far_spectrum[i]);
+        const __m128i adapt_v =
+                _mm_loadu_si128((const __m128i *) &aecm->channelAdapt16[i]);
+        __m128i est_low, est_high;
+
+        _mm_storeu_si128((__m128i *) &aecm->channelStored[i], adapt_v);
+
+        MulS16U16(adapt_v, spectrum_v, &est_low, &est_high);
+        _mm_storeu_si128((__m128i *) &echo_est[i], est_low);
+        _mm_storeu_si128((__m128i *) &echo_est[i + 4], est_high);
+    }
+    aecm->channelStored[PART_LEN] = aecm->channelAdapt16[PART_LEN];
+    echo_est[PART_LEN] = WEBRTC_SPL_MUL_16_U16(aecm->channelStored[PART_LEN],
+                                               far_spectrum[PART_LEN]);
+}
+
+void WebRtcAecm_ResetAdaptiveChannelSse2(AecmCore *aecm) {
+    const __m128i zero = _mm_setzero_si128();
+    int i;
+
+    // The C code of following optimized code.
+    // for (i = 0; i < PART_LEN1; i++) {
+    //   aecm->channelAdapt16[i] = aecm->channelStored[i];
+    //   aecm->channelAdapt32[i] = WEBRTC_SPL_LSHIFT_W32(
+    //              (int32_t)aecm->channelStored[i], 16);
+    // }
+    for (i = 0; i < PART_LEN; i += 8) {
+        const __m128i stored_v =
+                _mm_loadu_si128((const __m128i *) &aecm->channelStored[i]);
+
+        _mm_storeu_si128((__m128i *) &aecm->channelAdapt16[i], stored_v);
+
+        // Interleaving with zeros below puts the channel in the upper half of
+        // each 32-bit lane, which is the same as shifting it up by 16.
+        _mm_storeu_si128((__m128i *) &aecm->channelAdapt32[i],
+                         _mm_unpacklo_epi16(zero, stored_v));
+        _mm_storeu_si128((__m128i *) &aecm->channelAdapt32[i + 4],
+                         _mm_unpackhi_epi16(zero, stored_v));
+    }
+    aecm->channelAdapt16[PART_LEN] = aecm->channelStored[PART_LEN];
+    aecm->channelAdapt32[PART_LEN] = (int32_t) aecm->channelStored[PART_LEN] << 16;
+}
+
+// WebRtcSpl_SqrtFloor() of four lanes in [0, 2^31). The single precision root
+// is at most 46340 and within one of the exact root over this range, so one
+// correction step in each direction gives the floor.
+static inline __m128i SqrtFloor(__m128i value) {
+    __m128i root = _mm_cvttps_epi32(_mm_sqrt_ps(_mm_cvtepi32_ps(value)));
+    __m128i square;
+
+    // The roots fit in 16 bits, so their squares are the low and high halves
+    // of the unsigned 16-bit products.
+    square = _mm_or_si128(_mm_mullo_epi16(root, root),
+                          _mm_slli_epi32(_mm_mulhi_epu16(root, root), 16));
+    root = _mm_add_epi32(root, _mm_cmpgt_epi32(square, value));
+    square = _mm_or_si128(_mm_mullo_epi16(root, root),
+                          _mm_slli_epi32(_mm_mulhi_epu16(root, root), 16));
+    return _mm_sub_epi32(root,
+                         _mm_cmpgt_epi32(_mm_sub_epi32(value, square),
+                                         _mm_add_epi32(root, root)));
+}
+
+// real^2 + imag^2 of four bins, saturated as WebRtcSpl_AddSatW32() does. The
+// sum only overflows for two -32768, which gives 0x80000000 and is moved to
+// 0x7FFFFFFF by adding the all ones mask.
+static inline __m128i SquaredMagnitude(__m128i spectrum) {
+    const __m128i sum = _mm_madd_epi16(spectrum, spectrum);
+    const __m128i min = _mm_set1_epi32((int32_t) 0x80000000);
+    return _mm_add_epi32(sum, _mm_cmpeq_epi32(sum, min));
+}
+
+void WebRtcAecm_CalcMagnitudesSse2(const ComplexInt16 *freq_signal,
+                                   uint16_t *freq_signal_abs,
+                                   uint32_t *freq_signal_sum_abs) {
+    const __m128i bias = _mm_set1_epi32(0x8000);
+    __m128i sum_v = _mm_setzero_si128();
+    int i;
+
+    // Unlike the C code there are no special cases for bins with a zero real
+    // or imaginary part, nor for the first and last bins. The square root of
+    // a square is exact, including 32768 for -32768.
+    for (i = 0; i < PART_LEN; i += 8) {
+        const __m128i abs_low = SqrtFloor(SquaredMagnitude(
+                _mm_loadu_si128((const __m128i *) &freq_signal[i])));
+        const __m128i abs_high = SqrtFloor(SquaredMagnitude(
+                _mm_loadu_si128((const __m128i *) &freq_signal[i + 4])));
+
+        sum_v = _mm_add_epi32(sum_v, _mm_add_epi32(abs_low, abs_high));
+        // Bias to the signed range for the saturating pack, and back.
+        _mm_storeu_si128(
+                (__m128i *) &freq_signal_abs[i],
+                _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(abs_low, bias),
+                                              _mm_sub_epi32(abs_high, bias)),
+                              _mm_set1_epi16((int16_t) 0x8000)));
+    }
+    freq_signal_abs[PART_LEN] =
+            (uint16_t) WEBRTC_SPL_ABS_W16(freq_signal[PART_LEN].real);
+    *freq_signal_sum_abs = AddLanes(sum_v) + freq_signal_abs[PART_LEN];
+}
+
+// Reverses the order of the eight 16-bit lanes.
+static inline __m128i Reverse16(__m128i v) {
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// (int16_t) ((a * b) >> 14) for eight lanes, taking bits 14 to 29 of the
+// 32-bit products.
+static inline __m128i MulQ14(__m128i a, __m128i b) {
+    return _mm_or_si128(_mm_srli_epi16(_mm_mullo_epi16(a, b), 14),
+                        _mm_slli_epi16(_mm_mulhi_epi16(a, b), 2));
+}
+
+// Negates the imaginary parts of interleaved complex values. Negating as
+// ~x + 1 wraps -32768 like the C code.
+static inline __m128i Conjugate(__m128i v) {
+    const __m128i imag_mask = _mm_set1_epi32((int32_t) 0xFFFF0000);
+    return _mm_sub_epi16(_mm_xor_si128(v, imag_mask), imag_mask);
+}
+
+// The 32-bit products of eight signed 16-bit lanes.
+static inline void MulS16(__m128i a,
+                          __m128i b,
+                          __m128i *prod_low,
+                          __m128i *prod_high) {
+    const __m128i lo = _mm_mullo_epi16(a, b);
+    const __m128i hi = _mm_mulhi_epi16(a, b);
+    *prod_low = _mm_unpacklo_epi16(lo, hi);
+    *prod_high = _mm_unpackhi_epi16(lo, hi);
+}
+
+// WEBRTC_SPL_SHIFT_W32() of four lanes by the same amount.
+static inline __m128i ShiftW32(__m128i v, int shift) {
+    if (shift >= 0) {
+        return _mm_sll_epi32(v, _mm_cvtsi32_si128(shift));
+    }
+    return _mm_sra_epi32(v, _mm_cvtsi32_si128(-shift));
+}
+
+// Windows the two blocks of |time_signal| with the square root Hanning window
+// into |fft|.
+static void Window(int16_t *fft, const int16_t *time_signal,
+                   int time_signal_scaling) {
+    const __m128i scaling = _mm_cvtsi32_si128(time_signal_scaling);
+    int i;
+
+    // Window time domain signal and insert into real part of transformation
+    // array |fft|. The second half uses the window backwards, i.e.,
+    // WebRtcAecm_kSqrtHanning[PART_LEN - i].
+    for (i = 0; i < PART_LEN; i += 8) {
+        const __m128i first = _mm_sll_epi16(
+                _mm_loadu_si128((const __m128i *) &time_signal[i]), scaling);
+        const __m128i second = _mm_sll_epi16(
+                _mm_loadu_si128((const __m128i *) &time_signal[PART_LEN + i]),
+                scaling);
+        const __m128i window = _mm_loadu_si128(
+                (const __m128i *) &WebRtcAecm_kSqrtHanning[i]);
+        const __m128i window_reversed = Reverse16(_mm_loadu_si128(
+                (const __m128i *) &WebRtcAecm_kSqrtHanning[PART_LEN - 7 - i]));
+
+        _mm_storeu_si128((__m128i *) &fft[i], MulQ14(first, window));
+        _mm_storeu_si128((__m128i *) &fft[PART_LEN + i],
+                         MulQ14(second, window_reversed));
+    }
+}
+
+// Changes the signs of the imaginary parts of the first PART_LEN bins.
+static void ConjugateSpectrum(int16_t *freq) {
+    int i;
+
+    for (i = 0; i < PART_LEN2; i += 8) {
+        _mm_storeu_si128(
+                (__m128i *) &freq[i],
+                Conjugate(_mm_loadu_si128((const __m128i *) &freq[i])));
+    }
+}
+
+void WebRtcAecm_WindowAndFFTSse2(AecmCore *aecm,
+                                 int16_t *fft,
+                                 const int16_t *time_signal,
+                                 ComplexInt16 *freq_signal,
+                                 int time_signal_scaling) {
+    int16_t *freq = (int16_t *) freq_signal;
+
+    Window(fft, time_signal, time_signal_scaling);
+
+    // Do forward FFT, then take only the first PART_LEN complex samples,
+    // and change signs of the imaginary parts.
+    WebRtcSpl_RealForwardFFT(aecm->real_fft, fft, freq);
+    ConjugateSpectrum(freq);
+}
+
+void WebRtcAecm_WindowAndFFTPairSse2(AecmCore *aecm,
+                                     int16_t *fft,
+                                     const int16_t *time_signal_a,
+                                     const int16_t *time_signal_b,
+                                     ComplexInt16 *freq_signal_a,
+                                     ComplexInt16 *freq_signal_b,
+                                     int time_signal_scaling_a,
+                                     int time_signal_scaling_b) {
+    int16_t *freq_a = (int16_t *) freq_signal_a;
+    int16_t *freq_b = (int16_t *) freq_signal_b;
+
+    Window(fft, time_signal_a, time_signal_scaling_a);
+    Window(fft + PART_LEN2, time_signal_b, time_signal_scaling_b);
+
+    WebRtcSpl_RealForwardFFTPair(aecm->real_fft, fft, fft + PART_LEN2, freq_a,
+                                 freq_b);
+    ConjugateSpectrum(freq_a);
+    ConjugateSpectrum(freq_b);
+}
+
+void WebRtcAecm_InverseFFTAndWindowSse2(AecmCore *aecm,
+                                        int16_t *fft,
+                                        ComplexInt16 *efw,
+                                        int16_t *output,
+                                        const int16_t *nearendClean) {
+    const __m128i round = _mm_set1_epi32(1 << 13);
+    const int16_t *efw16 = (const int16_t *) efw;
+    // Reuse |efw| for the inverse FFT output after transferring
+    // the contents to |fft|.
+    int16_t *ifft_out = (int16_t *) efw;
+    int i, out_cfft, shift;
+
+    // Synthesis. The conjugated spectrum has the layout of |fft|.
+    for (i = 0; i < PART_LEN2; i += 8) {
+        _mm_storeu_si128(
+                (__m128i *) &fft[i],
+                Conjugate(_mm_loadu_si128((const __m128i *) &efw16[i])));
+    }
+    fft[PART_LEN2] = efw[PART_LEN].real;
+    fft[PART_LEN2 + 1] = -efw[PART_LEN].imag;
+
+    // Inverse FFT. Keep out_cfft to scale the samples in the next block.
+    out_cfft = WebRtcSpl_RealInverseFFT(aecm->real_fft, fft, ifft_out);
+    shift = out_cfft - aecm->dfaCleanQDomain;
+    for (i = 0; i < PART_LEN; i += 8) {
+        const __m128i window = _mm_loadu_si128(
+                (const __m128i *) &WebRtcAecm_kSqrtHanning[i]);
+        const __m128i window_reversed = Reverse16(_mm_loadu_si128(
+                (const __m128i *) &WebRtcAecm_kSqrtHanning[PART_LEN - 7 - i]));
+        const __m128i out_buf =
+                _mm_loadu_si128((const __m128i *) &aecm->outBuf[i]);
+        __m128i low, high;
+
+        // The rounded and windowed first half is cast to int16_t before it is
+        // shifted, so it goes through a 16-bit lane.
+        MulS16(_mm_loadu_si128((const __m128i *) &ifft_out[i]), window, &low,
+               &high);
+        low = _mm_srai_epi32(_mm_add_epi32(low, round), 14);
+        high = _mm_srai_epi32(_mm_add_epi32(high, round), 14);
+        low = _mm_srai_epi32(_mm_slli_epi32(low, 16), 16);
+        high = _mm_srai_epi32(_mm_slli_epi32(high, 16), 16);
+        low = _mm_add_epi32(ShiftW32(low, shift),
+                            _mm_srai_epi32(_mm_unpacklo_epi16(out_buf, out_buf),
+                                           16));
+        high = _mm_add_epi32(ShiftW32(high, shift),
+                             _mm_srai_epi32(_mm_unpackhi_epi16(out_buf, out_buf),
+                                            16));
+        _mm_storeu_si128((__m128i *) &output[i], _mm_packs_epi32(low, high));
+
+        MulS16(_mm_loadu_si128((const __m128i *) &ifft_out[PART_LEN + i]),
+               window_reversed, &low, &high);
+        low = ShiftW32(_mm_srai_epi32(low, 14), shift);
+        high = ShiftW32(_mm_srai_epi32(high, 14), shift);
+        _mm_storeu_si128((__m128i *) &aecm->outBuf[i],
+                         _mm_packs_epi32(low, high));
+    }
+
+    // Copy the current block to the old position
+    // (aecm->outBuf is shifted elsewhere)
+    memcpy(aecm->xBuf, aecm->xBuf + PART_LEN, sizeof(int16_t) * PART_LEN);
+    memcpy(aecm->dBufNoisy, aecm->dBufNoisy + PART_LEN,
+           sizeof(int16_t) * PART_LEN);
+    if (nearendClean != NULL) {
+        memcpy(aecm->dBufClean, aecm->dBufClean + PART_LEN,
+               sizeof(int16_t) * PART_LEN);
+    }
+}
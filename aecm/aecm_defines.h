@@ -23,7 +23,13 @@
 #define PART_LEN2 (PART_LEN << 1) /* Length of partition * 2. */
 #define PART_LEN4 (PART_LEN << 2) /* Length of partition * 4. */
 #define FAR_BUF_LEN PART_LEN4     /* Length of buffers. */
-#define MAX_DELAY 100
+#ifndef MAX_DELAY
+#define MAX_DELAY 100   /* Delay estimation history, in partitions. */
+#endif
+/* Far end history row length; PART_LEN1 padded to whole 64 byte cache lines. */
+#define FAR_HISTORY_STRIDE ((PART_LEN1 + 31) & ~31)
+/* Shortest MAX_DELAY to use the coarse-to-fine delay search for. */
+#define COARSE_DELAY_SEARCH_MIN 250
 
 /* Counter parameters */
 #define CONV_LEN 512              /* Convergence length used at startup. */
@@ -84,4 +90,12 @@
 #define NLP_COMP_LOW 3277     /* 0.2 in Q14 */
 #define NLP_COMP_HIGH ONE_Q14 /* 1 in Q14 */
 
+/* The per-bin and per-lane kernels of the spectral passes are too large for
+ * the compilers to inline on their own. */
+#if defined(_MSC_VER)
+#define AECM_ALWAYS_INLINE __forceinline
+#else
+#define AECM_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
 #endif
@@ -0,0 +1,423 @@
+/*
+ *  Copyright (c) 2012 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "aecm_scheduler.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+// The largest frame WebRtcAecm_Process() takes, 10 ms at 16 kHz.
+static const size_t kMaxFrameSamples = 160;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+struct AecmScheduler;
+
+struct AecmFrame {
+    int isCapture;
+    size_t nrOfSamples;
+    int16_t nearendNoisy[kMaxFrameSamples];
+    int16_t nearendClean[kMaxFrameSamples];
+    int hasClean;
+    int16_t *out;
+    int16_t msInSndCardBuf;
+    AecmFrameCallback callback;
+    void *userData;
+    Clock::time_point deadline;
+};
+
+// The frames of one AECM instance, in a ring of fixed slots so submitting
+// never allocates. A stream is in at most one worker queue at a time, while
+// |scheduled| is set, which keeps its frames in order.
+struct AecmStream {
+    AecmScheduler *scheduler;
+    void *aecmInst;
+    size_t homeWorker;
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    AecmFrame frames[AECM_MAX_QUEUED_FRAMES];
+    size_t head;
+    size_t count;
+    bool scheduled;
+
+    // The first error of WebRtcAecm_BufferFarend() since the last capture
+    // frame, reported with the next one. Only the worker holding the stream
+    // touches it.
+    int32_t farendError;
+};
+
+// The streams with work of one worker, and the state of the worker while it
+// sleeps on |wake|. |size| mirrors the length of |streams|, and |sleeping|
+// is set while the worker waits, so that the other workers can read both
+// without the lock. |woken| asks a sleeping worker to steal. All is padded by
+// a cache line, so the workers do not share lines of their queues. The queues
+// are allocated with new[], which does not honor more than the default
+// alignment before C++17.
+struct AecmWorkerQueue {
+    std::mutex mutex;
+    std::deque<AecmStream *> streams;
+    std::atomic<size_t> size;
+    std::atomic<bool> sleeping;
+    bool woken;
+    std::condition_variable wake;
+    char padding[64];
+};
+
+struct AecmScheduler {
+    std::vector<std::thread> threads;
+    AecmWorkerQueue *queues;
+    size_t numWorkers;
+    std::atomic<size_t> nextHome;
+    std::atomic<bool> stop;
+};
+
+}  // namespace
+
+// Wakes the sleeping worker nearest to |worker| to steal from its queue.
+static void WakeThief(AecmScheduler *scheduler, size_t worker) {
+    size_t i;
+
+    for (i = 1; i < scheduler->numWorkers; i++) {
+        AecmWorkerQueue *queue =
+                &scheduler->queues[(worker + i) % scheduler->numWorkers];
+        if (queue->sleeping.load()) {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (queue->sleeping.load() && !queue->woken) {
+                queue->woken = true;
+                queue->wake.notify_one();
+                return;
+            }
+        }
+    }
+}
+
+// Appends |stream| to the queue of |worker|, and wakes the worker if it
+// sleeps. Only if the stream lines up behind another one while the worker is
+// busy are the other workers looked at, to wake one that steals from the
+// queue. Otherwise no line but the queue of |worker| is touched.
+static void PushStream(AecmScheduler *scheduler, size_t worker,
+                       AecmStream *stream) {
+    AecmWorkerQueue *queue = &scheduler->queues[worker];
+    bool backlog = false;
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->streams.push_back(stream);
+        queue->size.store(queue->streams.size());
+        if (queue->sleeping.load()) {
+            queue->wake.notify_one();
+        } else {
+            backlog = queue->streams.size() > 1;
+        }
+    }
+    if (backlog) {
+        WakeThief(scheduler, worker);
+    }
+}
+
+// Takes the stream that has waited longest in the queue of |worker|. All
+// capture frames have the same time to their deadline, so this is also the
+// most urgent one.
+static AecmStream *PopStream(AecmScheduler *scheduler, size_t worker) {
+    AecmWorkerQueue *queue = &scheduler->queues[worker];
+    AecmStream *stream = NULL;
+
+    if (queue->size.load() == 0) {
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (!queue->streams.empty()) {
+        stream = queue->streams.front();
+        queue->streams.pop_front();
+        queue->size.store(queue->streams.size());
+    }
+    return stream;
+}
+
+// Runs the oldest frame of |stream|, then puts the stream back at the end of
+// the queue of |worker| if it has more. One frame per turn keeps a stream
+// that has fallen behind from delaying all others.
+static void RunStream(AecmScheduler *scheduler, size_t worker,
+                      AecmStream *stream) {
+    AecmFrame *frame = NULL;
+    int32_t status = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        frame = &stream->frames[stream->head];
+    }
+
+    if (frame->isCapture) {
+        status = WebRtcAecm_Process(
+                stream->aecmInst, frame->nearendNoisy,
+                (frame->hasClean ? frame->nearendClean : NULL), frame->out,
+                frame->nrOfSamples, frame->msInSndCardBuf);
+        if (status == 0) {
+            status = stream->farendError;
+        }
+        stream->farendError = 0;
+        // The stream is still held, so the callbacks stay in order.
+        if (frame->callback) {
+            frame->callback(frame->userData, status,
+                            Clock::now() > frame->deadline);
+        }
+    } else {
+        status = WebRtcAecm_BufferFarend(stream->aecmInst, frame->nearendNoisy,
+                                         frame->nrOfSamples);
+        if (stream->farendError == 0) {
+            stream->farendError = status;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    stream->head = (stream->head + 1) % AECM_MAX_QUEUED_FRAMES;
+    stream->count--;
+    if (stream->count > 0) {
+        PushStream(scheduler, worker, stream);
+    } else {
+        stream->scheduled = false;
+        stream->idle.notify_all();
+    }
+}
+
+static void WorkerLoop(AecmScheduler *scheduler, size_t worker) {
+    for (;;) {
+        AecmStream *stream = PopStream(scheduler, worker);
+        size_t i;
+
+        // Steal from the other workers, the nearest first.
+        for (i = 1; stream == NULL && i < scheduler->numWorkers; i++) {
+            stream = PopStream(scheduler,
+                               (worker + i) % scheduler->numWorkers);
+        }
+        if (stream != NULL) {
+            RunStream(scheduler, worker, stream);
+            continue;
+        }
+
+        AecmWorkerQueue *queue = &scheduler->queues[worker];
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        // Announced before the other queues are looked at, so that a push to
+        // them either is seen here or sees the worker sleeping.
+        queue->sleeping.store(true);
+        for (i = 0; i < scheduler->numWorkers; i++) {
+            if (scheduler->queues[i].size.load() > 0) {
+                break;
+            }
+        }
+        if (i < scheduler->numWorkers) {
+            queue->sleeping.store(false);
+            continue;
+        }
+        if (scheduler->stop.load()) {
+            queue->sleeping.store(false);
+            return;
+        }
+        queue->wake.wait(lock, [scheduler, queue] {
+            return !queue->streams.empty() || queue->woken ||
+                   scheduler->stop.load();
+        });
+        queue->sleeping.store(false);
+        queue->woken = false;
+    }
+}
+
+// Reserves the next free frame slot of |stream|, or returns NULL if all are
+// taken. The slot is handed to the workers with CommitFrame().
+static AecmFrame *ReserveFrame(AecmStream *stream) {
+    if (stream->count == AECM_MAX_QUEUED_FRAMES) {
+        return NULL;
+    }
+    return &stream->frames[(stream->head + stream->count) %
+                           AECM_MAX_QUEUED_FRAMES];
+}
+
+static void CommitFrame(AecmStream *stream) {
+    stream->count++;
+    if (!stream->scheduled) {
+        stream->scheduled = true;
+        PushStream(stream->scheduler, stream->homeWorker, stream);
+    }
+}
+
+void *WebRtcAecm_CreateScheduler(size_t numThreads) {
+    AecmScheduler *scheduler = new(std::nothrow) AecmScheduler();
+    size_t i;
+
+    if (!scheduler) {
+        return NULL;
+    }
+    if (numThreads == 0) {
+        numThreads = std::thread::hardware_concurrency();
+        if (numThreads == 0) {
+            numThreads = 1;
+        }
+    }
+    scheduler->queues = new(std::nothrow) AecmWorkerQueue[numThreads];
+    if (!scheduler->queues) {
+        delete scheduler;
+        return NULL;
+    }
+    for (i = 0; i < numThreads; i++) {
+        scheduler->queues[i].size = 0;
+        scheduler->queues[i].sleeping = false;
+        scheduler->queues[i].woken = false;
+    }
+    scheduler->numWorkers = numThreads;
+    scheduler->nextHome = 0;
+    scheduler->stop = false;
+
+    for (i = 0; i < numThreads; i++) {
+        scheduler->threads.push_back(std::thread(WorkerLoop, scheduler, i));
+    }
+    return scheduler;
+}
+
+void WebRtcAecm_FreeScheduler(void *schedulerInst) {
+    AecmScheduler *scheduler = static_cast<AecmScheduler *>(schedulerInst);
+    size_t i;
+
+    if (scheduler == NULL) {
+        return;
+    }
+
+    scheduler->stop = true;
+    for (i = 0; i < scheduler->numWorkers; i++) {
+        std::lock_guard<std::mutex> lock(scheduler->queues[i].mutex);
+        scheduler->queues[i].wake.notify_one();
+    }
+    for (i = 0; i < scheduler->threads.size(); i++) {
+        scheduler->threads[i].join();
+    }
+    delete[] scheduler->queues;
+    delete scheduler;
+}
+
+void *WebRtcAecm_AttachStream(void *schedulerInst, void *aecmInst) {
+    AecmScheduler *scheduler = static_cast<AecmScheduler *>(schedulerInst);
+    AecmStream *stream = NULL;
+
+    if (scheduler == NULL || aecmInst == NULL) {
+        return NULL;
+    }
+    stream = new(std::nothrow) AecmStream();
+    if (!stream) {
+        return NULL;
+    }
+    stream->scheduler = scheduler;
+    stream->aecmInst = aecmInst;
+    // Spread the streams over the workers, so that stealing is the
+    // exception.
+    stream->homeWorker = scheduler->nextHome.fetch_add(1) %
+                         scheduler->numWorkers;
+    stream->head = 0;
+    stream->count = 0;
+    stream->scheduled = false;
+    stream->farendError = 0;
+    return stream;
+}
+
+void WebRtcAecm_DetachStream(void *streamInst) {
+    AecmStream *stream = static_cast<AecmStream *>(streamInst);
+
+    if (stream == NULL) {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(stream->mutex);
+        stream->idle.wait(lock, [stream] { return !stream->scheduled; });
+    }
+    delete stream;
+}
+
+int32_t WebRtcAecm_SubmitFarend(void *streamInst,
+                                const int16_t *farend,
+                                size_t nrOfSamples) {
+    AecmStream *stream = static_cast<AecmStream *>(streamInst);
+    AecmFrame *frame = NULL;
+
+    if (stream == NULL) {
+        return -1;
+    }
+    if (farend == NULL) {
+        return AECM_NULL_POINTER_ERROR;
+    }
+    if (nrOfSamples != 80 && nrOfSamples != 160) {
+        return AECM_BAD_PARAMETER_ERROR;
+    }
+
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    frame = ReserveFrame(stream);
+    if (frame == NULL) {
+        return AECM_QUEUE_FULL_ERROR;
+    }
+    frame->isCapture = 0;
+    frame->nrOfSamples = nrOfSamples;
+    memcpy(frame->nearendNoisy, farend, sizeof(int16_t) * nrOfSamples);
+    CommitFrame(stream);
+
+    return 0;
+}
+
+int32_t WebRtcAecm_SubmitProcess(void *streamInst,
+                                 const int16_t *nearendNoisy,
+                                 const int16_t *nearendClean,
+                                 int16_t *out,
+                                 size_t nrOfSamples,
+                                 int16_t msInSndCardBuf,
+                                 AecmFrameCallback callback,
+                                 void *userData) {
+    AecmStream *stream = static_cast<AecmStream *>(streamInst);
+    AecmFrame *frame = NULL;
+
+    if (stream == NULL) {
+        return -1;
+    }
+    if (nearendNoisy == NULL || out == NULL) {
+        return AECM_NULL_POINTER_ERROR;
+    }
+    if (nrOfSamples != 80 && nrOfSamples != 160) {
+        return AECM_BAD_PARAMETER_ERROR;
+    }
+
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    frame = ReserveFrame(stream);
+    if (frame == NULL) {
+        return AECM_QUEUE_FULL_ERROR;
+    }
+    frame->isCapture = 1;
+    frame->nrOfSamples = nrOfSamples;
+    memcpy(frame->nearendNoisy, nearendNoisy, sizeof(int16_t) * nrOfSamples);
+    frame->hasClean = (nearendClean != NULL);
+    if (nearendClean) {
+        memcpy(frame->nearendClean, nearendClean,
+               sizeof(int16_t) * nrOfSamples);
+    }
+    frame->out = out;
+    frame->msInSndCardBuf = msInSndCardBuf;
+    frame->callback = callback;
+    frame->userData = userData;
+    frame->deadline = Clock::now() +
+                      std::chrono::milliseconds(AECM_FRAME_DEADLINE_MS);
+    CommitFrame(stream);
+
+    return 0;
+}
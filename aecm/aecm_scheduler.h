@@ -0,0 +1,179 @@
+/*
+ *  Copyright (c) 2012 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+// Runs the frames of many AECM instances on a pool of worker threads. Each
+// instance is attached as a stream, and its render and capture frames are
+// processed in the order they are submitted, by one worker at a time. Every
+// worker has its own queue of streams with work, and idle workers steal from
+// the others, so the load spreads over all threads whichever thread submits.
+// Submitting and taking a stream touch only the queue of one worker. An idle
+// worker sleeps on its own queue, and is woken to steal when a stream lines up
+// behind another in the queue of a busy worker, so a stream may wait for the
+// frame in progress before an idle worker takes it. The scaling has not been
+// measured beyond a few threads.
+
+#ifndef MODULES_AUDIO_PROCESSING_AECM_AECM_SCHEDULER_H_
+#define MODULES_AUDIO_PROCESSING_AECM_AECM_SCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "echo_control_mobile.h"
+
+// Returned when a stream already has AECM_MAX_QUEUED_FRAMES frames waiting.
+#define AECM_QUEUE_FULL_ERROR 12005
+
+// Frames that may wait per stream, i.e., 80 ms of render and capture audio.
+#define AECM_MAX_QUEUED_FRAMES 16
+
+// Time a capture frame has from its submission until it is due.
+#define AECM_FRAME_DEADLINE_MS 10
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Called on a worker thread when a capture frame is processed. The callbacks
+ * of a stream are made in submission order, and never concurrently. The
+ * stream counts as busy until its callback returns, so the callback must not
+ * call WebRtcAecm_DetachStream() or WebRtcAecm_FreeScheduler(), which wait
+ * for that and would deadlock. It may submit frames.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          userData      Pointer given with the frame
+ * int32_t        status        Return value of WebRtcAecm_Process(), or
+ *                              if that is 0, the first error of
+ *                              WebRtcAecm_BufferFarend() on the farend
+ *                              frames since the previous capture frame
+ * int            missedDeadline 1 if the frame was done more than
+ *                              AECM_FRAME_DEADLINE_MS after its
+ *                              submission, otherwise 0
+ */
+typedef void (*AecmFrameCallback)(void *userData,
+                                  int32_t status,
+                                  int missedDeadline);
+
+/*
+ * Starts a scheduler with |numThreads| worker threads.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * size_t         numThreads    Number of worker threads, 0 for one per
+ *                              hardware thread
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * void*          return        Pointer to the scheduler, nullptr at
+ *                              failure
+ */
+void *WebRtcAecm_CreateScheduler(size_t numThreads);
+
+/*
+ * Waits for all submitted frames and stops the worker threads. All streams
+ * must be detached first. Must not be called from an AecmFrameCallback.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          scheduler     Pointer to the scheduler
+ */
+void WebRtcAecm_FreeScheduler(void *scheduler);
+
+/*
+ * Attaches an initialized AECM instance to a scheduler. From then on, the
+ * instance must only be used through the returned stream until it is
+ * detached. The workers process different streams at the same time, so an
+ * instance must not share mutable state with another instance in use. The
+ * instances of a batch share only constant tables, and may be attached while
+ * the batch lives.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          scheduler     Pointer to the scheduler
+ * void*          aecmInst      Pointer to the AECM instance
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * void*          return        Pointer to the stream, nullptr at failure
+ */
+void *WebRtcAecm_AttachStream(void *scheduler, void *aecmInst);
+
+/*
+ * Waits until all frames of a stream are done, and releases the stream. The
+ * AECM instance is not freed. Must not be called from an AecmFrameCallback.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          stream        Pointer to the stream
+ */
+void WebRtcAecm_DetachStream(void *stream);
+
+/*
+ * Queues an 80 or 160 sample block of farend data, see
+ * WebRtcAecm_BufferFarend(). The samples are copied. An error in buffering
+ * them is reported to the callback of the next capture frame.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          stream        Pointer to the stream
+ * int16_t*       farend        In buffer containing one frame of
+ *                              farend signal
+ * size_t         nrOfSamples   Number of samples in farend buffer
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * int32_t        return        0: OK
+ *                              1200-12005: error
+ */
+int32_t WebRtcAecm_SubmitFarend(void *stream,
+                                const int16_t *farend,
+                                size_t nrOfSamples);
+
+/*
+ * Queues an 80 or 160 sample block of nearend data, see
+ * WebRtcAecm_Process(). The samples are copied, and |out| is written before
+ * |callback| is called, so it must stay valid until then.
+ *
+ * Inputs                        Description
+ * -------------------------------------------------------------------
+ * void*          stream         Pointer to the stream
+ * int16_t*       nearendNoisy   In buffer containing one frame of
+ *                               reference nearend+echo signal
+ * int16_t*       nearendClean   In buffer containing one frame of
+ *                               clean nearend+echo signal, or a NULL
+ *                               pointer
+ * size_t         nrOfSamples    Number of samples in nearend buffer
+ * int16_t        msInSndCardBuf Delay estimate for sound card and
+ *                               system buffers
+ * AecmFrameCallback callback    Called when the frame is done, or a
+ *                               NULL pointer
+ * void*          userData       Passed on to |callback|
+ *
+ * Outputs                       Description
+ * -------------------------------------------------------------------
+ * int16_t*       out            Out buffer, one frame of processed nearend
+ * int32_t        return         0: OK
+ *                               1200-12005: error
+ */
+int32_t WebRtcAecm_SubmitProcess(void *stream,
+                                 const int16_t *nearendNoisy,
+                                 const int16_t *nearendClean,
+                                 int16_t *out,
+                                 size_t nrOfSamples,
+                                 int16_t msInSndCardBuf,
+                                 AecmFrameCallback callback,
+                                 void *userData);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MODULES_AUDIO_PROCESSING_AECM_AECM_SCHEDULER_H_
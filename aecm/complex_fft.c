@@ -10,7 +10,8 @@
 
 
 /*
- * This file contains the function WebRtcSpl_ComplexFFT().
+ * This file contains the functions WebRtcSpl_ComplexFFTC(),
+ * WebRtcSpl_ComplexIFFTC() and their versions with tabulated twiddle factors.
  * The description header can be found in signal_processing_library.h
  *
  */
@@ -25,7 +26,7 @@
 #define CIFFTRND 1
 
 
-static const int16_t kSinTable1024[] = {
+const int16_t WebRtcSpl_kSinTable1024[] = {
         0, 201, 402, 603, 804, 1005, 1206, 1406, 1607,
         1808, 2009, 2209, 2410, 2610, 2811, 3011, 3211, 3411,
         3611, 3811, 4011, 4210, 4409, 4608, 4807, 5006, 5205,
@@ -238,7 +239,7 @@ void WebRtcSpl_ComplexBitReverse(int16_t *__restrict complex_data, int stages) {
     }
 }
 
-int WebRtcSpl_ComplexFFT(int16_t frfi[], int stages, int mode) {
+int WebRtcSpl_ComplexFFTC(int16_t frfi[], int stages, int mode) {
     int i, j, l, k, istep, n, m;
     int16_t wr, wi;
     int32_t tr32, ti32, qr32, qi32;
@@ -266,8 +267,8 @@ int WebRtcSpl_ComplexFFT(int16_t frfi[], int stages, int mode) {
                  * kSinTable1024[], and should not be changed depending on the input
                  * parameter 'stages'. It will result in 0 <= j < N_SINE_WAVE/2
                  */
-                wr = kSinTable1024[j + 256];
-                wi = -kSinTable1024[j];
+                wr = WebRtcSpl_kSinTable1024[j + 256];
+                wi = -WebRtcSpl_kSinTable1024[j];
 
                 for (i = m; i < n; i += istep) {
                     j = i + l;
@@ -302,8 +303,8 @@ int WebRtcSpl_ComplexFFT(int16_t frfi[], int stages, int mode) {
                  * kSinTable1024[], and should not be changed depending on the input
                  * parameter 'stages'. It will result in 0 <= j < N_SINE_WAVE/2
                  */
-                wr = kSinTable1024[j + 256];
-                wi = -kSinTable1024[j];
+                wr = WebRtcSpl_kSinTable1024[j + 256];
+                wi = -WebRtcSpl_kSinTable1024[j];
 
 #ifdef WEBRTC_ARCH_ARM_V7
                 int32_t wri = 0;
@@ -358,7 +359,7 @@ int WebRtcSpl_ComplexFFT(int16_t frfi[], int stages, int mode) {
     return 0;
 }
 
-int WebRtcSpl_ComplexIFFT(int16_t frfi[], int stages, int mode) {
+int WebRtcSpl_ComplexIFFTC(int16_t frfi[], int stages, int mode) {
     size_t i, j, l, istep, n, m;
     int k, scale, shift;
     int16_t wr, wi;
@@ -406,8 +407,8 @@ int WebRtcSpl_ComplexIFFT(int16_t frfi[], int stages, int mode) {
                  * kSinTable1024[], and should not be changed depending on the input
                  * parameter 'stages'. It will result in 0 <= j < N_SINE_WAVE/2
                  */
-                wr = kSinTable1024[j + 256];
-                wi = kSinTable1024[j];
+                wr = WebRtcSpl_kSinTable1024[j + 256];
+                wi = WebRtcSpl_kSinTable1024[j];
 
                 for (i = m; i < n; i += istep) {
                     j = i + l;
@@ -434,8 +435,8 @@ int WebRtcSpl_ComplexIFFT(int16_t frfi[], int stages, int mode) {
                  * kSinTable1024[], and should not be changed depending on the input
                  * parameter 'stages'. It will result in 0 <= j < N_SINE_WAVE/2
                  */
-                wr = kSinTable1024[j + 256];
-                wi = kSinTable1024[j];
+                wr = WebRtcSpl_kSinTable1024[j + 256];
+                wi = WebRtcSpl_kSinTable1024[j];
 
 #ifdef WEBRTC_ARCH_ARM_V7
                 int32_t wri = 0;
@@ -489,3 +490,120 @@ int WebRtcSpl_ComplexIFFT(int16_t frfi[], int stages, int mode) {
     }
     return scale;
 }
+
+void WebRtcSpl_ComplexFFTTwiddles(int stages, int inverse,
+                                  int32_t *w_re, int32_t *w_im) {
+    int l, m;
+    int k = 10 - 1;
+
+    for (l = 1; l < (1 << stages); l <<= 1, --k) {
+        for (m = 0; m < l; ++m) {
+            const int j = m << k;
+            const uint16_t wr = (uint16_t) WebRtcSpl_kSinTable1024[j + 256];
+            const uint16_t wi = (uint16_t) (inverse ?
+                    WebRtcSpl_kSinTable1024[j] : -WebRtcSpl_kSinTable1024[j]);
+
+            const uint16_t minus_wi = (uint16_t) -wi;
+
+            w_re[l - 1 + m] = (int32_t) (wr | ((uint32_t) minus_wi << 16));
+            w_im[l - 1 + m] = (int32_t) (wi | ((uint32_t) wr << 16));
+        }
+    }
+}
+
+int WebRtcSpl_ComplexFFTStagesC(int16_t frfi[], int stages,
+                                const int32_t *w_re, const int32_t *w_im) {
+    int i, j, l, istep, n, m;
+    int16_t wr, wi;
+    int32_t tr32, ti32, qr32, qi32;
+
+    n = 1 << stages;
+    for (l = 1; l < n; l = istep) {
+        istep = l << 1;
+
+        for (m = 0; m < l; ++m) {
+            wr = (int16_t) w_re[l - 1 + m];
+            wi = (int16_t) w_im[l - 1 + m];
+
+            for (i = m; i < n; i += istep) {
+                j = i + l;
+
+                tr32 = wr * frfi[2 * j] - wi * frfi[2 * j + 1] + CFFTRND;
+                ti32 = wr * frfi[2 * j + 1] + wi * frfi[2 * j] + CFFTRND;
+                tr32 >>= 15 - CFFTSFT;
+                ti32 >>= 15 - CFFTSFT;
+
+                qr32 = ((int32_t) frfi[2 * i]) * (1 << CFFTSFT);
+                qi32 = ((int32_t) frfi[2 * i + 1]) * (1 << CFFTSFT);
+
+                frfi[2 * j] = (int16_t) (
+                        (qr32 - tr32 + CFFTRND2) >> (1 + CFFTSFT));
+                frfi[2 * j + 1] = (int16_t) (
+                        (qi32 - ti32 + CFFTRND2) >> (1 + CFFTSFT));
+                frfi[2 * i] = (int16_t) (
+                        (qr32 + tr32 + CFFTRND2) >> (1 + CFFTSFT));
+                frfi[2 * i + 1] = (int16_t) (
+                        (qi32 + ti32 + CFFTRND2) >> (1 + CFFTSFT));
+            }
+        }
+    }
+    return 0;
+}
+
+int WebRtcSpl_ComplexIFFTStagesC(int16_t frfi[], int stages,
+                                 const int32_t *w_re, const int32_t *w_im) {
+    size_t i, j, l, istep, n, m;
+    int scale, shift;
+    int16_t wr, wi;
+    int32_t tr32, ti32, qr32, qi32;
+    int32_t tmp32, round2;
+
+    n = ((size_t) 1) << stages;
+    scale = 0;
+    for (l = 1; l < n; l = istep) {
+        // variable scaling, depending upon data
+        shift = 0;
+        round2 = 8192;
+
+        tmp32 = WebRtcSpl_MaxAbsValueW16(frfi, 2 * n);
+        if (tmp32 > 13573) {
+            shift++;
+            scale++;
+            round2 <<= 1;
+        }
+        if (tmp32 > 27146) {
+            shift++;
+            scale++;
+            round2 <<= 1;
+        }
+
+        istep = l << 1;
+
+        for (m = 0; m < l; ++m) {
+            wr = (int16_t) w_re[l - 1 + m];
+            wi = (int16_t) w_im[l - 1 + m];
+
+            for (i = m; i < n; i += istep) {
+                j = i + l;
+
+                tr32 = wr * frfi[2 * j] - wi * frfi[2 * j + 1] + CIFFTRND;
+                ti32 = wr * frfi[2 * j + 1] + wi * frfi[2 * j] + CIFFTRND;
+                tr32 >>= 15 - CIFFTSFT;
+                ti32 >>= 15 - CIFFTSFT;
+
+                qr32 = ((int32_t) frfi[2 * i]) * (1 << CIFFTSFT);
+                qi32 = ((int32_t) frfi[2 * i + 1]) * (1 << CIFFTSFT);
+
+                frfi[2 * j] = (int16_t) (
+                        (qr32 - tr32 + round2) >> (shift + CIFFTSFT));
+                frfi[2 * j + 1] = (int16_t) (
+                        (qi32 - ti32 + round2) >> (shift + CIFFTSFT));
+                frfi[2 * i] = (int16_t) (
+                        (qr32 + tr32 + round2) >> (shift + CIFFTSFT));
+                frfi[2 * i + 1] = (int16_t) (
+                        (qi32 + ti32 + round2) >> (shift + CIFFTSFT));
+            }
+        }
+    }
+    return scale;
+}
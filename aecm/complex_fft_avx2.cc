@@ -0,0 +1,365 @@
+/*
+ *  Copyright (c) 2011 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <immintrin.h>
+
+#include "signal_processing_library.h"
+
+// Every vector holds eight complex values [Re Im] in its 32-bit lanes. The
+// butterflies reproduce the high-accuracy mode of the C version exactly:
+//   t = (w * x + 1) >> 1
+//   out = (int16_t) ((in * 2^14 +/- t + round) >> shift)
+// where _mm256_madd_epi16 computes the complex product w * x in one step.
+
+// Loads the twiddle factors of eight consecutive butterflies of stage |l|,
+// starting at |m|.
+static inline void LoadTwiddles(const int32_t *w_re, const int32_t *w_im,
+                                int l, int m, __m256i *re, __m256i *im) {
+    *re = _mm256_loadu_si256((const __m256i *) &w_re[l - 1 + m]);
+    *im = _mm256_loadu_si256((const __m256i *) &w_im[l - 1 + m]);
+}
+
+// Truncates the 32-bit real and imaginary parts to 16 bits and interleaves
+// them.
+static inline __m256i PackComplex(__m256i re, __m256i im) {
+    return _mm256_blend_epi16(re, _mm256_slli_epi32(im, 16), 0xAA);
+}
+
+// Eight radix-2 butterflies: a' = a + w * b, b' = a - w * b.
+static inline void Butterfly(__m256i *a, __m256i *b, __m256i w_re,
+                             __m256i w_im, __m256i round, __m128i shift) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i tr = _mm256_srai_epi32(
+            _mm256_add_epi32(_mm256_madd_epi16(*b, w_re), one), 1);
+    const __m256i ti = _mm256_srai_epi32(
+            _mm256_add_epi32(_mm256_madd_epi16(*b, w_im), one), 1);
+    // Sign-extended parts of |a| in Q14, with the rounding term added.
+    const __m256i qr = _mm256_add_epi32(
+            _mm256_srai_epi32(_mm256_slli_epi32(*a, 16), 2), round);
+    const __m256i qi = _mm256_add_epi32(
+            _mm256_slli_epi32(_mm256_srai_epi32(*a, 16), 14), round);
+
+    *a = PackComplex(_mm256_sra_epi32(_mm256_add_epi32(qr, tr), shift),
+                     _mm256_sra_epi32(_mm256_add_epi32(qi, ti), shift));
+    *b = PackComplex(_mm256_sra_epi32(_mm256_sub_epi32(qr, tr), shift),
+                     _mm256_sra_epi32(_mm256_sub_epi32(qi, ti), shift));
+}
+
+// Selects the even (or odd) complex values of the pair |a|, |b|, within each
+// 128-bit lane.
+static inline __m256i EvenW32(__m256i a, __m256i b) {
+    return _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a),
+                                                 _mm256_castsi256_ps(b),
+                                                 _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+static inline __m256i OddW32(__m256i a, __m256i b) {
+    return _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a),
+                                                 _mm256_castsi256_ps(b),
+                                                 _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+// Largest absolute value of the 16-bit lanes, with abs(-32768) = 32767 as in
+// WebRtcSpl_MaxAbsValueW16().
+static inline __m256i MaxAbsW16(__m256i max_abs, __m256i v) {
+    const __m256i negated = _mm256_subs_epi16(_mm256_setzero_si256(), v);
+    return _mm256_max_epi16(max_abs, _mm256_max_epi16(v, negated));
+}
+
+static inline int HorizontalMaxW16(__m256i v) {
+    __m128i max_v = _mm_max_epi16(_mm256_castsi256_si128(v),
+                                  _mm256_extracti128_si256(v, 1));
+    max_v = _mm_max_epi16(max_v,
+                          _mm_shuffle_epi32(max_v, _MM_SHUFFLE(1, 0, 3, 2)));
+    max_v = _mm_max_epi16(max_v,
+                          _mm_shuffle_epi32(max_v, _MM_SHUFFLE(2, 3, 0, 1)));
+    max_v = _mm_max_epi16(max_v, _mm_srli_epi32(max_v, 16));
+    return (int16_t) _mm_cvtsi128_si32(max_v);
+}
+
+// The first three forward stages (l = 1, 2 and 4) on sixteen points at a
+// time, kept in registers.
+static inline void ForwardFirstStages(int16_t *frfi, int n,
+                                      const int32_t *w_re,
+                                      const int32_t *w_im, __m256i round,
+                                      __m128i shift) {
+    const __m256i w1_re = _mm256_set1_epi32(w_re[0]);
+    const __m256i w1_im = _mm256_set1_epi32(w_im[0]);
+    const __m256i w2_re = _mm256_setr_epi32(w_re[1], w_re[1], w_re[2], w_re[2],
+                                            w_re[1], w_re[1], w_re[2], w_re[2]);
+    const __m256i w2_im = _mm256_setr_epi32(w_im[1], w_im[1], w_im[2], w_im[2],
+                                            w_im[1], w_im[1], w_im[2], w_im[2]);
+    const __m256i w4_re = _mm256_setr_epi32(w_re[3], w_re[3], w_re[4], w_re[4],
+                                            w_re[5], w_re[5], w_re[6], w_re[6]);
+    const __m256i w4_im = _mm256_setr_epi32(w_im[3], w_im[3], w_im[4], w_im[4],
+                                            w_im[5], w_im[5], w_im[6], w_im[6]);
+    int i;
+
+    for (i = 0; i < n; i += 16) {
+        __m256i *ptr = (__m256i *) &frfi[2 * i];
+        const __m256i v0 = _mm256_loadu_si256(ptr);
+        const __m256i v1 = _mm256_loadu_si256(ptr + 1);
+        // Points (0 2 8 10 4 6 12 14) and (1 3 9 11 5 7 13 15).
+        __m256i a = EvenW32(v0, v1);
+        __m256i b = OddW32(v0, v1);
+        Butterfly(&a, &b, w1_re, w1_im, round, shift);
+        // Points (0 8 1 9 4 12 5 13) and (2 10 3 11 6 14 7 15).
+        __m256i c = EvenW32(a, b);
+        __m256i d = OddW32(a, b);
+        Butterfly(&c, &d, w2_re, w2_im, round, shift);
+        // Points (0 8 1 9 2 10 3 11) and (4 12 5 13 6 14 7 15).
+        __m256i e = _mm256_permute2x128_si256(c, d, 0x20);
+        __m256i f = _mm256_permute2x128_si256(c, d, 0x31);
+        Butterfly(&e, &f, w4_re, w4_im, round, shift);
+        _mm256_storeu_si256(ptr, _mm256_permute4x64_epi64(
+                EvenW32(e, f), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_si256(ptr + 1, _mm256_permute4x64_epi64(
+                OddW32(e, f), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+}
+
+// Two stages, l and 2 * l with l >= 8, fused into one pass: each group of
+// four points i, i + l, i + 2 * l and i + 3 * l stays in registers.
+static inline void Radix4Pass(int16_t *frfi, int n, int l,
+                              const int32_t *w_re, const int32_t *w_im,
+                              __m256i round, __m128i shift) {
+    const int istep = l << 2;
+    int i, m;
+
+    for (m = 0; m < l; m += 8) {
+        __m256i w1_re, w1_im, w2_re, w2_im, w3_re, w3_im;
+        LoadTwiddles(w_re, w_im, l, m, &w1_re, &w1_im);
+        LoadTwiddles(w_re, w_im, 2 * l, m, &w2_re, &w2_im);
+        LoadTwiddles(w_re, w_im, 2 * l, m + l, &w3_re, &w3_im);
+        for (i = m; i < n; i += istep) {
+            __m256i *ptr0 = (__m256i *) &frfi[2 * i];
+            __m256i *ptr1 = (__m256i *) &frfi[2 * (i + l)];
+            __m256i *ptr2 = (__m256i *) &frfi[2 * (i + 2 * l)];
+            __m256i *ptr3 = (__m256i *) &frfi[2 * (i + 3 * l)];
+            __m256i x0 = _mm256_loadu_si256(ptr0);
+            __m256i x1 = _mm256_loadu_si256(ptr1);
+            __m256i x2 = _mm256_loadu_si256(ptr2);
+            __m256i x3 = _mm256_loadu_si256(ptr3);
+            Butterfly(&x0, &x1, w1_re, w1_im, round, shift);
+            Butterfly(&x2, &x3, w1_re, w1_im, round, shift);
+            Butterfly(&x0, &x2, w2_re, w2_im, round, shift);
+            Butterfly(&x1, &x3, w3_re, w3_im, round, shift);
+            _mm256_storeu_si256(ptr0, x0);
+            _mm256_storeu_si256(ptr1, x1);
+            _mm256_storeu_si256(ptr2, x2);
+            _mm256_storeu_si256(ptr3, x3);
+        }
+    }
+}
+
+// One stage l >= 8. Returns the largest absolute value of the output.
+static inline int Radix2Pass(int16_t *frfi, int n, int l,
+                             const int32_t *w_re, const int32_t *w_im,
+                             __m256i round, __m128i shift) {
+    const int istep = l << 1;
+    __m256i max_abs = _mm256_setzero_si256();
+    int i, m;
+
+    for (m = 0; m < l; m += 8) {
+        __m256i w1_re, w1_im;
+        LoadTwiddles(w_re, w_im, l, m, &w1_re, &w1_im);
+        for (i = m; i < n; i += istep) {
+            __m256i *ptr0 = (__m256i *) &frfi[2 * i];
+            __m256i *ptr1 = (__m256i *) &frfi[2 * (i + l)];
+            __m256i x0 = _mm256_loadu_si256(ptr0);
+            __m256i x1 = _mm256_loadu_si256(ptr1);
+            Butterfly(&x0, &x1, w1_re, w1_im, round, shift);
+            _mm256_storeu_si256(ptr0, x0);
+            _mm256_storeu_si256(ptr1, x1);
+            max_abs = MaxAbsW16(max_abs, x0);
+            max_abs = MaxAbsW16(max_abs, x1);
+        }
+    }
+    return HorizontalMaxW16(max_abs);
+}
+
+// The inverse stages l = 1, 2 and 4, one pass each since the scaling of a
+// stage depends on the output of the previous one. Return the largest
+// absolute value of the output.
+static inline int InverseStage1(int16_t *frfi, int n, const int32_t *w_re,
+                                const int32_t *w_im, __m256i round,
+                                __m128i shift) {
+    const __m256i w1_re = _mm256_set1_epi32(w_re[0]);
+    const __m256i w1_im = _mm256_set1_epi32(w_im[0]);
+    __m256i max_abs = _mm256_setzero_si256();
+    int i;
+
+    for (i = 0; i < n; i += 16) {
+        __m256i *ptr = (__m256i *) &frfi[2 * i];
+        const __m256i v0 = _mm256_loadu_si256(ptr);
+        const __m256i v1 = _mm256_loadu_si256(ptr + 1);
+        __m256i a = EvenW32(v0, v1);
+        __m256i b = OddW32(v0, v1);
+        Butterfly(&a, &b, w1_re, w1_im, round, shift);
+        _mm256_storeu_si256(ptr, _mm256_unpacklo_epi32(a, b));
+        _mm256_storeu_si256(ptr + 1, _mm256_unpackhi_epi32(a, b));
+        max_abs = MaxAbsW16(max_abs, a);
+        max_abs = MaxAbsW16(max_abs, b);
+    }
+    return HorizontalMaxW16(max_abs);
+}
+
+static inline int InverseStage2(int16_t *frfi, int n, const int32_t *w_re,
+                                const int32_t *w_im, __m256i round,
+                                __m128i shift) {
+    const __m256i w2_re = _mm256_setr_epi32(w_re[1], w_re[2], w_re[1], w_re[2],
+                                            w_re[1], w_re[2], w_re[1], w_re[2]);
+    const __m256i w2_im = _mm256_setr_epi32(w_im[1], w_im[2], w_im[1], w_im[2],
+                                            w_im[1], w_im[2], w_im[1], w_im[2]);
+    __m256i max_abs = _mm256_setzero_si256();
+    int i;
+
+    for (i = 0; i < n; i += 16) {
+        __m256i *ptr = (__m256i *) &frfi[2 * i];
+        const __m256i v0 = _mm256_loadu_si256(ptr);
+        const __m256i v1 = _mm256_loadu_si256(ptr + 1);
+        // Points (0 1 8 9 4 5 12 13) and (2 3 10 11 6 7 14 15).
+        __m256i a = _mm256_unpacklo_epi64(v0, v1);
+        __m256i b = _mm256_unpackhi_epi64(v0, v1);
+        Butterfly(&a, &b, w2_re, w2_im, round, shift);
+        _mm256_storeu_si256(ptr, _mm256_unpacklo_epi64(a, b));
+        _mm256_storeu_si256(ptr + 1, _mm256_unpackhi_epi64(a, b));
+        max_abs = MaxAbsW16(max_abs, a);
+        max_abs = MaxAbsW16(max_abs, b);
+    }
+    return HorizontalMaxW16(max_abs);
+}
+
+static inline int InverseStage4(int16_t *frfi, int n, const int32_t *w_re,
+                                const int32_t *w_im, __m256i round,
+                                __m128i shift) {
+    const __m256i w4_re = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) &w_re[3]));
+    const __m256i w4_im = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) &w_im[3]));
+    __m256i max_abs = _mm256_setzero_si256();
+    int i;
+
+    for (i = 0; i < n; i += 16) {
+        __m256i *ptr = (__m256i *) &frfi[2 * i];
+        const __m256i v0 = _mm256_loadu_si256(ptr);
+        const __m256i v1 = _mm256_loadu_si256(ptr + 1);
+        // Points (0 1 2 3 8 9 10 11) and (4 5 6 7 12 13 14 15).
+        __m256i a = _mm256_permute2x128_si256(v0, v1, 0x20);
+        __m256i b = _mm256_permute2x128_si256(v0, v1, 0x31);
+        Butterfly(&a, &b, w4_re, w4_im, round, shift);
+        _mm256_storeu_si256(ptr, _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256(ptr + 1, _mm256_permute2x128_si256(a, b, 0x31));
+        max_abs = MaxAbsW16(max_abs, a);
+        max_abs = MaxAbsW16(max_abs, b);
+    }
+    return HorizontalMaxW16(max_abs);
+}
+
+// |kStages| > 0 fixes the number of stages at compile time, so that the
+// passes are unrolled for it; 0 reads it from |stages|.
+template <int kStages>
+static int ForwardStages(int16_t *frfi, int stages, const int32_t *w_re,
+                         const int32_t *w_im) {
+    const __m256i round = _mm256_set1_epi32(16384);
+    const __m128i shift = _mm_cvtsi32_si128(15);
+    const int n = 1 << (kStages > 0 ? kStages : stages);
+    int l;
+
+    ForwardFirstStages(frfi, n, w_re, w_im, round, shift);
+    for (l = 8; l * 4 <= n; l <<= 2) {
+        Radix4Pass(frfi, n, l, w_re, w_im, round, shift);
+    }
+    if (l < n) {
+        Radix2Pass(frfi, n, l, w_re, w_im, round, shift);
+    }
+    return 0;
+}
+
+template <int kStages>
+static int InverseStages(int16_t *frfi, int stages, const int32_t *w_re,
+                         const int32_t *w_im) {
+    const int n = 1 << (kStages > 0 ? kStages : stages);
+    int l, max_abs;
+    int scale = 0;
+
+    max_abs = WebRtcSpl_MaxAbsValueW16(frfi, 2 * n);
+    for (l = 1; l < n; l <<= 1) {
+        // Variable scaling, depending upon data.
+        const int shift = (max_abs > 13573) + (max_abs > 27146);
+        const __m256i round = _mm256_set1_epi32(8192 << shift);
+        const __m128i shift_v = _mm_cvtsi32_si128(shift + 14);
+        scale += shift;
+
+        if (l == 1) {
+            max_abs = InverseStage1(frfi, n, w_re, w_im, round, shift_v);
+        } else if (l == 2) {
+            max_abs = InverseStage2(frfi, n, w_re, w_im, round, shift_v);
+        } else if (l == 4) {
+            max_abs = InverseStage4(frfi, n, w_re, w_im, round, shift_v);
+        } else {
+            max_abs = Radix2Pass(frfi, n, l, w_re, w_im, round, shift_v);
+        }
+    }
+    return scale;
+}
+
+int WebRtcSpl_ComplexFFTStagesAvx2(int16_t frfi[], int stages,
+                                   const int32_t *w_re,
+                                   const int32_t *w_im) {
+    if (stages < 4) {
+        return WebRtcSpl_ComplexFFTStagesC(frfi, stages, w_re, w_im);
+    }
+    if (stages == 6) {
+        return ForwardStages<6>(frfi, stages, w_re, w_im);
+    }
+    if (stages == 7) {
+        return ForwardStages<7>(frfi, stages, w_re, w_im);
+    }
+    return ForwardStages<0>(frfi, stages, w_re, w_im);
+}
+
+int WebRtcSpl_ComplexIFFTStagesAvx2(int16_t frfi[], int stages,
+                                    const int32_t *w_re,
+                                    const int32_t *w_im) {
+    if (stages < 4) {
+        return WebRtcSpl_ComplexIFFTStagesC(frfi, stages, w_re, w_im);
+    }
+    if (stages == 6) {
+        return InverseStages<6>(frfi, stages, w_re, w_im);
+    }
+    return InverseStages<0>(frfi, stages, w_re, w_im);
+}
+
+int WebRtcSpl_ComplexFFTAvx2(int16_t frfi[], int stages, int mode) {
+    int32_t w_re[1023], w_im[1023];
+
+    if (stages > 10) {
+        return -1;
+    }
+    if (mode == 0 || stages < 4) {
+        return WebRtcSpl_ComplexFFTC(frfi, stages, mode);
+    }
+    WebRtcSpl_ComplexFFTTwiddles(stages, 0, w_re, w_im);
+    return WebRtcSpl_ComplexFFTStagesAvx2(frfi, stages, w_re, w_im);
+}
+
+int WebRtcSpl_ComplexIFFTAvx2(int16_t frfi[], int stages, int mode) {
+    int32_t w_re[1023], w_im[1023];
+
+    if (stages > 10) {
+        return -1;
+    }
+    if (mode == 0 || stages < 4) {
+        return WebRtcSpl_ComplexIFFTC(frfi, stages, mode);
+    }
+    WebRtcSpl_ComplexFFTTwiddles(stages, 1, w_re, w_im);
+    return WebRtcSpl_ComplexIFFTStagesAvx2(frfi, stages, w_re, w_im);
+}
@@ -0,0 +1,319 @@
+/*
+ *  Copyright (c) 2011 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <emmintrin.h>
+
+#include "signal_processing_library.h"
+
+// Every vector holds four complex values [Re Im] in its 32-bit lanes. The
+// butterflies reproduce the high-accuracy mode of the C version exactly:
+//   t = (w * x + 1) >> 1
+//   out = (int16_t) ((in * 2^14 +/- t + round) >> shift)
+// where _mm_madd_epi16 computes the complex product w * x in one step.
+
+// Loads the twiddle factors of four consecutive butterflies of stage |l|,
+// starting at |m|.
+static inline void LoadTwiddles(const int32_t *w_re, const int32_t *w_im,
+                                int l, int m, __m128i *re, __m128i *im) {
+    *re = _mm_loadu_si128((const __m128i *) &w_re[l - 1 + m]);
+    *im = _mm_loadu_si128((const __m128i *) &w_im[l - 1 + m]);
+}
+
+// Truncates the 32-bit real and imaginary parts to 16 bits and interleaves
+// them.
+static inline __m128i PackComplex(__m128i re, __m128i im) {
+    const __m128i low_mask = _mm_set1_epi32(0xFFFF);
+    return _mm_or_si128(_mm_and_si128(re, low_mask), _mm_slli_epi32(im, 16));
+}
+
+// Four radix-2 butterflies: a' = a + w * b, b' = a - w * b.
+static inline void Butterfly(__m128i *a, __m128i *b, __m128i w_re,
+                             __m128i w_im, __m128i round, __m128i shift) {
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i tr = _mm_srai_epi32(
+            _mm_add_epi32(_mm_madd_epi16(*b, w_re), one), 1);
+    const __m128i ti = _mm_srai_epi32(
+            _mm_add_epi32(_mm_madd_epi16(*b, w_im), one), 1);
+    // Sign-extended parts of |a| in Q14, with the rounding term added.
+    const __m128i qr = _mm_add_epi32(
+            _mm_srai_epi32(_mm_slli_epi32(*a, 16), 2), round);
+    const __m128i qi = _mm_add_epi32(
+            _mm_slli_epi32(_mm_srai_epi32(*a, 16), 14), round);
+
+    *a = PackComplex(_mm_sra_epi32(_mm_add_epi32(qr, tr), shift),
+                     _mm_sra_epi32(_mm_add_epi32(qi, ti), shift));
+    *b = PackComplex(_mm_sra_epi32(_mm_sub_epi32(qr, tr), shift),
+                     _mm_sra_epi32(_mm_sub_epi32(qi, ti), shift));
+}
+
+// Selects the even (or odd) complex values of the pair |a|, |b|.
+static inline __m128i EvenW32(__m128i a, __m128i b) {
+    return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a),
+                                           _mm_castsi128_ps(b),
+                                           _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+static inline __m128i OddW32(__m128i a, __m128i b) {
+    return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a),
+                                           _mm_castsi128_ps(b),
+                                           _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+// Largest absolute value of the 16-bit lanes, with abs(-32768) = 32767 as in
+// WebRtcSpl_MaxAbsValueW16().
+static inline __m128i MaxAbsW16(__m128i max_abs, __m128i v) {
+    const __m128i negated = _mm_subs_epi16(_mm_setzero_si128(), v);
+    return _mm_max_epi16(max_abs, _mm_max_epi16(v, negated));
+}
+
+static inline int HorizontalMaxW16(__m128i v) {
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_epi16(v, _mm_srli_epi32(v, 16));
+    return (int16_t) _mm_cvtsi128_si32(v);
+}
+
+// The first two forward stages (l = 1 and l = 2) on eight points at a time,
+// kept in registers.
+static inline void ForwardFirstStages(int16_t *frfi, int n,
+                                      const int32_t *w_re,
+                                      const int32_t *w_im, __m128i round,
+                                      __m128i shift) {
+    const __m128i w1_re = _mm_set1_epi32(w_re[0]);
+    const __m128i w1_im = _mm_set1_epi32(w_im[0]);
+    const __m128i w2_re = _mm_setr_epi32(w_re[1], w_re[1], w_re[2], w_re[2]);
+    const __m128i w2_im = _mm_setr_epi32(w_im[1], w_im[1], w_im[2], w_im[2]);
+    int i;
+
+    for (i = 0; i < n; i += 8) {
+        __m128i *ptr = (__m128i *) &frfi[2 * i];
+        const __m128i v0 = _mm_loadu_si128(ptr);
+        const __m128i v1 = _mm_loadu_si128(ptr + 1);
+        // Points (0 2 4 6) and (1 3 5 7).
+        __m128i a = EvenW32(v0, v1);
+        __m128i b = OddW32(v0, v1);
+        Butterfly(&a, &b, w1_re, w1_im, round, shift);
+        // Points (0 4 1 5) and (2 6 3 7).
+        __m128i c = EvenW32(a, b);
+        __m128i d = OddW32(a, b);
+        Butterfly(&c, &d, w2_re, w2_im, round, shift);
+        _mm_storeu_si128(ptr, EvenW32(c, d));
+        _mm_storeu_si128(ptr + 1, OddW32(c, d));
+    }
+}
+
+// Two stages, l and 2 * l with l >= 4, fused into one pass: each group of
+// four points i, i + l, i + 2 * l and i + 3 * l stays in registers.
+static inline void Radix4Pass(int16_t *frfi, int n, int l,
+                              const int32_t *w_re, const int32_t *w_im,
+                              __m128i round, __m128i shift) {
+    const int istep = l << 2;
+    int i, m;
+
+    for (m = 0; m < l; m += 4) {
+        __m128i w1_re, w1_im, w2_re, w2_im, w3_re, w3_im;
+        LoadTwiddles(w_re, w_im, l, m, &w1_re, &w1_im);
+        LoadTwiddles(w_re, w_im, 2 * l, m, &w2_re, &w2_im);
+        LoadTwiddles(w_re, w_im, 2 * l, m + l, &w3_re, &w3_im);
+        for (i = m; i < n; i += istep) {
+            __m128i *ptr0 = (__m128i *) &frfi[2 * i];
+            __m128i *ptr1 = (__m128i *) &frfi[2 * (i + l)];
+            __m128i *ptr2 = (__m128i *) &frfi[2 * (i + 2 * l)];
+            __m128i *ptr3 = (__m128i *) &frfi[2 * (i + 3 * l)];
+            __m128i x0 = _mm_loadu_si128(ptr0);
+            __m128i x1 = _mm_loadu_si128(ptr1);
+            __m128i x2 = _mm_loadu_si128(ptr2);
+            __m128i x3 = _mm_loadu_si128(ptr3);
+            Butterfly(&x0, &x1, w1_re, w1_im, round, shift);
+            Butterfly(&x2, &x3, w1_re, w1_im, round, shift);
+            Butterfly(&x0, &x2, w2_re, w2_im, round, shift);
+            Butterfly(&x1, &x3, w3_re, w3_im, round, shift);
+            _mm_storeu_si128(ptr0, x0);
+            _mm_storeu_si128(ptr1, x1);
+            _mm_storeu_si128(ptr2, x2);
+            _mm_storeu_si128(ptr3, x3);
+        }
+    }
+}
+
+// One stage l >= 4. Returns the largest absolute value of the output.
+static inline int Radix2Pass(int16_t *frfi, int n, int l,
+                             const int32_t *w_re, const int32_t *w_im,
+                             __m128i round, __m128i shift) {
+    const int istep = l << 1;
+    __m128i max_abs = _mm_setzero_si128();
+    int i, m;
+
+    for (m = 0; m < l; m += 4) {
+        __m128i w1_re, w1_im;
+        LoadTwiddles(w_re, w_im, l, m, &w1_re, &w1_im);
+        for (i = m; i < n; i += istep) {
+            __m128i *ptr0 = (__m128i *) &frfi[2 * i];
+            __m128i *ptr1 = (__m128i *) &frfi[2 * (i + l)];
+            __m128i x0 = _mm_loadu_si128(ptr0);
+            __m128i x1 = _mm_loadu_si128(ptr1);
+            Butterfly(&x0, &x1, w1_re, w1_im, round, shift);
+            _mm_storeu_si128(ptr0, x0);
+            _mm_storeu_si128(ptr1, x1);
+            max_abs = MaxAbsW16(max_abs, x0);
+            max_abs = MaxAbsW16(max_abs, x1);
+        }
+    }
+    return HorizontalMaxW16(max_abs);
+}
+
+// The inverse stages l = 1 and l = 2, one pass each since the scaling of a
+// stage depends on the output of the previous one. Return the largest
+// absolute value of the output.
+static inline int InverseStage1(int16_t *frfi, int n, const int32_t *w_re,
+                                const int32_t *w_im, __m128i round,
+                                __m128i shift) {
+    const __m128i w1_re = _mm_set1_epi32(w_re[0]);
+    const __m128i w1_im = _mm_set1_epi32(w_im[0]);
+    __m128i max_abs = _mm_setzero_si128();
+    int i;
+
+    for (i = 0; i < n; i += 8) {
+        __m128i *ptr = (__m128i *) &frfi[2 * i];
+        const __m128i v0 = _mm_loadu_si128(ptr);
+        const __m128i v1 = _mm_loadu_si128(ptr + 1);
+        __m128i a = EvenW32(v0, v1);
+        __m128i b = OddW32(v0, v1);
+        Butterfly(&a, &b, w1_re, w1_im, round, shift);
+        _mm_storeu_si128(ptr, _mm_unpacklo_epi32(a, b));
+        _mm_storeu_si128(ptr + 1, _mm_unpackhi_epi32(a, b));
+        max_abs = MaxAbsW16(max_abs, a);
+        max_abs = MaxAbsW16(max_abs, b);
+    }
+    return HorizontalMaxW16(max_abs);
+}
+
+static inline int InverseStage2(int16_t *frfi, int n, const int32_t *w_re,
+                                const int32_t *w_im, __m128i round,
+                                __m128i shift) {
+    const __m128i w2_re = _mm_setr_epi32(w_re[1], w_re[2], w_re[1], w_re[2]);
+    const __m128i w2_im = _mm_setr_epi32(w_im[1], w_im[2], w_im[1], w_im[2]);
+    __m128i max_abs = _mm_setzero_si128();
+    int i;
+
+    for (i = 0; i < n; i += 8) {
+        __m128i *ptr = (__m128i *) &frfi[2 * i];
+        const __m128i v0 = _mm_loadu_si128(ptr);
+        const __m128i v1 = _mm_loadu_si128(ptr + 1);
+        // Points (0 1 4 5) and (2 3 6 7).
+        __m128i a = _mm_unpacklo_epi64(v0, v1);
+        __m128i b = _mm_unpackhi_epi64(v0, v1);
+        Butterfly(&a, &b, w2_re, w2_im, round, shift);
+        _mm_storeu_si128(ptr, _mm_unpacklo_epi64(a, b));
+        _mm_storeu_si128(ptr + 1, _mm_unpackhi_epi64(a, b));
+        max_abs = MaxAbsW16(max_abs, a);
+        max_abs = MaxAbsW16(max_abs, b);
+    }
+    return HorizontalMaxW16(max_abs);
+}
+
+// |kStages| > 0 fixes the number of stages at compile time, so that the
+// passes are unrolled for it; 0 reads it from |stages|.
+template <int kStages>
+static int ForwardStages(int16_t *frfi, int stages, const int32_t *w_re,
+                         const int32_t *w_im) {
+    const __m128i round = _mm_set1_epi32(16384);
+    const __m128i shift = _mm_cvtsi32_si128(15);
+    const int n = 1 << (kStages > 0 ? kStages : stages);
+    int l;
+
+    ForwardFirstStages(frfi, n, w_re, w_im, round, shift);
+    for (l = 4; l * 4 <= n; l <<= 2) {
+        Radix4Pass(frfi, n, l, w_re, w_im, round, shift);
+    }
+    if (l < n) {
+        Radix2Pass(frfi, n, l, w_re, w_im, round, shift);
+    }
+    return 0;
+}
+
+template <int kStages>
+static int InverseStages(int16_t *frfi, int stages, const int32_t *w_re,
+                         const int32_t *w_im) {
+    const int n = 1 << (kStages > 0 ? kStages : stages);
+    int l, max_abs;
+    int scale = 0;
+
+    max_abs = WebRtcSpl_MaxAbsValueW16(frfi, 2 * n);
+    for (l = 1; l < n; l <<= 1) {
+        // Variable scaling, depending upon data.
+        const int shift = (max_abs > 13573) + (max_abs > 27146);
+        const __m128i round = _mm_set1_epi32(8192 << shift);
+        const __m128i shift_v = _mm_cvtsi32_si128(shift + 14);
+        scale += shift;
+
+        if (l == 1) {
+            max_abs = InverseStage1(frfi, n, w_re, w_im, round, shift_v);
+        } else if (l == 2) {
+            max_abs = InverseStage2(frfi, n, w_re, w_im, round, shift_v);
+        } else {
+            max_abs = Radix2Pass(frfi, n, l, w_re, w_im, round, shift_v);
+        }
+    }
+    return scale;
+}
+
+int WebRtcSpl_ComplexFFTStagesSse2(int16_t frfi[], int stages,
+                                   const int32_t *w_re,
+                                   const int32_t *w_im) {
+    if (stages < 3) {
+        return WebRtcSpl_ComplexFFTStagesC(frfi, stages, w_re, w_im);
+    }
+    if (stages == 6) {
+        return ForwardStages<6>(frfi, stages, w_re, w_im);
+    }
+    if (stages == 7) {
+        return ForwardStages<7>(frfi, stages, w_re, w_im);
+    }
+    return ForwardStages<0>(frfi, stages, w_re, w_im);
+}
+
+int WebRtcSpl_ComplexIFFTStagesSse2(int16_t frfi[], int stages,
+                                    const int32_t *w_re,
+                                    const int32_t *w_im) {
+    if (stages < 3) {
+        return WebRtcSpl_ComplexIFFTStagesC(frfi, stages, w_re, w_im);
+    }
+    if (stages == 6) {
+        return InverseStages<6>(frfi, stages, w_re, w_im);
+    }
+    return InverseStages<0>(frfi, stages, w_re, w_im);
+}
+
+int WebRtcSpl_ComplexFFTSse2(int16_t frfi[], int stages, int mode) {
+    int32_t w_re[1023], w_im[1023];
+
+    if (stages > 10) {
+        return -1;
+    }
+    if (mode == 0 || stages < 3) {
+        return WebRtcSpl_ComplexFFTC(frfi, stages, mode);
+    }
+    WebRtcSpl_ComplexFFTTwiddles(stages, 0, w_re, w_im);
+    return WebRtcSpl_ComplexFFTStagesSse2(frfi, stages, w_re, w_im);
+}
+
+int WebRtcSpl_ComplexIFFTSse2(int16_t frfi[], int stages, int mode) {
+    int32_t w_re[1023], w_im[1023];
+
+    if (stages > 10) {
+        return -1;
+    }
+    if (mode == 0 || stages < 3) {
+        return WebRtcSpl_ComplexIFFTC(frfi, stages, mode);
+    }
+    WebRtcSpl_ComplexFFTTwiddles(stages, 1, w_re, w_im);
+    return WebRtcSpl_ComplexIFFTStagesSse2(frfi, stages, w_re, w_im);
+}
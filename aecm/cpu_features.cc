@@ -0,0 +1,174 @@
+/*
+ *  Copyright (c) 2011 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+// Parts of this file derived from Chromium's base/cpu.cc.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "cpu_features_wrapper.h"
+#include "signal_processing_library.h"
+
+#if defined(WEBRTC_ARCH_X86_FAMILY) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// No CPU feature is available => straight C path.
+static int GetCPUInfoNoASM(CPUFeature feature) {
+    (void) feature;
+    return 0;
+}
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+// xgetbv returns the value of an Intel Extended Control Register (XCR).
+// Currently only XCR0 is defined by Intel so |xcr| should always be zero.
+static uint64_t xgetbv(uint32_t xcr) {
+#if defined(_MSC_VER)
+    return _xgetbv(xcr);
+#else
+    uint32_t eax, edx;
+
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(xcr));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif  // _MSC_VER
+}
+
+#ifndef _MSC_VER
+// Intrinsic for "cpuid".
+#if defined(__pic__) && defined(__i386__)
+static inline void __cpuid(int cpu_info[4], int info_type) {
+    __asm__ volatile(
+            "mov %%ebx, %%edi\n"
+            "cpuid\n"
+            "xchg %%edi, %%ebx\n"
+            : "=a"(cpu_info[0]), "=D"(cpu_info[1]), "=c"(cpu_info[2]),
+              "=d"(cpu_info[3])
+            : "a"(info_type), "c"(0));
+}
+#else
+static inline void __cpuid(int cpu_info[4], int info_type) {
+    __asm__ volatile("cpuid\n"
+                     : "=a"(cpu_info[0]), "=b"(cpu_info[1]), "=c"(cpu_info[2]),
+                       "=d"(cpu_info[3])
+                     : "a"(info_type), "c"(0));
+}
+#endif
+#endif  // _MSC_VER
+#endif  // WEBRTC_ARCH_X86_FAMILY
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+// Probes the CPU for all features in CPUFeature, and returns them as a bit
+// mask indexed by feature.
+static uint32_t ProbeCPUFeatures() {
+    uint32_t features = 0;
+    int cpu_info[4];
+    int cpu_info7[4] = {0, 0, 0, 0};
+    __cpuid(cpu_info, 0);
+    const int num_ids = cpu_info[0];
+    __cpuid(cpu_info, 1);
+    if (num_ids >= 7) {
+#if defined(_MSC_VER)
+        __cpuidex(cpu_info7, 7, 0);
+#else
+        __cpuid(cpu_info7, 7);
+#endif
+    }
+
+    if (cpu_info[3] & 0x04000000) {
+        features |= 1 << kSSE2;
+    }
+    if (cpu_info[2] & 0x00000001) {
+        features |= 1 << kSSE3;
+    }
+    if (cpu_info[2] & 0x00000200) {
+        features |= 1 << kSSSE3;
+    }
+
+    // AVX instructions can be used when
+    //     a) AVX are supported by the CPU,
+    //     b) XSAVE is supported by the CPU,
+    //     c) XSAVE is enabled by the kernel.
+    // See http://software.intel.com/en-us/blogs/2011/04/14/is-avx-enabled
+    const bool avx_support = (cpu_info[2] & 0x10000000) != 0 &&
+                             (cpu_info[2] & 0x04000000) != 0 /* XSAVE */ &&
+                             (cpu_info[2] & 0x08000000) != 0 /* OSXSAVE */;
+    const uint64_t xcr0 = avx_support ? xgetbv(0) : 0;
+    // AVX2 support needs (avx_support && (cpu_info7[1] & 0x00000020) != 0;).
+    if ((xcr0 & 0x00000006) == 6 /* XSAVE enabled by kernel */ &&
+        (cpu_info7[1] & 0x00000020) != 0) {
+        features |= 1 << kAVX2;
+        // AVX-512 additionally needs the opmask and ZMM state enabled by the
+        // kernel. We require the F, DQ, BW and VL subsets.
+        if ((xcr0 & 0x000000E0) == 0xE0 &&
+            (cpu_info7[1] & 0x00010000) != 0 /* AVX512F */ &&
+            (cpu_info7[1] & 0x00020000) != 0 /* AVX512DQ */ &&
+            (cpu_info7[1] & 0x40000000) != 0 /* AVX512BW */ &&
+            (cpu_info7[1] & 0x80000000) != 0 /* AVX512VL */) {
+            features |= 1 << kAVX512;
+        }
+    }
+    return features;
+}
+
+// Actual feature detection for x86.
+static int GetCPUInfo(CPUFeature feature) {
+    // Thread-safe initialization, so CPUID only runs once per process.
+    static const uint32_t features = ProbeCPUFeatures();
+    return (features >> feature) & 1;
+}
+#else
+// Default to straight C for other platforms.
+static int GetCPUInfo(CPUFeature feature) {
+    (void) feature;
+    return 0;
+}
+#endif
+
+WebRtc_CPUInfo WebRtc_GetCPUInfo = GetCPUInfo;
+WebRtc_CPUInfo WebRtc_GetCPUInfoNoASM = GetCPUInfoNoASM;
+
+static std::atomic<int> max_isa_level(kIsaLevelMax);
+static std::atomic<bool> isa_level_latched(false);
+
+static IsaLevel LatchIsaLevel() {
+    int level = kIsaLevelMax;
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+    level = kIsaLevelGeneric;
+    if (GetCPUInfo(kSSE2)) {
+        level = kIsaLevelSSE2;
+        if (GetCPUInfo(kSSSE3)) {
+            level = kIsaLevelSSSE3;
+            if (GetCPUInfo(kAVX2)) {
+                level = kIsaLevelAVX2;
+                if (GetCPUInfo(kAVX512)) {
+                    level = kIsaLevelAVX512;
+                }
+            }
+        }
+    }
+#endif
+    isa_level_latched = true;
+    return static_cast<IsaLevel>(std::min(level, max_isa_level.load()));
+}
+
+IsaLevel WebRtc_GetIsaLevel(void) {
+    static const IsaLevel level = LatchIsaLevel();
+    return level;
+}
+
+int WebRtc_SetMaxIsaLevel(IsaLevel level) {
+    if (isa_level_latched) {
+        return -1;
+    }
+    max_isa_level = level;
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2011 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef SYSTEM_WRAPPERS_INCLUDE_CPU_FEATURES_WRAPPER_H_
+#define SYSTEM_WRAPPERS_INCLUDE_CPU_FEATURES_WRAPPER_H_
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+// List of features in x86.
+typedef enum {
+    kSSE2,
+    kSSE3,
+    kSSSE3,
+    kAVX2,
+    kAVX512
+} CPUFeature;
+
+typedef int (*WebRtc_CPUInfo)(CPUFeature feature);
+
+// Returns true if the CPU supports the feature. The CPU is only probed on the
+// first call.
+extern WebRtc_CPUInfo WebRtc_GetCPUInfo;
+
+// No CPU feature is available => straight C path.
+extern WebRtc_CPUInfo WebRtc_GetCPUInfoNoASM;
+
+// Instruction set levels used to select kernels, in increasing order. Each
+// level implies all levels below it. On ARM and MIPS the kernels are chosen at
+// compile time and the level only tells the generic C code
+// (kIsaLevelGeneric) from the platform kernels (any other level).
+typedef enum {
+    kIsaLevelGeneric = 0,
+    kIsaLevelSSE2,
+    kIsaLevelSSSE3,
+    kIsaLevelAVX2,
+    kIsaLevelAVX512,
+    kIsaLevelMax = kIsaLevelAVX512
+} IsaLevel;
+
+// Returns the instruction set level all kernels are bound to, i.e., the
+// highest level supported by the CPU capped by WebRtc_SetMaxIsaLevel(). The
+// level is latched on the first call and then stays fixed for the lifetime of
+// the process. The call is thread-safe.
+IsaLevel WebRtc_GetIsaLevel(void);
+
+// Caps the instruction set level used by the kernels, e.g., to let benchmarks
+// force the generic or the SSE2 code on a CPU supporting AVX2. Has to be
+// called before the first AECM instance is created, since the level is latched
+// on first use.
+//
+// Return value:
+//      - 0   : OK.
+//      - -1  : The level is already latched.
+int WebRtc_SetMaxIsaLevel(IsaLevel level);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}  // extern "C"
+#endif
+
+#endif  // SYSTEM_WRAPPERS_INCLUDE_CPU_FEATURES_WRAPPER_H_
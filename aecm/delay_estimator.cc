@@ -10,34 +10,75 @@
 
 #include "delay_estimator.h"
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <algorithm>
 
+#include "cpu_features_wrapper.h"
 #include "signal_processing_library.h"
 
 
-// Number of right shifts for scaling is linearly depending on number of bits in
-// the far-end binary spectrum.
-static const int kShiftsAtZero = 13;  // Right shifts at zero binary spectrum.
-static const int kShiftsLinearSlope = 3;
-
 static const int32_t kProbabilityOffset = 1024;      // 2 in Q9.
 static const int32_t kProbabilityLowerLimit = 8704;  // 17 in Q9.
 static const int32_t kProbabilityMinSpread = 2816;   // 5.5 in Q9.
 
 // Robust validation settings
-static const float kHistogramMax = 3000.f;
-static const float kLastHistogramMax = 250.f;
-static const float kMinHistogramThreshold = 1.5f;
+// The |histogram| is in Q14.
+static const int32_t kHistogramMax = 3000 << 14;
+static const int32_t kLastHistogramMax = 250 << 14;
+static const int32_t kMinHistogramThreshold = 3 << 13;  // 1.5 in Q14.
 static const int kMinRequiredHits = 10;
 static const int kMaxHitsWhenPossiblyNonCausal = 10;
 static const int kMaxHitsWhenPossiblyCausal = 1000;
-static const float kQ14Scaling = 1.f / (1 << 14);  // Scaling by 2^14 to get Q0.
-static const float kFractionSlope = 0.05f;
-static const float kMinFractionWhenPossiblyCausal = 0.5f;
-static const float kMinFractionWhenPossiblyNonCausal = 0.25f;
+// Above this |histogram_offset| it is folded into the |histogram|, leaving
+// room for kHistogramMax and one more update in an int32_t.
+static const int32_t kMaxHistogramOffset = 1 << 30;
+static const int32_t kFractionSlopeQ14 = 819;                  // 0.05 in Q14.
+static const int32_t kMinFractionWhenPossiblyCausalQ14 = 8192;  // 0.5 in Q14.
+static const int32_t kMinFractionWhenPossiblyNonCausalQ14 = 4096;  // 0.25.
+
+// Coarse-to-fine search settings
+static const int kMinCoarseHistorySize = 8;
+static const int kMaxCoarseFactor = 127;
+
+// Hint-guided search settings
+static const float kHintMinQuality = 0.55f;
+static const int kHintWidenBlocks = 25;
+static const int kHintNarrowBlocks = 500;
+static const int kHintSweepParts = 8;
+
+// Rounds the size of each part of an estimator placed in caller memory up to
+// 32 bytes, so every array starts aligned.
+static size_t AlignedBytes(size_t bytes) {
+    return (bytes + 31) & ~(size_t) 31;
+}
+
+// Returns the next |bytes| of caller memory, and advances |memory|.
+static void *TakeMemory(char **memory, size_t bytes) {
+    void *part = *memory;
+    *memory += AlignedBytes(bytes);
+    return part;
+}
+
+// The group size of the coarse-to-fine search of a history.
+static int CoarseFactor(int history_size) {
+    return std::min((int) (sqrtf((float) history_size / 2) + 0.5f),
+                    kMaxCoarseFactor);
+}
+
+// The most groups the coarse-to-fine search has at any history size up to
+// |history_size|, which caller memory has to hold.
+static int MaxCoarseGroups(int history_size) {
+    int max_groups = 0;
+    int size = 0;
+    for (size = kMinCoarseHistorySize; size <= history_size; ++size) {
+        const int factor = CoarseFactor(size);
+        max_groups = std::max(max_groups, (size + factor - 1) / factor);
+    }
+    return max_groups;
+}
 
 
 // Counts and returns number of bits of a 32-bit word.
@@ -51,23 +92,10 @@ static int BitCount(uint32_t u32) {
     return ((int) tmp);
 }
 
-// Compares the |binary_vector| with all rows of the |binary_matrix| and counts
-// per row the number of times they have the same value.
-//
-// Inputs:
-//      - binary_vector     : binary "vector" stored in a long
-//      - binary_matrix     : binary "matrix" stored as a vector of long
-//      - matrix_size       : size of binary "matrix"
-//
-// Output:
-//      - bit_counts        : "Vector" stored as a long, containing for each
-//                            row the number of times the matrix row and the
-//                            input vector have the same value
-//
-static void BitCountComparison(uint32_t binary_vector,
-                               const uint32_t *binary_matrix,
-                               int matrix_size,
-                               int32_t *bit_counts) {
+void WebRtc_BitCountComparisonC(uint32_t binary_vector,
+                                const uint32_t *binary_matrix,
+                                int matrix_size,
+                                int32_t *bit_counts) {
     int n = 0;
 
     // Compare |binary_vector| with all rows of the |binary_matrix|
@@ -76,6 +104,81 @@ static void BitCountComparison(uint32_t binary_vector,
     }
 }
 
+void WebRtc_UpdateMeanBitCountsC(const int32_t *bit_counts,
+                                 const int *far_bit_counts,
+                                 int size,
+                                 int first_delay,
+                                 int32_t *mean_bit_counts,
+                                 int32_t *value_best_candidate,
+                                 int *candidate_delay,
+                                 int32_t *value_worst_candidate) {
+    int i = 0;
+
+    for (i = 0; i < size; i++) {
+        // |bit_counts| is constrained to [0, 32], meaning we can smooth with a
+        // factor up to 2^26. We use Q9.
+        int32_t bit_count = (bit_counts[i] << 9);  // Q9.
+
+        // Update |mean_bit_counts| only when far-end signal has something to
+        // contribute. If |far_bit_counts| is zero the far-end signal is weak and
+        // we likely have a poor echo condition, hence don't update.
+        if (far_bit_counts[i] > 0) {
+            // Make number of right shifts piecewise linear w.r.t. |far_bit_counts|.
+            int shifts = kShiftsAtZero;
+            shifts -= (kShiftsLinearSlope * far_bit_counts[i]) >> 4;
+            WebRtc_MeanEstimatorFix(bit_count, shifts, &(mean_bit_counts[i]));
+        }
+
+        if (mean_bit_counts[i] < *value_best_candidate) {
+            *value_best_candidate = mean_bit_counts[i];
+            *candidate_delay = first_delay + i;
+        }
+        if (mean_bit_counts[i] > *value_worst_candidate) {
+            *value_worst_candidate = mean_bit_counts[i];
+        }
+    }
+}
+
+BitCountComparison WebRtc_BitCountComparison = WebRtc_BitCountComparisonC;
+UpdateMeanBitCounts WebRtc_UpdateMeanBitCounts = WebRtc_UpdateMeanBitCountsC;
+
+// Binds the kernels to the instruction set level returned by
+// WebRtc_GetIsaLevel().
+static bool InitFunctionPointers(void) {
+    const IsaLevel level = WebRtc_GetIsaLevel();
+
+    WebRtc_BitCountComparison = WebRtc_BitCountComparisonC;
+    WebRtc_UpdateMeanBitCounts = WebRtc_UpdateMeanBitCountsC;
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+    if (level >= kIsaLevelSSE2) {
+        WebRtc_BitCountComparison = WebRtc_BitCountComparisonSse2;
+        WebRtc_UpdateMeanBitCounts = WebRtc_UpdateMeanBitCountsSse2;
+    }
+    if (level >= kIsaLevelAVX2) {
+        WebRtc_BitCountComparison = WebRtc_BitCountComparisonAvx2;
+        WebRtc_UpdateMeanBitCounts = WebRtc_UpdateMeanBitCountsAvx2;
+    }
+#else
+    (void) level;
+#endif
+    return true;
+}
+
+// Returns the |histogram| value of |delay|. The bins not touched in a block are
+// all decreased by the same amount, which is accumulated in |histogram_offset|
+// instead, and a bin stays at zero once it reaches it.
+static int32_t HistogramValue(const BinaryDelayEstimator *self, int delay) {
+    const int32_t value = self->histogram[delay] - self->histogram_offset;
+    return (value > 0 ? value : 0);
+}
+
+// Sets the |histogram| value of |delay|, see HistogramValue().
+static void SetHistogramValue(BinaryDelayEstimator *self,
+                              int delay,
+                              int32_t value) {
+    self->histogram[delay] = value + self->histogram_offset;
+}
+
 // Collects necessary statistics for the HistogramBasedValidation().  This
 // function has to be called prior to calling HistogramBasedValidation().  The
 // statistics updated and used by the HistogramBasedValidation() are:
@@ -84,7 +187,9 @@ static void BitCountComparison(uint32_t binary_vector,
 //  2. the |histogram| of candidate delays over time.  This histogram is
 //     weighted with respect to a reliability measure and time-varying to cope
 //     with possible delay shifts.
-// For further description see commented code.
+// For further description see commented code. Only the at most eight bins
+// around |candidate_delay| and |last_delay| are visited, so the cost does not
+// depend on the history size.
 //
 // Inputs:
 //  - candidate_delay   : The delay to validate.
@@ -97,12 +202,14 @@ static void UpdateRobustValidationStatistics(BinaryDelayEstimator *self,
                                              int candidate_delay,
                                              int32_t valley_depth_q14,
                                              int32_t valley_level_q14) {
-    const float valley_depth = valley_depth_q14 * kQ14Scaling;
-    float decrease_in_last_set = valley_depth;
+    int32_t decrease_in_last_set = valley_depth_q14;
     const int max_hits_for_slow_change = (candidate_delay < self->last_delay)
                                          ? kMaxHitsWhenPossiblyNonCausal
                                          : kMaxHitsWhenPossiblyCausal;
+    int32_t values[8];
+    int first[2] = {candidate_delay - 2, self->last_delay - 2};
     int i = 0;
+    int j = 0;
 
     RTC_DCHECK_EQ(self->history_size, self->farend->history_size);
     // Reset |candidate_hits| if we have a new candidate.
@@ -117,10 +224,6 @@ static void UpdateRobustValidationStatistics(BinaryDelayEstimator *self,
     //    |valley_depth|, which is a simple measure of how reliable the
     //    |candidate_delay| is.  The histogram is not increased above
     //    |kHistogramMax|.
-    self->histogram[candidate_delay] += valley_depth;
-    if (self->histogram[candidate_delay] > kHistogramMax) {
-        self->histogram[candidate_delay] = kHistogramMax;
-    }
     // 2. The histogram bins in the neighborhood of |candidate_delay| are
     //    unaffected.  The neighborhood is defined as x + {-2, -1, 0, 1}.
     // 3. The histogram bins in the neighborhood of |last_delay| are decreased
@@ -132,25 +235,54 @@ static void UpdateRobustValidationStatistics(BinaryDelayEstimator *self,
     //    these histogram bins more rapidly with |valley_depth|.
     if (self->candidate_hits < max_hits_for_slow_change) {
         decrease_in_last_set =
-                (self->mean_bit_counts[self->compare_delay] - valley_level_q14) *
-                kQ14Scaling;
+                self->mean_bit_counts[self->compare_delay] - valley_level_q14;
+    }
+    // Read the bins of both neighborhoods before any is changed.
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < 4; ++i) {
+            const int delay = first[j] + i;
+            if ((delay >= 0) && (delay < self->history_size)) {
+                values[4 * j + i] = HistogramValue(self, delay);
+            }
+        }
     }
     // 4. All other bins are decreased with |valley_depth|.
-    // TODO(bjornv): Investigate how to make this loop more efficient.  Split up
-    // the loop?  Remove parts that doesn't add too much.
-    for (i = 0; i < self->history_size; ++i) {
-        int is_in_last_set = (i >= self->last_delay - 2) &&
-                             (i <= self->last_delay + 1) && (i != candidate_delay);
-        int is_in_candidate_set =
-                (i >= candidate_delay - 2) && (i <= candidate_delay + 1);
-        self->histogram[i] -=
-                decrease_in_last_set * is_in_last_set +
-                valley_depth * (!is_in_last_set && !is_in_candidate_set);
-        // 5. No histogram bin can go below 0.
-        if (self->histogram[i] < 0) {
-            self->histogram[i] = 0;
+    // 5. No histogram bin can go below 0.
+    self->histogram_offset += valley_depth_q14;
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < 4; ++i) {
+            const int delay = first[j] + i;
+            int32_t value = values[4 * j + i];
+            const int is_in_last_set = (delay >= self->last_delay - 2) &&
+                                       (delay <= self->last_delay + 1) &&
+                                       (delay != candidate_delay);
+            if ((delay < 0) || (delay >= self->history_size)) {
+                continue;
+            }
+            if (delay == candidate_delay) {
+                value += valley_depth_q14;
+                if (value > kHistogramMax) {
+                    value = kHistogramMax;
+                }
+            } else if (is_in_last_set) {
+                // |decrease_in_last_set| may be negative when |compare_delay|
+                // was not searched this block.
+                value -= decrease_in_last_set;
+                if (value < 0) {
+                    value = 0;
+                } else if (value > kHistogramMax) {
+                    value = kHistogramMax;
+                }
+            }
+            SetHistogramValue(self, delay, value);
         }
     }
+    if (self->histogram_offset > kMaxHistogramOffset) {
+        for (i = 0; i < self->history_size; ++i) {
+            self->histogram[i] = HistogramValue(self, i);
+        }
+        self->histogram_offset = 0;
+    }
 }
 
 // Validates the |candidate_delay|, estimated in WebRtc_ProcessBinarySpectrum(),
@@ -177,8 +309,8 @@ static void UpdateRobustValidationStatistics(BinaryDelayEstimator *self,
 //                          0 - Otherwise.
 static int HistogramBasedValidation(const BinaryDelayEstimator *self,
                                     int candidate_delay) {
-    float fraction = 1.f;
-    float histogram_threshold = self->histogram[self->compare_delay];
+    int32_t fraction = 1 << 14;  // 1 in Q14.
+    int32_t histogram_threshold = HistogramValue(self, self->compare_delay);
     const int delay_difference = candidate_delay - self->last_delay;
     int is_histogram_valid = 0;
 
@@ -201,22 +333,24 @@ static int HistogramBasedValidation(const BinaryDelayEstimator *self,
     // TODO(bjornv): How much can we gain by turning the fraction calculation
     // into tables?
     if (delay_difference > self->allowed_offset) {
-        fraction = 1.f - kFractionSlope * (delay_difference - self->allowed_offset);
-        fraction = (fraction > kMinFractionWhenPossiblyCausal
+        fraction = (1 << 14) -
+                   kFractionSlopeQ14 * (delay_difference - self->allowed_offset);
+        fraction = (fraction > kMinFractionWhenPossiblyCausalQ14
                     ? fraction
-                    : kMinFractionWhenPossiblyCausal);
+                    : kMinFractionWhenPossiblyCausalQ14);
     } else if (delay_difference < 0) {
-        fraction =
-                kMinFractionWhenPossiblyNonCausal - kFractionSlope * delay_difference;
-        fraction = (fraction > 1.f ? 1.f : fraction);
+        fraction = kMinFractionWhenPossiblyNonCausalQ14 -
+                   kFractionSlopeQ14 * delay_difference;
+        fraction = (fraction > (1 << 14) ? (1 << 14) : fraction);
     }
-    histogram_threshold *= fraction;
+    histogram_threshold =
+            (int32_t) (((int64_t) histogram_threshold * fraction) >> 14);
     histogram_threshold =
             (histogram_threshold > kMinHistogramThreshold ? histogram_threshold
                                                           : kMinHistogramThreshold);
 
     is_histogram_valid =
-            (self->histogram[candidate_delay] >= histogram_threshold) &&
+            (HistogramValue(self, candidate_delay) >= histogram_threshold) &&
             (self->candidate_hits > kMinRequiredHits);
 
     return is_histogram_valid;
@@ -260,7 +394,8 @@ static int RobustValidation(const BinaryDelayEstimator *self,
     //      the instantaneous one if |is_histogram_valid| = 1 and the histogram
     //      is significantly strong.
     is_robust |= is_histogram_valid &&
-                 (self->histogram[candidate_delay] > self->last_delay_histogram);
+                 (HistogramValue(self, candidate_delay) >
+                  self->last_delay_histogram);
 
     return is_robust;
 }
@@ -276,12 +411,19 @@ void WebRtc_FreeBinaryDelayEstimatorFarend(BinaryDelayEstimatorFarend *self) {
     free(self->far_bit_counts);
     self->far_bit_counts = NULL;
 
+    free(self->far_coarse_history);
+    self->far_coarse_history = NULL;
+
     free(self);
 }
 
 BinaryDelayEstimatorFarend *WebRtc_CreateBinaryDelayEstimatorFarend(
         int history_size) {
     BinaryDelayEstimatorFarend *self = NULL;
+    // The kernels are selected once per process and the initialization of the
+    // local static is thread-safe.
+    static const bool kernels_initialized = InitFunctionPointers();
+    (void) kernels_initialized;
 
     if (history_size > 1) {
         // Sanity conditions fulfilled.
@@ -293,8 +435,13 @@ BinaryDelayEstimatorFarend *WebRtc_CreateBinaryDelayEstimatorFarend(
     }
 
     self->history_size = 0;
+    self->fixed_history_size = 0;
+    self->head = 0;
+    self->active_count = 0;
     self->binary_far_history = NULL;
     self->far_bit_counts = NULL;
+    self->far_coarse_history = NULL;
+    self->coarse_factor = 0;
     if (WebRtc_AllocateFarendBufferMemory(self, history_size) == 0) {
         WebRtc_FreeBinaryDelayEstimatorFarend(self);
         self = NULL;
@@ -302,16 +449,81 @@ BinaryDelayEstimatorFarend *WebRtc_CreateBinaryDelayEstimatorFarend(
     return self;
 }
 
+size_t WebRtc_BinaryDelayEstimatorFarendRequiredMemory(int history_size) {
+    if (history_size <= 1) {
+        return 0;
+    }
+    return AlignedBytes(sizeof(BinaryDelayEstimatorFarend)) +
+           2 * AlignedBytes(history_size * sizeof(uint32_t)) +
+           AlignedBytes(history_size * sizeof(int));
+}
+
+BinaryDelayEstimatorFarend *WebRtc_CreateBinaryDelayEstimatorFarendInPlace(
+        void *memory,
+        int history_size) {
+    BinaryDelayEstimatorFarend *self = NULL;
+    char *next = static_cast<char *>(memory);
+    static const bool kernels_initialized = InitFunctionPointers();
+    (void) kernels_initialized;
+
+    if (memory == NULL || history_size <= 1) {
+        return NULL;
+    }
+
+    self = static_cast<BinaryDelayEstimatorFarend *>(
+            TakeMemory(&next, sizeof(BinaryDelayEstimatorFarend)));
+    self->binary_far_history = static_cast<uint32_t *>(
+            TakeMemory(&next, history_size * sizeof(uint32_t)));
+    self->far_bit_counts =
+            static_cast<int *>(TakeMemory(&next, history_size * sizeof(int)));
+    self->far_coarse_history = static_cast<uint32_t *>(
+            TakeMemory(&next, history_size * sizeof(uint32_t)));
+    self->history_size = 0;
+    self->fixed_history_size = history_size;
+    self->head = 0;
+    self->active_count = 0;
+    self->coarse_factor = 0;
+    WebRtc_AllocateFarendBufferMemory(self, history_size);
+    return self;
+}
+
 int WebRtc_AllocateFarendBufferMemory(BinaryDelayEstimatorFarend *self,
                                       int history_size) {
+    int i = 0;
+
     RTC_DCHECK(self);
+    if (self->fixed_history_size > 0 &&
+        history_size > self->fixed_history_size) {
+        // The buffers are in caller memory and cannot grow.
+        return 0;
+    }
+    // Put the newest entry first, so the delays keep their entries whether
+    // the buffers grow or shrink.
+    if (self->head > 0) {
+        std::rotate(self->binary_far_history,
+                    self->binary_far_history + self->head,
+                    self->binary_far_history + self->history_size);
+        std::rotate(self->far_bit_counts, self->far_bit_counts + self->head,
+                    self->far_bit_counts + self->history_size);
+        std::rotate(self->far_coarse_history,
+                    self->far_coarse_history + self->head,
+                    self->far_coarse_history + self->history_size);
+        self->head = 0;
+    }
     // (Re-)Allocate memory for history buffers.
-    self->binary_far_history = static_cast<uint32_t *>(
-            realloc(self->binary_far_history,
-                    history_size * sizeof(*self->binary_far_history)));
-    self->far_bit_counts = static_cast<int *>(realloc(
-            self->far_bit_counts, history_size * sizeof(*self->far_bit_counts)));
-    if ((self->binary_far_history == NULL) || (self->far_bit_counts == NULL)) {
+    if (self->fixed_history_size == 0) {
+        self->binary_far_history = static_cast<uint32_t *>(
+                realloc(self->binary_far_history,
+                        history_size * sizeof(*self->binary_far_history)));
+        self->far_bit_counts = static_cast<int *>(
+                realloc(self->far_bit_counts,
+                        history_size * sizeof(*self->far_bit_counts)));
+        self->far_coarse_history = static_cast<uint32_t *>(
+                realloc(self->far_coarse_history,
+                        history_size * sizeof(*self->far_coarse_history)));
+    }
+    if ((self->binary_far_history == NULL) || (self->far_bit_counts == NULL) ||
+        (self->far_coarse_history == NULL)) {
         history_size = 0;
     }
     // Fill with zeros if we have expanded the buffers.
@@ -321,64 +533,155 @@ int WebRtc_AllocateFarendBufferMemory(BinaryDelayEstimatorFarend *self,
                sizeof(*self->binary_far_history) * size_diff);
         memset(&self->far_bit_counts[self->history_size], 0,
                sizeof(*self->far_bit_counts) * size_diff);
+        memset(&self->far_coarse_history[self->history_size], 0,
+               sizeof(*self->far_coarse_history) * size_diff);
     }
     self->history_size = history_size;
 
+    self->active_count = 0;
+    for (i = 0; i < self->history_size; ++i) {
+        self->active_count += (self->far_bit_counts[i] > 0);
+    }
+
     return self->history_size;
 }
 
+// Spreads the bits of |binary_spectrum| over the bytes of four 64-bit words,
+// bit i to byte i, and adds (|sign| = 1) or removes (|sign| = -1) them to the
+// per bit counts of the coarse window. Then returns the bitwise majority of the
+// window.
+static uint32_t UpdateCoarseWindow(BinaryDelayEstimatorFarend *self,
+                                   uint32_t binary_spectrum, int sign) {
+    const uint64_t kOnes = 0x0101010101010101ULL;
+    // Adding |threshold| sets bit 7 of the bytes with 2 * count > factor.
+    const uint64_t threshold =
+            kOnes * (uint64_t) (0x7F - (self->coarse_factor >> 1));
+    uint32_t majority = 0;
+    int i = 0;
+
+    for (i = 0; i < 4; ++i) {
+        uint64_t bits = ((binary_spectrum >> (8 * i)) & 0xFF) * kOnes;
+        uint64_t set = 0;
+        bits = (((bits & 0x8040201008040201ULL) + kOnes * 0x7F) >> 7) & kOnes;
+        self->coarse_counts[i] += (sign > 0 ? bits : 0 - bits);
+        // Gather bit 7 of each byte into the lowest byte.
+        set = ((self->coarse_counts[i] + threshold) >> 7) & kOnes;
+        set |= set >> 7;
+        set |= set >> 14;
+        set |= set >> 28;
+        majority |= (uint32_t) (set & 0xFF) << (8 * i);
+    }
+    return majority;
+}
+
+// Rebuilds |far_coarse_history| after the history has changed other than by
+// WebRtc_AddBinaryFarSpectrum(), sliding the window from the oldest entry.
+static void UpdateFarCoarseHistory(BinaryDelayEstimatorFarend *self) {
+    int delay = 0;
+
+    if (self->coarse_factor == 0) {
+        return;
+    }
+    memset(self->coarse_counts, 0, sizeof(self->coarse_counts));
+    for (delay = self->history_size - 1; delay >= 0; --delay) {
+        const int index = (self->head + delay) % self->history_size;
+        if (delay + self->coarse_factor < self->history_size) {
+            UpdateCoarseWindow(self,
+                               self->binary_far_history[
+                                       (index + self->coarse_factor) %
+                                       self->history_size], -1);
+        }
+        self->far_coarse_history[index] =
+                UpdateCoarseWindow(self, self->binary_far_history[index], 1);
+    }
+}
+
 void WebRtc_InitBinaryDelayEstimatorFarend(BinaryDelayEstimatorFarend *self) {
     RTC_DCHECK(self);
     memset(self->binary_far_history, 0, sizeof(uint32_t) * self->history_size);
     memset(self->far_bit_counts, 0, sizeof(int) * self->history_size);
+    memset(self->far_coarse_history, 0, sizeof(uint32_t) * self->history_size);
+    memset(self->coarse_counts, 0, sizeof(self->coarse_counts));
+    self->head = 0;
+    self->active_count = 0;
 }
 
 void WebRtc_SoftResetBinaryDelayEstimatorFarend(
         BinaryDelayEstimatorFarend *self,
         int delay_shift) {
     int abs_shift = abs(delay_shift);
-    int shift_size = 0;
-    int dest_index = 0;
-    int src_index = 0;
-    int padding_index = 0;
+    int padding_delay = 0;
+    int i = 0;
 
     RTC_DCHECK(self);
-    shift_size = self->history_size - abs_shift;
-    RTC_DCHECK_GT(shift_size, 0);
+    RTC_DCHECK_GT(self->history_size - abs_shift, 0);
     if (delay_shift == 0) {
         return;
-    } else if (delay_shift > 0) {
-        dest_index = abs_shift;
     } else if (delay_shift < 0) {
-        src_index = abs_shift;
-        padding_index = shift_size;
+        padding_delay = self->history_size - abs_shift;
     }
 
-    // Shift and zero pad buffers.
-    memmove(&self->binary_far_history[dest_index],
-            &self->binary_far_history[src_index],
-            sizeof(*self->binary_far_history) * shift_size);
-    memset(&self->binary_far_history[padding_index], 0,
-           sizeof(*self->binary_far_history) * abs_shift);
-    memmove(&self->far_bit_counts[dest_index], &self->far_bit_counts[src_index],
-            sizeof(*self->far_bit_counts) * shift_size);
-    memset(&self->far_bit_counts[padding_index], 0,
-           sizeof(*self->far_bit_counts) * abs_shift);
+    // Shifting the history is a move of the ring head. The |abs_shift| entries
+    // that wrap around are zero padded.
+    self->head = (self->head - delay_shift + self->history_size) %
+                 self->history_size;
+    for (i = 0; i < abs_shift; ++i) {
+        const int index = (self->head + padding_delay + i) % self->history_size;
+        self->active_count -= (self->far_bit_counts[index] > 0);
+        self->binary_far_history[index] = 0;
+        self->far_bit_counts[index] = 0;
+    }
+    UpdateFarCoarseHistory(self);
+}
+
+int WebRtc_CopyBinaryDelayEstimatorFarend(
+        BinaryDelayEstimatorFarend *self,
+        const BinaryDelayEstimatorFarend *src) {
+    BinaryDelayEstimatorFarend buffers;
+
+    RTC_DCHECK(self);
+    RTC_DCHECK(src);
+    if (self->history_size != src->history_size &&
+        WebRtc_AllocateFarendBufferMemory(self, src->history_size) !=
+                src->history_size) {
+        return -1;
+    }
+    // Take all of |src| but the buffers of |self|.
+    buffers = *self;
+    *self = *src;
+    self->far_bit_counts = buffers.far_bit_counts;
+    self->binary_far_history = buffers.binary_far_history;
+    self->fixed_history_size = buffers.fixed_history_size;
+    self->far_coarse_history = buffers.far_coarse_history;
+    memcpy(self->far_bit_counts, src->far_bit_counts,
+           sizeof(*src->far_bit_counts) * src->history_size);
+    memcpy(self->binary_far_history, src->binary_far_history,
+           sizeof(*src->binary_far_history) * src->history_size);
+    memcpy(self->far_coarse_history, src->far_coarse_history,
+           sizeof(*src->far_coarse_history) * src->history_size);
+    return 0;
 }
 
 void WebRtc_AddBinaryFarSpectrum(BinaryDelayEstimatorFarend *handle,
                                  uint32_t binary_far_spectrum) {
     RTC_DCHECK(handle);
-    // Shift binary spectrum history and insert current |binary_far_spectrum|.
-    memmove(&(handle->binary_far_history[1]), &(handle->binary_far_history[0]),
-            (handle->history_size - 1) * sizeof(uint32_t));
-    handle->binary_far_history[0] = binary_far_spectrum;
-
-    // Shift history of far-end binary spectrum bit counts and insert bit count
-    // of current |binary_far_spectrum|.
-    memmove(&(handle->far_bit_counts[1]), &(handle->far_bit_counts[0]),
-            (handle->history_size - 1) * sizeof(int));
-    handle->far_bit_counts[0] = BitCount(binary_far_spectrum);
+    // Move the ring head back one entry, dropping the oldest spectrum, and
+    // insert current |binary_far_spectrum| and its bit count there.
+    handle->head = (handle->head == 0 ? handle->history_size : handle->head) - 1;
+    handle->active_count -= (handle->far_bit_counts[handle->head] > 0);
+    handle->binary_far_history[handle->head] = binary_far_spectrum;
+    handle->far_bit_counts[handle->head] = BitCount(binary_far_spectrum);
+    handle->active_count += (handle->far_bit_counts[handle->head] > 0);
+    if (handle->coarse_factor > 0) {
+        // Slide the coarse window; the entry leaving it is now at delay
+        // |coarse_factor|.
+        UpdateCoarseWindow(handle,
+                           handle->binary_far_history[
+                                   (handle->head + handle->coarse_factor) %
+                                   handle->history_size], -1);
+        handle->far_coarse_history[handle->head] = UpdateCoarseWindow(
+                handle, binary_far_spectrum, 1);
+    }
 }
 
 void WebRtc_FreeBinaryDelayEstimator(BinaryDelayEstimator *self) {
@@ -398,6 +701,15 @@ void WebRtc_FreeBinaryDelayEstimator(BinaryDelayEstimator *self) {
     free(self->histogram);
     self->histogram = NULL;
 
+    free(self->coarse_mean_bit_counts);
+    self->coarse_mean_bit_counts = NULL;
+
+    free(self->coarse_far_history);
+    self->coarse_far_history = NULL;
+
+    free(self->coarse_far_bit_counts);
+    self->coarse_far_bit_counts = NULL;
+
     // BinaryDelayEstimator does not have ownership of |farend|, hence we do not
     // free the memory here. That should be handled separately by the user.
     self->farend = NULL;
@@ -405,6 +717,36 @@ void WebRtc_FreeBinaryDelayEstimator(BinaryDelayEstimator *self) {
     free(self);
 }
 
+// Sets the fields of a new estimator to their defaults. The buffers are
+// left to the caller.
+static void SetDefaults(BinaryDelayEstimator *self,
+                        BinaryDelayEstimatorFarend *farend,
+                        int max_lookahead) {
+    self->farend = farend;
+    self->near_history_size = max_lookahead + 1;
+    self->near_head = 0;
+    self->history_size = 0;
+    self->fixed_history_size = 0;
+    self->fixed_coarse_groups = 0;
+    self->robust_validation_enabled = 0;  // Disabled by default.
+    self->allowed_offset = 0;
+    self->coarse_search_enabled = 0;  // Disabled by default.
+    self->coarse_factor = 0;
+    self->coarse_mean_bit_counts = NULL;
+    self->coarse_far_history = NULL;
+    self->coarse_far_bit_counts = NULL;
+    self->fine_windows = 0;
+    self->hint_window = 0;  // Disabled by default.
+    self->hint_width = 0;
+
+    self->lookahead = max_lookahead;
+
+    self->mean_bit_counts = NULL;
+    self->bit_counts = NULL;
+    self->histogram = NULL;
+    self->binary_near_history = NULL;
+}
+
 BinaryDelayEstimator *WebRtc_CreateBinaryDelayEstimator(
         BinaryDelayEstimatorFarend *farend,
         int max_lookahead) {
@@ -418,19 +760,9 @@ BinaryDelayEstimator *WebRtc_CreateBinaryDelayEstimator(
     if (self == NULL) {
         return NULL;
     }
-
-    self->farend = farend;
-    self->near_history_size = max_lookahead + 1;
-    self->history_size = 0;
-    self->robust_validation_enabled = 0;  // Disabled by default.
-    self->allowed_offset = 0;
-
-    self->lookahead = max_lookahead;
+    SetDefaults(self, farend, max_lookahead);
 
     // Allocate memory for spectrum and history buffers.
-    self->mean_bit_counts = NULL;
-    self->bit_counts = NULL;
-    self->histogram = NULL;
     self->binary_near_history = static_cast<uint32_t *>(
             malloc((max_lookahead + 1) * sizeof(*self->binary_near_history)));
     if (self->binary_near_history == NULL ||
@@ -442,9 +774,119 @@ BinaryDelayEstimator *WebRtc_CreateBinaryDelayEstimator(
     return self;
 }
 
+size_t WebRtc_BinaryDelayEstimatorRequiredMemory(int history_size,
+                                                 int max_lookahead) {
+    const int num_groups = MaxCoarseGroups(history_size);
+
+    if (history_size <= 1 || max_lookahead < 0) {
+        return 0;
+    }
+    // |mean_bit_counts| and |histogram| have the extra dummy element.
+    return AlignedBytes(sizeof(BinaryDelayEstimator)) +
+           AlignedBytes((max_lookahead + 1) * sizeof(uint32_t)) +
+           2 * AlignedBytes((history_size + 1) * sizeof(int32_t)) +
+           AlignedBytes(history_size * sizeof(int32_t)) +
+           2 * AlignedBytes(num_groups * sizeof(int32_t)) +
+           AlignedBytes(num_groups * sizeof(int));
+}
+
+BinaryDelayEstimator *WebRtc_CreateBinaryDelayEstimatorInPlace(
+        void *memory,
+        BinaryDelayEstimatorFarend *farend,
+        int max_lookahead) {
+    BinaryDelayEstimator *self = NULL;
+    char *next = static_cast<char *>(memory);
+    int history_size = 0;
+    int num_groups = 0;
+
+    if ((memory == NULL) || (farend == NULL) || (max_lookahead < 0)) {
+        return NULL;
+    }
+    history_size = farend->history_size;
+    num_groups = MaxCoarseGroups(history_size);
+
+    self = static_cast<BinaryDelayEstimator *>(
+            TakeMemory(&next, sizeof(BinaryDelayEstimator)));
+    SetDefaults(self, farend, max_lookahead);
+    self->binary_near_history = static_cast<uint32_t *>(
+            TakeMemory(&next, (max_lookahead + 1) * sizeof(uint32_t)));
+    self->mean_bit_counts = static_cast<int32_t *>(
+            TakeMemory(&next, (history_size + 1) * sizeof(int32_t)));
+    self->histogram = static_cast<int32_t *>(
+            TakeMemory(&next, (history_size + 1) * sizeof(int32_t)));
+    self->bit_counts = static_cast<int32_t *>(
+            TakeMemory(&next, history_size * sizeof(int32_t)));
+    if (num_groups > 0) {
+        self->coarse_mean_bit_counts = static_cast<int32_t *>(
+                TakeMemory(&next, num_groups * sizeof(int32_t)));
+        self->coarse_far_history = static_cast<uint32_t *>(
+                TakeMemory(&next, num_groups * sizeof(uint32_t)));
+        self->coarse_far_bit_counts =
+                static_cast<int *>(TakeMemory(&next, num_groups * sizeof(int)));
+    }
+    self->fixed_history_size = history_size;
+    self->fixed_coarse_groups = num_groups;
+    if (WebRtc_AllocateHistoryBufferMemory(self, history_size) == 0) {
+        return NULL;
+    }
+
+    return self;
+}
+
+// Sets up the coarse-to-fine search for the current history size, or turns
+// it off if it is disabled or the history is too short to gain from it.
+// Returns 0 on success and -1 if out of memory.
+static int ConfigureCoarseSearch(BinaryDelayEstimator *self) {
+    BinaryDelayEstimatorFarend *far = self->farend;
+    int num_groups = 0;
+    int i = 0;
+
+    self->coarse_factor = 0;
+    self->fine_windows = 0;
+    far->coarse_factor = 0;
+    if (!self->coarse_search_enabled ||
+        (self->history_size < kMinCoarseHistorySize)) {
+        return 0;
+    }
+    // The far-end window counts are bytes, see UpdateCoarseWindow().
+    self->coarse_factor = CoarseFactor(self->history_size);
+    num_groups = (self->history_size + self->coarse_factor - 1) /
+                 self->coarse_factor;
+    if (self->fixed_history_size == 0) {
+        self->coarse_mean_bit_counts = static_cast<int32_t *>(
+                realloc(self->coarse_mean_bit_counts,
+                        num_groups * sizeof(*self->coarse_mean_bit_counts)));
+        self->coarse_far_history = static_cast<uint32_t *>(
+                realloc(self->coarse_far_history,
+                        num_groups * sizeof(*self->coarse_far_history)));
+        self->coarse_far_bit_counts = static_cast<int *>(
+                realloc(self->coarse_far_bit_counts,
+                        num_groups * sizeof(*self->coarse_far_bit_counts)));
+    }
+    if ((num_groups > self->fixed_coarse_groups &&
+         self->fixed_history_size > 0) ||
+        (self->coarse_mean_bit_counts == NULL) ||
+        (self->coarse_far_history == NULL) ||
+        (self->coarse_far_bit_counts == NULL)) {
+        self->coarse_factor = 0;
+        return -1;
+    }
+    for (i = 0; i < num_groups; ++i) {
+        self->coarse_mean_bit_counts[i] = (20 << 9);  // 20 in Q9.
+    }
+    far->coarse_factor = self->coarse_factor;
+    UpdateFarCoarseHistory(far);
+    return 0;
+}
+
 int WebRtc_AllocateHistoryBufferMemory(BinaryDelayEstimator *self,
                                        int history_size) {
     BinaryDelayEstimatorFarend *far = self->farend;
+    if (self->fixed_history_size > 0 &&
+        history_size > self->fixed_history_size) {
+        // The buffers are in caller memory and cannot grow.
+        return 0;
+    }
     // (Re-)Allocate memory for spectrum and history buffers.
     if (history_size != far->history_size) {
         // Only update far-end buffers if we need.
@@ -453,13 +895,16 @@ int WebRtc_AllocateHistoryBufferMemory(BinaryDelayEstimator *self,
     // The extra array element in |mean_bit_counts| and |histogram| is a dummy
     // element only used while |last_delay| == -2, i.e., before we have a valid
     // estimate.
-    self->mean_bit_counts = static_cast<int32_t *>(
-            realloc(self->mean_bit_counts,
-                    (history_size + 1) * sizeof(*self->mean_bit_counts)));
-    self->bit_counts = static_cast<int32_t *>(
-            realloc(self->bit_counts, history_size * sizeof(*self->bit_counts)));
-    self->histogram = static_cast<float *>(
-            realloc(self->histogram, (history_size + 1) * sizeof(*self->histogram)));
+    if (self->fixed_history_size == 0) {
+        self->mean_bit_counts = static_cast<int32_t *>(
+                realloc(self->mean_bit_counts,
+                        (history_size + 1) * sizeof(*self->mean_bit_counts)));
+        self->bit_counts = static_cast<int32_t *>(realloc(
+                self->bit_counts, history_size * sizeof(*self->bit_counts)));
+        self->histogram = static_cast<int32_t *>(
+                realloc(self->histogram,
+                        (history_size + 1) * sizeof(*self->histogram)));
+    }
 
     if ((self->mean_bit_counts == NULL) || (self->bit_counts == NULL) ||
         (self->histogram == NULL)) {
@@ -472,10 +917,14 @@ int WebRtc_AllocateHistoryBufferMemory(BinaryDelayEstimator *self,
                sizeof(*self->mean_bit_counts) * size_diff);
         memset(&self->bit_counts[self->history_size], 0,
                sizeof(*self->bit_counts) * size_diff);
+        // Including the dummy element.
         memset(&self->histogram[self->history_size], 0,
-               sizeof(*self->histogram) * size_diff);
+               sizeof(*self->histogram) * (size_diff + 1));
     }
     self->history_size = history_size;
+    if (ConfigureCoarseSearch(self) != 0) {
+        self->history_size = 0;
+    }
 
     return self->history_size;
 }
@@ -487,10 +936,24 @@ void WebRtc_InitBinaryDelayEstimator(BinaryDelayEstimator *self) {
     memset(self->bit_counts, 0, sizeof(int32_t) * self->history_size);
     memset(self->binary_near_history, 0,
            sizeof(uint32_t) * self->near_history_size);
+    self->near_head = 0;
     for (i = 0; i <= self->history_size; ++i) {
         self->mean_bit_counts[i] = (20 << 9);  // 20 in Q9.
-        self->histogram[i] = 0.f;
+        self->histogram[i] = 0;
+    }
+    if (self->coarse_factor > 0) {
+        const int num_groups = (self->history_size + self->coarse_factor - 1) /
+                               self->coarse_factor;
+        for (i = 0; i < num_groups; ++i) {
+            self->coarse_mean_bit_counts[i] = (20 << 9);  // 20 in Q9.
+        }
     }
+    self->fine_windows = 0;
+    self->hint_sweep = 0;
+    self->delay_hint = -1;
+    self->hint_width = self->hint_window;
+    self->hint_misses = 0;
+    self->hint_hits = 0;
     self->minimum_probability = kMaxBitCountsQ9;          // 32 in Q9.
     self->last_delay_probability = (int) kMaxBitCountsQ9;  // 32 in Q9.
 
@@ -500,7 +963,8 @@ void WebRtc_InitBinaryDelayEstimator(BinaryDelayEstimator *self) {
     self->last_candidate_delay = -2;
     self->compare_delay = self->history_size;
     self->candidate_hits = 0;
-    self->last_delay_histogram = 0.f;
+    self->last_delay_histogram = 0;
+    self->histogram_offset = 0;
 }
 
 int WebRtc_SoftResetBinaryDelayEstimator(BinaryDelayEstimator *self,
@@ -518,9 +982,340 @@ int WebRtc_SoftResetBinaryDelayEstimator(BinaryDelayEstimator *self,
     return lookahead - self->lookahead;
 }
 
+int WebRtc_CopyBinaryDelayEstimator(BinaryDelayEstimator *self,
+                                    const BinaryDelayEstimator *src) {
+    BinaryDelayEstimator buffers;
+    int num_groups = 0;
+
+    RTC_DCHECK(self);
+    RTC_DCHECK(src);
+    if (self->near_history_size != src->near_history_size) {
+        return -1;
+    }
+    if (self->history_size != src->history_size ||
+        self->coarse_factor != src->coarse_factor) {
+        self->coarse_search_enabled = src->coarse_search_enabled;
+        if (WebRtc_AllocateHistoryBufferMemory(self, src->history_size) !=
+            src->history_size) {
+            return -1;
+        }
+    }
+    // Take all of |src| but the buffers of |self|.
+    buffers = *self;
+    *self = *src;
+    self->mean_bit_counts = buffers.mean_bit_counts;
+    self->bit_counts = buffers.bit_counts;
+    self->binary_near_history = buffers.binary_near_history;
+    self->fixed_history_size = buffers.fixed_history_size;
+    self->fixed_coarse_groups = buffers.fixed_coarse_groups;
+    self->histogram = buffers.histogram;
+    self->coarse_mean_bit_counts = buffers.coarse_mean_bit_counts;
+    self->coarse_far_history = buffers.coarse_far_history;
+    self->coarse_far_bit_counts = buffers.coarse_far_bit_counts;
+    self->farend = buffers.farend;
+
+    // Including the dummy elements.
+    memcpy(self->mean_bit_counts, src->mean_bit_counts,
+           sizeof(*src->mean_bit_counts) * (src->history_size + 1));
+    memcpy(self->histogram, src->histogram,
+           sizeof(*src->histogram) * (src->history_size + 1));
+    memcpy(self->bit_counts, src->bit_counts,
+           sizeof(*src->bit_counts) * src->history_size);
+    memcpy(self->binary_near_history, src->binary_near_history,
+           sizeof(*src->binary_near_history) * src->near_history_size);
+    if (src->coarse_factor > 0) {
+        num_groups = (src->history_size + src->coarse_factor - 1) /
+                     src->coarse_factor;
+        memcpy(self->coarse_mean_bit_counts, src->coarse_mean_bit_counts,
+               sizeof(*src->coarse_mean_bit_counts) * num_groups);
+        memcpy(self->coarse_far_history, src->coarse_far_history,
+               sizeof(*src->coarse_far_history) * num_groups);
+        memcpy(self->coarse_far_bit_counts, src->coarse_far_bit_counts,
+               sizeof(*src->coarse_far_bit_counts) * num_groups);
+    }
+    return 0;
+}
+
+// Compares |binary_near_spectrum| with the far-end spectra of the delays
+// [start, end), updates their |mean_bit_counts| and their best and worst
+// candidates. The delays are walked as the two contiguous segments they have
+// in the far-end history rings.
+static void SearchDelays(BinaryDelayEstimator *self,
+                         uint32_t binary_near_spectrum,
+                         int start,
+                         int end,
+                         int32_t *value_best_candidate,
+                         int *candidate_delay,
+                         int32_t *value_worst_candidate) {
+    const BinaryDelayEstimatorFarend *far = self->farend;
+    const int index = (far->head + start) % far->history_size;
+    const int first_size = std::min(end - start, far->history_size - index);
+    const int second_start = start + first_size;
+
+    WebRtc_BitCountComparison(binary_near_spectrum,
+                              &far->binary_far_history[index], first_size,
+                              &self->bit_counts[start]);
+    WebRtc_UpdateMeanBitCounts(&self->bit_counts[start],
+                               &far->far_bit_counts[index], first_size, start,
+                               &self->mean_bit_counts[start],
+                               value_best_candidate, candidate_delay,
+                               value_worst_candidate);
+    if (end > second_start) {
+        WebRtc_BitCountComparison(binary_near_spectrum,
+                                  far->binary_far_history, end - second_start,
+                                  &self->bit_counts[second_start]);
+        WebRtc_UpdateMeanBitCounts(&self->bit_counts[second_start],
+                                   far->far_bit_counts, end - second_start,
+                                   second_start,
+                                   &self->mean_bit_counts[second_start],
+                                   value_best_candidate, candidate_delay,
+                                   value_worst_candidate);
+    }
+}
+
+// Returns 1 if |delay| was searched at full resolution in the previous block.
+static int InFineWindows(const BinaryDelayEstimator *self, int delay) {
+    int i = 0;
+
+    for (i = 0; i < self->fine_windows; ++i) {
+        if ((delay >= self->fine_start[i]) && (delay < self->fine_end[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Runs SearchDelays() in the first |num_windows| (one or two) of the windows
+// [start, end) of delays, clamped to the history and merged if they overlap,
+// and stores them. Unless |seed_level| is negative, delays that have not been
+// searched in the previous block start from |seed_level|, the level of the
+// delays that are not a match.
+static void SearchWindows(BinaryDelayEstimator *self,
+                          uint32_t binary_near_spectrum,
+                          int *start,
+                          int *end,
+                          int num_windows,
+                          int32_t seed_level,
+                          int32_t *value_best_candidate,
+                          int *candidate_delay,
+                          int32_t *value_worst_candidate) {
+    int i = 0;
+    int delay = 0;
+
+    if (num_windows == 2) {
+        if (start[1] < start[0]) {
+            std::swap(start[0], start[1]);
+            std::swap(end[0], end[1]);
+        }
+        if (start[1] <= end[0]) {
+            end[0] = std::max(end[0], end[1]);
+            num_windows = 1;
+        }
+    }
+    for (i = 0; i < num_windows; ++i) {
+        start[i] = std::max(start[i], 0);
+        end[i] = std::min(end[i], self->history_size);
+        for (delay = start[i]; (seed_level >= 0) && (delay < end[i]); ++delay) {
+            if (!InFineWindows(self, delay)) {
+                self->mean_bit_counts[delay] = seed_level;
+            }
+        }
+    }
+    self->fine_windows = num_windows;
+    for (i = 0; i < num_windows; ++i) {
+        self->fine_start[i] = start[i];
+        self->fine_end[i] = end[i];
+        SearchDelays(self, binary_near_spectrum, start[i], end[i],
+                     value_best_candidate, candidate_delay,
+                     value_worst_candidate);
+    }
+}
+
+// Searches the delays within |hint_width| of |delay_hint| and around
+// |last_delay| every block, and the other delays in turns of
+// 1 / |kHintSweepParts| of the history, so they never go stale. Searches all
+// delays until there is a delay estimate.
+static void HintGuidedSearch(BinaryDelayEstimator *self,
+                             uint32_t binary_near_spectrum,
+                             int32_t *value_best_candidate,
+                             int *candidate_delay,
+                             int32_t *value_worst_candidate) {
+    const int half_window = std::max(self->hint_window >> 2, 2);
+    const int part_size =
+            (self->history_size + kHintSweepParts - 1) / kHintSweepParts;
+    const int sweep_end =
+            std::min((self->hint_sweep + 1) * part_size, self->history_size);
+    int start[2] = {self->delay_hint - self->hint_width,
+                    self->last_delay - half_window};
+    int end[2] = {self->delay_hint + self->hint_width + 1,
+                  self->last_delay + half_window + 1};
+    int delay = self->hint_sweep * part_size;
+    int i = 0;
+
+    if (self->last_delay < 0) {
+        SearchDelays(self, binary_near_spectrum, 0, self->history_size,
+                     value_best_candidate, candidate_delay,
+                     value_worst_candidate);
+        self->fine_windows = 1;
+        self->fine_start[0] = 0;
+        self->fine_end[0] = self->history_size;
+        return;
+    }
+    SearchWindows(self, binary_near_spectrum, start, end, 2, -1,
+                  value_best_candidate, candidate_delay, value_worst_candidate);
+    // Sweep the part of the history not covered by the windows.
+    for (i = 0; i < self->fine_windows; ++i) {
+        if (self->fine_start[i] > delay) {
+            SearchDelays(self, binary_near_spectrum, delay,
+                         std::min(self->fine_start[i], sweep_end),
+                         value_best_candidate, candidate_delay,
+                         value_worst_candidate);
+        }
+        delay = std::max(delay, self->fine_end[i]);
+    }
+    if (sweep_end > delay) {
+        SearchDelays(self, binary_near_spectrum, delay, sweep_end,
+                     value_best_candidate, candidate_delay,
+                     value_worst_candidate);
+    }
+    self->hint_sweep = (self->hint_sweep + 1) % kHintSweepParts;
+}
+
+// Returns the quality of the last delay estimate in [0, 1] from the depth of
+// the minimum of the cost function. Unlike the histogram height used with
+// robust validation, it does not depend on the validation setting.
+static float DelayProbabilityQuality(const BinaryDelayEstimator *self) {
+    // Note that |last_delay_probability| states how deep the minimum of the
+    // cost function is, so it is rather an error probability.
+    float quality = (float) (kMaxBitCountsQ9 - self->last_delay_probability) /
+                    kMaxBitCountsQ9;
+    if (quality < 0) {
+        quality = 0;
+    }
+    return quality;
+}
+
+// Widens the hint window when the delay estimate looks poor or the best
+// candidate sits on the edge of the searched delays, i.e., the echo path is
+// not where the hint says, and narrows it back after a longer stretch of good
+// estimates. The estimate is judged by DelayProbabilityQuality(), since the
+// histogram quality of robust validation rarely gets near |kHintMinQuality|.
+static void UpdateHintWindow(BinaryDelayEstimator *self, int candidate_delay) {
+    int on_edge = 0;
+    int i = 0;
+
+    for (i = 0; i < self->fine_windows; ++i) {
+        on_edge |= ((candidate_delay == self->fine_start[i]) &&
+                    (candidate_delay > 0)) ||
+                   ((candidate_delay == self->fine_end[i] - 1) &&
+                    (candidate_delay < self->history_size - 1));
+    }
+    if (on_edge ||
+        (DelayProbabilityQuality(self) < kHintMinQuality)) {
+        self->hint_misses++;
+        self->hint_hits = 0;
+    } else {
+        self->hint_hits++;
+        self->hint_misses = 0;
+    }
+    if ((self->hint_misses >= kHintWidenBlocks) &&
+        (self->hint_width < self->history_size)) {
+        self->hint_width = std::min(2 * self->hint_width, self->history_size);
+        self->hint_misses = 0;
+    } else if ((self->hint_hits >= kHintNarrowBlocks) &&
+               (self->hint_width > self->hint_window)) {
+        self->hint_width = std::max(self->hint_width >> 1, self->hint_window);
+        self->hint_hits = 0;
+    }
+}
+
+// The coarse-to-fine counterpart of SearchDelays() over all delays. First
+// updates |coarse_mean_bit_counts| against the decimated far-end history and
+// picks the best group, then runs SearchDelays() in a window around it and
+// around |last_delay|. |bit_counts| is used as scratch by both passes.
+static void CoarseToFineSearch(BinaryDelayEstimator *self,
+                               uint32_t binary_near_spectrum,
+                               int32_t *value_best_candidate,
+                               int *candidate_delay,
+                               int32_t *value_worst_candidate) {
+    const BinaryDelayEstimatorFarend *far = self->farend;
+    const int coarse_factor = self->coarse_factor;
+    const int half_factor = coarse_factor >> 1;
+    const int num_groups =
+            (self->history_size + coarse_factor - 1) / coarse_factor;
+    int32_t value_best_group = kMaxBitCountsQ9;
+    int32_t value_worst_group = 0;
+    int32_t mean_level = 0;
+    int best_group = 0;
+    int start[2] = {0, 0};
+    int end[2] = {0, 0};
+    int index = far->head;
+    int g = 0;
+
+    // Gather the decimated far-end history, one entry every |coarse_factor|
+    // delays, to run the same kernels as the full resolution search on it.
+    for (g = 0; g < num_groups; ++g) {
+        self->coarse_far_history[g] = far->far_coarse_history[index];
+        self->coarse_far_bit_counts[g] = BitCount(self->coarse_far_history[g]);
+        index += coarse_factor;
+        if (index >= far->history_size) {
+            index -= far->history_size;
+        }
+    }
+    WebRtc_BitCountComparison(binary_near_spectrum, self->coarse_far_history,
+                              num_groups, self->bit_counts);
+    WebRtc_UpdateMeanBitCounts(self->bit_counts, self->coarse_far_bit_counts,
+                               num_groups, 0, self->coarse_mean_bit_counts,
+                               &value_best_group, &best_group,
+                               &value_worst_group);
+    for (g = 0; g < num_groups; ++g) {
+        mean_level += self->coarse_mean_bit_counts[g];
+    }
+    mean_level /= num_groups;
+
+    start[0] = best_group * coarse_factor - half_factor;
+    end[0] = best_group * coarse_factor + coarse_factor + half_factor;
+    start[1] = self->last_delay - half_factor;
+    end[1] = self->last_delay + half_factor + 1;
+    SearchWindows(self, binary_near_spectrum, start, end,
+                  self->last_delay >= 0 ? 2 : 1, mean_level,
+                  value_best_candidate, candidate_delay, value_worst_candidate);
+    if (value_worst_group > *value_worst_candidate) {
+        *value_worst_candidate = value_worst_group;
+    }
+}
+
+int WebRtc_SetDelayHintWindow(BinaryDelayEstimator *self, int window) {
+    RTC_DCHECK(self);
+    if (window < 0) {
+        return -1;
+    }
+    self->hint_window = window;
+    self->hint_width = window;
+    self->hint_misses = 0;
+    self->hint_hits = 0;
+    return 0;
+}
+
+void WebRtc_SetDelayHint(BinaryDelayEstimator *self, int delay_hint) {
+    RTC_DCHECK(self);
+    if (delay_hint >= self->history_size) {
+        delay_hint = self->history_size - 1;
+    }
+    self->delay_hint = delay_hint;
+}
+
+int WebRtc_EnableCoarseSearch(BinaryDelayEstimator *self, int enable) {
+    RTC_DCHECK(self);
+    if ((enable < 0) || (enable > 1)) {
+        return -1;
+    }
+    self->coarse_search_enabled = enable;
+    return ConfigureCoarseSearch(self);
+}
+
 int WebRtc_ProcessBinarySpectrum(BinaryDelayEstimator *self,
                                  uint32_t binary_near_spectrum) {
-    int i = 0;
     int candidate_delay = -1;
     int valid_candidate = 0;
 
@@ -534,45 +1329,33 @@ int WebRtc_ProcessBinarySpectrum(BinaryDelayEstimator *self,
         return -1;
     }
     if (self->near_history_size > 1) {
-        // If we apply lookahead, shift near-end binary spectrum history. Insert
-        // current |binary_near_spectrum| and pull out the delayed one.
-        memmove(&(self->binary_near_history[1]), &(self->binary_near_history[0]),
-                (self->near_history_size - 1) * sizeof(uint32_t));
-        self->binary_near_history[0] = binary_near_spectrum;
-        binary_near_spectrum = self->binary_near_history[self->lookahead];
+        // If we apply lookahead, insert current |binary_near_spectrum| in the
+        // near-end binary spectrum history and pull out the delayed one.
+        self->near_head = (self->near_head == 0 ? self->near_history_size
+                                                : self->near_head) - 1;
+        self->binary_near_history[self->near_head] = binary_near_spectrum;
+        binary_near_spectrum = self->binary_near_history[
+                (self->near_head + self->lookahead) % self->near_history_size];
     }
 
     // Compare with delayed spectra and store the |bit_counts| for each delay.
-    BitCountComparison(binary_near_spectrum, self->farend->binary_far_history,
-                       self->history_size, self->bit_counts);
-
-    // Update |mean_bit_counts|, which is the smoothed version of |bit_counts|.
-    for (i = 0; i < self->history_size; i++) {
-        // |bit_counts| is constrained to [0, 32], meaning we can smooth with a
-        // factor up to 2^26. We use Q9.
-        int32_t bit_count = (self->bit_counts[i] << 9);  // Q9.
-
-        // Update |mean_bit_counts| only when far-end signal has something to
-        // contribute. If |far_bit_counts| is zero the far-end signal is weak and
-        // we likely have a poor echo condition, hence don't update.
-        if (self->farend->far_bit_counts[i] > 0) {
-            // Make number of right shifts piecewise linear w.r.t. |far_bit_counts|.
-            int shifts = kShiftsAtZero;
-            shifts -= (kShiftsLinearSlope * self->farend->far_bit_counts[i]) >> 4;
-            WebRtc_MeanEstimatorFix(bit_count, shifts, &(self->mean_bit_counts[i]));
-        }
-    }
-
-    // Find |candidate_delay|, |value_best_candidate| and |value_worst_candidate|
-    // of |mean_bit_counts|.
-    for (i = 0; i < self->history_size; i++) {
-        if (self->mean_bit_counts[i] < value_best_candidate) {
-            value_best_candidate = self->mean_bit_counts[i];
-            candidate_delay = i;
-        }
-        if (self->mean_bit_counts[i] > value_worst_candidate) {
-            value_worst_candidate = self->mean_bit_counts[i];
-        }
+    // Then update |mean_bit_counts| and find |candidate_delay|,
+    // |value_best_candidate| and |value_worst_candidate| of it in the same
+    // pass, over all delays or only where the delay hint or the coarse search
+    // points.
+    if ((self->hint_window > 0) && (self->delay_hint >= 0)) {
+        HintGuidedSearch(self, binary_near_spectrum, &value_best_candidate,
+                         &candidate_delay, &value_worst_candidate);
+    } else if (self->coarse_factor > 0) {
+        CoarseToFineSearch(self, binary_near_spectrum, &value_best_candidate,
+                           &candidate_delay, &value_worst_candidate);
+    } else {
+        SearchDelays(self, binary_near_spectrum, 0, self->history_size,
+                     &value_best_candidate, &candidate_delay,
+                     &value_worst_candidate);
+        self->fine_windows = 1;
+        self->fine_start[0] = 0;
+        self->fine_end[0] = self->history_size;
     }
     valley_depth = value_worst_candidate - value_best_candidate;
 
@@ -620,10 +1403,7 @@ int WebRtc_ProcessBinarySpectrum(BinaryDelayEstimator *self,
                         (value_best_candidate < self->last_delay_probability)));
 
     // Check for nonstationary farend signal.
-    const bool non_stationary_farend =
-            std::any_of(self->farend->far_bit_counts,
-                        self->farend->far_bit_counts + self->history_size,
-                        [](int a) { return a > 0; });
+    const bool non_stationary_farend = (self->farend->active_count > 0);
 
     if (non_stationary_farend) {
         // Only update the validation statistics when the farend is nonstationary
@@ -642,15 +1422,16 @@ int WebRtc_ProcessBinarySpectrum(BinaryDelayEstimator *self,
     // a valid delay candidate is available.
     if (non_stationary_farend && valid_candidate) {
         if (candidate_delay != self->last_delay) {
+            const int32_t candidate_histogram =
+                    HistogramValue(self, candidate_delay);
             self->last_delay_histogram =
-                    (self->histogram[candidate_delay] > kLastHistogramMax
+                    (candidate_histogram > kLastHistogramMax
                      ? kLastHistogramMax
-                     : self->histogram[candidate_delay]);
+                     : candidate_histogram);
             // Adjust the histogram if we made a change to |last_delay|, though it was
             // not the most likely one according to the histogram.
-            if (self->histogram[candidate_delay] <
-                self->histogram[self->compare_delay]) {
-                self->histogram[self->compare_delay] = self->histogram[candidate_delay];
+            if (candidate_histogram < HistogramValue(self, self->compare_delay)) {
+                SetHistogramValue(self, self->compare_delay, candidate_histogram);
             }
         }
         self->last_delay = candidate_delay;
@@ -660,6 +1441,11 @@ int WebRtc_ProcessBinarySpectrum(BinaryDelayEstimator *self,
         self->compare_delay = self->last_delay;
     }
 
+    if ((self->hint_window > 0) && (self->delay_hint >= 0) &&
+        (self->last_delay >= 0)) {
+        UpdateHintWindow(self, candidate_delay);
+    }
+
     return self->last_delay;
 }
 
@@ -674,15 +1460,10 @@ float WebRtc_binary_last_delay_quality(BinaryDelayEstimator *self) {
 
     if (self->robust_validation_enabled) {
         // Simply a linear function of the histogram height at delay estimate.
-        quality = self->histogram[self->compare_delay] / kHistogramMax;
+        quality = (float) HistogramValue(self, self->compare_delay) /
+                  kHistogramMax;
     } else {
-        // Note that |last_delay_probability| states how deep the minimum of the
-        // cost function is, so it is rather an error probability.
-        quality = (float) (kMaxBitCountsQ9 - self->last_delay_probability) /
-                  kMaxBitCountsQ9;
-        if (quality < 0) {
-            quality = 0;
-        }
+        quality = DelayProbabilityQuality(self);
     }
     return quality;
 }
@@ -14,17 +14,38 @@
 #ifndef MODULES_AUDIO_PROCESSING_UTILITY_DELAY_ESTIMATOR_H_
 #define MODULES_AUDIO_PROCESSING_UTILITY_DELAY_ESTIMATOR_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "signal_processing_library.h"
+
 
 static const int32_t kMaxBitCountsQ9 = (32 << 9);  // 32 matching bits in Q9.
 
+// Number of right shifts for scaling is linearly depending on number of bits in
+// the far-end binary spectrum.
+static const int kShiftsAtZero = 13;  // Right shifts at zero binary spectrum.
+static const int kShiftsLinearSlope = 3;
+
 typedef struct {
     // Pointer to bit counts.
     int *far_bit_counts;
-    // Binary history variables.
+    // Binary history variables. Both histories are rings: the entry of delay
+    // d is at index (head + d) % history_size.
     uint32_t *binary_far_history;
     int history_size;
+    // Capacity of the buffers if they are in caller memory, otherwise 0.
+    int fixed_history_size;
+    int head;
+    // Number of entries with a nonzero |far_bit_counts|.
+    int active_count;
+    // For the coarse search, the bitwise majority of each entry and the
+    // |coarse_factor| - 1 entries before it, kept as a ring like the history,
+    // and the per bit counts of the window ending at |head|, one byte per bit.
+    // Not updated while |coarse_factor| is 0.
+    uint32_t *far_coarse_history;
+    int coarse_factor;
+    uint64_t coarse_counts[4];
 } BinaryDelayEstimatorFarend;
 
 typedef struct {
@@ -34,10 +55,16 @@ typedef struct {
     // determined at run-time.
     int32_t *bit_counts;
 
-    // Binary history variables.
+    // Binary history variables. |binary_near_history| is a ring like the
+    // far-end histories, with the newest entry at |near_head|.
     uint32_t *binary_near_history;
     int near_history_size;
+    int near_head;
     int history_size;
+    // Capacity of the history and coarse search buffers if they are in caller
+    // memory, otherwise 0.
+    int fixed_history_size;
+    int fixed_coarse_groups;
 
     // Delay estimation variables.
     int32_t minimum_probability;
@@ -52,12 +79,39 @@ typedef struct {
     int last_candidate_delay;
     int compare_delay;
     int candidate_hits;
-    float *histogram;
-    float last_delay_histogram;
+    // In Q14, lazily decreased by |histogram_offset|, see HistogramValue().
+    int32_t *histogram;
+    int32_t histogram_offset;
+    int32_t last_delay_histogram;
 
     // For dynamically changing the lookahead when using SoftReset...().
     int lookahead;
 
+    // Coarse-to-fine search, see WebRtc_EnableCoarseSearch(). The delays are
+    // searched in groups of |coarse_factor|, and at full resolution only in
+    // the |fine_windows| windows [fine_start, fine_end) of the current block.
+    int coarse_search_enabled;
+    int coarse_factor;
+    int32_t *coarse_mean_bit_counts;
+    // The decimated far-end history of the current block, gathered from
+    // |far_coarse_history|.
+    uint32_t *coarse_far_history;
+    int *coarse_far_bit_counts;
+    int fine_windows;
+    int fine_start[2];
+    int fine_end[2];
+
+    // Hint-guided search, see WebRtc_SetDelayHintWindow(). |hint_width| is the
+    // current half width of the window around |delay_hint|, adapted from
+    // |hint_window| by the consecutive |hint_misses| and |hint_hits|.
+    // |hint_sweep| is the part of the history searched outside the windows.
+    int delay_hint;
+    int hint_window;
+    int hint_width;
+    int hint_misses;
+    int hint_hits;
+    int hint_sweep;
+
     // Far-end binary spectrum history buffer etc.
     BinaryDelayEstimatorFarend *farend;
 } BinaryDelayEstimator;
@@ -87,6 +141,29 @@ void WebRtc_FreeBinaryDelayEstimatorFarend(BinaryDelayEstimatorFarend *self);
 BinaryDelayEstimatorFarend *WebRtc_CreateBinaryDelayEstimatorFarend(
         int history_size);
 
+// Returns the size of the memory WebRtc_CreateBinaryDelayEstimatorFarendInPlace()
+// needs for |history_size|, or 0 if |history_size| is invalid.
+size_t WebRtc_BinaryDelayEstimatorFarendRequiredMemory(int history_size);
+
+// As WebRtc_CreateBinaryDelayEstimatorFarend(), but places the instance and
+// its buffers in |memory|, which is owned by the caller. The history can then
+// not grow beyond |history_size|. The instance must not be passed to
+// WebRtc_FreeBinaryDelayEstimatorFarend().
+//
+// Inputs:
+//      - memory          : WebRtc_BinaryDelayEstimatorFarendRequiredMemory()
+//                          bytes, aligned to 32 bytes.
+//      - history_size    : Size of the far-end binary spectrum history.
+//
+// Return value:
+//      - BinaryDelayEstimatorFarend*
+//                        : Created |handle|, or NULL if any of the input
+//                          parameters are invalid.
+//
+BinaryDelayEstimatorFarend *WebRtc_CreateBinaryDelayEstimatorFarendInPlace(
+        void *memory,
+        int history_size);
+
 // Re-allocates the buffers.
 //
 // Inputs:
@@ -121,6 +198,21 @@ void WebRtc_SoftResetBinaryDelayEstimatorFarend(
         BinaryDelayEstimatorFarend *self,
         int delay_shift);
 
+// Copies the state of |src| to |self|, which keeps its own buffers. The
+// history of |self| is resized to that of |src| if needed.
+//
+// Inputs:
+//      - src             : The far-end instance to copy.
+//
+// Output:
+//      - self            : Pointer to the far-end instance to copy to.
+//
+// Return value:
+//      - 0 on success, -1 if the history could not be resized.
+int WebRtc_CopyBinaryDelayEstimatorFarend(
+        BinaryDelayEstimatorFarend *self,
+        const BinaryDelayEstimatorFarend *src);
+
 // Adds the binary far-end spectrum to the internal far-end history buffer. This
 // spectrum is used as reference when calculating the delay using
 // WebRtc_ProcessBinarySpectrum().
@@ -158,6 +250,32 @@ BinaryDelayEstimator *WebRtc_CreateBinaryDelayEstimator(
         BinaryDelayEstimatorFarend *farend,
         int max_lookahead);
 
+// Returns the size of the memory WebRtc_CreateBinaryDelayEstimatorInPlace()
+// needs for a far-end of |history_size|, or 0 if a parameter is invalid.
+size_t WebRtc_BinaryDelayEstimatorRequiredMemory(int history_size,
+                                                 int max_lookahead);
+
+// As WebRtc_CreateBinaryDelayEstimator(), but places the instance and its
+// buffers in |memory|, which is owned by the caller. The history can then not
+// grow beyond the current history size of |farend|. The instance must not be
+// passed to WebRtc_FreeBinaryDelayEstimator().
+//
+// Inputs:
+//      - memory          : WebRtc_BinaryDelayEstimatorRequiredMemory() bytes,
+//                          aligned to 32 bytes.
+//      - farend          : Pointer to the far-end instance.
+//      - max_lookahead   : Maximum amount of non-causal lookahead allowed.
+//
+// Return value:
+//      - BinaryDelayEstimator*
+//                        : Created |handle|, or NULL if any of the input
+//                          parameters are invalid.
+//
+BinaryDelayEstimator *WebRtc_CreateBinaryDelayEstimatorInPlace(
+        void *memory,
+        BinaryDelayEstimatorFarend *farend,
+        int max_lookahead);
+
 // Re-allocates |history_size| dependent buffers. The far-end buffers will be
 // updated at the same time if needed.
 //
@@ -195,6 +313,22 @@ void WebRtc_InitBinaryDelayEstimator(BinaryDelayEstimator *self);
 int WebRtc_SoftResetBinaryDelayEstimator(BinaryDelayEstimator *self,
                                          int delay_shift);
 
+// Copies the state of |src| to |self|, which keeps its own buffers and its
+// far-end instance. The far-ends are copied separately, with
+// WebRtc_CopyBinaryDelayEstimatorFarend(), before this call.
+//
+// Inputs:
+//      - src             : The instance to copy.
+//
+// Output:
+//      - self            : Pointer to the instance to copy to.
+//
+// Return value:
+//      - 0 on success, -1 if the lookaheads differ or the history could not
+//        be resized.
+int WebRtc_CopyBinaryDelayEstimator(BinaryDelayEstimator *self,
+                                    const BinaryDelayEstimator *src);
+
 // Estimates and returns the delay between the binary far-end and binary near-
 // end spectra. It is assumed the binary far-end spectrum has been added using
 // WebRtc_AddBinaryFarSpectrum() prior to this call. The value will be offset by
@@ -215,6 +349,57 @@ int WebRtc_SoftResetBinaryDelayEstimator(BinaryDelayEstimator *self,
 int WebRtc_ProcessBinarySpectrum(BinaryDelayEstimator *self,
                                  uint32_t binary_near_spectrum);
 
+// Enables (|enable| = 1) or disables (|enable| = 0) the coarse-to-fine delay
+// search, which keeps the cost per block growing with the square root of the
+// history size instead of linearly. The far-end history is decimated into
+// groups of about sqrt(history_size / 2) consecutive delays, represented by
+// the bitwise majority of their spectra. Every block, a coarse pass smooths
+// the bit count difference to each group. Then |mean_bit_counts| is updated
+// and searched at full resolution only around the best group and around
+// |last_delay|. Delays entering these windows start from the average coarse
+// level, i.e., the level of the delays that are not a match. Disabled by
+// default; the state is preserved over a reset.
+//
+// Input:
+//    - self              : Pointer to the delay estimation instance.
+//    - enable            : Enable (1) or disable (0) the coarse search.
+//
+// Return value:
+//    - 0                 : OK.
+//    - -1                : Error (invalid input or out of memory).
+//
+int WebRtc_EnableCoarseSearch(BinaryDelayEstimator *self, int enable);
+
+// Sets the half width, in blocks, of the window around the delay hint that the
+// search concentrates on, see WebRtc_SetDelayHint(). The window and the delays
+// around |last_delay| are searched every block, the rest of the history one
+// eighth per block. Until there is a delay estimate, all delays are searched.
+// The window is doubled, up to the whole history, while the delay quality
+// (WebRtc_binary_last_delay_quality()) stays low or the best candidate sits on
+// its edge, and is halved back after a longer stretch of good estimates. A
+// |window| of 0, the default, disables the hint. The setting is preserved over
+// a reset.
+//
+// Input:
+//    - self              : Pointer to the delay estimation instance.
+//    - window            : Half width of the search window, in blocks.
+//
+// Return value:
+//    - 0                 : OK.
+//    - -1                : Error (negative |window|).
+//
+int WebRtc_SetDelayHintWindow(BinaryDelayEstimator *self, int window);
+
+// Sets the delay, in blocks, that the system suggests, e.g., from its audio
+// buffer levels. It is used by the search until it is set again, and cleared
+// by setting -1 or by a reset.
+//
+// Input:
+//    - self              : Pointer to the delay estimation instance.
+//    - delay_hint        : The suggested delay, or -1 for none.
+//
+void WebRtc_SetDelayHint(BinaryDelayEstimator *self, int delay_hint);
+
 // Returns the last calculated delay updated by the function
 // WebRtc_ProcessBinarySpectrum(...).
 //
@@ -236,6 +421,83 @@ int WebRtc_binary_last_delay(BinaryDelayEstimator *self);
 //                                      delay value.
 float WebRtc_binary_last_delay_quality(BinaryDelayEstimator *self);
 
+// Compares the |binary_vector| with all rows of the |binary_matrix| and counts
+// per row the number of bits in which they differ. The kernel is selected at
+// run-time, on the first WebRtc_CreateBinaryDelayEstimatorFarend() call.
+//
+// Inputs:
+//      - binary_vector     : binary "vector" stored in a long
+//      - binary_matrix     : binary "matrix" stored as a vector of long
+//      - matrix_size       : size of binary "matrix"
+//
+// Output:
+//      - bit_counts        : "Vector" stored as a long, containing for each
+//                            row the number of times the matrix row and the
+//                            input vector have different values
+//
+typedef void (*BitCountComparison)(uint32_t binary_vector,
+                                   const uint32_t *binary_matrix,
+                                   int matrix_size,
+                                   int32_t *bit_counts);
+extern BitCountComparison WebRtc_BitCountComparison;
+void WebRtc_BitCountComparisonC(uint32_t binary_vector,
+                                const uint32_t *binary_matrix,
+                                int matrix_size,
+                                int32_t *bit_counts);
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+void WebRtc_BitCountComparisonSse2(uint32_t binary_vector,
+                                   const uint32_t *binary_matrix,
+                                   int matrix_size,
+                                   int32_t *bit_counts);
+void WebRtc_BitCountComparisonAvx2(uint32_t binary_vector,
+                                   const uint32_t *binary_matrix,
+                                   int matrix_size,
+                                   int32_t *bit_counts);
+#endif
+
+// Updates |mean_bit_counts|, the smoothed version of |bit_counts|, for |size|
+// consecutive delays from |first_delay| on, with the |far_bit_counts| of the
+// same delays. In the same pass, the smallest updated value and its delay are
+// written to |value_best_candidate| and |candidate_delay| if it is smaller
+// than |value_best_candidate|, and the largest to |value_worst_candidate| if
+// it is larger. On ties the smallest delay wins, so consecutive calls over
+// increasing delays find the first minimum like a single loop does.
+typedef void (*UpdateMeanBitCounts)(const int32_t *bit_counts,
+                                    const int *far_bit_counts,
+                                    int size,
+                                    int first_delay,
+                                    int32_t *mean_bit_counts,
+                                    int32_t *value_best_candidate,
+                                    int *candidate_delay,
+                                    int32_t *value_worst_candidate);
+extern UpdateMeanBitCounts WebRtc_UpdateMeanBitCounts;
+void WebRtc_UpdateMeanBitCountsC(const int32_t *bit_counts,
+                                 const int *far_bit_counts,
+                                 int size,
+                                 int first_delay,
+                                 int32_t *mean_bit_counts,
+                                 int32_t *value_best_candidate,
+                                 int *candidate_delay,
+                                 int32_t *value_worst_candidate);
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+void WebRtc_UpdateMeanBitCountsSse2(const int32_t *bit_counts,
+                                    const int *far_bit_counts,
+                                    int size,
+                                    int first_delay,
+                                    int32_t *mean_bit_counts,
+                                    int32_t *value_best_candidate,
+                                    int *candidate_delay,
+                                    int32_t *value_worst_candidate);
+void WebRtc_UpdateMeanBitCountsAvx2(const int32_t *bit_counts,
+                                    const int *far_bit_counts,
+                                    int size,
+                                    int first_delay,
+                                    int32_t *mean_bit_counts,
+                                    int32_t *value_best_candidate,
+                                    int *candidate_delay,
+                                    int32_t *value_worst_candidate);
+#endif
+
 // Updates the |mean_value| recursively with a step size of 2^-|factor|. This
 // function is used internally in the Binary Delay Estimator as well as the
 // Fixed point wrapper.
@@ -0,0 +1,126 @@
+/*
+ *  Copyright (c) 2012 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <immintrin.h>
+
+#include "delay_estimator.h"
+
+// Counts the bits of eight words: each nibble looks its count up with
+// vpshufb, and the byte counts of a word are summed with two multiply-adds.
+static inline __m256i BitCountW32(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    const __m256i low = _mm256_and_si256(v, low_mask);
+    const __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    const __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low),
+                                          _mm256_shuffle_epi8(lookup, high));
+
+    return _mm256_madd_epi16(
+            _mm256_maddubs_epi16(bytes, _mm256_set1_epi8(1)),
+            _mm256_set1_epi16(1));
+}
+
+void WebRtc_BitCountComparisonAvx2(uint32_t binary_vector,
+                                   const uint32_t *binary_matrix,
+                                   int matrix_size,
+                                   int32_t *bit_counts) {
+    const __m256i vector = _mm256_set1_epi32((int32_t) binary_vector);
+    int n = 0;
+
+    for (; n + 8 <= matrix_size; n += 8) {
+        const __m256i row =
+                _mm256_loadu_si256((const __m256i *) &binary_matrix[n]);
+        _mm256_storeu_si256((__m256i *) &bit_counts[n],
+                            BitCountW32(_mm256_xor_si256(vector, row)));
+    }
+    WebRtc_BitCountComparisonC(binary_vector, &binary_matrix[n],
+                               matrix_size - n, &bit_counts[n]);
+}
+
+// See ReduceCandidates() in delay_estimator_sse2.cc.
+static inline void ReduceCandidates(__m256i best,
+                                    __m256i best_delay,
+                                    __m256i worst,
+                                    int32_t *value_best_candidate,
+                                    int *candidate_delay,
+                                    int32_t *value_worst_candidate) {
+    int32_t best_lanes[8], delay_lanes[8], worst_lanes[8];
+    int lane;
+
+    _mm256_storeu_si256((__m256i *) best_lanes, best);
+    _mm256_storeu_si256((__m256i *) delay_lanes, best_delay);
+    _mm256_storeu_si256((__m256i *) worst_lanes, worst);
+    for (lane = 0; lane < 8; ++lane) {
+        if (best_lanes[lane] < *value_best_candidate ||
+            (best_lanes[lane] == *value_best_candidate &&
+             delay_lanes[lane] >= 0 && delay_lanes[lane] < *candidate_delay)) {
+            *value_best_candidate = best_lanes[lane];
+            *candidate_delay = delay_lanes[lane];
+        }
+        if (worst_lanes[lane] > *value_worst_candidate) {
+            *value_worst_candidate = worst_lanes[lane];
+        }
+    }
+}
+
+void WebRtc_UpdateMeanBitCountsAvx2(const int32_t *bit_counts,
+                                    const int *far_bit_counts,
+                                    int size,
+                                    int first_delay,
+                                    int32_t *mean_bit_counts,
+                                    int32_t *value_best_candidate,
+                                    int *candidate_delay,
+                                    int32_t *value_worst_candidate) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i slope = _mm256_set1_epi32(kShiftsLinearSlope);
+    const __m256i shifts_at_zero = _mm256_set1_epi32(kShiftsAtZero);
+    __m256i best = _mm256_set1_epi32(*value_best_candidate);
+    __m256i best_delay = _mm256_set1_epi32(-1);
+    __m256i worst = _mm256_set1_epi32(*value_worst_candidate);
+    __m256i delay = _mm256_add_epi32(_mm256_set1_epi32(first_delay),
+                                     _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    int i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        const __m256i far =
+                _mm256_loadu_si256((const __m256i *) &far_bit_counts[i]);
+        const __m256i bit_count = _mm256_slli_epi32(
+                _mm256_loadu_si256((const __m256i *) &bit_counts[i]), 9);
+        __m256i mean =
+                _mm256_loadu_si256((const __m256i *) &mean_bit_counts[i]);
+        const __m256i shifts = _mm256_sub_epi32(
+                shifts_at_zero,
+                _mm256_srai_epi32(_mm256_mullo_epi32(far, slope), 4));
+        const __m256i diff = _mm256_sub_epi32(bit_count, mean);
+        // WebRtc_MeanEstimatorFix() shifts the magnitude of |diff|.
+        const __m256i step = _mm256_sign_epi32(
+                _mm256_srlv_epi32(_mm256_abs_epi32(diff), shifts), diff);
+        __m256i less;
+
+        mean = _mm256_add_epi32(
+                mean, _mm256_and_si256(_mm256_cmpgt_epi32(far, zero), step));
+        _mm256_storeu_si256((__m256i *) &mean_bit_counts[i], mean);
+
+        // Strictly smaller values only, so each lane keeps its first minimum.
+        less = _mm256_cmpgt_epi32(best, mean);
+        best = _mm256_min_epi32(best, mean);
+        best_delay = _mm256_blendv_epi8(best_delay, delay, less);
+        worst = _mm256_max_epi32(worst, mean);
+        delay = _mm256_add_epi32(delay, _mm256_set1_epi32(8));
+    }
+    ReduceCandidates(best, best_delay, worst, value_best_candidate,
+                     candidate_delay, value_worst_candidate);
+    WebRtc_UpdateMeanBitCountsC(&bit_counts[i], &far_bit_counts[i], size - i,
+                                first_delay + i, &mean_bit_counts[i],
+                                value_best_candidate, candidate_delay,
+                                value_worst_candidate);
+}
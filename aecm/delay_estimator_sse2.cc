@@ -0,0 +1,139 @@
+/*
+ *  Copyright (c) 2012 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <emmintrin.h>
+
+#include "delay_estimator.h"
+
+// SSE2 has neither POPCNT nor a byte shuffle, so the bits of four words are
+// counted in parallel with the usual shift-and-add reduction.
+static inline __m128i BitCountW32(__m128i v) {
+    const __m128i m1 = _mm_set1_epi32(0x55555555);
+    const __m128i m2 = _mm_set1_epi32(0x33333333);
+    const __m128i m4 = _mm_set1_epi32(0x0F0F0F0F);
+
+    v = _mm_sub_epi32(v, _mm_and_si128(_mm_srli_epi32(v, 1), m1));
+    v = _mm_add_epi32(_mm_and_si128(v, m2),
+                      _mm_and_si128(_mm_srli_epi32(v, 2), m2));
+    v = _mm_and_si128(_mm_add_epi32(v, _mm_srli_epi32(v, 4)), m4);
+    v = _mm_add_epi32(v, _mm_srli_epi32(v, 8));
+    v = _mm_add_epi32(v, _mm_srli_epi32(v, 16));
+    return _mm_and_si128(v, _mm_set1_epi32(0x3F));
+}
+
+void WebRtc_BitCountComparisonSse2(uint32_t binary_vector,
+                                   const uint32_t *binary_matrix,
+                                   int matrix_size,
+                                   int32_t *bit_counts) {
+    const __m128i vector = _mm_set1_epi32((int32_t) binary_vector);
+    int n = 0;
+
+    for (; n + 4 <= matrix_size; n += 4) {
+        const __m128i row =
+                _mm_loadu_si128((const __m128i *) &binary_matrix[n]);
+        _mm_storeu_si128((__m128i *) &bit_counts[n],
+                         BitCountW32(_mm_xor_si128(vector, row)));
+    }
+    WebRtc_BitCountComparisonC(binary_vector, &binary_matrix[n],
+                               matrix_size - n, &bit_counts[n]);
+}
+
+// SSE2 lacks the 32-bit min/max instructions; select through a compare mask.
+static inline __m128i Select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Writes the smallest value of |best| to |value_best_candidate| and its
+// |best_delay| to |candidate_delay| if it is smaller than
+// |value_best_candidate|, preferring the smallest delay on ties, and the
+// largest value of |worst| to |value_worst_candidate| if it is larger.
+static inline void ReduceCandidates(__m128i best,
+                                    __m128i best_delay,
+                                    __m128i worst,
+                                    int32_t *value_best_candidate,
+                                    int *candidate_delay,
+                                    int32_t *value_worst_candidate) {
+    int32_t best_lanes[4], delay_lanes[4], worst_lanes[4];
+    int lane;
+
+    _mm_storeu_si128((__m128i *) best_lanes, best);
+    _mm_storeu_si128((__m128i *) delay_lanes, best_delay);
+    _mm_storeu_si128((__m128i *) worst_lanes, worst);
+    for (lane = 0; lane < 4; ++lane) {
+        // A lane only holds a delay if it went below the incoming value.
+        if (best_lanes[lane] < *value_best_candidate ||
+            (best_lanes[lane] == *value_best_candidate &&
+             delay_lanes[lane] >= 0 && delay_lanes[lane] < *candidate_delay)) {
+            *value_best_candidate = best_lanes[lane];
+            *candidate_delay = delay_lanes[lane];
+        }
+        if (worst_lanes[lane] > *value_worst_candidate) {
+            *value_worst_candidate = worst_lanes[lane];
+        }
+    }
+}
+
+void WebRtc_UpdateMeanBitCountsSse2(const int32_t *bit_counts,
+                                    const int *far_bit_counts,
+                                    int size,
+                                    int first_delay,
+                                    int32_t *mean_bit_counts,
+                                    int32_t *value_best_candidate,
+                                    int *candidate_delay,
+                                    int32_t *value_worst_candidate) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i slope = _mm_set1_epi32(kShiftsLinearSlope);
+    const __m128i exponent_bias = _mm_set1_epi32(127 + 16 - kShiftsAtZero);
+    __m128i best = _mm_set1_epi32(*value_best_candidate);
+    __m128i best_delay = _mm_set1_epi32(-1);
+    __m128i worst = _mm_set1_epi32(*value_worst_candidate);
+    __m128i delay = _mm_setr_epi32(first_delay, first_delay + 1,
+                                   first_delay + 2, first_delay + 3);
+    int i = 0;
+
+    for (; i + 4 <= size; i += 4) {
+        const __m128i far = _mm_loadu_si128((const __m128i *) &far_bit_counts[i]);
+        const __m128i bit_count = _mm_slli_epi32(
+                _mm_loadu_si128((const __m128i *) &bit_counts[i]), 9);
+        __m128i mean = _mm_loadu_si128((const __m128i *) &mean_bit_counts[i]);
+        // The far-end bit counts are at most 32, so a 16-bit multiply-add
+        // gives kShiftsLinearSlope * far_bit_counts.
+        const __m128i slope_term = _mm_srai_epi32(_mm_madd_epi16(far, slope), 4);
+        // 2^(16 - shifts) as the bits of a float, converted to an integer.
+        const __m128i scale = _mm_cvttps_epi32(_mm_castsi128_ps(_mm_slli_epi32(
+                _mm_add_epi32(slope_term, exponent_bias), 23)));
+        const __m128i diff = _mm_sub_epi32(bit_count, mean);
+        const __m128i sign = _mm_srai_epi32(diff, 31);
+        // Both |bit_count| and |mean| are in [0, 32] in Q9, so |diff| fits an
+        // unsigned 16-bit lane and the high half of the product is the
+        // variable right shift of WebRtc_MeanEstimatorFix().
+        const __m128i abs_step = _mm_mulhi_epu16(
+                _mm_sub_epi32(_mm_xor_si128(diff, sign), sign), scale);
+        const __m128i step = _mm_sub_epi32(_mm_xor_si128(abs_step, sign), sign);
+        __m128i less;
+
+        mean = _mm_add_epi32(
+                mean, _mm_and_si128(_mm_cmpgt_epi32(far, zero), step));
+        _mm_storeu_si128((__m128i *) &mean_bit_counts[i], mean);
+
+        // Strictly smaller values only, so each lane keeps its first minimum.
+        less = _mm_cmplt_epi32(mean, best);
+        best = Select(less, mean, best);
+        best_delay = Select(less, delay, best_delay);
+        worst = Select(_mm_cmpgt_epi32(mean, worst), mean, worst);
+        delay = _mm_add_epi32(delay, _mm_set1_epi32(4));
+    }
+    ReduceCandidates(best, best_delay, worst, value_best_candidate,
+                     candidate_delay, value_worst_candidate);
+    WebRtc_UpdateMeanBitCountsC(&bit_counts[i], &far_bit_counts[i], size - i,
+                                first_delay + i, &mean_bit_counts[i],
+                                value_best_candidate, candidate_delay,
+                                value_worst_candidate);
+}
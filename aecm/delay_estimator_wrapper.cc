@@ -205,6 +205,45 @@ void *WebRtc_CreateDelayEstimatorFarend(int spectrum_size, int history_size) {
     return self;
 }
 
+// Size of each part of an instance placed in caller memory, rounded up so
+// the next part stays aligned for the binary estimator.
+static size_t AlignedBytes(size_t bytes) {
+    return (bytes + 31) & ~(size_t) 31;
+}
+
+size_t WebRtc_DelayEstimatorFarendRequiredMemory(int spectrum_size,
+                                                 int history_size) {
+    const size_t binary_size =
+            WebRtc_BinaryDelayEstimatorFarendRequiredMemory(history_size);
+
+    if (spectrum_size < kBandLast || binary_size == 0) {
+        return 0;
+    }
+    return AlignedBytes(sizeof(DelayEstimatorFarend)) +
+           AlignedBytes(spectrum_size * sizeof(SpectrumType)) + binary_size;
+}
+
+void *WebRtc_CreateDelayEstimatorFarendInPlace(void *memory,
+                                               int spectrum_size,
+                                               int history_size) {
+    DelayEstimatorFarend *self = (DelayEstimatorFarend *) memory;
+    char *next = static_cast<char *>(memory);
+
+    if (memory == NULL ||
+        WebRtc_DelayEstimatorFarendRequiredMemory(spectrum_size,
+                                                  history_size) == 0) {
+        return NULL;
+    }
+    next += AlignedBytes(sizeof(DelayEstimatorFarend));
+    self->mean_far_spectrum = (SpectrumType *) next;
+    next += AlignedBytes(spectrum_size * sizeof(SpectrumType));
+    self->binary_farend =
+            WebRtc_CreateBinaryDelayEstimatorFarendInPlace(next, history_size);
+    self->spectrum_size = spectrum_size;
+
+    return self;
+}
+
 int WebRtc_InitDelayEstimatorFarend(void *handle) {
     DelayEstimatorFarend *self = (DelayEstimatorFarend *) handle;
 
@@ -230,6 +269,37 @@ void WebRtc_SoftResetDelayEstimatorFarend(void *handle, int delay_shift) {
     WebRtc_SoftResetBinaryDelayEstimatorFarend(self->binary_farend, delay_shift);
 }
 
+int WebRtc_CopyDelayEstimatorFarend(void *handle, const void *src_handle) {
+    DelayEstimatorFarend *self = (DelayEstimatorFarend *) handle;
+    const DelayEstimatorFarend *src = (const DelayEstimatorFarend *) src_handle;
+
+    if (self == NULL || src == NULL || self->spectrum_size != src->spectrum_size) {
+        return -1;
+    }
+    memcpy(self->mean_far_spectrum, src->mean_far_spectrum,
+           sizeof(SpectrumType) * src->spectrum_size);
+    self->far_spectrum_initialized = src->far_spectrum_initialized;
+
+    return WebRtc_CopyBinaryDelayEstimatorFarend(self->binary_farend,
+                                                 src->binary_farend);
+}
+
+void *WebRtc_CloneDelayEstimatorFarendInPlace(void *memory,
+                                              const void *src_handle) {
+    const DelayEstimatorFarend *src = (const DelayEstimatorFarend *) src_handle;
+    void *self = NULL;
+
+    if (src == NULL) {
+        return NULL;
+    }
+    self = WebRtc_CreateDelayEstimatorFarendInPlace(
+            memory, src->spectrum_size, src->binary_farend->history_size);
+    if (self == NULL || WebRtc_CopyDelayEstimatorFarend(self, src) != 0) {
+        return NULL;
+    }
+    return self;
+}
+
 int WebRtc_AddFarSpectrumFix(void *handle,
                              const uint16_t *far_spectrum,
                              int spectrum_size,
@@ -335,6 +405,43 @@ void *WebRtc_CreateDelayEstimator(void *farend_handle, int max_lookahead) {
     return self;
 }
 
+size_t WebRtc_DelayEstimatorRequiredMemory(int spectrum_size,
+                                           int history_size,
+                                           int max_lookahead) {
+    const size_t binary_size =
+            WebRtc_BinaryDelayEstimatorRequiredMemory(history_size,
+                                                      max_lookahead);
+
+    if (spectrum_size < kBandLast || binary_size == 0) {
+        return 0;
+    }
+    return AlignedBytes(sizeof(DelayEstimator)) +
+           AlignedBytes(spectrum_size * sizeof(SpectrumType)) + binary_size;
+}
+
+void *WebRtc_CreateDelayEstimatorInPlace(void *memory,
+                                         void *farend_handle,
+                                         int max_lookahead) {
+    DelayEstimator *self = (DelayEstimator *) memory;
+    DelayEstimatorFarend *farend = (DelayEstimatorFarend *) farend_handle;
+    char *next = static_cast<char *>(memory);
+
+    if (memory == NULL || farend_handle == NULL) {
+        return NULL;
+    }
+    next += AlignedBytes(sizeof(DelayEstimator));
+    self->mean_near_spectrum = (SpectrumType *) next;
+    next += AlignedBytes(farend->spectrum_size * sizeof(SpectrumType));
+    self->binary_handle = WebRtc_CreateBinaryDelayEstimatorInPlace(
+            next, farend->binary_farend, max_lookahead);
+    if (self->binary_handle == NULL) {
+        return NULL;
+    }
+    self->spectrum_size = farend->spectrum_size;
+
+    return self;
+}
+
 int WebRtc_InitDelayEstimator(void *handle) {
     DelayEstimator *self = (DelayEstimator *) handle;
 
@@ -360,6 +467,38 @@ int WebRtc_SoftResetDelayEstimator(void *handle, int delay_shift) {
     return WebRtc_SoftResetBinaryDelayEstimator(self->binary_handle, delay_shift);
 }
 
+int WebRtc_CopyDelayEstimator(void *handle, const void *src_handle) {
+    DelayEstimator *self = (DelayEstimator *) handle;
+    const DelayEstimator *src = (const DelayEstimator *) src_handle;
+
+    if (self == NULL || src == NULL || self->spectrum_size != src->spectrum_size) {
+        return -1;
+    }
+    memcpy(self->mean_near_spectrum, src->mean_near_spectrum,
+           sizeof(SpectrumType) * src->spectrum_size);
+    self->near_spectrum_initialized = src->near_spectrum_initialized;
+
+    return WebRtc_CopyBinaryDelayEstimator(self->binary_handle,
+                                           src->binary_handle);
+}
+
+void *WebRtc_CloneDelayEstimatorInPlace(void *memory,
+                                        void *farend_handle,
+                                        const void *src_handle) {
+    const DelayEstimator *src = (const DelayEstimator *) src_handle;
+    void *self = NULL;
+
+    if (src == NULL) {
+        return NULL;
+    }
+    self = WebRtc_CreateDelayEstimatorInPlace(
+            memory, farend_handle, src->binary_handle->near_history_size - 1);
+    if (self == NULL || WebRtc_CopyDelayEstimator(self, src) != 0) {
+        return NULL;
+    }
+    return self;
+}
+
 int WebRtc_set_history_size(void *handle, int history_size) {
     DelayEstimator *self = static_cast<DelayEstimator *>(handle);
 
@@ -444,6 +583,55 @@ int WebRtc_is_robust_validation_enabled(const void *handle) {
     return self->binary_handle->robust_validation_enabled;
 }
 
+int WebRtc_enable_coarse_search(void *handle, int enable) {
+    DelayEstimator *self = (DelayEstimator *) handle;
+
+    if (self == NULL) {
+        return -1;
+    }
+    RTC_DCHECK(self->binary_handle);
+    return WebRtc_EnableCoarseSearch(self->binary_handle, enable);
+}
+
+int WebRtc_is_coarse_search_enabled(const void *handle) {
+    const DelayEstimator *self = (const DelayEstimator *) handle;
+
+    if (self == NULL) {
+        return -1;
+    }
+    return self->binary_handle->coarse_search_enabled;
+}
+
+int WebRtc_set_delay_hint_window(void *handle, int window) {
+    DelayEstimator *self = (DelayEstimator *) handle;
+
+    if (self == NULL) {
+        return -1;
+    }
+    RTC_DCHECK(self->binary_handle);
+    return WebRtc_SetDelayHintWindow(self->binary_handle, window);
+}
+
+int WebRtc_get_delay_hint_window(const void *handle) {
+    const DelayEstimator *self = (const DelayEstimator *) handle;
+
+    if (self == NULL) {
+        return -1;
+    }
+    return self->binary_handle->hint_window;
+}
+
+int WebRtc_set_delay_hint(void *handle, int delay_hint) {
+    DelayEstimator *self = (DelayEstimator *) handle;
+
+    if ((self == NULL) || (delay_hint < -1)) {
+        return -1;
+    }
+    RTC_DCHECK(self->binary_handle);
+    WebRtc_SetDelayHint(self->binary_handle, delay_hint);
+    return 0;
+}
+
 int WebRtc_DelayEstimatorProcessFix(void *handle,
                                     const uint16_t *near_spectrum,
                                     int spectrum_size,
@@ -14,6 +14,7 @@
 #ifndef MODULES_AUDIO_PROCESSING_UTILITY_DELAY_ESTIMATOR_WRAPPER_H_
 #define MODULES_AUDIO_PROCESSING_UTILITY_DELAY_ESTIMATOR_WRAPPER_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 
@@ -39,6 +40,23 @@ void WebRtc_FreeDelayEstimatorFarend(void *handle);
 //                        returned.
 void *WebRtc_CreateDelayEstimatorFarend(int spectrum_size, int history_size);
 
+// Returns the size of the memory WebRtc_CreateDelayEstimatorFarendInPlace()
+// needs, or 0 if any of the input parameters are invalid.
+size_t WebRtc_DelayEstimatorFarendRequiredMemory(int spectrum_size,
+                                                 int history_size);
+
+// As WebRtc_CreateDelayEstimatorFarend(...), but places the instance in
+// |memory|, which is owned by the caller and must be aligned to 32 bytes. The
+// history can then not grow beyond |history_size|, and the instance must not
+// be passed to WebRtc_FreeDelayEstimatorFarend(...).
+//
+// Return value:
+//  - void*             : Created |handle|, or NULL if any of the input
+//                        parameters are invalid.
+void *WebRtc_CreateDelayEstimatorFarendInPlace(void *memory,
+                                               int spectrum_size,
+                                               int history_size);
+
 // Initializes the far-end part of the delay estimation instance returned by
 // WebRtc_CreateDelayEstimatorFarend(...)
 int WebRtc_InitDelayEstimatorFarend(void *handle);
@@ -49,6 +67,20 @@ int WebRtc_InitDelayEstimatorFarend(void *handle);
 //      - delay_shift   : The amount of blocks to shift history buffers.
 void WebRtc_SoftResetDelayEstimatorFarend(void *handle, int delay_shift);
 
+// Copies the state of the far-end instance |src_handle| to |handle|. Both
+// keep their own memory, and must have the same spectrum size.
+// Return value:
+//      - 0 on success, -1 on error.
+int WebRtc_CopyDelayEstimatorFarend(void *handle, const void *src_handle);
+
+// Creates a copy of the far-end instance |src_handle| in |memory|, as
+// WebRtc_CreateDelayEstimatorFarendInPlace(...) with the spectrum and history
+// sizes of |src_handle|.
+// Return value:
+//      - void*             : Created |handle|, or NULL on error.
+void *WebRtc_CloneDelayEstimatorFarendInPlace(void *memory,
+                                              const void *src_handle);
+
 // Adds the far-end spectrum to the far-end history buffer. This spectrum is
 // used as reference when calculating the delay using
 // WebRtc_ProcessSpectrum().
@@ -115,6 +147,25 @@ void WebRtc_FreeDelayEstimator(void *handle);
 //                        returned.
 void *WebRtc_CreateDelayEstimator(void *farend_handle, int max_lookahead);
 
+// Returns the size of the memory WebRtc_CreateDelayEstimatorInPlace() needs
+// for a far-end created with |spectrum_size| and |history_size|, or 0 if any
+// of the input parameters are invalid.
+size_t WebRtc_DelayEstimatorRequiredMemory(int spectrum_size,
+                                           int history_size,
+                                           int max_lookahead);
+
+// As WebRtc_CreateDelayEstimator(...), but places the instance in |memory|,
+// which is owned by the caller and must be aligned to 32 bytes. The history
+// can then not grow beyond the current history size of |farend_handle|, and
+// the instance must not be passed to WebRtc_FreeDelayEstimator(...).
+//
+// Return value:
+//      - void*         : Created |handle|, or NULL if any of the input
+//                        parameters are invalid.
+void *WebRtc_CreateDelayEstimatorInPlace(void *memory,
+                                         void *farend_handle,
+                                         int max_lookahead);
+
 // Initializes the delay estimation instance returned by
 // WebRtc_CreateDelayEstimator(...)
 int WebRtc_InitDelayEstimator(void *handle);
@@ -128,6 +179,22 @@ int WebRtc_InitDelayEstimator(void *handle);
 //      - actual_shifts : The actual number of shifts performed.
 int WebRtc_SoftResetDelayEstimator(void *handle, int delay_shift);
 
+// Copies the state of the delay estimation instance |src_handle| to |handle|.
+// Both keep their own memory and far-end instances, which are copied
+// separately, with WebRtc_CopyDelayEstimatorFarend(), before this call.
+// Return value:
+//      - 0 on success, -1 on error.
+int WebRtc_CopyDelayEstimator(void *handle, const void *src_handle);
+
+// Creates a copy of the delay estimation instance |src_handle| in |memory|,
+// as WebRtc_CreateDelayEstimatorInPlace(...) with the lookahead of
+// |src_handle|. |farend_handle| is the copy of the far-end of |src_handle|.
+// Return value:
+//      - void*         : Created |handle|, or NULL on error.
+void *WebRtc_CloneDelayEstimatorInPlace(void *memory,
+                                        void *farend_handle,
+                                        const void *src_handle);
+
 // Sets the effective |history_size| used. Valid values from 2. We simply need
 // at least two delays to compare to perform an estimate. If |history_size| is
 // changed, buffers are reallocated filling in with zeros if necessary.
@@ -193,6 +260,42 @@ int WebRtc_enable_robust_validation(void *handle, int enable);
 // Returns 1 if robust validation is enabled and 0 if disabled.
 int WebRtc_is_robust_validation_enabled(const void *handle);
 
+// Enables/Disables the coarse-to-fine delay search, which makes the cost per
+// block grow with the square root of the history size rather than linearly,
+// for long histories. See WebRtc_EnableCoarseSearch() for details. This is by
+// default set to disabled at create time.  The state is preserved over a reset
+// and a change of history size.
+// Inputs:
+//      - handle        : Pointer to the delay estimation instance.
+//      - enable        : Enable (1) or disable (0) this feature.
+int WebRtc_enable_coarse_search(void *handle, int enable);
+
+// Returns 1 if the coarse-to-fine search is enabled and 0 if disabled.
+int WebRtc_is_coarse_search_enabled(const void *handle);
+
+// Restricts the search to the delays within |window| blocks of the delay hint
+// set by WebRtc_set_delay_hint(), and around the last delay estimate. The
+// window widens automatically while the delay quality is low, see
+// WebRtc_SetDelayHintWindow() for details. A |window| of 0, the default,
+// searches all delays. The setting is preserved over a reset.
+// Inputs:
+//      - handle        : Pointer to the delay estimation instance.
+//      - window        : Half width of the search window, in blocks.
+int WebRtc_set_delay_hint_window(void *handle, int window);
+
+// Returns the half width of the search window around the delay hint, in
+// blocks.
+int WebRtc_get_delay_hint_window(const void *handle);
+
+// Sets the delay the system suggests, e.g., from its audio buffer levels, for
+// the search window set by WebRtc_set_delay_hint_window(). The hint is in
+// blocks, offset like the values returned by WebRtc_DelayEstimatorProcessFix().
+// It is kept until set again, and cleared by -1 or a reset.
+// Inputs:
+//      - handle        : Pointer to the delay estimation instance.
+//      - delay_hint    : The suggested delay, or -1 for none.
+int WebRtc_set_delay_hint(void *handle, int delay_hint);
+
 // Estimates and returns the delay between the far-end and near-end blocks. The
 // value will be offset by the lookahead (i.e. the lookahead should be
 // subtracted from the returned value).
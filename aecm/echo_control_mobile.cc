@@ -14,9 +14,13 @@
 #include <stdio.h>
 #endif
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <mutex>
+#include <new>
+
 extern "C" {
 #include "ring_buffer.h"
 #include "signal_processing_library.h"
@@ -24,6 +28,7 @@ extern "C" {
 }
 
 #include "aecm_core.h"
+#include "delay_estimator_wrapper.h"
 
 
 #define BUF_SIZE_FRAMES 50  // buffer size (frames)
@@ -76,8 +81,35 @@ typedef struct {
     RingBuffer *farendBuf;
 
     AecmCore *aecmCore;
+
+    // The block holding the instance and the allocator it came from. |memory|
+    // is NULL if the block is owned by the caller.
+    void *memory;
+    AecmAllocator allocator;
 } AecMobile;
 
+// The instances of a batch are in one block, one slot each, so that they
+// are laid out back to back.
+typedef struct {
+    size_t numInstances;
+    size_t slotSize;
+    char *memory;
+} AecmBatch;
+
+// The instances of a pool and its template are in one block, one slot each.
+// |idle| is a stack of the instances not handed out, |acquired| flags the
+// slots that are handed out.
+typedef struct {
+    size_t numInstances;
+    size_t slotSize;
+    char *memory;
+    AecMobile *pristine;
+    AecMobile **idle;
+    size_t numIdle;
+    char *acquired;
+    std::mutex mutex;
+} AecmPool;
+
 
 // Estimates delay to set the position of the farend buffer read pointer
 // (controlled by knownDelay)
@@ -86,22 +118,31 @@ static int WebRtcAecm_EstBufDelay(AecMobile *aecm, short msInSndCardBuf);
 // Stuffs the farend buffer if the estimated delay is too large
 static int WebRtcAecm_DelayComp(AecMobile *aecm);
 
-void *WebRtcAecm_Create() {
-    // Allocate zero-filled memory.
-    AecMobile *aecm = static_cast<AecMobile *>(calloc(1, sizeof(AecMobile)));
+static void *DefaultAllocate(void *opaque, size_t size) {
+    (void) opaque;
+    return malloc(size);
+}
 
-    aecm->aecmCore = WebRtcAecm_CreateCore();
-    if (!aecm->aecmCore) {
-        WebRtcAecm_Free(aecm);
-        return NULL;
-    }
+static void DefaultRelease(void *opaque, void *memory) {
+    (void) opaque;
+    free(memory);
+}
 
-    aecm->farendBuf = WebRtc_CreateBuffer(kBufSizeSamp, sizeof(int16_t));
-    if (!aecm->farendBuf) {
-        WebRtcAecm_Free(aecm);
-        return NULL;
-    }
+static size_t CacheLineBytes(size_t bytes) {
+    return (bytes + 63) & ~(size_t) 63;
+}
+
+// The farend buffer and the core follow the AecMobile struct in the block,
+// each on a cache line. Returns the size of the block.
+static size_t InstanceLayout(size_t *farendBufOffset, size_t *coreOffset) {
+    *farendBufOffset = CacheLineBytes(sizeof(AecMobile));
+    *coreOffset = *farendBufOffset +
+                  CacheLineBytes(WebRtc_BufferRequiredMemory(kBufSizeSamp,
+                                                             sizeof(int16_t)));
+    return *coreOffset + WebRtcAecm_CoreRequiredMemory();
+}
 
+static void OpenDebugFiles(AecMobile *aecm) {
 #ifdef AEC_DEBUG
     aecm->aecmCore->farFile = fopen("aecFar.pcm", "wb");
     aecm->aecmCore->nearFile = fopen("aecNear.pcm", "wb");
@@ -112,7 +153,81 @@ void *WebRtcAecm_Create() {
     aecm->delayFile = fopen("aecDelay.dat", "wb");
     aecm->preCompFile = fopen("preComp.pcm", "wb");
     aecm->postCompFile = fopen("postComp.pcm", "wb");
+#else
+    (void) aecm;
 #endif  // AEC_DEBUG
+}
+
+void *WebRtcAecm_Create() {
+    AecmAllocator allocator = {DefaultAllocate, DefaultRelease, NULL};
+    return WebRtcAecm_CreateWithAllocator(&allocator);
+}
+
+// Places a new instance, or a copy of |src| if it is not NULL, in a block
+// from |allocator|.
+static void *CreateFromAllocator(const AecmAllocator *allocator,
+                                 const AecMobile *src) {
+    void *memory = NULL;
+    AecMobile *aecm = NULL;
+
+    if (allocator == NULL || allocator->allocate == NULL ||
+        allocator->release == NULL) {
+        return NULL;
+    }
+    memory = allocator->allocate(allocator->opaque, WebRtcAecm_RequiredMemory());
+    if (!memory) {
+        return NULL;
+    }
+    aecm = static_cast<AecMobile *>(src ? WebRtcAecm_CloneInPlace(memory, src)
+                                        : WebRtcAecm_CreateInPlace(memory));
+    if (!aecm) {
+        allocator->release(allocator->opaque, memory);
+        return NULL;
+    }
+    aecm->memory = memory;
+    aecm->allocator = *allocator;
+    return aecm;
+}
+
+void *WebRtcAecm_CreateWithAllocator(const AecmAllocator *allocator) {
+    return CreateFromAllocator(allocator, NULL);
+}
+
+size_t WebRtcAecm_RequiredMemory() {
+    size_t farendBufOffset = 0;
+    size_t coreOffset = 0;
+    // With slack to align the block to a cache line.
+    return InstanceLayout(&farendBufOffset, &coreOffset) + 63;
+}
+
+void *WebRtcAecm_CreateInPlace(void *memory) {
+    size_t farendBufOffset = 0;
+    size_t coreOffset = 0;
+    char *block = NULL;
+    AecMobile *aecm = NULL;
+
+    if (!memory) {
+        return NULL;
+    }
+    block = (char *) (((uintptr_t) memory + 63) & ~(uintptr_t) 63);
+    InstanceLayout(&farendBufOffset, &coreOffset);
+
+    // Zero-fill the instance, the core fills its own part.
+    memset(block, 0, coreOffset);
+    aecm = reinterpret_cast<AecMobile *>(block);
+
+    aecm->aecmCore = WebRtcAecm_CreateCoreInPlace(block + coreOffset);
+    if (!aecm->aecmCore) {
+        return NULL;
+    }
+
+    aecm->farendBuf = WebRtc_CreateBufferInPlace(block + farendBufOffset,
+                                                 kBufSizeSamp, sizeof(int16_t));
+    if (!aecm->farendBuf) {
+        return NULL;
+    }
+
+    OpenDebugFiles(aecm);
     return aecm;
 }
 
@@ -134,9 +249,86 @@ void WebRtcAecm_Free(void *aecmInst) {
     fclose(aecm->preCompFile);
     fclose(aecm->postCompFile);
 #endif  // AEC_DEBUG
-    WebRtcAecm_FreeCore(aecm->aecmCore);
-    WebRtc_FreeBuffer(aecm->farendBuf);
-    free(aecm);
+    // The core and the farend buffer are in the block of the instance.
+    if (aecm->memory) {
+        aecm->allocator.release(aecm->allocator.opaque, aecm->memory);
+    }
+}
+
+// Returns the size of a slot in a block of instances, a whole number of cache
+// lines.
+static size_t SlotSize() {
+    return (WebRtcAecm_RequiredMemory() + 63) & ~(size_t) 63;
+}
+
+// Returns the instance placed in slot |index| of |memory|.
+static AecMobile *SlotInstance(char *memory, size_t slotSize, size_t index) {
+    return reinterpret_cast<AecMobile *>(
+            ((uintptr_t) memory + index * slotSize + 63) & ~(uintptr_t) 63);
+}
+
+void *WebRtcAecm_BatchCreate(size_t numInstances) {
+    AecmBatch *batch = NULL;
+    size_t i;
+
+    if (numInstances == 0) {
+        return NULL;
+    }
+    batch = static_cast<AecmBatch *>(calloc(1, sizeof(AecmBatch)));
+    if (!batch) {
+        return NULL;
+    }
+    batch->slotSize = SlotSize();
+    if (numInstances > SIZE_MAX / batch->slotSize) {
+        free(batch);
+        return NULL;
+    }
+    batch->memory = static_cast<char *>(malloc(numInstances * batch->slotSize));
+    if (!batch->memory) {
+        WebRtcAecm_BatchFree(batch);
+        return NULL;
+    }
+
+    for (i = 0; i < numInstances; i++) {
+        AecMobile *aecm = static_cast<AecMobile *>(WebRtcAecm_CreateInPlace(
+                batch->memory + i * batch->slotSize));
+        if (!aecm) {
+            WebRtcAecm_BatchFree(batch);
+            return NULL;
+        }
+        batch->numInstances++;
+        // One copy of the FFT tables serves all instances, and stays in the
+        // cache across the batch. Each instance keeps its own FFT scratch.
+        WebRtcAecm_ShareRealFFT(aecm->aecmCore,
+                                SlotInstance(batch->memory, batch->slotSize, 0)
+                                        ->aecmCore);
+    }
+    return batch;
+}
+
+void WebRtcAecm_BatchFree(void *aecmBatch) {
+    AecmBatch *batch = static_cast<AecmBatch *>(aecmBatch);
+    size_t i;
+
+    if (batch == NULL) {
+        return;
+    }
+
+    // Closes the debug files, the instances are in |memory|.
+    for (i = 0; i < batch->numInstances; i++) {
+        WebRtcAecm_Free(SlotInstance(batch->memory, batch->slotSize, i));
+    }
+    free(batch->memory);
+    free(batch);
+}
+
+void *WebRtcAecm_BatchInstance(void *aecmBatch, size_t index) {
+    AecmBatch *batch = static_cast<AecmBatch *>(aecmBatch);
+
+    if (batch == NULL || index >= batch->numInstances) {
+        return NULL;
+    }
+    return SlotInstance(batch->memory, batch->slotSize, index);
 }
 
 int32_t WebRtcAecm_Init(void *aecmInst, int32_t sampFreq) {
@@ -190,6 +382,25 @@ int32_t WebRtcAecm_Init(void *aecmInst, int32_t sampFreq) {
     return 0;
 }
 
+int32_t WebRtcAecm_BatchInit(void *aecmBatch, int32_t sampFreq) {
+    AecmBatch *batch = static_cast<AecmBatch *>(aecmBatch);
+    size_t i;
+
+    if (batch == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < batch->numInstances; i++) {
+        const int32_t err = WebRtcAecm_Init(
+                SlotInstance(batch->memory, batch->slotSize, i), sampFreq);
+        if (err != 0) {
+            return err;
+        }
+    }
+
+    return 0;
+}
+
 // Returns any error that is caused when buffering the
 // farend signal.
 int32_t WebRtcAecm_GetBufferFarendError(void *aecmInst,
@@ -407,6 +618,256 @@ int32_t WebRtcAecm_Process(void *aecmInst,
     return retVal;
 }
 
+int32_t WebRtcAecm_BatchProcess(void *aecmBatch,
+                                const int16_t *const *nearendNoisy,
+                                const int16_t *const *nearendClean,
+                                int16_t *const *out,
+                                size_t nrOfSamples,
+                                const int16_t *msInSndCardBuf,
+                                int32_t *status) {
+    AecmBatch *batch = static_cast<AecmBatch *>(aecmBatch);
+    int32_t retVal = 0;
+    size_t i;
+
+    if (batch == NULL) {
+        return -1;
+    }
+
+    if (nearendNoisy == NULL || out == NULL || msInSndCardBuf == NULL) {
+        return AECM_NULL_POINTER_ERROR;
+    }
+
+    for (i = 0; i < batch->numInstances; i++) {
+        const int32_t err = WebRtcAecm_Process(
+                SlotInstance(batch->memory, batch->slotSize, i), nearendNoisy[i],
+                (nearendClean ? nearendClean[i] : NULL), out[i], nrOfSamples,
+                msInSndCardBuf[i]);
+        if (status) {
+            status[i] = err;
+        }
+        if (retVal == 0) {
+            retVal = err;
+        }
+    }
+
+    return retVal;
+}
+
+// Copies the state of |src| to |aecm|. Both keep their own memory.
+static int32_t CopyInstance(AecMobile *aecm, const AecMobile *src) {
+    RingBuffer *farendBuf = aecm->farendBuf;
+    AecmCore *aecmCore = aecm->aecmCore;
+    void *memory = aecm->memory;
+    AecmAllocator allocator = aecm->allocator;
+#ifdef AEC_DEBUG
+    FILE *bufFile = aecm->bufFile;
+    FILE *delayFile = aecm->delayFile;
+    FILE *preCompFile = aecm->preCompFile;
+    FILE *postCompFile = aecm->postCompFile;
+#endif  // AEC_DEBUG
+
+    memcpy(aecm, src, sizeof(AecMobile));
+    aecm->farendBuf = farendBuf;
+    aecm->aecmCore = aecmCore;
+    aecm->memory = memory;
+    aecm->allocator = allocator;
+#ifdef AEC_DEBUG
+    aecm->bufFile = bufFile;
+    aecm->delayFile = delayFile;
+    aecm->preCompFile = preCompFile;
+    aecm->postCompFile = postCompFile;
+#endif  // AEC_DEBUG
+
+    if (WebRtc_CopyBuffer(aecm->farendBuf, src->farendBuf) != 0 ||
+        WebRtcAecm_CopyCore(aecm->aecmCore, src->aecmCore) != 0) {
+        return AECM_UNSPECIFIED_ERROR;
+    }
+    return 0;
+}
+
+// Returns the instance placed in slot |index| of |pool|.
+static AecMobile *PoolSlot(AecmPool *pool, size_t index) {
+    return SlotInstance(pool->memory, pool->slotSize, index);
+}
+
+void *WebRtcAecm_Clone(const void *aecmInst) {
+    const AecMobile *src = static_cast<const AecMobile *>(aecmInst);
+    AecmAllocator allocator = {DefaultAllocate, DefaultRelease, NULL};
+
+    if (src == NULL) {
+        return NULL;
+    }
+    // A copy of an instance in caller memory comes from the heap.
+    if (src->memory) {
+        allocator = src->allocator;
+    }
+    return CreateFromAllocator(&allocator, src);
+}
+
+void *WebRtcAecm_CloneInPlace(void *memory, const void *aecmInst) {
+    const AecMobile *src = static_cast<const AecMobile *>(aecmInst);
+    size_t farendBufOffset = 0;
+    size_t coreOffset = 0;
+    char *block = NULL;
+    AecMobile *aecm = NULL;
+
+    if (!memory || src == NULL) {
+        return NULL;
+    }
+    block = (char *) (((uintptr_t) memory + 63) & ~(uintptr_t) 63);
+    InstanceLayout(&farendBufOffset, &coreOffset);
+
+    // The parts are copied as they are, nothing is set up anew.
+    aecm = reinterpret_cast<AecMobile *>(block);
+    memcpy(aecm, src, sizeof(AecMobile));
+    aecm->memory = NULL;
+    memset(&aecm->allocator, 0, sizeof(aecm->allocator));
+    aecm->farendBuf =
+            WebRtc_CloneBufferInPlace(block + farendBufOffset, src->farendBuf);
+    aecm->aecmCore =
+            WebRtcAecm_CloneCoreInPlace(block + coreOffset, src->aecmCore);
+    if (!aecm->aecmCore) {
+        return NULL;
+    }
+
+    OpenDebugFiles(aecm);
+    return aecm;
+}
+
+void *WebRtcAecm_PoolCreate(size_t numInstances, int32_t sampFreq) {
+    AecmPool *pool = NULL;
+    size_t i;
+
+    if (numInstances == 0) {
+        return NULL;
+    }
+    pool = new(std::nothrow) AecmPool();
+    if (!pool) {
+        return NULL;
+    }
+    pool->slotSize = SlotSize();
+    // The last slot holds the template, and the size must not wrap.
+    if (numInstances > SIZE_MAX / pool->slotSize - 1) {
+        delete pool;
+        return NULL;
+    }
+    pool->memory = static_cast<char *>(
+            malloc((numInstances + 1) * pool->slotSize));
+    pool->idle =
+            static_cast<AecMobile **>(calloc(numInstances, sizeof(AecMobile *)));
+    pool->acquired = static_cast<char *>(calloc(numInstances, 1));
+    if (!pool->memory || !pool->idle || !pool->acquired) {
+        WebRtcAecm_PoolFree(pool);
+        return NULL;
+    }
+
+    pool->pristine = static_cast<AecMobile *>(WebRtcAecm_CreateInPlace(
+            pool->memory + numInstances * pool->slotSize));
+    if (!pool->pristine || WebRtcAecm_Init(pool->pristine, sampFreq) != 0) {
+        WebRtcAecm_PoolFree(pool);
+        return NULL;
+    }
+    for (i = 0; i < numInstances; i++) {
+        AecMobile *aecm = static_cast<AecMobile *>(
+                WebRtcAecm_CreateInPlace(pool->memory + i * pool->slotSize));
+        if (!aecm || CopyInstance(aecm, pool->pristine) != 0) {
+            WebRtcAecm_PoolFree(pool);
+            return NULL;
+        }
+        pool->idle[i] = aecm;
+        pool->numInstances++;
+    }
+    pool->numIdle = numInstances;
+    return pool;
+}
+
+void WebRtcAecm_PoolFree(void *aecmPool) {
+    AecmPool *pool = static_cast<AecmPool *>(aecmPool);
+    size_t i;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    // Closes the debug files, the instances are in |memory|.
+    for (i = 0; i < pool->numInstances; i++) {
+        WebRtcAecm_Free(PoolSlot(pool, i));
+    }
+    WebRtcAecm_Free(pool->pristine);
+    free(pool->idle);
+    free(pool->acquired);
+    free(pool->memory);
+    delete pool;
+}
+
+// Returns the index of the slot that |aecm| is placed in, or -1 if |aecm| is
+// not an instance of |pool|.
+static ptrdiff_t PoolSlotIndex(AecmPool *pool, const AecMobile *aecm) {
+    size_t index = 0;
+
+    if ((const char *) aecm < pool->memory ||
+        (const char *) aecm >= pool->memory + pool->numInstances * pool->slotSize) {
+        return -1;
+    }
+    index = (size_t) ((const char *) aecm - pool->memory) / pool->slotSize;
+    if (aecm != PoolSlot(pool, index)) {
+        return -1;
+    }
+    return (ptrdiff_t) index;
+}
+
+void *WebRtcAecm_PoolAcquire(void *aecmPool) {
+    AecmPool *pool = static_cast<AecmPool *>(aecmPool);
+    AecMobile *aecm = NULL;
+
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    if (pool->numIdle == 0) {
+        return NULL;
+    }
+    aecm = pool->idle[--pool->numIdle];
+    pool->acquired[PoolSlotIndex(pool, aecm)] = 1;
+    return aecm;
+}
+
+int32_t WebRtcAecm_PoolRelease(void *aecmPool, void *aecmInst) {
+    AecmPool *pool = static_cast<AecmPool *>(aecmPool);
+    AecMobile *aecm = static_cast<AecMobile *>(aecmInst);
+    ptrdiff_t index = 0;
+    int32_t err = 0;
+
+    if (pool == NULL || aecm == NULL) {
+        return -1;
+    }
+    index = PoolSlotIndex(pool, aecm);
+    if (index < 0) {
+        return AECM_BAD_PARAMETER_ERROR;
+    }
+    {
+        // An instance that is idle, or being released by another call, is
+        // not taken back twice.
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (!pool->acquired[index] || pool->numIdle == pool->numInstances) {
+            return AECM_BAD_PARAMETER_ERROR;
+        }
+        pool->acquired[index] = 0;
+    }
+
+    // Reset outside the lock, by copying the template over the state.
+    err = CopyInstance(aecm, pool->pristine);
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    if (err != 0) {
+        // The instance stays with the caller.
+        pool->acquired[index] = 1;
+        return err;
+    }
+    pool->idle[pool->numIdle++] = aecm;
+    return 0;
+}
+
 int32_t WebRtcAecm_set_config(void *aecmInst, AecmConfig config) {
     AecMobile *aecm = static_cast<AecMobile *>(aecmInst);
 
@@ -478,6 +939,32 @@ int32_t WebRtcAecm_set_config(void *aecmInst, AecmConfig config) {
     return 0;
 }
 
+int32_t WebRtcAecm_set_delay_hint_window(void *aecmInst, int16_t windowMs) {
+    AecMobile *aecm = static_cast<AecMobile *>(aecmInst);
+    int windowBlocks;
+
+    if (aecm == NULL) {
+        return -1;
+    }
+
+    if (aecm->initFlag != kInitCheck) {
+        return AECM_UNINITIALIZED_ERROR;
+    }
+
+    if (windowMs < 0 || windowMs > 500) {
+        return AECM_BAD_PARAMETER_ERROR;
+    }
+    // Round up to whole blocks.
+    windowBlocks = (windowMs * kSampMsNb * aecm->aecmCore->mult + PART_LEN - 1) /
+                   PART_LEN;
+    if (WebRtc_set_delay_hint_window(aecm->aecmCore->delay_estimator,
+                                     windowBlocks) != 0) {
+        return AECM_UNSPECIFIED_ERROR;
+    }
+
+    return 0;
+}
+
 int32_t WebRtcAecm_InitEchoPath(void *aecmInst,
                                 const void *echo_path,
                                 size_t size_bytes) {
@@ -569,6 +1056,10 @@ static int WebRtcAecm_EstBufDelay(AecMobile *aecm, short msInSndCardBuf) {
     if (aecm->timeForDelayChange > 25) {
         aecm->knownDelay = WEBRTC_SPL_MAX((int) aecm->filtDelay - 160, 0);
     }
+
+    // The filtered delay, in blocks, guides the delay estimator.
+    WebRtc_set_delay_hint(aecm->aecmCore->delay_estimator,
+                          aecm->filtDelay / PART_LEN);
     return 0;
 }
 
@@ -34,6 +34,15 @@ typedef struct {
     int16_t echoMode;  // 0, 1, 2, 3 (default), 4
 } AecmConfig;
 
+// Memory callbacks for WebRtcAecm_CreateWithAllocator(). |allocate| returns
+// |size| bytes, or a NULL pointer at failure, and |release| takes back a
+// block from |allocate|. Both are passed |opaque|.
+typedef struct {
+    void *(*allocate)(void *opaque, size_t size);
+    void (*release)(void *opaque, void *memory);
+    void *opaque;
+} AecmAllocator;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -46,7 +55,82 @@ extern "C" {
 void *WebRtcAecm_Create();
 
 /*
- * This function releases the memory allocated by WebRtcAecm_Create()
+ * As WebRtcAecm_Create(), but gets the memory from |allocator|. The instance,
+ * its buffers and tables are in one block of WebRtcAecm_RequiredMemory()
+ * bytes, which is the only allocation.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * AecmAllocator* allocator     Memory callbacks, copied by the instance
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * void*          return        Pointer to the instance, nullptr at
+ *                              failure
+ */
+void *WebRtcAecm_CreateWithAllocator(const AecmAllocator *allocator);
+
+/*
+ * Returns the size in bytes of the memory WebRtcAecm_CreateInPlace() needs.
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * size_t         return        Size in bytes
+ */
+size_t WebRtcAecm_RequiredMemory();
+
+/*
+ * As WebRtcAecm_Create(), but places the instance in |memory|, which is owned
+ * by the caller and needs no particular alignment. Nothing is allocated.
+ * WebRtcAecm_Free() may be called on the instance, but leaves the memory to
+ * the caller.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          memory        WebRtcAecm_RequiredMemory() bytes
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * void*          return        Pointer to the instance, which need not be
+ *                              |memory|, nullptr at failure
+ */
+void *WebRtcAecm_CreateInPlace(void *memory);
+
+/*
+ * Creates an independent copy of an AECM instance, with its configuration,
+ * delay estimate, adapted echo channel and buffered signals. Processing the
+ * same data, the copy gives the same output as the original. The copy is
+ * released by WebRtcAecm_Free(). Its memory comes from the allocator of the
+ * original, or from the heap if the original is in caller memory.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          aecmInst      Pointer to the AECM instance to copy
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * void*          return        Pointer to the copy, nullptr at failure
+ */
+void *WebRtcAecm_Clone(const void *aecmInst);
+
+/*
+ * As WebRtcAecm_Clone(), but places the copy in |memory|, which is owned by
+ * the caller, as WebRtcAecm_CreateInPlace().
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          memory        WebRtcAecm_RequiredMemory() bytes
+ * void*          aecmInst      Pointer to the AECM instance to copy
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * void*          return        Pointer to the copy, nullptr at failure
+ */
+void *WebRtcAecm_CloneInPlace(void *memory, const void *aecmInst);
+
+/*
+ * This function releases the memory allocated by WebRtcAecm_Create() or
+ * WebRtcAecm_CreateWithAllocator()
  *
  * Inputs                       Description
  * -------------------------------------------------------------------
@@ -54,6 +138,51 @@ void *WebRtcAecm_Create();
  */
 void WebRtcAecm_Free(void *aecmInst);
 
+/*
+ * Allocates a batch of AECM instances that are processed together by
+ * WebRtcAecm_BatchProcess(). The instances are placed back to back in one
+ * block, as in a pool. They read one copy of the FFT tables, which belongs to
+ * the first instance, and keep their own scratch areas, so instances of a
+ * batch may be processed on different threads. Their handles
+ * are valid until WebRtcAecm_BatchFree(). The batch needs to be initialized
+ * separately using the WebRtcAecm_BatchInit() function.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * size_t   numInstances        Number of instances in the batch
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * void*    return              Pointer to the batch, nullptr at failure
+ */
+void *WebRtcAecm_BatchCreate(size_t numInstances);
+
+/*
+ * This function releases the memory allocated by WebRtcAecm_BatchCreate()
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*    aecmBatch           Pointer to the AECM batch
+ */
+void WebRtcAecm_BatchFree(void *aecmBatch);
+
+/*
+ * Returns the instance at |index| of a batch, for the calls that take an
+ * AECM instance, e.g., WebRtcAecm_BufferFarend() and WebRtcAecm_set_config().
+ * The instance is owned by the batch and must not be freed on its own.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*    aecmBatch           Pointer to the AECM batch
+ * size_t   index               Index of the instance
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * void*    return              Pointer to the instance, nullptr if
+ *                              |index| is out of range
+ */
+void *WebRtcAecm_BatchInstance(void *aecmBatch, size_t index);
+
 /*
  * Initializes an AECM instance.
  *
@@ -69,6 +198,21 @@ void WebRtcAecm_Free(void *aecmInst);
  */
 int32_t WebRtcAecm_Init(void *aecmInst, int32_t sampFreq);
 
+/*
+ * Initializes all instances of an AECM batch, as WebRtcAecm_Init().
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          aecmBatch     Pointer to the AECM batch
+ * int32_t        sampFreq      Sampling frequency of data
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * int32_t        return        0: OK
+ *                              1200-12004,12100: error/warning
+ */
+int32_t WebRtcAecm_BatchInit(void *aecmBatch, int32_t sampFreq);
+
 /*
  * Inserts an 80 or 160 sample block of data into the farend buffer.
  *
@@ -139,6 +283,101 @@ int32_t WebRtcAecm_Process(void *aecmInst,
                            size_t nrOfSamples,
                            int16_t msInSndCardBuf);
 
+/*
+ * Runs WebRtcAecm_Process() on one 80 or 160 sample block of data for each
+ * instance of a batch. The output is the same as if each instance was
+ * processed on its own.
+ *
+ * Inputs                        Description
+ * -------------------------------------------------------------------
+ * void*          aecmBatch      Pointer to the AECM batch
+ * int16_t**      nearendNoisy   One nearend buffer per instance, see
+ *                               WebRtcAecm_Process()
+ * int16_t**      nearendClean   One clean nearend buffer per instance,
+ *                               or a NULL pointer if there are none
+ * size_t         nrOfSamples    Number of samples in each nearend buffer
+ * int16_t*       msInSndCardBuf Delay estimate for sound card and
+ *                               system buffers, one per instance
+ *
+ * Outputs                       Description
+ * -------------------------------------------------------------------
+ * int16_t**      out            One out buffer per instance
+ * int32_t*       status         Return value of WebRtcAecm_Process()
+ *                               per instance, or a NULL pointer
+ * int32_t        return         0: OK
+ *                               1200-12004,12100: the first
+ *                               error/warning of any instance
+ */
+int32_t WebRtcAecm_BatchProcess(void *aecmBatch,
+                                const int16_t *const *nearendNoisy,
+                                const int16_t *const *nearendClean,
+                                int16_t *const *out,
+                                size_t nrOfSamples,
+                                const int16_t *msInSndCardBuf,
+                                int32_t *status);
+
+/*
+ * Creates a pool of |numInstances| AECM instances, initialized for
+ * |sampFreq|. The instances are handed out by WebRtcAecm_PoolAcquire() and
+ * taken back by WebRtcAecm_PoolRelease(), which resets them by copying the
+ * state of an initialized template, so calls can be set up and torn down
+ * without allocating or running WebRtcAecm_Init(). The pool may be used from
+ * several threads at a time, each instance from one thread at a time.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * size_t         numInstances  Number of instances in the pool
+ * int32_t        sampFreq      Sampling frequency of data
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * void*          return        Pointer to the pool, nullptr at failure
+ */
+void *WebRtcAecm_PoolCreate(size_t numInstances, int32_t sampFreq);
+
+/*
+ * This function releases the memory allocated by WebRtcAecm_PoolCreate(),
+ * including the instances that are still handed out.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          aecmPool      Pointer to the AECM pool
+ */
+void WebRtcAecm_PoolFree(void *aecmPool);
+
+/*
+ * Hands out an initialized instance of a pool. It may be configured, e.g.,
+ * with WebRtcAecm_set_config(), but must not be freed on its own.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          aecmPool      Pointer to the AECM pool
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * void*          return        Pointer to the instance, nullptr if all
+ *                              instances are handed out
+ */
+void *WebRtcAecm_PoolAcquire(void *aecmPool);
+
+/*
+ * Resets an instance from WebRtcAecm_PoolAcquire() to its initial state and
+ * configuration, and takes it back into the pool. An instance that is not
+ * handed out by the pool, e.g., one released twice, is refused with
+ * AECM_BAD_PARAMETER_ERROR.
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          aecmPool      Pointer to the AECM pool
+ * void*          aecmInst      Pointer to the AECM instance
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * int32_t        return        0: OK
+ *                              1200-12004,12100: error/warning
+ */
+int32_t WebRtcAecm_PoolRelease(void *aecmPool, void *aecmInst);
+
 /*
  * This function enables the user to set certain parameters on-the-fly
  *
@@ -155,6 +394,24 @@ int32_t WebRtcAecm_Process(void *aecmInst,
  */
 int32_t WebRtcAecm_set_config(void *aecmInst, AecmConfig config);
 
+/*
+ * This function restricts the delay search to a window around the delay
+ * implied by msInSndCardBuf. The window widens automatically when the delay
+ * estimate gets unreliable. Set after WebRtcAecm_Init().
+ *
+ * Inputs                       Description
+ * -------------------------------------------------------------------
+ * void*          aecmInst      Pointer to the AECM instance
+ * int16_t        windowMs      Half width of the search window in ms,
+ *                              0 (default) to search all delays
+ *
+ * Outputs                      Description
+ * -------------------------------------------------------------------
+ * int32_t        return        0: OK
+ *                              1200-12004,12100: error/warning
+ */
+int32_t WebRtcAecm_set_delay_hint_window(void *aecmInst, int16_t windowMs);
+
 /*
  * This function enables the user to set the echo path on-the-fly.
  *
@@ -0,0 +1,205 @@
+/*
+ *  Copyright (c) 2012 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <emmintrin.h>
+
+#include "signal_processing_library.h"
+
+// SSE2 lacks the 32-bit min/max instructions; select through a compare mask.
+static inline __m128i MaxW32(__m128i a, __m128i b) {
+    const __m128i a_greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(a_greater, a),
+                        _mm_andnot_si128(a_greater, b));
+}
+
+static inline __m128i MinW32(__m128i a, __m128i b) {
+    const __m128i a_greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(a_greater, b),
+                        _mm_andnot_si128(a_greater, a));
+}
+
+static inline int16_t HorizontalMaxW16(__m128i v) {
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_epi16(v, _mm_srli_epi32(v, 16));
+    return (int16_t) _mm_cvtsi128_si32(v);
+}
+
+static inline int16_t HorizontalMinW16(__m128i v) {
+    v = _mm_min_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_min_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_min_epi16(v, _mm_srli_epi32(v, 16));
+    return (int16_t) _mm_cvtsi128_si32(v);
+}
+
+static inline int32_t HorizontalMaxW32(__m128i v) {
+    v = MaxW32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = MaxW32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+static inline int32_t HorizontalMinW32(__m128i v) {
+    v = MinW32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = MinW32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+// Maximum absolute value of word16 vector. SSE2 version.
+int16_t WebRtcSpl_MaxAbsValueW16Sse2(const int16_t *vector, size_t length) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i max_v = zero;
+    size_t i = 0;
+    int absolute = 0, maximum = 0;
+
+    RTC_DCHECK_GT(length, 0);
+
+    // The saturating negation maps -32768 to 32767, which is the same guard as
+    // in the C code.
+    for (; i + 8 <= length; i += 8) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) &vector[i]);
+        max_v = _mm_max_epi16(max_v, _mm_max_epi16(v, _mm_subs_epi16(zero, v)));
+    }
+    maximum = HorizontalMaxW16(max_v);
+
+    // Second part, do the remaining iterations (if any).
+    for (; i < length; i++) {
+        absolute = abs((int) vector[i]);
+        if (absolute > maximum) {
+            maximum = absolute;
+        }
+    }
+
+    // Guard the case for abs(-32768).
+    if (maximum > WEBRTC_SPL_WORD16_MAX) {
+        maximum = WEBRTC_SPL_WORD16_MAX;
+    }
+
+    return (int16_t) maximum;
+}
+
+// Maximum absolute value of word32 vector. SSE2 version.
+int32_t WebRtcSpl_MaxAbsValueW32Sse2(const int32_t *vector, size_t length) {
+    // The absolute values are compared as unsigned numbers, by flipping the
+    // sign bit, to accommodate abs(0x80000000), which is 0x80000000.
+    const __m128i sign_bit = _mm_set1_epi32((int32_t) 0x80000000);
+    __m128i max_v = sign_bit;
+    uint32_t absolute = 0, maximum = 0;
+    size_t i = 0;
+
+    RTC_DCHECK_GT(length, 0);
+
+    for (; i + 4 <= length; i += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) &vector[i]);
+        const __m128i sign = _mm_srai_epi32(v, 31);
+        const __m128i abs_v = _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+        max_v = MaxW32(max_v, _mm_xor_si128(abs_v, sign_bit));
+    }
+    maximum = (uint32_t) HorizontalMaxW32(max_v) ^ 0x80000000;
+
+    // Second part, do the remaining iterations (if any).
+    for (; i < length; i++) {
+        // abs() is undefined for 0x80000000, so negate as unsigned.
+        absolute = vector[i] >= 0 ? (uint32_t) vector[i]
+                                  : 0u - (uint32_t) vector[i];
+        if (absolute > maximum) {
+            maximum = absolute;
+        }
+    }
+
+    maximum = WEBRTC_SPL_MIN(maximum, WEBRTC_SPL_WORD32_MAX);
+
+    return (int32_t) maximum;
+}
+
+// Maximum value of word16 vector. SSE2 version.
+int16_t WebRtcSpl_MaxValueW16Sse2(const int16_t *vector, size_t length) {
+    __m128i max_v = _mm_set1_epi16(WEBRTC_SPL_WORD16_MIN);
+    int16_t maximum;
+    size_t i = 0;
+
+    RTC_DCHECK_GT(length, 0);
+
+    for (; i + 8 <= length; i += 8) {
+        max_v = _mm_max_epi16(max_v,
+                              _mm_loadu_si128((const __m128i *) &vector[i]));
+    }
+    maximum = HorizontalMaxW16(max_v);
+
+    // Second part, do the remaining iterations (if any).
+    for (; i < length; i++) {
+        if (vector[i] > maximum)
+            maximum = vector[i];
+    }
+    return maximum;
+}
+
+// Maximum value of word32 vector. SSE2 version.
+int32_t WebRtcSpl_MaxValueW32Sse2(const int32_t *vector, size_t length) {
+    __m128i max_v = _mm_set1_epi32(WEBRTC_SPL_WORD32_MIN);
+    int32_t maximum;
+    size_t i = 0;
+
+    RTC_DCHECK_GT(length, 0);
+
+    for (; i + 4 <= length; i += 4) {
+        max_v = MaxW32(max_v, _mm_loadu_si128((const __m128i *) &vector[i]));
+    }
+    maximum = HorizontalMaxW32(max_v);
+
+    // Second part, do the remaining iterations (if any).
+    for (; i < length; i++) {
+        if (vector[i] > maximum)
+            maximum = vector[i];
+    }
+    return maximum;
+}
+
+// Minimum value of word16 vector. SSE2 version.
+int16_t WebRtcSpl_MinValueW16Sse2(const int16_t *vector, size_t length) {
+    __m128i min_v = _mm_set1_epi16(WEBRTC_SPL_WORD16_MAX);
+    int16_t minimum;
+    size_t i = 0;
+
+    RTC_DCHECK_GT(length, 0);
+
+    for (; i + 8 <= length; i += 8) {
+        min_v = _mm_min_epi16(min_v,
+                              _mm_loadu_si128((const __m128i *) &vector[i]));
+    }
+    minimum = HorizontalMinW16(min_v);
+
+    // Second part, do the remaining iterations (if any).
+    for (; i < length; i++) {
+        if (vector[i] < minimum)
+            minimum = vector[i];
+    }
+    return minimum;
+}
+
+// Minimum value of word32 vector. SSE2 version.
+int32_t WebRtcSpl_MinValueW32Sse2(const int32_t *vector, size_t length) {
+    __m128i min_v = _mm_set1_epi32(WEBRTC_SPL_WORD32_MAX);
+    int32_t minimum;
+    size_t i = 0;
+
+    RTC_DCHECK_GT(length, 0);
+
+    for (; i + 4 <= length; i += 4) {
+        min_v = MinW32(min_v, _mm_loadu_si128((const __m128i *) &vector[i]));
+    }
+    minimum = HorizontalMinW32(min_v);
+
+    // Second part, do the remaining iterations (if any).
+    for (; i < length; i++) {
+        if (vector[i] < minimum)
+            minimum = vector[i];
+    }
+    return minimum;
+}
@@ -11,29 +11,163 @@
 #include "real_fft.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "signal_processing_library.h"
 
+// A plan for one transform length N = 2^order. Everything the transforms
+// look up per call is tabulated here once, and the scratch areas are sized
+// for N instead of the largest supported order. All arrays live in the same
+// allocation as the struct.
 struct RealFFT {
     int order;
+    // Twiddle factors of the complex FFT of length N, laid out as
+    // WebRtcSpl_ComplexFFTStages() reads them. The tables of a shorter FFT
+    // are a prefix of them, so the first N / 2 - 1 entries serve the
+    // transforms of length N / 2.
+    int32_t *fft_w_re;
+    int32_t *fft_w_im;
+    // Twiddle factors of the complex IFFT of length N / 2.
+    int32_t *ifft_w_re;
+    int32_t *ifft_w_im;
+    // The merged spectrum of WebRtcSpl_RealInverseFFT(), N values.
+    int32_t *merged;
+    // cos and sin of 2.pi.k/N in Q14, k = 0, 1, ..., N/4.
+    int16_t *split_cos;
+    int16_t *split_sin;
+    // Bit-reversed index of every complex point, N / 2 values.
+    int16_t *bit_reverse;
+    // The same for the N points of WebRtcSpl_RealForwardFFTPair().
+    int16_t *pair_bit_reverse;
+    // The complex-valued FFT works in place on up to 2^order 16-bit complex
+    // numbers, for both time and frequency data.
+    int16_t *buffer;
 };
 
+// Fills |table| with the bit-reversed index of each of the 2^|stages|
+// complex points.
+static void FillBitReverseTable(int stages, int16_t *table) {
+    int k, i;
+
+    for (k = 0; k < (1 << stages); ++k) {
+        int reversed = 0;
+        for (i = 0; i < stages; ++i) {
+            reversed |= ((k >> i) & 1) << (stages - 1 - i);
+        }
+        table[k] = (int16_t) reversed;
+    }
+}
+
 struct RealFFT *WebRtcSpl_CreateRealFFT(int order) {
-    struct RealFFT *self = NULL;
+    const size_t size = WebRtcSpl_RealFFTRequiredMemory(order);
+    void *memory = NULL;
 
-    if (order > kMaxFFTOrder || order < 0) {
+    if (size == 0) {
         return NULL;
     }
-
-    self = malloc(sizeof(struct RealFFT));
-    if (self == NULL) {
+    memory = malloc(size);
+    if (memory == NULL) {
         return NULL;
     }
+    return WebRtcSpl_CreateRealFFTInPlace(memory, order);
+}
+
+size_t WebRtcSpl_RealFFTRequiredMemory(int order) {
+    int half, n;
+
+    // The packed transform needs at least one complex point.
+    if (order > kMaxFFTOrder || order < 1) {
+        return 0;
+    }
+    half = 1 << (order - 1);
+    n = 1 << order;
+
+    // The 32-bit arrays come first, so all of them are aligned.
+    return sizeof(struct RealFFT) +
+           sizeof(int32_t) * (2 * (n - 1) + 2 * (half - 1) + n) +
+           sizeof(int16_t) * (2 * (half / 2 + 1) + half + n + 2 * n);
+}
+
+// Points the arrays of |self| into the memory after the struct.
+static void SetArrays(struct RealFFT *self, int order) {
+    const int half = 1 << (order - 1);
+    const int n = 1 << order;
+    int32_t *w32;
+    int16_t *w16;
+
     self->order = order;
 
+    w32 = (int32_t *) (self + 1);
+    self->fft_w_re = w32;
+    self->fft_w_im = self->fft_w_re + (n - 1);
+    self->ifft_w_re = self->fft_w_im + (n - 1);
+    self->ifft_w_im = self->ifft_w_re + (half - 1);
+    self->merged = self->ifft_w_im + (half - 1);
+    w16 = (int16_t *) (self->merged + n);
+    self->split_cos = w16;
+    self->split_sin = self->split_cos + (half / 2 + 1);
+    self->bit_reverse = self->split_sin + (half / 2 + 1);
+    self->pair_bit_reverse = self->bit_reverse + half;
+    self->buffer = self->pair_bit_reverse + n;
+}
+
+struct RealFFT *WebRtcSpl_CreateRealFFTInPlace(void *memory, int order) {
+    struct RealFFT *self = (struct RealFFT *) memory;
+    int half, k;
+
+    if (self == NULL || WebRtcSpl_RealFFTRequiredMemory(order) == 0) {
+        return NULL;
+    }
+    half = 1 << (order - 1);
+    SetArrays(self, order);
+
+    WebRtcSpl_ComplexFFTTwiddles(order, 0, self->fft_w_re, self->fft_w_im);
+    WebRtcSpl_ComplexFFTTwiddles(order - 1, 1, self->ifft_w_re,
+                                 self->ifft_w_im);
+    for (k = 0; k <= half / 2; ++k) {
+        const int j = k * (1024 >> order);
+        self->split_cos[k] = WebRtcSpl_kSinTable1024[j + 256];
+        self->split_sin[k] = WebRtcSpl_kSinTable1024[j];
+    }
+    FillBitReverseTable(order - 1, self->bit_reverse);
+    FillBitReverseTable(order, self->pair_bit_reverse);
+
+    return self;
+}
+
+struct RealFFT *WebRtcSpl_CloneRealFFTInPlace(void *memory,
+                                              const struct RealFFT *src) {
+    struct RealFFT *self = (struct RealFFT *) memory;
+
+    if (self == NULL || src == NULL) {
+        return NULL;
+    }
+    SetArrays(self, src->order);
+    // The tables are the same for all plans of an order, and the buffer is
+    // scratch, so a copy is cheaper than computing the twiddle factors.
+    memcpy(self + 1, src + 1,
+           WebRtcSpl_RealFFTRequiredMemory(src->order) - sizeof(*src));
+
     return self;
 }
 
+int WebRtcSpl_ShareRealFFTTables(struct RealFFT *self,
+                                 const struct RealFFT *owner) {
+    if (self == NULL || owner == NULL || self->order != owner->order) {
+        return -1;
+    }
+    // |merged| and |buffer| are scratch, and stay those of |self|.
+    self->fft_w_re = owner->fft_w_re;
+    self->fft_w_im = owner->fft_w_im;
+    self->ifft_w_re = owner->ifft_w_re;
+    self->ifft_w_im = owner->ifft_w_im;
+    self->split_cos = owner->split_cos;
+    self->split_sin = owner->split_sin;
+    self->bit_reverse = owner->bit_reverse;
+    self->pair_bit_reverse = owner->pair_bit_reverse;
+    return 0;
+}
+
 void WebRtcSpl_FreeRealFFT(struct RealFFT *self) {
     if (self != NULL) {
         free(self);
@@ -42,31 +176,101 @@ void WebRtcSpl_FreeRealFFT(struct RealFFT *self) {
 
 // The C version FFT functions (i.e. WebRtcSpl_RealForwardFFT and
 // WebRtcSpl_RealInverseFFT) are real-valued FFT wrappers for complex-valued
-// FFT implementation in SPL.
+// FFT implementation in SPL. A real signal of length N = 2^order is packed
+// into a complex signal of length N / 2, with the even samples as real parts
+// and the odd samples as imaginary parts, so the complex FFT does half the
+// work. The two halves are separated, or merged for the inverse, with the
+// twiddle factors W^k = e^(-j.2.pi.k/N) from the plan. The bit reversal of
+// the complex FFT input is folded into the copy into the plan's buffer.
+// WebRtcSpl_RealForwardFFTPair transforms two real signals with one complex
+// FFT of length N instead, and separates them with no twiddle factors.
 
 int WebRtcSpl_RealForwardFFT(struct RealFFT *self,
                              const int16_t *real_data_in,
                              int16_t *complex_data_out) {
-    int i = 0;
-    int j = 0;
+    int k = 0;
+    int result = 0;
+    const int half = 1 << (self->order - 1);
+    int16_t *complex_buffer = self->buffer;
+
+    // z[n] = x[2n] + j.x[2n+1] is the real input as it is laid out. It is
+    // halved first, taking over the scaling of the missing first stage, and
+    // so that |z| and every stage output stay within 16 bits.
+    for (k = 0; k < half; ++k) {
+        const int16_t *z = &real_data_in[2 * self->bit_reverse[k]];
+        complex_buffer[2 * k] = (int16_t) ((z[0] + 1) >> 1);
+        complex_buffer[2 * k + 1] = (int16_t) ((z[1] + 1) >> 1);
+    }
+
+    result = WebRtcSpl_ComplexFFTStages(complex_buffer, self->order - 1,
+                                        self->fft_w_re, self->fft_w_im);
+
+    // Z[k] = ZE[k] + j.ZO[k] holds the spectra of the even and odd samples,
+    // scaled by 1 / N. With A = Z[k] + conj(Z[half - k]) = 2.ZE[k] and
+    // B = -j.(Z[k] - conj(Z[half - k])) = 2.ZO[k], the spectrum scaled by
+    // 1 / N as the full-length complex FFT gives it is
+    //     X[k] = (A + W^k.B) / 2,  k = 0, 1, ..., N/2.
+    // Bin half - k has A and B conjugated and negated-conjugated, and
+    // W^(half-k) = -conj(W^k), so each pass of the loop gives both bins.
+    for (k = 0; k <= half / 2; ++k) {
+        const int16_t *z1 = &complex_buffer[2 * k];
+        const int16_t *z2 = &complex_buffer[2 * ((half - k) & (half - 1))];
+        const int32_t cos_w = self->split_cos[k];
+        const int32_t sin_w = self->split_sin[k];
+        const int32_t ar = z1[0] + z2[0];
+        const int32_t ai = z1[1] - z2[1];
+        const int32_t br = z1[1] + z2[1];
+        const int32_t bi = z2[0] - z1[0];
+        // W^k.B in Q14, and A in Q14 with the rounding term added.
+        const int32_t tr = (cos_w * br + sin_w * bi) >> 1;
+        const int32_t ti = (cos_w * bi - sin_w * br) >> 1;
+        const int32_t qr = ar * 16384 + 16384;
+        const int32_t qi = ai * 16384;
+
+        complex_data_out[2 * k] = WebRtcSpl_SatW32ToW16((qr + tr) >> 15);
+        complex_data_out[2 * k + 1] =
+                WebRtcSpl_SatW32ToW16((qi + ti + 16384) >> 15);
+        complex_data_out[2 * (half - k)] =
+                WebRtcSpl_SatW32ToW16((qr - tr) >> 15);
+        complex_data_out[2 * (half - k) + 1] =
+                WebRtcSpl_SatW32ToW16((ti - qi + 16384) >> 15);
+    }
+
+    return result;
+}
+
+int WebRtcSpl_RealForwardFFTPair(struct RealFFT *self,
+                                 const int16_t *real_data_in_a,
+                                 const int16_t *real_data_in_b,
+                                 int16_t *complex_data_out_a,
+                                 int16_t *complex_data_out_b) {
+    int k = 0;
     int result = 0;
-    int n = 1 << self->order;
-    // The complex-value FFT implementation needs a buffer to hold 2^order
-    // 16-bit COMPLEX numbers, for both time and frequency data.
-    int16_t complex_buffer[2 << kMaxFFTOrder];
+    const int n = 1 << self->order;
+    int16_t *complex_buffer = self->buffer;
 
-    // Insert zeros to the imaginary parts for complex forward FFT input.
-    for (i = 0, j = 0; i < n; i += 1, j += 2) {
-        complex_buffer[j] = real_data_in[i];
-        complex_buffer[j + 1] = 0;
+    // z[n] = a[n] + j.b[n], halved as in WebRtcSpl_RealForwardFFT().
+    for (k = 0; k < n; ++k) {
+        const int m = self->pair_bit_reverse[k];
+        complex_buffer[2 * k] = (int16_t) ((real_data_in_a[m] + 1) >> 1);
+        complex_buffer[2 * k + 1] = (int16_t) ((real_data_in_b[m] + 1) >> 1);
     }
 
-    WebRtcSpl_ComplexBitReverse(complex_buffer, self->order);
-    result = WebRtcSpl_ComplexFFT(complex_buffer, self->order, 1);
+    result = WebRtcSpl_ComplexFFTStages(complex_buffer, self->order,
+                                        self->fft_w_re, self->fft_w_im);
 
-    // For real FFT output, use only the first N + 2 elements from
-    // complex forward FFT.
-    memcpy(complex_data_out, complex_buffer, sizeof(int16_t) * (n + 2));
+    // Z[k] = (A[k] + j.B[k]) / 2 scaled by 1 / N, and both spectra are
+    // conjugate-symmetric, so
+    //     A[k] = Z[k] + conj(Z[N - k]),  B[k] = -j.(Z[k] - conj(Z[N - k])).
+    for (k = 0; k <= n / 2; ++k) {
+        const int16_t *z1 = &complex_buffer[2 * k];
+        const int16_t *z2 = &complex_buffer[2 * ((n - k) & (n - 1))];
+
+        complex_data_out_a[2 * k] = WebRtcSpl_SatW32ToW16(z1[0] + z2[0]);
+        complex_data_out_a[2 * k + 1] = WebRtcSpl_SatW32ToW16(z1[1] - z2[1]);
+        complex_data_out_b[2 * k] = WebRtcSpl_SatW32ToW16(z1[1] + z2[1]);
+        complex_data_out_b[2 * k + 1] = WebRtcSpl_SatW32ToW16(z2[0] - z1[0]);
+    }
 
     return result;
 }
@@ -74,28 +278,79 @@ int WebRtcSpl_RealForwardFFT(struct RealFFT *self,
 int WebRtcSpl_RealInverseFFT(struct RealFFT *self,
                              const int16_t *complex_data_in,
                              int16_t *real_data_out) {
-    int i = 0;
-    int j = 0;
+    int k = 0;
     int result = 0;
-    int n = 1 << self->order;
-    // Create the buffer specific to complex-valued FFT implementation.
-    int16_t complex_buffer[2 << kMaxFFTOrder];
+    int shift = 0;
+    int32_t max_abs = 0;
+    const int half = 1 << (self->order - 1);
+    int16_t *complex_buffer = self->buffer;
+    int32_t *merged = self->merged;
+
+    // Inverse of the split in WebRtcSpl_RealForwardFFT: with
+    // A = X[k] + conj(X[half - k]) and B = X[k] - conj(X[half - k]),
+    //     Z[k] = A + j.W^-k.B,  k = 0, 1, ..., N/2 - 1
+    // is the spectrum of z[n] = x[2n] + j.x[2n+1], where the inverse complex
+    // FFT of length N / 2 gives the same scaling as the full-length one.
+    // As in the forward split, each pass of the loop gives bins k and
+    // half - k. Z[k] is kept in Q12, so it is rounded only once below.
+    for (k = 0; k <= half / 2; ++k) {
+        const int16_t *x1 = &complex_data_in[2 * k];
+        const int16_t *x2 = &complex_data_in[2 * (half - k)];
+        const int32_t cos_w = self->split_cos[k];
+        const int32_t sin_w = self->split_sin[k];
+        const int32_t ar = (x1[0] + x2[0]) * 4096;
+        const int32_t ai = (x1[1] - x2[1]) * 4096;
+        const int32_t br = x1[0] - x2[0];
+        const int32_t bi = x1[1] + x2[1];
+        // W^-k.B in Q12; every product fits, as |B| < 2^16 per part.
+        const int32_t pr = ((cos_w * br) >> 3) - ((sin_w * bi) >> 3);
+        const int32_t pi = ((cos_w * bi) >> 3) + ((sin_w * br) >> 3);
 
-    // For n-point FFT, first copy the first n + 2 elements into complex
-    // FFT, then construct the remaining n - 2 elements by real FFT's
-    // conjugate-symmetric properties.
-    memcpy(complex_buffer, complex_data_in, sizeof(int16_t) * (n + 2));
-    for (i = n + 2; i < 2 * n; i += 2) {
-        complex_buffer[i] = complex_data_in[2 * n - i];
-        complex_buffer[i + 1] = -complex_data_in[2 * n - i + 1];
+        merged[2 * k] = ar - pi;
+        merged[2 * k + 1] = ai + pr;
+        max_abs = WEBRTC_SPL_MAX(max_abs, WEBRTC_SPL_ABS_W32(ar - pi));
+        max_abs = WEBRTC_SPL_MAX(max_abs, WEBRTC_SPL_ABS_W32(ai + pr));
+        // Bin half itself is not part of Z.
+        if (k > 0) {
+            merged[2 * (half - k)] = ar + pi;
+            merged[2 * (half - k) + 1] = pr - ai;
+            max_abs = WEBRTC_SPL_MAX(max_abs, WEBRTC_SPL_ABS_W32(ar + pi));
+            max_abs = WEBRTC_SPL_MAX(max_abs, WEBRTC_SPL_ABS_W32(pr - ai));
+        }
+    }
+
+    // Scale Z[k] to fill 16 bits: down, if it grew beyond the input, or up
+    // to keep its fraction, so the rounding here is not amplified by the
+    // IFFT. Any gain is taken back from the returned scale, or from the
+    // output when the scale would go negative.
+    if (max_abs > 0) {
+        shift = WEBRTC_SPL_MAX(4 - WebRtcSpl_NormW32(max_abs), -12);
+        while (((max_abs + ((1 << (shift + 12)) >> 1)) >> (shift + 12)) >
+               WEBRTC_SPL_WORD16_MAX) {
+            shift++;
+        }
+    }
+    for (k = 0; k < half; ++k) {
+        const int32_t *z = &merged[2 * self->bit_reverse[k]];
+        complex_buffer[2 * k] = (int16_t) (
+                (z[0] + ((1 << (shift + 12)) >> 1)) >> (shift + 12));
+        complex_buffer[2 * k + 1] = (int16_t) (
+                (z[1] + ((1 << (shift + 12)) >> 1)) >> (shift + 12));
     }
 
-    WebRtcSpl_ComplexBitReverse(complex_buffer, self->order);
-    result = WebRtcSpl_ComplexIFFT(complex_buffer, self->order, 1);
+    result = WebRtcSpl_ComplexIFFTStages(complex_buffer, self->order - 1,
+                                         self->ifft_w_re, self->ifft_w_im) +
+             shift;
 
-    // Strip out the imaginary parts of the complex inverse FFT output.
-    for (i = 0, j = 0; i < n; i += 1, j += 2) {
-        real_data_out[i] = complex_buffer[j];
+    // z[n] = x[2n] + j.x[2n+1] is the real output as it is laid out.
+    if (result < 0) {
+        for (k = 0; k < 2 * half; ++k) {
+            real_data_out[k] = (int16_t) (
+                    (complex_buffer[k] + (1 << (-result - 1))) >> -result);
+        }
+        result = 0;
+    } else {
+        memcpy(real_data_out, complex_buffer, sizeof(int16_t) * 2 * half);
     }
 
     return result;
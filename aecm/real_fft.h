@@ -11,6 +11,7 @@
 #ifndef COMMON_AUDIO_SIGNAL_PROCESSING_INCLUDE_REAL_FFT_H_
 #define COMMON_AUDIO_SIGNAL_PROCESSING_INCLUDE_REAL_FFT_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 // For ComplexFFT(), the maximum fft order is 10;
@@ -27,6 +28,27 @@ extern "C" {
 
 struct RealFFT *WebRtcSpl_CreateRealFFT(int order);
 
+// Returns the bytes WebRtcSpl_CreateRealFFTInPlace() needs for a plan of
+// length 2^order, or 0 if |order| is not supported.
+size_t WebRtcSpl_RealFFTRequiredMemory(int order);
+
+// Creates the plan in |memory|, which must hold
+// WebRtcSpl_RealFFTRequiredMemory() bytes and be aligned for a pointer. The
+// memory stays with the caller, so WebRtcSpl_FreeRealFFT() must not be
+// called. Returns null on failure.
+struct RealFFT *WebRtcSpl_CreateRealFFTInPlace(void *memory, int order);
+
+// As WebRtcSpl_CreateRealFFTInPlace(), but copies the tables of |src|
+// instead of computing them.
+struct RealFFT *WebRtcSpl_CloneRealFFTInPlace(void *memory,
+                                              const struct RealFFT *src);
+
+// Makes |self| read the tables of |owner|, a plan of the same order, and
+// keep its own scratch areas. The plans may then transform at the same time,
+// but |owner| must outlive |self|. Returns -1 if the orders differ.
+int WebRtcSpl_ShareRealFFTTables(struct RealFFT *self,
+                                 const struct RealFFT *owner);
+
 void WebRtcSpl_FreeRealFFT(struct RealFFT *self);
 
 // Compute an FFT for a real-valued signal of length of 2^order,
@@ -64,6 +86,29 @@ int WebRtcSpl_RealForwardFFT(struct RealFFT *self,
                              const int16_t *real_data_in,
                              int16_t *complex_data_out);
 
+// Compute the FFTs of two real-valued signals of length 2^order with a single
+// complex FFT of length 2^order. Each output has the CCS layout and scaling of
+// WebRtcSpl_RealForwardFFT(), so signals normalized to different Q-domains
+// keep their own domain.
+//
+// Input Arguments:
+//   self - pointer to preallocated and initialized FFT specification structure.
+//   real_data_in_a, real_data_in_b - the two input signals.
+//
+// Output Arguments:
+//   complex_data_out_a, complex_data_out_b - the output complex signals, each
+//                                            with (2^order + 2) 16-bit
+//                                            elements.
+//
+// Return Value:
+//   0  - FFT calculation is successful.
+//   -1 - Error with bad arguments (null pointers).
+int WebRtcSpl_RealForwardFFTPair(struct RealFFT *self,
+                                 const int16_t *real_data_in_a,
+                                 const int16_t *real_data_in_b,
+                                 int16_t *complex_data_out_a,
+                                 int16_t *complex_data_out_b);
+
 // Compute the inverse FFT for a conjugate-symmetric input sequence of length of
 // 2^order, where 1 < order <= MAX_FFT_ORDER. Transform length is determined by
 // the specification structure, which must be initialized prior to calling the
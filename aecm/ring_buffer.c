@@ -51,23 +51,36 @@ static size_t GetBufferReadRegions(RingBuffer *buf,
 }
 
 RingBuffer *WebRtc_CreateBuffer(size_t element_count, size_t element_size) {
+    const size_t size = WebRtc_BufferRequiredMemory(element_count, element_size);
     RingBuffer *self = NULL;
-    if (element_count == 0 || element_size == 0) {
+    if (size == 0) {
         return NULL;
     }
 
-    self = malloc(sizeof(RingBuffer));
+    self = malloc(size);
     if (!self) {
         return NULL;
     }
+    return WebRtc_CreateBufferInPlace(self, element_count, element_size);
+}
+
+// The data follows the struct in the same allocation.
+size_t WebRtc_BufferRequiredMemory(size_t element_count, size_t element_size) {
+    if (element_count == 0 || element_size == 0) {
+        return 0;
+    }
+    return sizeof(RingBuffer) + element_count * element_size;
+}
 
-    self->data = malloc(element_count * element_size);
-    if (!self->data) {
-        free(self);
-        self = NULL;
+RingBuffer *WebRtc_CreateBufferInPlace(void *memory,
+                                       size_t element_count,
+                                       size_t element_size) {
+    RingBuffer *self = (RingBuffer *) memory;
+    if (self == NULL || element_count == 0 || element_size == 0) {
         return NULL;
     }
 
+    self->data = (char *) (self + 1);
     self->element_count = element_count;
     self->element_size = element_size;
     WebRtc_InitBuffer(self);
@@ -84,13 +97,42 @@ void WebRtc_InitBuffer(RingBuffer *self) {
     memset(self->data, 0, self->element_count * self->element_size);
 }
 
+int WebRtc_CopyBuffer(RingBuffer *self, const RingBuffer *src) {
+    if (!self || !src || self->element_count != src->element_count ||
+        self->element_size != src->element_size) {
+        return -1;
+    }
+
+    self->read_pos = src->read_pos;
+    self->write_pos = src->write_pos;
+    self->rw_wrap = src->rw_wrap;
+    // Stuffing moves the read position back over old data, so all of it is
+    // copied, not only what is available to read.
+    memcpy(self->data, src->data, src->element_count * src->element_size);
+
+    return 0;
+}
+
+RingBuffer *WebRtc_CloneBufferInPlace(void *memory, const RingBuffer *src) {
+    RingBuffer *self = (RingBuffer *) memory;
+    if (self == NULL || src == NULL) {
+        return NULL;
+    }
+
+    self->data = (char *) (self + 1);
+    self->element_count = src->element_count;
+    self->element_size = src->element_size;
+    WebRtc_CopyBuffer(self, src);
+
+    return self;
+}
+
 void WebRtc_FreeBuffer(void *handle) {
     RingBuffer *self = (RingBuffer *) handle;
     if (!self) {
         return;
     }
 
-    free(self->data);
     free(self);
 }
 
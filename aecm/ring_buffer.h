@@ -38,8 +38,29 @@ typedef struct RingBuffer {
 // Creates and initializes the buffer. Returns null on failure.
 RingBuffer *WebRtc_CreateBuffer(size_t element_count, size_t element_size);
 
+// Returns the bytes WebRtc_CreateBufferInPlace() needs for the buffer, or 0
+// if the parameters are invalid.
+size_t WebRtc_BufferRequiredMemory(size_t element_count, size_t element_size);
+
+// Creates and initializes the buffer in |memory|, which must hold
+// WebRtc_BufferRequiredMemory() bytes and be aligned for a pointer. The
+// memory stays with the caller, so WebRtc_FreeBuffer() must not be called.
+// Returns null on failure.
+RingBuffer *WebRtc_CreateBufferInPlace(void *memory,
+                                       size_t element_count,
+                                       size_t element_size);
+
 void WebRtc_InitBuffer(RingBuffer *handle);
 
+// Copies the contents and the read and write positions of |src| to |handle|,
+// which keeps its own memory. Returns 0 on success and -1 if the buffers
+// differ in size.
+int WebRtc_CopyBuffer(RingBuffer *handle, const RingBuffer *src);
+
+// Creates a copy of |src| in |memory|, which must hold as many bytes as
+// |src| needs, see WebRtc_CreateBufferInPlace(). Returns null on failure.
+RingBuffer *WebRtc_CloneBufferInPlace(void *memory, const RingBuffer *src);
+
 void WebRtc_FreeBuffer(void *handle);
 
 // Reads data from the buffer. Returns the number of elements that were read.
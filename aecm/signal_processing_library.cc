@@ -8,47 +8,155 @@
  *  be found in the AUTHORS file in the root of the source tree.
  */
 #include "signal_processing_library.h"
+#include "cpu_features_wrapper.h"
 
 // TODO(bugs.webrtc.org/9553): These function pointers are useless. Refactor
 // things so that we simply have a bunch of regular functions with different
 // implementations for different platforms.
 
+// Declare function pointers. They point to the compile-time default until
+// WebRtcSpl_Init() has been called.
 #if defined(WEBRTC_HAS_NEON)
 
-const MaxAbsValueW16 WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16Neon;
-const MaxAbsValueW32 WebRtcSpl_MaxAbsValueW32 = WebRtcSpl_MaxAbsValueW32Neon;
-const MaxValueW16 WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16Neon;
-const MaxValueW32 WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32Neon;
-const MinValueW16 WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16Neon;
-const MinValueW32 WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32Neon;
+MaxAbsValueW16 WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16Neon;
+MaxAbsValueW32 WebRtcSpl_MaxAbsValueW32 = WebRtcSpl_MaxAbsValueW32Neon;
+MaxValueW16 WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16Neon;
+MaxValueW32 WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32Neon;
+MinValueW16 WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16Neon;
+MinValueW32 WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32Neon;
+ComplexFFT WebRtcSpl_ComplexFFT = WebRtcSpl_ComplexFFTC;
+ComplexIFFT WebRtcSpl_ComplexIFFT = WebRtcSpl_ComplexIFFTC;
+ComplexFFTStages WebRtcSpl_ComplexFFTStages = WebRtcSpl_ComplexFFTStagesC;
+ComplexFFTStages WebRtcSpl_ComplexIFFTStages = WebRtcSpl_ComplexIFFTStagesC;
 
 
 #elif defined(MIPS32_LE)
 
-const MaxAbsValueW16 WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16_mips;
-const MaxAbsValueW32 WebRtcSpl_MaxAbsValueW32 =
+MaxAbsValueW16 WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16_mips;
+MaxAbsValueW32 WebRtcSpl_MaxAbsValueW32 =
 #ifdef MIPS_DSP_R1_LE
     WebRtcSpl_MaxAbsValueW32_mips;
 #else
     WebRtcSpl_MaxAbsValueW32C;
 #endif
-const MaxValueW16 WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16_mips;
-const MaxValueW32 WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32_mips;
-const MinValueW16 WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16_mips;
-const MinValueW32 WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32_mips;
+MaxValueW16 WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16_mips;
+MaxValueW32 WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32_mips;
+MinValueW16 WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16_mips;
+MinValueW32 WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32_mips;
+ComplexFFT WebRtcSpl_ComplexFFT = WebRtcSpl_ComplexFFTC;
+ComplexIFFT WebRtcSpl_ComplexIFFT = WebRtcSpl_ComplexIFFTC;
+ComplexFFTStages WebRtcSpl_ComplexFFTStages = WebRtcSpl_ComplexFFTStagesC;
+ComplexFFTStages WebRtcSpl_ComplexIFFTStages = WebRtcSpl_ComplexIFFTStagesC;
 
 
 #else
 
-const MaxAbsValueW16 WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16C;
-const MaxAbsValueW32 WebRtcSpl_MaxAbsValueW32 = WebRtcSpl_MaxAbsValueW32C;
-const MaxValueW16 WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16C;
-const MaxValueW32 WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32C;
-const MinValueW16 WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16C;
-const MinValueW32 WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32C;
+MaxAbsValueW16 WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16C;
+MaxAbsValueW32 WebRtcSpl_MaxAbsValueW32 = WebRtcSpl_MaxAbsValueW32C;
+MaxValueW16 WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16C;
+MaxValueW32 WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32C;
+MinValueW16 WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16C;
+MinValueW32 WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32C;
+ComplexFFT WebRtcSpl_ComplexFFT = WebRtcSpl_ComplexFFTC;
+ComplexIFFT WebRtcSpl_ComplexIFFT = WebRtcSpl_ComplexIFFTC;
+ComplexFFTStages WebRtcSpl_ComplexFFTStages = WebRtcSpl_ComplexFFTStagesC;
+ComplexFFTStages WebRtcSpl_ComplexIFFTStages = WebRtcSpl_ComplexIFFTStagesC;
 
 #endif
 
+// Initialize function pointers to the generic C version.
+static void InitPointersToC(void) {
+    WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16C;
+    WebRtcSpl_MaxAbsValueW32 = WebRtcSpl_MaxAbsValueW32C;
+    WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16C;
+    WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32C;
+    WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16C;
+    WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32C;
+    WebRtcSpl_ComplexFFT = WebRtcSpl_ComplexFFTC;
+    WebRtcSpl_ComplexIFFT = WebRtcSpl_ComplexIFFTC;
+    WebRtcSpl_ComplexFFTStages = WebRtcSpl_ComplexFFTStagesC;
+    WebRtcSpl_ComplexIFFTStages = WebRtcSpl_ComplexIFFTStagesC;
+}
+
+#if defined(WEBRTC_HAS_NEON)
+// Initialize function pointers to the Neon version.
+static void InitPointersToNeon(void) {
+    WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16Neon;
+    WebRtcSpl_MaxAbsValueW32 = WebRtcSpl_MaxAbsValueW32Neon;
+    WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16Neon;
+    WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32Neon;
+    WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16Neon;
+    WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32Neon;
+}
+#endif
+
+#if defined(MIPS32_LE)
+// Initialize function pointers to the MIPS version.
+static void InitPointersToMIPS(void) {
+    WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16_mips;
+#if defined(MIPS_DSP_R1_LE)
+    WebRtcSpl_MaxAbsValueW32 = WebRtcSpl_MaxAbsValueW32_mips;
+#endif
+    WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16_mips;
+    WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32_mips;
+    WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16_mips;
+    WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32_mips;
+}
+#endif
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+// Initialize function pointers to the x86 versions for |level|.
+static void InitPointersToX86(IsaLevel level) {
+    if (level >= kIsaLevelSSE2) {
+        WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16Sse2;
+        WebRtcSpl_MaxAbsValueW32 = WebRtcSpl_MaxAbsValueW32Sse2;
+        WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16Sse2;
+        WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32Sse2;
+        WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16Sse2;
+        WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32Sse2;
+        WebRtcSpl_ComplexFFT = WebRtcSpl_ComplexFFTSse2;
+        WebRtcSpl_ComplexIFFT = WebRtcSpl_ComplexIFFTSse2;
+        WebRtcSpl_ComplexFFTStages = WebRtcSpl_ComplexFFTStagesSse2;
+        WebRtcSpl_ComplexIFFTStages = WebRtcSpl_ComplexIFFTStagesSse2;
+    }
+    if (level >= kIsaLevelAVX2) {
+        WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16Avx2;
+        WebRtcSpl_MaxAbsValueW32 = WebRtcSpl_MaxAbsValueW32Avx2;
+        WebRtcSpl_MaxValueW16 = WebRtcSpl_MaxValueW16Avx2;
+        WebRtcSpl_MaxValueW32 = WebRtcSpl_MaxValueW32Avx2;
+        WebRtcSpl_MinValueW16 = WebRtcSpl_MinValueW16Avx2;
+        WebRtcSpl_MinValueW32 = WebRtcSpl_MinValueW32Avx2;
+        WebRtcSpl_ComplexFFT = WebRtcSpl_ComplexFFTAvx2;
+        WebRtcSpl_ComplexIFFT = WebRtcSpl_ComplexIFFTAvx2;
+        WebRtcSpl_ComplexFFTStages = WebRtcSpl_ComplexFFTStagesAvx2;
+        WebRtcSpl_ComplexIFFTStages = WebRtcSpl_ComplexIFFTStagesAvx2;
+    }
+}
+#endif
+
+static bool InitFunctionPointers(void) {
+    const IsaLevel level = WebRtc_GetIsaLevel();
+
+    InitPointersToC();
+    if (level == kIsaLevelGeneric) {
+        return true;
+    }
+#if defined(WEBRTC_HAS_NEON)
+    InitPointersToNeon();
+#elif defined(MIPS32_LE)
+    InitPointersToMIPS();
+#elif defined(WEBRTC_ARCH_X86_FAMILY)
+    InitPointersToX86(level);
+#endif
+    return true;
+}
+
+void WebRtcSpl_Init(void) {
+    // Thread-safe initialization, so the pointers are only written once.
+    static const bool initialized = InitFunctionPointers();
+    (void) initialized;
+}
+
 // Table used by WebRtcSpl_CountLeadingZeros32_NotBuiltin. For each uint32_t n
 // that's a sequence of 0 bits followed by a sequence of 1 bits, the entry at
 // index (n * 0x8c0b2891) >> 26 in this table gives the number of zero bits in
@@ -184,7 +292,9 @@ int32_t WebRtcSpl_MaxAbsValueW32C(const int32_t *vector, size_t length) {
     RTC_DCHECK_GT(length, 0);
 
     for (i = 0; i < length; i++) {
-        absolute = abs((int) vector[i]);
+        // abs() is undefined for 0x80000000, so negate as unsigned.
+        absolute = vector[i] >= 0 ? (uint32_t) vector[i]
+                                  : 0u - (uint32_t) vector[i];
         if (absolute > maximum) {
             maximum = absolute;
         }
@@ -161,6 +161,14 @@ int32_t WebRtcSpl_SqrtFloor(int32_t value);
 
 
 
+// Initialize SPL. Currently it contains only function pointer initialization.
+// The pointers are bound to the generic C code, or to the code optimized for
+// the instruction set level returned by WebRtc_GetIsaLevel(). Only the first
+// call has any effect, and the call is thread-safe.
+// Note that this function MUST be called in any application that uses SPL
+// functions.
+void WebRtcSpl_Init(void);
+
 // Minimum and maximum operation functions and their pointers.
 // Implementation in min_max_operations.c.
 
@@ -172,11 +180,15 @@ int32_t WebRtcSpl_SqrtFloor(int32_t value);
 //
 // Return value  : Maximum absolute value in vector.
 typedef int16_t (*MaxAbsValueW16)(const int16_t *vector, size_t length);
-extern const MaxAbsValueW16 WebRtcSpl_MaxAbsValueW16;
+extern MaxAbsValueW16 WebRtcSpl_MaxAbsValueW16;
 int16_t WebRtcSpl_MaxAbsValueW16C(const int16_t *vector, size_t length);
 #if defined(WEBRTC_HAS_NEON)
 int16_t WebRtcSpl_MaxAbsValueW16Neon(const int16_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int16_t WebRtcSpl_MaxAbsValueW16Sse2(const int16_t* vector, size_t length);
+int16_t WebRtcSpl_MaxAbsValueW16Avx2(const int16_t* vector, size_t length);
+#endif
 #if defined(MIPS32_LE)
 int16_t WebRtcSpl_MaxAbsValueW16_mips(const int16_t* vector, size_t length);
 #endif
@@ -189,11 +201,15 @@ int16_t WebRtcSpl_MaxAbsValueW16_mips(const int16_t* vector, size_t length);
 //
 // Return value  : Maximum absolute value in vector.
 typedef int32_t (*MaxAbsValueW32)(const int32_t *vector, size_t length);
-extern const MaxAbsValueW32 WebRtcSpl_MaxAbsValueW32;
+extern MaxAbsValueW32 WebRtcSpl_MaxAbsValueW32;
 int32_t WebRtcSpl_MaxAbsValueW32C(const int32_t *vector, size_t length);
 #if defined(WEBRTC_HAS_NEON)
 int32_t WebRtcSpl_MaxAbsValueW32Neon(const int32_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int32_t WebRtcSpl_MaxAbsValueW32Sse2(const int32_t* vector, size_t length);
+int32_t WebRtcSpl_MaxAbsValueW32Avx2(const int32_t* vector, size_t length);
+#endif
 #if defined(MIPS_DSP_R1_LE)
 int32_t WebRtcSpl_MaxAbsValueW32_mips(const int32_t* vector, size_t length);
 #endif
@@ -206,11 +222,15 @@ int32_t WebRtcSpl_MaxAbsValueW32_mips(const int32_t* vector, size_t length);
 //
 // Return value  : Maximum sample value in |vector|.
 typedef int16_t (*MaxValueW16)(const int16_t *vector, size_t length);
-extern const MaxValueW16 WebRtcSpl_MaxValueW16;
+extern MaxValueW16 WebRtcSpl_MaxValueW16;
 int16_t WebRtcSpl_MaxValueW16C(const int16_t *vector, size_t length);
 #if defined(WEBRTC_HAS_NEON)
 int16_t WebRtcSpl_MaxValueW16Neon(const int16_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int16_t WebRtcSpl_MaxValueW16Sse2(const int16_t* vector, size_t length);
+int16_t WebRtcSpl_MaxValueW16Avx2(const int16_t* vector, size_t length);
+#endif
 #if defined(MIPS32_LE)
 int16_t WebRtcSpl_MaxValueW16_mips(const int16_t* vector, size_t length);
 #endif
@@ -223,11 +243,15 @@ int16_t WebRtcSpl_MaxValueW16_mips(const int16_t* vector, size_t length);
 //
 // Return value  : Maximum sample value in |vector|.
 typedef int32_t (*MaxValueW32)(const int32_t *vector, size_t length);
-extern const MaxValueW32 WebRtcSpl_MaxValueW32;
+extern MaxValueW32 WebRtcSpl_MaxValueW32;
 int32_t WebRtcSpl_MaxValueW32C(const int32_t *vector, size_t length);
 #if defined(WEBRTC_HAS_NEON)
 int32_t WebRtcSpl_MaxValueW32Neon(const int32_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int32_t WebRtcSpl_MaxValueW32Sse2(const int32_t* vector, size_t length);
+int32_t WebRtcSpl_MaxValueW32Avx2(const int32_t* vector, size_t length);
+#endif
 #if defined(MIPS32_LE)
 int32_t WebRtcSpl_MaxValueW32_mips(const int32_t* vector, size_t length);
 #endif
@@ -240,11 +264,15 @@ int32_t WebRtcSpl_MaxValueW32_mips(const int32_t* vector, size_t length);
 //
 // Return value  : Minimum sample value in |vector|.
 typedef int16_t (*MinValueW16)(const int16_t *vector, size_t length);
-extern const MinValueW16 WebRtcSpl_MinValueW16;
+extern MinValueW16 WebRtcSpl_MinValueW16;
 int16_t WebRtcSpl_MinValueW16C(const int16_t *vector, size_t length);
 #if defined(WEBRTC_HAS_NEON)
 int16_t WebRtcSpl_MinValueW16Neon(const int16_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int16_t WebRtcSpl_MinValueW16Sse2(const int16_t* vector, size_t length);
+int16_t WebRtcSpl_MinValueW16Avx2(const int16_t* vector, size_t length);
+#endif
 #if defined(MIPS32_LE)
 int16_t WebRtcSpl_MinValueW16_mips(const int16_t* vector, size_t length);
 #endif
@@ -257,11 +285,15 @@ int16_t WebRtcSpl_MinValueW16_mips(const int16_t* vector, size_t length);
 //
 // Return value  : Minimum sample value in |vector|.
 typedef int32_t (*MinValueW32)(const int32_t *vector, size_t length);
-extern const MinValueW32 WebRtcSpl_MinValueW32;
+extern MinValueW32 WebRtcSpl_MinValueW32;
 int32_t WebRtcSpl_MinValueW32C(const int32_t *vector, size_t length);
 #if defined(WEBRTC_HAS_NEON)
 int32_t WebRtcSpl_MinValueW32Neon(const int32_t* vector, size_t length);
 #endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int32_t WebRtcSpl_MinValueW32Sse2(const int32_t* vector, size_t length);
+int32_t WebRtcSpl_MinValueW32Avx2(const int32_t* vector, size_t length);
+#endif
 #if defined(MIPS32_LE)
 int32_t WebRtcSpl_MinValueW32_mips(const int32_t* vector, size_t length);
 #endif
@@ -289,8 +321,96 @@ int32_t WebRtcSpl_DivW32W16(int32_t num, int16_t den);
 
 // FFT operations
 
-int WebRtcSpl_ComplexFFT(int16_t vector[], int stages, int mode);
-int WebRtcSpl_ComplexIFFT(int16_t vector[], int stages, int mode);
+// Quarter-wave sine table shared by the complex FFTs, 1024 entries in Q15.
+extern const int16_t WebRtcSpl_kSinTable1024[];
+
+// In-place radix-2 decimation-in-time complex FFT of bit-reversed input.
+//
+// Input:
+//      - vector        : 2^|stages| complex values [Re Im Re Im ...], in
+//                        bit-reversed order.
+//      - stages        : Number of FFT stages, at most 10.
+//      - mode          : 0 for the low-accuracy mode, 1 for the
+//                        high-accuracy mode, which is the one AECM uses.
+//
+// Output:
+//      - vector        : The spectrum, scaled by 2^-|stages|.
+//
+// Return value         : 0 on success, -1 if |stages| is too large.
+//
+// The x86 versions vectorize the high-accuracy mode for at least 8 (SSE2) or
+// 16 (AVX2) points and fuse two stages per pass; the rounding of every stage
+// is kept, so the output is bit-exact with the C version.
+typedef int (*ComplexFFT)(int16_t vector[], int stages, int mode);
+extern ComplexFFT WebRtcSpl_ComplexFFT;
+int WebRtcSpl_ComplexFFTC(int16_t vector[], int stages, int mode);
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int WebRtcSpl_ComplexFFTSse2(int16_t vector[], int stages, int mode);
+int WebRtcSpl_ComplexFFTAvx2(int16_t vector[], int stages, int mode);
+#endif
+
+// In-place complex inverse FFT of bit-reversed input, with data-dependent
+// scaling: every stage is shifted down by 0, 1 or 2 bits depending on the
+// largest absolute value in |vector| before the stage.
+//
+// Input:
+//      - vector        : 2^|stages| complex values [Re Im Re Im ...], in
+//                        bit-reversed order.
+//      - stages        : Number of FFT stages, at most 10.
+//      - mode          : 0 for the low-accuracy mode, 1 for the
+//                        high-accuracy mode.
+//
+// Output:
+//      - vector        : The time signal, scaled by 2^-(return value).
+//
+// Return value         : The total number of bits the output was shifted
+//                        down, or -1 if |stages| is too large.
+//
+// The x86 versions take the maximum for the next stage while storing the
+// current one, instead of scanning |vector| again; results are bit-exact.
+typedef int (*ComplexIFFT)(int16_t vector[], int stages, int mode);
+extern ComplexIFFT WebRtcSpl_ComplexIFFT;
+int WebRtcSpl_ComplexIFFTC(int16_t vector[], int stages, int mode);
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int WebRtcSpl_ComplexIFFTSse2(int16_t vector[], int stages, int mode);
+int WebRtcSpl_ComplexIFFTAvx2(int16_t vector[], int stages, int mode);
+#endif
+
+// Fills the twiddle factor tables of WebRtcSpl_ComplexFFTStages() (|inverse|
+// = 0) or WebRtcSpl_ComplexIFFTStages() (|inverse| = 1) for 2^|stages|
+// points. Both tables hold 2^|stages| - 1 entries.
+void WebRtcSpl_ComplexFFTTwiddles(int stages, int inverse,
+                                  int32_t *w_re, int32_t *w_im);
+
+// The high-accuracy mode of WebRtcSpl_ComplexFFT() and WebRtcSpl_ComplexIFFT()
+// with the twiddle factors read from tables, as the plans of real_fft.c hold
+// them. Stage l = 1, 2, 4, ... reads the l entries from index l - 1. Every
+// entry packs two 16-bit values, low half first: |w_re| holds (wr, -wi) and
+// |w_im| holds (wi, wr), so one multiply-add with [Re Im] gives the real or
+// the imaginary part of the product. The results are bit-exact with the
+// functions above; the IFFT returns the same scale.
+//
+// The x86 versions are specialized at compile time for 6 stages, the complex
+// FFT inside the 128-point real FFT of AECM, and the forward FFT also for 7
+// stages, the FFT that transforms two of the AECM blocks at once.
+typedef int (*ComplexFFTStages)(int16_t vector[], int stages,
+                                const int32_t *w_re, const int32_t *w_im);
+extern ComplexFFTStages WebRtcSpl_ComplexFFTStages;
+extern ComplexFFTStages WebRtcSpl_ComplexIFFTStages;
+int WebRtcSpl_ComplexFFTStagesC(int16_t vector[], int stages,
+                                const int32_t *w_re, const int32_t *w_im);
+int WebRtcSpl_ComplexIFFTStagesC(int16_t vector[], int stages,
+                                 const int32_t *w_re, const int32_t *w_im);
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+int WebRtcSpl_ComplexFFTStagesSse2(int16_t vector[], int stages,
+                                   const int32_t *w_re, const int32_t *w_im);
+int WebRtcSpl_ComplexIFFTStagesSse2(int16_t vector[], int stages,
+                                    const int32_t *w_re, const int32_t *w_im);
+int WebRtcSpl_ComplexFFTStagesAvx2(int16_t vector[], int stages,
+                                   const int32_t *w_re, const int32_t *w_im);
+int WebRtcSpl_ComplexIFFTStagesAvx2(int16_t vector[], int stages,
+                                    const int32_t *w_re, const int32_t *w_im);
+#endif
 
 // Treat a 16-bit complex data buffer |complex_data| as an array of 32-bit
 // values, and swap elements whose indexes are bit-reverses of each other.
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "benchmark_util.h"
+#include "timing.h"
+
+#include "aecm/echo_control_mobile.h"
+
+// Processes 10 ms frames round-robin over 16, 64, ..., MAX_INSTANCES AECM
+// instances on one thread, one frame per instance at a time, as a server with
+// many calls per core does. Once the instances outgrow the caches, every frame
+// starts with the state of its instance evicted, so the time and the cache
+// misses per frame measure how many cache lines a frame touches. The fastest
+// of NUM_RUNS runs is reported. On Linux the L1 data cache read misses and the
+// last level cache misses are counted where the kernel exposes them. The
+// output of all instances is folded into a checksum, which must not change
+// with the instance layout.
+
+#define MAX_INSTANCES 4096
+#define FRAMES_PER_RUN 32768
+#define NUM_RUNS 3
+#define SAMPLE_RATE 16000
+#define FRAME_SAMPLES (SAMPLE_RATE / 100)
+#define SIGNAL_FRAMES 32
+
+typedef struct {
+    int16_t far[SIGNAL_FRAMES][FRAME_SAMPLES];
+    int16_t near[SIGNAL_FRAMES][FRAME_SAMPLES];
+} Signals;
+
+// The signals are shared by all instances, so that they stay in cache and
+// only the instance state is missed.
+static void makeSignals(Signals *signals) {
+    makeEchoSignals(&signals->far[0][0], &signals->near[0][0],
+                    SIGNAL_FRAMES * FRAME_SAMPLES);
+}
+
+// Processes |num_rounds| frames on each of the |num_instances| instances,
+// and returns the checksum of their output.
+static uint32_t runInstances(void **instances, int num_instances, int num_rounds,
+                             int first_frame, const Signals *signals) {
+    int16_t out[FRAME_SAMPLES];
+    uint32_t checksum = CHECKSUM_INIT;
+    int r = 0;
+    int n = 0;
+
+    for (r = 0; r < num_rounds; ++r) {
+        for (n = 0; n < num_instances; ++n) {
+            const int f = (first_frame + r + n) % SIGNAL_FRAMES;
+            WebRtcAecm_BufferFarend(instances[n], signals->far[f], FRAME_SAMPLES);
+            WebRtcAecm_Process(instances[n], signals->near[f], NULL, out,
+                               FRAME_SAMPLES, 20);
+            checksum = foldChecksum(checksum, out, FRAME_SAMPLES);
+        }
+    }
+    return checksum;
+}
+
+int main(int argc, char *argv[]) {
+    Signals *signals = new Signals;
+    void **instances = new void *[MAX_INSTANCES];
+    int num_instances = 0;
+    int n = 0;
+
+    (void) argc;
+    (void) argv;
+    makeSignals(signals);
+    printf("%zu bytes per instance\n", WebRtcAecm_RequiredMemory());
+    printf("instances  ns/frame  L1D misses  LLC misses  checksum\n");
+    for (num_instances = 16; num_instances <= MAX_INSTANCES; num_instances *= 4) {
+        const int num_rounds = FRAMES_PER_RUN / num_instances;
+        const int num_frames = num_rounds * num_instances;
+        double ns_per_frame = 0;
+        double l1_misses_per_frame = -1;
+        double llc_misses_per_frame = -1;
+        uint32_t checksum = 0;
+        int run = 0;
+
+        for (n = 0; n < num_instances; ++n) {
+            instances[n] = WebRtcAecm_Create();
+            if (instances[n] == NULL ||
+                WebRtcAecm_Init(instances[n], SAMPLE_RATE) != 0) {
+                return -1;
+            }
+        }
+        // Gets past the startup of the instances before the timed runs.
+        runInstances(instances, num_instances, SIGNAL_FRAMES, 0, signals);
+        for (run = 0; run < NUM_RUNS; ++run) {
+            double ns = 0;
+            double l1_misses = -1;
+            double llc_misses = -1;
+            double startTime = 0;
+            uint32_t run_checksum = 0;
+            const int l1_fd = openCounter(kL1dReadMisses);
+            const int llc_fd = openCounter(kLlcMisses);
+            startCounter(l1_fd);
+            startCounter(llc_fd);
+            startTime = now();
+            run_checksum = runInstances(instances, num_instances, num_rounds,
+                                        SIGNAL_FRAMES + run * num_rounds, signals);
+            ns = calcElapsed(startTime, now()) * 1e9 / num_frames;
+            l1_misses = stopCounter(l1_fd, num_frames);
+            llc_misses = stopCounter(llc_fd, num_frames);
+            checksum = (checksum ^ run_checksum) * 16777619u;
+            if (run == 0 || ns < ns_per_frame) {
+                ns_per_frame = ns;
+                l1_misses_per_frame = l1_misses;
+                llc_misses_per_frame = llc_misses;
+            }
+        }
+        for (n = 0; n < num_instances; ++n) {
+            WebRtcAecm_Free(instances[n]);
+        }
+        printf("%9d  %8.0f", num_instances, ns_per_frame);
+        printCount(l1_misses_per_frame, 10);
+        printCount(llc_misses_per_frame, 10);
+        printf("  %08x\n", checksum);
+    }
+    delete[] instances;
+    delete signals;
+    return 0;
+}
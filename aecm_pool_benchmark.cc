@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "timing.h"
+
+#include "aecm/echo_control_mobile.h"
+
+// Sets up and tears down NUM_CALLS calls at CALLS_PER_SECOND, with
+// LIVE_CALLS calls up at a time, first with WebRtcAecm_Create(),
+// WebRtcAecm_Init() and WebRtcAecm_Free(), then with an instance pool. Each
+// call processes CALL_FRAMES frames, so that the instances have state to
+// reset when they return to the pool. The output of every call must match
+// that of the first call on a fresh instance.
+
+#define NUM_CALLS 3000
+#define CALLS_PER_SECOND 1000
+#define LIVE_CALLS 64
+#define CALL_FRAMES 8
+#define SAMPLE_RATE 16000
+#define FRAME_SAMPLES (SAMPLE_RATE / 100)
+
+typedef struct {
+    int16_t far[CALL_FRAMES][FRAME_SAMPLES];
+    int16_t near[CALL_FRAMES][FRAME_SAMPLES];
+    int16_t reference[CALL_FRAMES][FRAME_SAMPLES];
+} Signals;
+
+static void makeSignals(Signals *signals) {
+    makeEchoSignals(&signals->far[0][0], &signals->near[0][0],
+                    CALL_FRAMES * FRAME_SAMPLES);
+}
+
+// Returns 1 if the output of the call matches |reference|, or fills it in if
+// |record| is set.
+static int runCall(void *aecm, Signals *signals, int record) {
+    int16_t out[FRAME_SAMPLES];
+    int match = 1;
+    int f = 0;
+
+    for (f = 0; f < CALL_FRAMES; ++f) {
+        WebRtcAecm_BufferFarend(aecm, signals->far[f], FRAME_SAMPLES);
+        WebRtcAecm_Process(aecm, signals->near[f], NULL, out, FRAME_SAMPLES, 20);
+        if (record) {
+            memcpy(signals->reference[f], out, sizeof(out));
+        } else {
+            match &= (memcmp(signals->reference[f], out, sizeof(out)) == 0);
+        }
+    }
+    return match;
+}
+
+typedef struct {
+    std::vector<double> setup;
+    std::vector<double> teardown;
+    int mismatches;
+} Latencies;
+
+static void *setupCall(void *pool) {
+    void *aecm = NULL;
+    if (pool) {
+        return WebRtcAecm_PoolAcquire(pool);
+    }
+    aecm = WebRtcAecm_Create();
+    if (aecm && WebRtcAecm_Init(aecm, SAMPLE_RATE) != 0) {
+        WebRtcAecm_Free(aecm);
+        return NULL;
+    }
+    return aecm;
+}
+
+static void tearDownCall(void *pool, void *aecm) {
+    if (pool) {
+        WebRtcAecm_PoolRelease(pool, aecm);
+    } else {
+        WebRtcAecm_Free(aecm);
+    }
+}
+
+// Paced call churn: every 1 / CALLS_PER_SECOND s the oldest call ends and a
+// new one starts.
+static int runChurn(void *pool, Signals *signals, Latencies *latencies) {
+    const std::chrono::nanoseconds period(1000000000 / CALLS_PER_SECOND);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    void *calls[LIVE_CALLS] = {NULL};
+    double startTime = 0;
+    int n = 0;
+
+    latencies->mismatches = 0;
+    for (n = 0; n < NUM_CALLS + LIVE_CALLS; ++n) {
+        void **slot = &calls[n % LIVE_CALLS];
+        std::this_thread::sleep_until(next);
+        next += period;
+
+        if (*slot) {
+            startTime = now();
+            tearDownCall(pool, *slot);
+            latencies->teardown.push_back(calcElapsed(startTime, now()));
+            *slot = NULL;
+        }
+        if (n >= NUM_CALLS) {
+            continue;
+        }
+        startTime = now();
+        *slot = setupCall(pool);
+        latencies->setup.push_back(calcElapsed(startTime, now()));
+        if (*slot == NULL) {
+            return -1;
+        }
+        latencies->mismatches += !runCall(*slot, signals, 0);
+    }
+    return 0;
+}
+
+static double percentile(std::vector<double> values, double fraction) {
+    size_t index = 0;
+    std::sort(values.begin(), values.end());
+    index = (size_t) (fraction * (values.size() - 1));
+    return values[index];
+}
+
+static double mean(const std::vector<double> &values) {
+    double sum = 0;
+    size_t i = 0;
+    for (i = 0; i < values.size(); ++i) {
+        sum += values[i];
+    }
+    return sum / values.size();
+}
+
+static void printLatencies(const char *name, const std::vector<double> &values) {
+    printf("%-9s %-8s  %7.2f  %7.2f  %7.2f  %8.2f\n", "", name,
+           mean(values) * 1e6, percentile(values, 0.5) * 1e6,
+           percentile(values, 0.99) * 1e6, percentile(values, 1.0) * 1e6);
+}
+
+int main(int argc, char *argv[]) {
+    Signals *signals = new Signals;
+    Latencies heap;
+    Latencies pooled;
+    void *aecm = NULL;
+    void *pool = NULL;
+    double startTime = 0;
+    double poolCreateTime = 0;
+
+    (void) argc;
+    (void) argv;
+    makeSignals(signals);
+    aecm = setupCall(NULL);
+    if (aecm == NULL) {
+        return -1;
+    }
+    runCall(aecm, signals, 1);
+    WebRtcAecm_Free(aecm);
+
+    if (runChurn(NULL, signals, &heap) != 0) {
+        return -1;
+    }
+    startTime = now();
+    pool = WebRtcAecm_PoolCreate(LIVE_CALLS, SAMPLE_RATE);
+    poolCreateTime = calcElapsed(startTime, now());
+    if (pool == NULL || runChurn(pool, signals, &pooled) != 0) {
+        return -1;
+    }
+    WebRtcAecm_PoolFree(pool);
+
+    printf("%d calls at %d calls/s, %d live, pool of %d created in %.2f ms\n",
+           NUM_CALLS, CALLS_PER_SECOND, LIVE_CALLS, LIVE_CALLS,
+           poolCreateTime * 1e3);
+    printf("%-9s %-8s  %7s  %7s  %7s  %8s  (us)\n", "", "", "mean", "p50", "p99",
+           "max");
+    printf("create/free, %d mismatching calls\n", heap.mismatches);
+    printLatencies("setup", heap.setup);
+    printLatencies("teardown", heap.teardown);
+    printf("pool, %d mismatching calls\n", pooled.mismatches);
+    printLatencies("setup", pooled.setup);
+    printLatencies("teardown", pooled.teardown);
+    delete signals;
+    return 0;
+}
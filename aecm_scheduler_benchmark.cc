@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+
+#include "benchmark_util.h"
+#include "timing.h"
+
+#include "aecm/aecm_scheduler.h"
+
+// Runs NUM_INSTANCES AECM instances through the scheduler with 1, 2, 4, ...
+// worker threads, up to one per hardware thread. The frames are submitted as
+// fast as the queues take them, so the rate is the throughput of the pool.
+// Each instance's output is folded into a checksum, which must match that of
+// the same instances processed one after the other on the calling thread.
+
+#define NUM_INSTANCES 256
+#define NUM_FRAMES 400
+#define SAMPLE_RATE 16000
+#define FRAME_SAMPLES (SAMPLE_RATE / 100)
+#define SIGNAL_FRAMES 32
+
+typedef struct {
+    void *aecm;
+    void *stream;
+    int16_t out[AECM_MAX_QUEUED_FRAMES][FRAME_SAMPLES];
+    int16_t far[SIGNAL_FRAMES][FRAME_SAMPLES];
+    int16_t near[SIGNAL_FRAMES][FRAME_SAMPLES];
+    uint32_t checksum;
+    int nextOut;
+    std::atomic<int> framesDone;
+} Instance;
+
+static std::atomic<int> deadlinesMissed(0);
+
+// The near end is the far end of the instance, delayed by a different number
+// of samples per instance and attenuated, plus noise.
+static void makeSignals(Instance *instances) {
+    int n = 0;
+    int f = 0;
+    int k = 0;
+
+    seed = 1;
+    for (n = 0; n < NUM_INSTANCES; ++n) {
+        const int delay = 100 + 7 * n;
+        for (f = 0; f < SIGNAL_FRAMES; ++f) {
+            for (k = 0; k < FRAME_SAMPLES; ++k) {
+                instances[n].far[f][k] = uniformRand(4000);
+            }
+        }
+        for (f = 0; f < SIGNAL_FRAMES; ++f) {
+            for (k = 0; k < FRAME_SAMPLES; ++k) {
+                const int t = (f * FRAME_SAMPLES + k - delay +
+                               SIGNAL_FRAMES * FRAME_SAMPLES) %
+                              (SIGNAL_FRAMES * FRAME_SAMPLES);
+                instances[n].near[f][k] = (int16_t) (
+                        instances[n].far[t / FRAME_SAMPLES][t % FRAME_SAMPLES] / 2 +
+                        uniformRand(100));
+            }
+        }
+    }
+}
+
+static int createInstances(Instance *instances) {
+    int n = 0;
+    for (n = 0; n < NUM_INSTANCES; ++n) {
+        instances[n].aecm = WebRtcAecm_Create();
+        if (instances[n].aecm == NULL ||
+            WebRtcAecm_Init(instances[n].aecm, SAMPLE_RATE) != 0) {
+            return -1;
+        }
+        instances[n].checksum = CHECKSUM_INIT;
+        instances[n].nextOut = 0;
+        instances[n].framesDone = 0;
+    }
+    return 0;
+}
+
+static void freeInstances(Instance *instances) {
+    int n = 0;
+    for (n = 0; n < NUM_INSTANCES; ++n) {
+        WebRtcAecm_Free(instances[n].aecm);
+    }
+}
+
+// The callbacks of an instance come in order, so its output slots are
+// consumed in the order they were handed out.
+static void frameDone(void *userData, int32_t status, int missedDeadline) {
+    Instance *instance = static_cast<Instance *>(userData);
+    (void) status;
+    instance->checksum = foldChecksum(instance->checksum,
+                                      instance->out[instance->nextOut],
+                                      FRAME_SAMPLES);
+    instance->nextOut = (instance->nextOut + 1) % AECM_MAX_QUEUED_FRAMES;
+    if (missedDeadline) {
+        deadlinesMissed.fetch_add(1);
+    }
+    instance->framesDone.fetch_add(1);
+}
+
+static uint32_t runSequential(Instance *instances) {
+    uint32_t checksum = 0;
+    int f = 0;
+    int n = 0;
+
+    for (f = 0; f < NUM_FRAMES; ++f) {
+        for (n = 0; n < NUM_INSTANCES; ++n) {
+            WebRtcAecm_BufferFarend(instances[n].aecm,
+                                    instances[n].far[f % SIGNAL_FRAMES],
+                                    FRAME_SAMPLES);
+            WebRtcAecm_Process(instances[n].aecm,
+                               instances[n].near[f % SIGNAL_FRAMES], NULL,
+                               instances[n].out[0], FRAME_SAMPLES, 20);
+            instances[n].checksum = foldChecksum(instances[n].checksum,
+                                                 instances[n].out[0],
+                                                 FRAME_SAMPLES);
+        }
+    }
+    for (n = 0; n < NUM_INSTANCES; ++n) {
+        checksum = checksum * 31u + instances[n].checksum;
+    }
+    return checksum;
+}
+
+static uint32_t runScheduled(Instance *instances, size_t num_threads,
+                             double *frames_per_second) {
+    void *scheduler = WebRtcAecm_CreateScheduler(num_threads);
+    uint32_t checksum = 0;
+    double startTime = 0;
+    int f = 0;
+    int n = 0;
+
+    for (n = 0; n < NUM_INSTANCES; ++n) {
+        instances[n].stream = WebRtcAecm_AttachStream(scheduler, instances[n].aecm);
+    }
+    deadlinesMissed = 0;
+    startTime = now();
+    for (f = 0; f < NUM_FRAMES; ++f) {
+        for (n = 0; n < NUM_INSTANCES; ++n) {
+            // A full queue pushes back on the submitter. The output slots
+            // are as many as the queue has frames.
+            while (f - instances[n].framesDone.load() >= AECM_MAX_QUEUED_FRAMES ||
+                   WebRtcAecm_SubmitFarend(instances[n].stream,
+                                           instances[n].far[f % SIGNAL_FRAMES],
+                                           FRAME_SAMPLES) == AECM_QUEUE_FULL_ERROR) {
+                std::this_thread::yield();
+            }
+            while (WebRtcAecm_SubmitProcess(
+                    instances[n].stream, instances[n].near[f % SIGNAL_FRAMES], NULL,
+                    instances[n].out[f % AECM_MAX_QUEUED_FRAMES], FRAME_SAMPLES, 20,
+                    frameDone, &instances[n]) == AECM_QUEUE_FULL_ERROR) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    for (n = 0; n < NUM_INSTANCES; ++n) {
+        WebRtcAecm_DetachStream(instances[n].stream);
+    }
+    *frames_per_second = NUM_FRAMES * NUM_INSTANCES / calcElapsed(startTime, now());
+    WebRtcAecm_FreeScheduler(scheduler);
+
+    for (n = 0; n < NUM_INSTANCES; ++n) {
+        checksum = checksum * 31u + instances[n].checksum;
+    }
+    return checksum;
+}
+
+int main(int argc, char *argv[]) {
+    Instance *instances = new Instance[NUM_INSTANCES];
+    size_t max_threads = std::thread::hardware_concurrency();
+    size_t num_threads = 0;
+    uint32_t reference = 0;
+    double startTime = 0;
+    double sequential_rate = 0;
+
+    (void) argc;
+    (void) argv;
+    if (max_threads == 0) {
+        max_threads = 1;
+    }
+    makeSignals(instances);
+    if (createInstances(instances) != 0) {
+        return -1;
+    }
+    startTime = now();
+    reference = runSequential(instances);
+    sequential_rate = NUM_FRAMES * NUM_INSTANCES / calcElapsed(startTime, now());
+    freeInstances(instances);
+
+    printf("threads  match  frames/s  speedup  missed deadlines\n");
+    printf("%7s  %5s  %8.0f  %7.2f  %16s\n", "none", "-", sequential_rate, 1.0, "-");
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        double rate = 0;
+        uint32_t checksum = 0;
+        if (createInstances(instances) != 0) {
+            return -1;
+        }
+        checksum = runScheduled(instances, num_threads, &rate);
+        printf("%7d  %5s  %8.0f  %7.2f  %16d\n", (int) num_threads,
+               checksum == reference ? "yes" : "NO", rate, rate / sequential_rate,
+               deadlinesMissed.load());
+        freeInstances(instances);
+    }
+    delete[] instances;
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "benchmark_util.h"
+#include "timing.h"
+
+#include "aecm/aecm_core.h"
+
+// Times the spectral pipeline of WebRtcAecm_ProcessBlock(), i.e., the
+// adaptive channel update, the channel store or reset and the Wiener filter,
+// on synthetic spectra for each of the channel updates. The fastest of
+// NUM_RUNS runs is reported. On Linux the L1 data cache reads and the cycles
+// are counted where the kernel exposes them.
+
+#define NUM_BLOCKS 100000
+#define NUM_RUNS 9
+#define NUM_INPUTS 64
+#define STEP_SIZE 4
+
+static const char *kChannelUpdateNames[3] = {"keep", "store", "reset"};
+
+typedef struct {
+    uint16_t far_spectrum[PART_LEN1];
+    uint16_t dfa[PART_LEN1];
+    ComplexInt16 dfw[PART_LEN1];
+} SpectralInput;
+
+// Returns a random value in [0, max).
+static uint16_t positiveRand(uint16_t max) {
+    return (uint16_t) (nextRand() % max);
+}
+
+static void makeInputs(SpectralInput *inputs) {
+    int n = 0;
+    int i = 0;
+
+    seed = 1;
+    for (n = 0; n < NUM_INPUTS; ++n) {
+        for (i = 0; i < PART_LEN1; ++i) {
+            inputs[n].far_spectrum[i] = positiveRand(4000);
+            inputs[n].dfa[i] = positiveRand(3000);
+            inputs[n].dfw[i].real = (int16_t) (positiveRand(8000) - 4000);
+            inputs[n].dfw[i].imag = (int16_t) (positiveRand(8000) - 4000);
+        }
+    }
+}
+
+static AecmCore *createCore() {
+    AecmCore *aecm = WebRtcAecm_CreateCore();
+    if (aecm == NULL || WebRtcAecm_InitCore(aecm, 16000) != 0) {
+        return NULL;
+    }
+    aecm->dfaNoisyQDomain = 2;
+    aecm->dfaCleanQDomain = 2;
+    aecm->dfaCleanQDomainOld = 2;
+    return aecm;
+}
+
+static void processBlock(AecmCore *aecm, const SpectralInput *input,
+                         int channel_update, int32_t *echo_est,
+                         ComplexInt16 *efw, int16_t *hnl) {
+    const int16_t far_q = 1;
+    int i = 0;
+
+    // The echo estimate through the stored channel, as after
+    // WebRtcAecm_CalcEnergies().
+    for (i = 0; i < PART_LEN1; ++i) {
+        echo_est[i] = WEBRTC_SPL_MUL_16_U16(aecm->channelStored[i],
+                                            input->far_spectrum[i]);
+    }
+    WebRtcAecm_UpdateAdaptiveChannel(aecm, input->far_spectrum, far_q,
+                                     input->dfa, STEP_SIZE);
+    if (channel_update == kAecmStoreChannel) {
+        WebRtcAecm_StoreAdaptiveChannel(aecm, input->far_spectrum, echo_est);
+    } else if (channel_update == kAecmResetChannel) {
+        WebRtcAecm_ResetAdaptiveChannel(aecm);
+    }
+    WebRtcAecm_ApplyWienerFilter(aecm, echo_est, input->dfa, far_q,
+                                 SUPGAIN_DEFAULT, input->dfw, efw, hnl);
+}
+
+static void runPipeline(const SpectralInput *inputs, int channel_update, double *ns_per_block,
+                        double *l1_reads_per_block, double *cycles_per_block) {
+    AecmCore *aecm = createCore();
+    int32_t echo_est[PART_LEN1];
+    ComplexInt16 efw[PART_LEN1];
+    int16_t hnl[PART_LEN1];
+    int n = 0;
+    double startTime = 0;
+    int l1_fd = -1;
+    int cycles_fd = -1;
+
+    *l1_reads_per_block = -1;
+    *cycles_per_block = -1;
+    if (aecm == NULL) {
+        *ns_per_block = -1;
+        return;
+    }
+    l1_fd = openCounter(kL1dReads);
+    cycles_fd = openCounter(kCycles);
+    startCounter(l1_fd);
+    startCounter(cycles_fd);
+    startTime = now();
+    for (n = 0; n < NUM_BLOCKS; ++n) {
+        processBlock(aecm, &inputs[n % NUM_INPUTS], channel_update, echo_est,
+                     efw, hnl);
+    }
+    *ns_per_block = calcElapsed(startTime, now()) * 1e9 / NUM_BLOCKS;
+    *l1_reads_per_block = stopCounter(l1_fd, NUM_BLOCKS);
+    *cycles_per_block = stopCounter(cycles_fd, NUM_BLOCKS);
+    WebRtcAecm_FreeCore(aecm);
+}
+
+int main(int argc, char *argv[]) {
+    SpectralInput *inputs = (SpectralInput *) malloc(NUM_INPUTS * sizeof(SpectralInput));
+    int channel_update = 0;
+
+    (void) argc;
+    (void) argv;
+    makeInputs(inputs);
+    printf("channel  ns/block  L1 reads     cycles\n");
+    for (channel_update = kAecmKeepChannel; channel_update <= kAecmResetChannel;
+         ++channel_update) {
+        double ns_per_block = 0;
+        double l1_reads_per_block = 0;
+        double cycles_per_block = 0;
+        int run = 0;
+        for (run = 0; run < NUM_RUNS; ++run) {
+            double ns = 0;
+            double l1_reads = 0;
+            double cycles = 0;
+            runPipeline(inputs, channel_update, &ns, &l1_reads, &cycles);
+            if (run == 0 || ns < ns_per_block) {
+                ns_per_block = ns;
+                l1_reads_per_block = l1_reads;
+                cycles_per_block = cycles;
+            }
+        }
+        printf("%-7s  %8.0f", kChannelUpdateNames[channel_update], ns_per_block);
+        printCount(l1_reads_per_block, 9);
+        printCount(cycles_per_block, 9);
+        printf("\n");
+    }
+    free(inputs);
+    return 0;
+}
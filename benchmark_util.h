@@ -0,0 +1,146 @@
+#ifndef BENCHMARK_UTIL_H_
+#define BENCHMARK_UTIL_H_
+
+// Helpers shared by the benchmarks: a reproducible noise source, echo test
+// signals, output checksums and hardware event counters.
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static uint32_t seed = 1;
+
+// Returns the next 24 random bits.
+static inline uint32_t nextRand() {
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+// Returns a random value in [-max, max).
+static inline int16_t uniformRand(int max) {
+    return (int16_t) ((int) (nextRand() % (2 * max)) - max);
+}
+
+// Fills |far| with noise and |near| with its echo, the far end attenuated by
+// 6 dB plus some near end noise.
+static inline void makeEchoSignals(int16_t *far, int16_t *near,
+                                   size_t numSamples) {
+    size_t k = 0;
+
+    for (k = 0; k < numSamples; ++k) {
+        far[k] = uniformRand(4000);
+        near[k] = (int16_t) (far[k] / 2 + uniformRand(100));
+    }
+}
+
+#define CHECKSUM_INIT 2166136261u
+
+// Folds |samples| into |checksum|, which starts at CHECKSUM_INIT.
+static inline uint32_t foldChecksum(uint32_t checksum,
+                                    const int16_t *samples,
+                                    size_t numSamples) {
+    size_t k = 0;
+    for (k = 0; k < numSamples; ++k) {
+        checksum = (checksum ^ (uint16_t) samples[k]) * 16777619u;
+    }
+    return checksum;
+}
+
+enum {
+    kCycles = 0,
+    kL1dReads,
+    kL1dReadMisses,
+    kLlcMisses
+};
+
+// Opens a counter of |event| for the calling thread in user space. Returns
+// -1 where the kernel does not expose it, and the other counter functions
+// then do nothing.
+static inline int openCounter(int event) {
+#if defined(__linux__)
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    switch (event) {
+        case kCycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case kL1dReads:
+        case kL1dReadMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D |
+                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           ((event == kL1dReads ? PERF_COUNT_HW_CACHE_RESULT_ACCESS
+                                                : PERF_COUNT_HW_CACHE_RESULT_MISS)
+                            << 16);
+            break;
+        case kLlcMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        default:
+            return -1;
+    }
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void) event;
+    return -1;
+#endif
+}
+
+static inline void startCounter(int fd) {
+#if defined(__linux__)
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    (void) fd;
+#endif
+}
+
+// Stops and closes the counter, and returns its count divided by |units|, or
+// a negative value if not available.
+static inline double stopCounter(int fd, double units) {
+#if defined(__linux__)
+    long long count = 0;
+    ssize_t bytes = 0;
+    if (fd < 0) {
+        return -1;
+    }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    bytes = read(fd, &count, sizeof(count));
+    close(fd);
+    if (bytes != sizeof(count)) {
+        return -1;
+    }
+    return (double) count / units;
+#else
+    (void) fd;
+    (void) units;
+    return -1;
+#endif
+}
+
+// Prints a count from stopCounter() in a column of |width|.
+static inline void printCount(double count, int width) {
+    if (count < 0) {
+        printf("  %*s", width, "n/a");
+    } else {
+        printf("  %*.0f", width, count);
+    }
+}
+
+#endif  // BENCHMARK_UTIL_H_
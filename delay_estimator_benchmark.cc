@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "timing.h"
+
+#include "aecm/delay_estimator_wrapper.h"
+
+// Compares the exhaustive, the coarse-to-fine and the hint-guided delay search,
+// and the exhaustive and the hint-guided search with robust validation, on
+// synthetic spectra. The far-end spectrum is a log-magnitude AR(1) process
+// per bin, the near end the far end delayed and attenuated plus noise. The
+// delay jumps half way, and the accuracy counts the blocks with the true delay
+// in the second half of each segment, after convergence. The delay hint stays
+// at the first delay, so it is wrong after the jump.
+
+#define SPECTRUM_SIZE 65
+#define NUM_BLOCKS 40000
+#define HINT_WINDOW 8
+
+enum {
+    kExhaustive = 0,
+    kCoarseToFine,
+    kHintGuided,
+    kRobustValidation,
+    kHintGuidedRobust,
+    kNumSearchModes
+};
+
+static const char *kSearchModeNames[kNumSearchModes] = {
+        "exhaustive", "coarse-to-fine", "hint-guided", "robust",
+        "hint-robust"};
+
+static uint32_t seed = 1;
+
+static float uniformRand() {
+    seed = seed * 1664525u + 1013904223u;
+    return (float) (seed >> 8) / (float) (1 << 24);
+}
+
+static void makeSpectra(uint16_t *far, uint16_t *near, int history_size) {
+    float level[SPECTRUM_SIZE] = {0};
+    int delays[2] = {history_size * 3 / 10, history_size * 8 / 10};
+    int n = 0;
+    int i = 0;
+
+    seed = 1;
+    for (n = 0; n < NUM_BLOCKS; ++n) {
+        for (i = 0; i < SPECTRUM_SIZE; ++i) {
+            level[i] = 0.8f * level[i] + (uniformRand() - 0.5f) * 2.f;
+            far[n * SPECTRUM_SIZE + i] = (uint16_t) (1000.f * powf(2.f, level[i]));
+        }
+    }
+    for (n = 0; n < NUM_BLOCKS; ++n) {
+        int delay = delays[n >= NUM_BLOCKS / 2];
+        for (i = 0; i < SPECTRUM_SIZE; ++i) {
+            float echo = n >= delay ? 0.5f * far[(n - delay) * SPECTRUM_SIZE + i] : 0.f;
+            near[n * SPECTRUM_SIZE + i] = (uint16_t) (echo + 100.f * uniformRand());
+        }
+    }
+}
+
+static void runEstimator(const uint16_t *far, const uint16_t *near, int history_size,
+                         int search_mode, double *accuracy, double *ns_per_block) {
+    int delays[2] = {history_size * 3 / 10, history_size * 8 / 10};
+    void *farend = WebRtc_CreateDelayEstimatorFarend(SPECTRUM_SIZE, history_size);
+    void *estimator = WebRtc_CreateDelayEstimator(farend, 0);
+    int hits = 0;
+    int counted = 0;
+    int n = 0;
+    double startTime = 0;
+
+    WebRtc_InitDelayEstimatorFarend(farend);
+    WebRtc_InitDelayEstimator(estimator);
+    WebRtc_enable_coarse_search(estimator, search_mode == kCoarseToFine);
+    WebRtc_enable_robust_validation(estimator,
+                                    search_mode == kRobustValidation ||
+                                            search_mode == kHintGuidedRobust);
+    if (search_mode == kHintGuided || search_mode == kHintGuidedRobust) {
+        WebRtc_set_delay_hint_window(estimator, HINT_WINDOW);
+        WebRtc_set_delay_hint(estimator, delays[0]);
+    }
+    startTime = now();
+    for (n = 0; n < NUM_BLOCKS; ++n) {
+        int delay = 0;
+        WebRtc_AddFarSpectrumFix(farend, &far[n * SPECTRUM_SIZE], SPECTRUM_SIZE, 0);
+        delay = WebRtc_DelayEstimatorProcessFix(estimator, &near[n * SPECTRUM_SIZE],
+                                                SPECTRUM_SIZE, 0);
+        if ((n % (NUM_BLOCKS / 2)) >= NUM_BLOCKS / 4) {
+            hits += (delay == delays[n >= NUM_BLOCKS / 2]);
+            counted++;
+        }
+    }
+    *ns_per_block = calcElapsed(startTime, now()) * 1e9 / NUM_BLOCKS;
+    *accuracy = (double) hits / counted;
+    WebRtc_FreeDelayEstimator(estimator);
+    WebRtc_FreeDelayEstimatorFarend(farend);
+}
+
+int main(int argc, char *argv[]) {
+    const int history_sizes[4] = {100, 250, 500, 1000};
+    uint16_t *far = (uint16_t *) malloc(NUM_BLOCKS * SPECTRUM_SIZE * sizeof(uint16_t));
+    uint16_t *near = (uint16_t *) malloc(NUM_BLOCKS * SPECTRUM_SIZE * sizeof(uint16_t));
+    int i = 0;
+
+    (void) argc;
+    (void) argv;
+    printf("history  search          accuracy  ns/block\n");
+    for (i = 0; i < 4; ++i) {
+        int mode = 0;
+        makeSpectra(far, near, history_sizes[i]);
+        for (mode = 0; mode < kNumSearchModes; ++mode) {
+            double accuracy = 0;
+            double ns_per_block = 0;
+            runEstimator(far, near, history_sizes[i], mode, &accuracy, &ns_per_block);
+            printf("%7d  %-14s  %8.3f  %8.0f\n", history_sizes[i],
+                   kSearchModeNames[mode], accuracy, ns_per_block);
+        }
+    }
+    free(far);
+    free(near);
+    return 0;
+}